@@ -0,0 +1,523 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+ ****************************************************************************
+ * alerts.c
+ *      threshold alerts on header metrics and columns of contexts.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#include <pwd.h>
+#include "include/alerts.h"
+
+/*
+ ****************************************************************************
+ * Find context by name used in alert rules, return -1 if there is no such
+ * context.
+ ****************************************************************************
+ */
+int context_lookup(const char * name)
+{
+    static const struct { const char * name; enum context context; } names[] = {
+        { "databases", pg_stat_database },
+        { "replication", pg_stat_replication },
+        { "tables", pg_stat_tables },
+        { "indexes", pg_stat_indexes },
+        { "tables_io", pg_statio_tables },
+        { "sizes", pg_tables_size },
+        { "activity", pg_stat_activity_long },
+        { "functions", pg_stat_functions },
+        { "statements_timing", pg_stat_statements_timing },
+        { "statements_general", pg_stat_statements_general },
+        { "statements_io", pg_stat_statements_io },
+        { "statements_temp", pg_stat_statements_temp },
+        { "statements_local", pg_stat_statements_local },
+        { "statements_agg", pg_stat_statements_agg },
+        { "progress", pg_stat_progress_vacuum },
+        { "proc", pg_stat_proc },
+        { "waits", pg_wait_profile },
+        { "locks", pg_locks_tree },
+        { "bloat", pg_tables_bloat },
+        { "wraparound", pg_xid_wraparound },
+        { "buffercache", pg_buffercache },
+        { "connections", pg_stat_connections },
+        { "index_usage", pg_index_usage },
+        { NULL, 0 } };
+    int i;
+
+    for (i = 0; names[i].name != NULL; i++)
+        if (!strcmp(names[i].name, name))
+            return names[i].context;
+
+    return -1;
+}
+
+/*
+ ****************************************************************************
+ * Compile alert rule, return false if rule is wrong. Rules look like:
+ *   <target> <op> <value> [for <duration>] [run <command>]
+ *   <target> drops|rises <N>% vs <duration> [avg] [for <duration>] [run <command>]
+ * where target is header metric or <context>.<column>, op is one of
+ * >, >=, <, <=, =, != and values may have suffixes like 5min or 1GB.
+ ****************************************************************************
+ */
+bool parse_alert_rule(const char * line, struct alert_rule_s * rule)
+{
+    static const char * ops[] = { ">", ">=", "<", "<=", "=", "!=", "drops", "rises" };
+    char buf[L_BUF_LEN], * tokens[ALERT_MAX_TOKENS], * p, * save, * dot;
+    int i, n = 0, next;
+    size_t len;
+
+    memset(rule, 0, sizeof(struct alert_rule_s));
+    rule->metric = -1;
+    snprintf(buf, sizeof(buf), "%s", line);
+    buf[strcspn(buf, "\r\n")] = '\0';
+
+    /* command is the rest of the line */
+    if ((p = strstr(buf, " run ")) != NULL) {
+        *p = '\0';
+        for (p += 5; *p == ' ' || *p == '\t'; p++)
+            ;
+        snprintf(rule->hook, sizeof(rule->hook), "%s", p);
+    }
+
+    for (p = strtok_r(buf, " \t", &save); p != NULL; p = strtok_r(NULL, " \t", &save)) {
+        if (n == ALERT_MAX_TOKENS)
+            return false;
+        tokens[n++] = p;
+    }
+    if (n < 3)
+        return false;
+
+    /* target */
+    if ((dot = strchr(tokens[0], '.')) != NULL) {
+        *dot = '\0';
+        if ((i = context_lookup(tokens[0])) < 0 || dot[1] == '\0')
+            return false;
+        *dot = '.';
+        rule->context = i;
+        snprintf(rule->column, sizeof(rule->column), "%s", dot + 1);
+    } else if ((rule->metric = metric_lookup(tokens[0])) < 0)
+        return false;
+
+    for (i = 0; i <= alert_rises && strcmp(tokens[1], ops[i]); i++)
+        ;
+    if (i > alert_rises)
+        return false;
+    rule->op = i;
+
+    if (isnan(rule->value = str_to_value(tokens[2])))
+        return false;
+    next = 3;
+
+    /* changes are tracked only for header metrics */
+    if (rule->op == alert_drops || rule->op == alert_rises) {
+        if (rule->metric < 0 || n < 5 || strcmp(tokens[3], "vs")
+                || isnan(rule->window = str_to_value(tokens[4])) || rule->window <= 0)
+            return false;
+        next = 5;
+        if (next < n && !strcmp(tokens[next], "avg"))
+            next++;
+    }
+
+    if (next + 1 < n && !strcmp(tokens[next], "for")) {
+        if (isnan(rule->hold = str_to_value(tokens[next + 1])) || rule->hold < 0)
+            return false;
+        next += 2;
+    }
+    if (next != n)
+        return false;
+
+    /* normalized condition for messages */
+    for (i = 0, len = 0; i < n && len < sizeof(rule->text); i++)
+        len += snprintf(rule->text + len, sizeof(rule->text) - len, "%s%s", (i > 0) ? " " : "", tokens[i]);
+
+    return true;
+}
+
+/*
+ ****************************************************************************
+ * Load alert rules from file specified at startup or from ~/.pgcenteralerts.
+ * Return NULL if there are no rules. Wrong rules are fatal, so mistakes are
+ * noticed at startup, not when alert should fire.
+ ****************************************************************************
+ */
+struct alerts_s * load_alerts(struct args_s * args)
+{
+    struct alerts_s * alerts;
+    char path[PATH_MAX], strbuf[XXXL_BUF_LEN], * p;
+    const struct passwd * pw = getpwuid(getuid());
+    unsigned int line = 0;
+    FILE * fp;
+
+    if (strlen(args->alertfile) != 0)
+        snprintf(path, sizeof(path), "%s", args->alertfile);
+    else if (pw != NULL)
+        snprintf(path, sizeof(path), "%s/%s", pw->pw_dir, PGCENTERALERTS_FILE);
+    else
+        return NULL;
+
+    if ((fp = fopen(path, "r")) == NULL) {
+        if (strlen(args->alertfile) != 0)
+            mreport(true, msg_fatal, "FATAL: no access to %s.\n", path);
+        return NULL;
+    }
+
+    if ((alerts = (struct alerts_s *) malloc(ALERTS_SIZE)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for alert rules failed.\n");
+    }
+    memset(alerts, 0, ALERTS_SIZE);
+
+    while (fgets(strbuf, sizeof(strbuf), fp) != NULL) {
+        line++;
+        for (p = strbuf; *p == ' ' || *p == '\t'; p++)
+            ;
+        /* skip comments and empty lines */
+        if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0')
+            continue;
+
+        if (alerts->n_rules == ALERT_RULES_MAX)
+            mreport(true, msg_fatal, "FATAL: %s: too many alert rules, max %d.\n", path, ALERT_RULES_MAX);
+        if (!parse_alert_rule(p, &alerts->rules[alerts->n_rules]))
+            mreport(true, msg_fatal, "FATAL: %s:%u: wrong alert rule: %s", path, line, p);
+        alerts->n_rules++;
+    }
+    fclose(fp);
+
+    if (alerts->n_rules == 0) {
+        free(alerts);
+        return NULL;
+    }
+
+    return alerts;
+}
+
+/*
+ ****************************************************************************
+ * Allocate alerts state of tab.
+ ****************************************************************************
+ */
+struct alert_tab_s * alert_tab_init(struct alerts_s * alerts)
+{
+    struct alert_tab_s * at;
+
+    if ((at = (struct alert_tab_s *) malloc(ALERT_TAB_SIZE)) == NULL
+        || (at->states = calloc(alerts->n_rules, sizeof(struct alert_state_s))) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for alerts state failed.\n");
+    }
+    at->marks = NULL;
+    at->marks_size = at->n_rows = at->n_cols = 0;
+    at->shown = false;
+
+    return at;
+}
+
+/*
+ ****************************************************************************
+ * Free alerts state of tab.
+ ****************************************************************************
+ */
+void free_alert_tab(struct alert_tab_s * at)
+{
+    if (at == NULL)
+        return;
+
+    free(at->states);
+    free(at->marks);
+    free(at);
+}
+
+/*
+ ****************************************************************************
+ * Seconds between two moments.
+ ****************************************************************************
+ */
+double alert_elapsed(struct timespec * from, struct timespec * to)
+{
+    return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1000000000.0;
+}
+
+/*
+ ****************************************************************************
+ * Check value against rule. Drops and rises are checked against average of
+ * the previous values, average is time-weighted with the window of rule as
+ * time constant and it's checked only when the window is passed since the
+ * first value.
+ ****************************************************************************
+ */
+bool alert_condition(struct alert_rule_s * rule, struct alert_state_s * st, double value, struct timespec * now)
+{
+    bool cond = false;
+
+    if (isnan(value))
+        return false;
+
+    switch (rule->op) {
+        case alert_gt:
+            return value > rule->value;
+        case alert_ge:
+            return value >= rule->value;
+        case alert_lt:
+            return value < rule->value;
+        case alert_le:
+            return value <= rule->value;
+        case alert_eq:
+            return !(value < rule->value) && !(value > rule->value);
+        case alert_ne:
+            return value < rule->value || value > rule->value;
+        case alert_drops: case alert_rises: default:
+            break;
+    }
+
+    if (!st->has_avg) {
+        st->avg = value;
+        st->avg_start = st->avg_ts = *now;
+        st->has_avg = true;
+        return false;
+    }
+
+    if (alert_elapsed(&st->avg_start, now) >= rule->window)
+        cond = (rule->op == alert_drops) ? value < st->avg * (1 - rule->value / 100)
+                                         : value > st->avg * (1 + rule->value / 100);
+
+    st->avg += (1 - exp(-alert_elapsed(&st->avg_ts, now) / rule->window)) * (value - st->avg);
+    st->avg_ts = *now;
+
+    return cond;
+}
+
+/*
+ ****************************************************************************
+ * Find offending row of column rule or start tracking it. Rows which didn't
+ * offend at the previous evaluation are free. Return NULL if all rows are
+ * busy, such row isn't tracked.
+ ****************************************************************************
+ */
+struct alert_row_s * alert_row_lookup(struct alert_state_s * st, unsigned int hash, struct timespec * now)
+{
+    struct alert_row_s * r;
+    unsigned int i, n, slot = ALERT_ROWS;
+
+    for (i = hash & (ALERT_ROWS - 1), n = 0; n < ALERT_ROWS; i = (i + 1) & (ALERT_ROWS - 1), n++) {
+        r = &st->rows[i];
+        if (r->seen == 0)
+            break;
+        if (r->seen + 1 >= st->seq && r->hash == hash) {
+            r->seen = st->seq;
+            return r;
+        }
+        if (r->seen + 1 < st->seq && slot == ALERT_ROWS)
+            slot = i;
+    }
+
+    if (slot == ALERT_ROWS) {
+        if (n == ALERT_ROWS)
+            return NULL;
+        slot = i;
+    }
+
+    r = &st->rows[slot];
+    r->hash = hash;
+    r->seen = st->seq;
+    r->since = *now;
+    r->fired = false;
+
+    return r;
+}
+
+/*
+ ****************************************************************************
+ * Execute command of fired rule in background, rule, object and value are
+ * passed through environment. Command doesn't write to the screen and isn't
+ * waited for, it's reaped later.
+ ****************************************************************************
+ */
+void run_alert_hook(struct alert_rule_s * rule, struct tab_s * tab, const char * object, double value)
+{
+    char strvalue[S_BUF_LEN];
+    pid_t pid;
+    int fd;
+
+    if (rule->hook[0] == '\0')
+        return;
+
+    /* parent, or fork is failed and command is skipped */
+    if ((pid = fork()) != 0)
+        return;
+
+    if ((fd = open("/dev/null", O_RDWR)) != -1) {
+        dup2(fd, STDIN_FILENO);
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        if (fd > STDERR_FILENO)
+            close(fd);
+    }
+    setsid();
+
+    snprintf(strvalue, sizeof(strvalue), "%.2f", value);
+    setenv("PGCENTER_ALERT", rule->text, 1);
+    setenv("PGCENTER_OBJECT", object, 1);
+    setenv("PGCENTER_VALUE", strvalue, 1);
+    setenv("PGCENTER_HOST", tab->host, 1);
+    setenv("PGCENTER_PORT", tab->port, 1);
+    execl("/bin/sh", "sh", "-c", rule->hook, (char *) NULL);
+    _exit(EXIT_FAILURE);
+}
+
+/*
+ ****************************************************************************
+ * Check column rules of the current context against result array and mark
+ * offending cells. Each cell of the rule column is checked once, so it's
+ * O(rows) per rule. Rows are identified by the first column for holding
+ * duration, command is executed once when row starts to offend.
+ ****************************************************************************
+ */
+void mark_alerts(struct alerts_s * alerts, struct tab_s * tab, PGresult * res, char *** arr,
+        unsigned int n_rows, unsigned int n_cols)
+{
+    struct alert_tab_s * at;
+    struct alert_rule_s * rule;
+    struct alert_state_s * st;
+    struct alert_row_s * r;
+    struct timespec now;
+    unsigned int i, k, col;
+    double value;
+
+    if (alerts == NULL)
+        return;
+    if (tab->alert == NULL)
+        tab->alert = alert_tab_init(alerts);
+    at = tab->alert;
+
+    if (n_rows * n_cols > at->marks_size) {
+        at->marks_size = n_rows * n_cols;
+        if ((at->marks = realloc(at->marks, at->marks_size)) == NULL) {
+            mreport(true, msg_fatal, "FATAL: malloc for alerts state failed.\n");
+        }
+    }
+    if (n_rows * n_cols > 0)
+        memset(at->marks, 0, n_rows * n_cols);
+    at->n_rows = n_rows;
+    at->n_cols = n_cols;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    for (k = 0; k < alerts->n_rules; k++) {
+        rule = &alerts->rules[k];
+        if (rule->metric >= 0)
+            continue;
+
+        /* rows offending before context switch are forgotten */
+        st = &at->states[k];
+        st->seq++;
+        if (rule->context != tab->current_context)
+            continue;
+
+        for (col = 0; col < n_cols && strcmp(PQfname(res, col), rule->column); col++)
+            ;
+        if (col == n_cols)
+            continue;
+
+        for (i = 0; i < n_rows; i++) {
+            value = str_to_value(arr[i][col]);
+            if (!alert_condition(rule, st, value, &now))
+                continue;
+            if ((r = alert_row_lookup(st, hash_text(arr[i][0], strlen(arr[i][0])), &now)) == NULL
+                    || alert_elapsed(&r->since, &now) < rule->hold)
+                continue;
+
+            at->marks[i * n_cols + col] = 1;
+            if (!r->fired) {
+                r->fired = true;
+                run_alert_hook(rule, tab, arr[i][0], value);
+            }
+        }
+    }
+}
+
+/*
+ ****************************************************************************
+ * Is cell of the shown result offending?
+ ****************************************************************************
+ */
+bool alert_marked(struct tab_s * tab, unsigned int row, unsigned int col)
+{
+    struct alert_tab_s * at = tab->alert;
+
+    return at != NULL && row < at->n_rows && col < at->n_cols && at->marks[row * at->n_cols + col];
+}
+
+/*
+ ****************************************************************************
+ * Check header rules against metrics of the latest refresh and print fired
+ * alerts into cmd window, unless it's busy with another message. Command
+ * is executed once when alert fires.
+ ****************************************************************************
+ */
+void check_header_alerts(WINDOW * window, struct alerts_s * alerts, struct tab_s * tab)
+{
+    struct alert_tab_s * at;
+    struct alert_rule_s * rule;
+    struct alert_state_s * st;
+    struct timespec now;
+    char msg[XL_BUF_LEN] = "";
+    size_t len = 0;
+    unsigned int k;
+    double value;
+    bool busy = getcurx(window) > 0;
+
+    /* reap finished commands */
+    while (waitpid(-1, NULL, WNOHANG) > 0)
+        ;
+
+    if (alerts == NULL)
+        return;
+    if (tab->alert == NULL)
+        tab->alert = alert_tab_init(alerts);
+    at = tab->alert;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    for (k = 0; k < alerts->n_rules; k++) {
+        rule = &alerts->rules[k];
+        if (rule->metric < 0)
+            continue;
+
+        st = &at->states[k];
+        value = tab->metrics[rule->metric];
+        if (!alert_condition(rule, st, value, &now)) {
+            st->active = st->fired = false;
+            continue;
+        }
+        if (!st->active) {
+            st->active = true;
+            st->since = now;
+        }
+        if (alert_elapsed(&st->since, &now) < rule->hold)
+            continue;
+
+        if (!st->fired) {
+            st->fired = true;
+            run_alert_hook(rule, tab, metric_name(rule->metric), value);
+        }
+        if (len < sizeof(msg))
+            len += snprintf(msg + len, sizeof(msg) - len, "%s%s (%.2f)",
+                    (len > 0) ? "; " : "alert: ", rule->text, value);
+    }
+
+    if (busy)
+        return;
+
+    /* cmd window is cleared, refresh it to hide alerts which aren't fired anymore */
+    if (len > 0) {
+        wattron(window, A_BOLD);
+        wprintw(window, "%s", msg);
+        wattroff(window, A_BOLD);
+        wrefresh(window);
+        at->shown = true;
+    } else if (at->shown) {
+        wrefresh(window);
+        at->shown = false;
+    }
+}
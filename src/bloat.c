@@ -0,0 +1,161 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+ ****************************************************************************
+ * bloat.c
+ *      dead tuples growth, bloat and autovacuum trigger estimation of tables.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#include "include/bloat.h"
+
+/*
+ ****************************************************************************
+ * Update rates of table using the new snapshot. When dead tuples are
+ * decreased the table has been vacuumed, such snapshot is used only as a
+ * new starting point and rates are kept.
+ ****************************************************************************
+ */
+void bloat_update(struct bloat_entry_s * e, long long n_dead, double bloat, struct timespec * ts)
+{
+    double elapsed, dead_rate, bloat_rate;
+
+    if (e->has_prev && n_dead >= e->n_dead) {
+        elapsed = (ts->tv_sec - e->ts.tv_sec) + (ts->tv_nsec - e->ts.tv_nsec) / 1000000000.0;
+        if (elapsed < BLOAT_MIN_ELAPSED)
+            return;
+
+        dead_rate = (n_dead - e->n_dead) / elapsed;
+        bloat_rate = (bloat - e->bloat) / elapsed;
+
+        if (e->has_rates) {
+            e->dead_rate += BLOAT_SMOOTH * (dead_rate - e->dead_rate);
+            e->bloat_rate += BLOAT_SMOOTH * (bloat_rate - e->bloat_rate);
+        } else {
+            e->dead_rate = dead_rate;
+            e->bloat_rate = bloat_rate;
+            e->has_rates = true;
+        }
+    }
+
+    e->n_dead = n_dead;
+    e->bloat = bloat;
+    e->ts = *ts;
+    e->has_prev = true;
+}
+
+/*
+ ****************************************************************************
+ * Estimate time until autovacuum is triggered for the table: number of dead
+ * tuples left to the threshold divided by the growth of dead tuples.
+ ****************************************************************************
+ */
+void format_vacuum_eta(struct bloat_entry_s * e, long long n_dead, double limit, bool enabled,
+        char * buf, size_t len)
+{
+    double eta;
+
+    if (!enabled) {
+        snprintf(buf, len, "off");
+    } else if (n_dead > limit) {
+        snprintf(buf, len, "due");
+    } else if (e == NULL || !e->has_rates || e->dead_rate <= 0) {
+        snprintf(buf, len, "never");
+    } else {
+        eta = (limit - n_dead) / e->dead_rate;
+        (eta >= 100 * 3600)
+            ? snprintf(buf, len, ">99h")
+            : snprintf(buf, len, "%02d:%02d:%02d",
+                    (int) eta / 3600, ((int) eta % 3600) / 60, (int) eta % 60);
+    }
+}
+
+/*
+ ****************************************************************************
+ * Replace tables statistics with dead tuples ratio, estimated bloat, their
+ * growth rates and time to the next autovacuum. Bloat is estimated as a part
+ * of table size occupied by dead tuples, rates are calculated from deltas of
+ * consecutive snapshots, so there is no need to scan tables. Tables which are
+ * gone are forgotten. Rates are empty until the second snapshot of table.
+ ****************************************************************************
+ */
+PGresult * merge_bloat_stats(PGconn * conn, PGresult * res, struct tab_s * tab)
+{
+    static const char * names[BLOAT_COLS] = { "relation", "size_kb", "live", "dead", "dead_pct",
+        "dead_rate", "bloat_kb", "bloat_rate", "av_limit", "av_eta" };
+    static const Oid types[BLOAT_COLS] = { TEXTOID, INT8OID, INT8OID, INT8OID, FLOAT8OID,
+        FLOAT8OID, INT8OID, FLOAT8OID, INT8OID, TEXTOID };
+    PGresult * new_res;
+    PGresAttDesc attrs[BLOAT_COLS];
+    struct oidmap_s * bs;
+    struct bloat_entry_s * e;
+    struct timespec ts;
+    char values[BLOAT_COLS][S_BUF_LEN];
+    unsigned int i, j, n_rows = PQntuples(res);
+    long long n_live, n_dead, size;
+    double limit, bloat;
+
+    if (PQnfields(res) <= BLOAT_ENABLED_COL)
+        return res;
+
+    memset(attrs, 0, sizeof(attrs));
+    for (i = 0; i < BLOAT_COLS; i++) {
+        attrs[i].name = (char *) names[i];
+        attrs[i].typid = types[i];
+        attrs[i].typlen = (types[i] == TEXTOID) ? -1 : 8;
+        attrs[i].atttypmod = -1;
+    }
+
+    if ((new_res = PQmakeEmptyPGresult(conn, PGRES_TUPLES_OK)) == NULL
+        || PQsetResultAttrs(new_res, BLOAT_COLS, attrs) == 0) {
+        PQclear(new_res);
+        return res;
+    }
+
+    if (tab->bloat == NULL)
+        tab->bloat = oidmap_init(sizeof(struct bloat_entry_s));
+    bs = tab->bloat;
+
+    /* history of known tables is kept, new tables start with empty history */
+    oidmap_rebuild(bs, res, BLOAT_RELID_COL);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    for (i = 0; i < n_rows; i++) {
+        for (j = 0; j < BLOAT_COLS; j++)
+            values[j][0] = '\0';
+        snprintf(values[0], sizeof(values[0]), "%s", PQgetvalue(res, i, BLOAT_RELATION_COL));
+
+        n_live = atoll(PQgetvalue(res, i, BLOAT_LIVE_COL));
+        n_dead = atoll(PQgetvalue(res, i, BLOAT_DEAD_COL));
+        size = atoll(PQgetvalue(res, i, BLOAT_SIZE_COL));
+        limit = atof(PQgetvalue(res, i, BLOAT_LIMIT_COL));
+        bloat = (n_live + n_dead > 0) ? (double) size * n_dead / (n_live + n_dead) : 0;
+
+        e = oidmap_lookup(bs, strtoul(PQgetvalue(res, i, BLOAT_RELID_COL), NULL, 10));
+        if (e != NULL)
+            bloat_update(e, n_dead, bloat, &ts);
+
+        snprintf(values[1], sizeof(values[1]), "%lli", size);
+        snprintf(values[2], sizeof(values[2]), "%lli", n_live);
+        snprintf(values[3], sizeof(values[3]), "%lli", n_dead);
+        snprintf(values[4], sizeof(values[4]), "%.2f",
+                (n_live + n_dead > 0) ? 100.0 * n_dead / (n_live + n_dead) : 0);
+        snprintf(values[6], sizeof(values[6]), "%.0f", bloat);
+        if (e != NULL && e->has_rates) {
+            snprintf(values[5], sizeof(values[5]), "%.2f", e->dead_rate);
+            snprintf(values[7], sizeof(values[7]), "%.2f", e->bloat_rate);
+        }
+        snprintf(values[8], sizeof(values[8]), "%.0f", limit);
+        format_vacuum_eta(e, n_dead, limit,
+                (PQgetvalue(res, i, BLOAT_ENABLED_COL)[0] == 't'), values[9], sizeof(values[9]));
+
+        for (j = 0; j < BLOAT_COLS; j++)
+            PQsetvalue(new_res, i, j, values[j], strlen(values[j]));
+    }
+
+    PQclear(res);
+    return new_res;
+}
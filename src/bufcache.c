@@ -0,0 +1,326 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+ ****************************************************************************
+ * bufcache.c
+ *      shared buffers residency of relations, using pg_buffercache.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#include "include/bufcache.h"
+
+/*
+ ****************************************************************************
+ * Allocate buffers residency state.
+ ****************************************************************************
+ */
+struct bufcache_s * bufcache_init(void)
+{
+    struct bufcache_s * bc;
+
+    if ((bc = (struct bufcache_s *) malloc(BUFCACHE_SIZE)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for buffers residency failed.\n");
+    }
+    memset(bc, 0, BUFCACHE_SIZE);
+
+    return bc;
+}
+
+/*
+ ****************************************************************************
+ * Free buffers residency state.
+ ****************************************************************************
+ */
+void free_bufcache(struct bufcache_s * bc)
+{
+    if (bc == NULL)
+        return;
+
+    free(bc->rels);
+    free(bc->names);
+    free(bc);
+}
+
+/*
+ ****************************************************************************
+ * Relations comparison function for qsort, by database and relfilenode.
+ ****************************************************************************
+ */
+int bufcache_rel_cmp(const void * a, const void * b)
+{
+    const struct bufcache_rel_s * ra = (const struct bufcache_rel_s *) a;
+    const struct bufcache_rel_s * rb = (const struct bufcache_rel_s *) b;
+
+    if (ra->datid != rb->datid)
+        return (ra->datid > rb->datid) - (ra->datid < rb->datid);
+    return (ra->filenode > rb->filenode) - (ra->filenode < rb->filenode);
+}
+
+/*
+ ****************************************************************************
+ * Names comparison function for qsort, by relfilenode.
+ ****************************************************************************
+ */
+int bufcache_name_cmp(const void * a, const void * b)
+{
+    unsigned int fa = ((const struct bufcache_name_s *) a)->filenode;
+    unsigned int fb = ((const struct bufcache_name_s *) b)->filenode;
+
+    return (fa > fb) - (fa < fb);
+}
+
+/*
+ ****************************************************************************
+ * Find relation of the last scan. Return NULL if not found.
+ ****************************************************************************
+ */
+struct bufcache_rel_s * bufcache_rel_lookup(struct bufcache_s * bc, unsigned int datid, unsigned int filenode)
+{
+    struct bufcache_rel_s key;
+
+    if (bc->used == 0)
+        return NULL;
+
+    key.datid = datid;
+    key.filenode = filenode;
+    return bsearch(&key, bc->rels, bc->used, sizeof(struct bufcache_rel_s), bufcache_rel_cmp);
+}
+
+/*
+ ****************************************************************************
+ * Find name of relation by its relfilenode. Return NULL if not found.
+ ****************************************************************************
+ */
+struct bufcache_name_s * bufcache_name_lookup(struct bufcache_s * bc, unsigned int filenode)
+{
+    struct bufcache_name_s key;
+
+    if (bc->names_used == 0)
+        return NULL;
+
+    key.filenode = filenode;
+    return bsearch(&key, bc->names, bc->names_used, sizeof(struct bufcache_name_s), bufcache_name_cmp);
+}
+
+/*
+ ****************************************************************************
+ * Request names and sizes of relations of the current database.
+ ****************************************************************************
+ */
+void bufcache_load_names(struct bufcache_s * bc, PGconn * conn)
+{
+    PGresult * res;
+    struct bufcache_name_s * names;
+    unsigned int i, n_rows;
+
+    res = exec_prepared(conn, PG_BUFFERCACHE_NAMES_QUERY, 0, NULL, 0);
+    bc->names_at = time(NULL);
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        PQclear(res);
+        return;
+    }
+
+    n_rows = PQntuples(res);
+    if ((names = malloc(sizeof(struct bufcache_name_s) * (n_rows + 1))) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for buffers residency failed.\n");
+    }
+    for (i = 0; i < n_rows; i++) {
+        names[i].filenode = strtoul(PQgetvalue(res, i, 0), NULL, 10);
+        snprintf(names[i].name, sizeof(names[i].name), "%s", PQgetvalue(res, i, 1));
+        names[i].relpages = atoll(PQgetvalue(res, i, 2));
+    }
+    qsort(names, n_rows, sizeof(struct bufcache_name_s), bufcache_name_cmp);
+
+    free(bc->names);
+    bc->names = names;
+    bc->names_used = n_rows;
+    bc->names_stale = false;
+    PQclear(res);
+}
+
+/*
+ ****************************************************************************
+ * Scan shared buffers and aggregate them by relations. Buffers are counted
+ * by relfilenode, usage count and dirtiness on server side, per-relation
+ * totals and usage distribution are built here. Buffers of other databases
+ * are shown as one relation, like unused buffers.
+ ****************************************************************************
+ */
+void bufcache_scan(struct bufcache_s * bc, PGconn * conn, unsigned int datid)
+{
+    PGresult * res;
+    struct bufcache_rel_s * rels, * r, * prev;
+    struct timespec start, end;
+    unsigned int i, n = 0, n_rows, rel_datid, usage;
+    long long count;
+    double duration;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    res = exec_prepared(conn, PG_BUFFERCACHE_SCAN_QUERY, 0, NULL, 0);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    /* don't load server with scans, even if they fail */
+    duration = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+    bc->scan_at = end;
+    bc->scan_interval = (duration * BUFCACHE_DUTY > BUFCACHE_MIN_INTERVAL)
+        ? duration * BUFCACHE_DUTY
+        : BUFCACHE_MIN_INTERVAL;
+
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        PQclear(res);
+        return;
+    }
+
+    n_rows = PQntuples(res);
+    if ((rels = malloc(sizeof(struct bufcache_rel_s) * (n_rows + 1))) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for buffers residency failed.\n");
+    }
+
+    bc->total = 0;
+    for (i = 0; i < n_rows; i++) {
+        r = &rels[n++];
+        memset(r, 0, sizeof(struct bufcache_rel_s));
+        rel_datid = strtoul(PQgetvalue(res, i, 1), NULL, 10);
+        if (PQgetisnull(res, i, 0)) {
+            r->datid = UINT_MAX;
+            r->filenode = BUFCACHE_UNUSED;
+        } else if (rel_datid != 0 && rel_datid != datid) {
+            r->datid = UINT_MAX;
+            r->filenode = BUFCACHE_OTHER_DB;
+        } else {
+            r->datid = rel_datid;
+            r->filenode = strtoul(PQgetvalue(res, i, 0), NULL, 10);
+        }
+
+        count = atoll(PQgetvalue(res, i, 4));
+        usage = atoi(PQgetvalue(res, i, 2));
+        r->buffers = count;
+        r->dirty = (PQgetvalue(res, i, 3)[0] == 't') ? count : 0;
+        r->usage[(usage > BUFCACHE_USAGE_MAX) ? BUFCACHE_USAGE_MAX : usage] = count;
+        bc->total += count;
+    }
+
+    /* merge rows of the same relation */
+    qsort(rels, n, sizeof(struct bufcache_rel_s), bufcache_rel_cmp);
+    for (i = 1, n = (n_rows > 0) ? 1 : 0; i < n_rows; i++) {
+        r = &rels[n - 1];
+        if (bufcache_rel_cmp(r, &rels[i]) == 0) {
+            r->buffers += rels[i].buffers;
+            r->dirty += rels[i].dirty;
+            for (usage = 0; usage <= BUFCACHE_USAGE_MAX; usage++)
+                r->usage[usage] += rels[i].usage[usage];
+        } else
+            rels[n++] = rels[i];
+    }
+
+    for (i = 0; i < n; i++)
+        if ((prev = bufcache_rel_lookup(bc, rels[i].datid, rels[i].filenode)) != NULL) {
+            rels[i].prev_buffers = prev->buffers;
+            rels[i].has_prev = true;
+        }
+
+    free(bc->rels);
+    bc->rels = rels;
+    bc->used = n;
+    bc->scanned = true;
+    PQclear(res);
+}
+
+/*
+ ****************************************************************************
+ * Replace context result with buffers residency of relations. Buffers are
+ * scanned not often than BUFCACHE_MIN_INTERVAL, and the longer the scan
+ * takes, the more rarely it is done; the last scan is shown in between.
+ ****************************************************************************
+ */
+PGresult * merge_buffercache(PGconn * conn, PGresult * res, struct tab_s * tab)
+{
+    static const char * names[BUFCACHE_COLS] = { "relation", "buffers", "cache_pct", "rel_pct",
+        "dirty_pct", "avg_usage", "usage_0-5", "change" };
+    static const Oid types[BUFCACHE_COLS] = { TEXTOID, INT8OID, FLOAT8OID, FLOAT8OID,
+        FLOAT8OID, FLOAT8OID, TEXTOID, INT8OID };
+    PGresult * new_res;
+    PGresAttDesc attrs[BUFCACHE_COLS];
+    struct bufcache_s * bc;
+    struct bufcache_rel_s * r;
+    struct bufcache_name_s * nm;
+    struct timespec now;
+    char values[BUFCACHE_COLS][S_BUF_LEN];
+    unsigned int i, j, row = 0, datid;
+    double weighted;
+
+    if (PQnfields(res) <= BUFCACHE_DATID_COL || PQntuples(res) == 0)
+        return res;
+
+    memset(attrs, 0, sizeof(attrs));
+    for (i = 0; i < BUFCACHE_COLS; i++) {
+        attrs[i].name = (char *) names[i];
+        attrs[i].typid = types[i];
+        attrs[i].typlen = (types[i] == TEXTOID) ? -1 : 8;
+        attrs[i].atttypmod = -1;
+    }
+
+    if ((new_res = PQmakeEmptyPGresult(conn, PGRES_TUPLES_OK)) == NULL
+        || PQsetResultAttrs(new_res, BUFCACHE_COLS, attrs) == 0) {
+        PQclear(new_res);
+        return res;
+    }
+
+    if (tab->bufcache == NULL)
+        tab->bufcache = bufcache_init();
+    bc = tab->bufcache;
+    datid = strtoul(PQgetvalue(res, 0, BUFCACHE_DATID_COL), NULL, 10);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (!bc->scanned || (now.tv_sec - bc->scan_at.tv_sec)
+            + (now.tv_nsec - bc->scan_at.tv_nsec) / 1000000000.0 >= bc->scan_interval)
+        bufcache_scan(bc, conn, datid);
+
+    /* names of new relations are requested not often than scans */
+    if (bc->names == NULL || time(NULL) - bc->names_at >= BUFCACHE_NAMES_TTL
+            || (bc->names_stale && time(NULL) - bc->names_at >= BUFCACHE_MIN_INTERVAL))
+        bufcache_load_names(bc, conn);
+
+    for (i = 0; i < bc->used; i++) {
+        r = &bc->rels[i];
+        nm = NULL;
+
+        if (r->datid == UINT_MAX)
+            snprintf(values[0], sizeof(values[0]), "%s",
+                    (r->filenode == BUFCACHE_UNUSED) ? "(unused)" : "(other databases)");
+        else if ((nm = bufcache_name_lookup(bc, r->filenode)) != NULL)
+            snprintf(values[0], sizeof(values[0]), "%s", nm->name);
+        else {
+            snprintf(values[0], sizeof(values[0]), "(filenode %u)", r->filenode);
+            bc->names_stale = true;
+        }
+
+        for (j = 0, weighted = 0; j <= BUFCACHE_USAGE_MAX; j++)
+            weighted += (double) j * r->usage[j];
+
+        snprintf(values[1], sizeof(values[1]), "%lli", r->buffers);
+        snprintf(values[2], sizeof(values[2]), "%.2f", bc->total > 0 ? 100.0 * r->buffers / bc->total : 0);
+        if (nm != NULL && nm->relpages > 0)
+            snprintf(values[3], sizeof(values[3]), "%.2f", 100.0 * r->buffers / nm->relpages);
+        else
+            values[3][0] = '\0';
+        snprintf(values[4], sizeof(values[4]), "%.2f", r->buffers > 0 ? 100.0 * r->dirty / r->buffers : 0);
+        snprintf(values[5], sizeof(values[5]), "%.2f", r->buffers > 0 ? weighted / r->buffers : 0);
+        snprintf(values[6], sizeof(values[6]), "%lli/%lli/%lli/%lli/%lli/%lli",
+                r->usage[0], r->usage[1], r->usage[2], r->usage[3], r->usage[4], r->usage[5]);
+        if (r->has_prev)
+            snprintf(values[7], sizeof(values[7]), "%lli", r->buffers - r->prev_buffers);
+        else
+            values[7][0] = '\0';
+
+        for (j = 0; j < BUFCACHE_COLS; j++)
+            PQsetvalue(new_res, row, j, values[j], strlen(values[j]));
+        row++;
+    }
+
+    PQclear(res);
+    return new_res;
+}
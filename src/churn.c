@@ -0,0 +1,306 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+ ****************************************************************************
+ * churn.c
+ *      connections churn: started and ended sessions by application and user.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#include "include/churn.h"
+
+/*
+ ****************************************************************************
+ * Allocate connections churn state.
+ ****************************************************************************
+ */
+struct churn_s * churn_init(void)
+{
+    struct churn_s * cs;
+
+    if ((cs = (struct churn_s *) malloc(CHURN_SIZE)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for connections churn failed.\n");
+    }
+    memset(cs, 0, CHURN_SIZE);
+
+    return cs;
+}
+
+/*
+ ****************************************************************************
+ * Free connections churn state.
+ ****************************************************************************
+ */
+void free_churn(struct churn_s * cs)
+{
+    if (cs == NULL)
+        return;
+
+    free(cs->sessions);
+    free(cs);
+}
+
+/*
+ ****************************************************************************
+ * Sessions comparison function for qsort, by pid.
+ ****************************************************************************
+ */
+int churn_session_cmp(const void * a, const void * b)
+{
+    int pa = ((const struct churn_session_s *) a)->pid;
+    int pb = ((const struct churn_session_s *) b)->pid;
+
+    return (pa > pb) - (pa < pb);
+}
+
+/*
+ ****************************************************************************
+ * Find group of application and user or add new one. Return index of the
+ * group or -1 when too many groups are tracked.
+ ****************************************************************************
+ */
+int churn_group_lookup(struct churn_s * cs, const char * app, const char * user, bool unseen)
+{
+    struct churn_group_s * g;
+    unsigned int hash, i;
+
+    hash = hash_text(app, strlen(app)) ^ (hash_text(user, strlen(user)) * 31) ^ unseen;
+    for (i = 0; i < cs->n_groups; i++)
+        if (cs->groups[i].hash == hash && cs->groups[i].unseen == unseen
+                && !strcmp(cs->groups[i].app, app) && !strcmp(cs->groups[i].user, user))
+            return i;
+
+    if (cs->n_groups == CHURN_GROUPS_MAX)
+        return -1;
+
+    g = &cs->groups[cs->n_groups];
+    memset(g, 0, sizeof(struct churn_group_s));
+    g->hash = hash;
+    g->unseen = unseen;
+    snprintf(g->app, sizeof(g->app), "%s", app);
+    snprintf(g->user, sizeof(g->user), "%s", user);
+
+    return cs->n_groups++;
+}
+
+/*
+ ****************************************************************************
+ * Update smoothed rates of groups using sessions counted since the previous
+ * snapshot, groups without sessions and activity are forgotten.
+ ****************************************************************************
+ */
+void churn_update_rates(struct churn_s * cs, double elapsed)
+{
+    struct churn_group_s * g;
+    int map[CHURN_GROUPS_MAX];
+    unsigned int i, n = 0;
+
+    for (i = 0; i < cs->n_groups; i++) {
+        g = &cs->groups[i];
+        if (g->has_rates) {
+            g->new_rate += CHURN_SMOOTH * (g->new_cnt / elapsed - g->new_rate);
+            g->exit_rate += CHURN_SMOOTH * (g->exit_cnt / elapsed - g->exit_rate);
+        } else {
+            g->new_rate = g->new_cnt / elapsed;
+            g->exit_rate = g->exit_cnt / elapsed;
+            g->has_rates = true;
+        }
+    }
+
+    for (i = 0; i < cs->n_groups; i++) {
+        g = &cs->groups[i];
+        if (g->conns == 0 && g->new_rate < 0.01 && g->exit_rate < 0.01) {
+            map[i] = -1;
+            continue;
+        }
+        map[i] = n;
+        if (n != i)
+            cs->groups[n] = *g;
+        n++;
+    }
+    cs->n_groups = n;
+
+    for (i = 0; i < cs->used; i++)
+        if (cs->sessions[i].group >= 0)
+            cs->sessions[i].group = map[cs->sessions[i].group];
+}
+
+/*
+ ****************************************************************************
+ * Compare sessions of the new snapshot with the previous one by pid and
+ * start time: new sessions are started, missing ones are ended. Since 14
+ * sessions which started and ended between snapshots are counted using
+ * total sessions counter.
+ ****************************************************************************
+ */
+void churn_snapshot(struct churn_s * cs, PGresult * res, struct timespec * ts, double elapsed)
+{
+    struct churn_session_s * sessions, * s, * p;
+    struct churn_group_s * g;
+    unsigned int i, j, n_rows = PQntuples(res), observed = 0;
+    long long now, life, total = -1, unseen;
+    int idx;
+
+    if ((sessions = malloc(sizeof(struct churn_session_s) * (n_rows + 1))) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for connections churn failed.\n");
+    }
+    for (i = 0; i < cs->n_groups; i++) {
+        cs->groups[i].conns = 0;
+        cs->groups[i].new_cnt = 0;
+        cs->groups[i].exit_cnt = 0;
+    }
+    for (i = 0; i < n_rows; i++) {
+        s = &sessions[i];
+        s->pid = atoi(PQgetvalue(res, i, CHURN_PID_COL));
+        s->started = atoll(PQgetvalue(res, i, CHURN_STARTED_COL));
+        s->group = churn_group_lookup(cs, PQgetvalue(res, i, CHURN_APP_COL),
+                PQgetvalue(res, i, CHURN_USER_COL), false);
+        if (s->group >= 0)
+            cs->groups[s->group].conns++;
+    }
+    qsort(sessions, n_rows, sizeof(struct churn_session_s), churn_session_cmp);
+    now = atoll(PQgetvalue(res, 0, CHURN_NOW_COL));
+    if (!PQgetisnull(res, 0, CHURN_SESSIONS_COL))
+        total = atoll(PQgetvalue(res, 0, CHURN_SESSIONS_COL));
+
+    if (cs->has_prev) {
+        /* walk both lists ordered by pid, reused pid is a new session */
+        for (i = 0, j = 0; i < cs->used || j < n_rows; ) {
+            p = (i < cs->used) ? &cs->sessions[i] : NULL;
+            s = (j < n_rows) ? &sessions[j] : NULL;
+
+            if (p != NULL && s != NULL && p->pid == s->pid && p->started == s->started) {
+                i++; j++;
+            } else if (p != NULL && (s == NULL || p->pid <= s->pid)) {
+                if (p->group >= 0) {
+                    g = &cs->groups[p->group];
+                    life = (now > p->started) ? now - p->started : 0;
+                    g->exit_cnt++;
+                    g->ended++;
+                    g->ended_short += (life < CHURN_SHORT_LIFE);
+                    g->life_sum += life;
+                }
+                i++;
+            } else {
+                if (s->group >= 0)
+                    cs->groups[s->group].new_cnt++;
+                observed++;
+                j++;
+            }
+        }
+
+        /* sessions which weren't seen at all */
+        unseen = (total >= 0 && cs->sessions_total >= 0) ? total - cs->sessions_total - observed : 0;
+        if (unseen > 0 && (idx = churn_group_lookup(cs, "(between refreshes)", "", true)) >= 0) {
+            g = &cs->groups[idx];
+            g->new_cnt = g->exit_cnt = unseen;
+            g->ended += unseen;
+            g->ended_short += unseen;
+        }
+    }
+
+    free(cs->sessions);
+    cs->sessions = sessions;
+    cs->used = n_rows;
+    cs->sessions_total = total;
+    cs->ts = *ts;
+    if (cs->has_prev)
+        churn_update_rates(cs, elapsed);
+    cs->has_prev = true;
+}
+
+/*
+ ****************************************************************************
+ * Replace sessions list with connections churn by application and user.
+ * Sessions which started and ended between snapshots are shown as a
+ * separate row, all groups are summed up in the last row.
+ ****************************************************************************
+ */
+PGresult * merge_conn_churn(PGconn * conn, PGresult * res, struct tab_s * tab)
+{
+    static const char * names[CHURN_COLS] = { "application_name", "usename", "conns",
+        "new_s", "exit_s", "short_pct", "avg_life" };
+    static const Oid types[CHURN_COLS] = { TEXTOID, TEXTOID, INT8OID,
+        FLOAT8OID, FLOAT8OID, FLOAT8OID, FLOAT8OID };
+    PGresult * new_res;
+    PGresAttDesc attrs[CHURN_COLS];
+    struct churn_s * cs;
+    struct churn_group_s * g, all;
+    struct timespec ts;
+    char values[CHURN_COLS][S_BUF_LEN];
+    unsigned int i, j, k;
+    double elapsed = 0, life_ended = 0;
+
+    if (PQnfields(res) <= CHURN_SESSIONS_COL || PQntuples(res) == 0)
+        return res;
+
+    memset(attrs, 0, sizeof(attrs));
+    for (i = 0; i < CHURN_COLS; i++) {
+        attrs[i].name = (char *) names[i];
+        attrs[i].typid = types[i];
+        attrs[i].typlen = (types[i] == TEXTOID) ? -1 : 8;
+        attrs[i].atttypmod = -1;
+    }
+
+    if ((new_res = PQmakeEmptyPGresult(conn, PGRES_TUPLES_OK)) == NULL
+        || PQsetResultAttrs(new_res, CHURN_COLS, attrs) == 0) {
+        PQclear(new_res);
+        return res;
+    }
+
+    if (tab->churn == NULL)
+        tab->churn = churn_init();
+    cs = tab->churn;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if (cs->has_prev)
+        elapsed = (ts.tv_sec - cs->ts.tv_sec) + (ts.tv_nsec - cs->ts.tv_nsec) / 1000000000.0;
+
+    /* too frequent snapshot, e.g. after context switch, is only shown */
+    if (!cs->has_prev || elapsed >= CHURN_MIN_ELAPSED)
+        churn_snapshot(cs, res, &ts, elapsed);
+
+    memset(&all, 0, sizeof(all));
+    for (i = 0, k = 0; i <= cs->n_groups; i++) {
+        if (i < cs->n_groups) {
+            g = &cs->groups[i];
+            all.conns += g->conns;
+            all.new_rate += g->new_rate;
+            all.exit_rate += g->exit_rate;
+            all.ended += g->ended;
+            all.ended_short += g->ended_short;
+            all.life_sum += g->life_sum;
+            if (!g->unseen)
+                life_ended += g->ended;
+        } else {
+            g = &all;
+            snprintf(g->app, sizeof(g->app), "(all)");
+            g->has_rates = cs->n_groups > 0 && cs->groups[0].has_rates;
+        }
+
+        snprintf(values[0], sizeof(values[0]), "%s", g->app);
+        snprintf(values[1], sizeof(values[1]), "%s", g->user);
+        snprintf(values[2], sizeof(values[2]), "%u", g->conns);
+        values[3][0] = values[4][0] = values[5][0] = values[6][0] = '\0';
+        if (g->has_rates) {
+            snprintf(values[3], sizeof(values[3]), "%.2f", g->new_rate);
+            snprintf(values[4], sizeof(values[4]), "%.2f", g->exit_rate);
+        }
+        if (g->ended > 0)
+            snprintf(values[5], sizeof(values[5]), "%.2f", 100.0 * g->ended_short / g->ended);
+        if (g != &all && g->ended > 0 && !g->unseen)
+            snprintf(values[6], sizeof(values[6]), "%.2f", g->life_sum / g->ended);
+        else if (g == &all && life_ended > 0)
+            snprintf(values[6], sizeof(values[6]), "%.2f", g->life_sum / life_ended);
+
+        for (j = 0; j < CHURN_COLS; j++)
+            PQsetvalue(new_res, k, j, values[j], strlen(values[j]));
+        k++;
+    }
+
+    PQclear(res);
+    return new_res;
+}
@@ -125,13 +125,14 @@ int check_string(const char * string, enum chk_type ctype)
             }
         break;
         case is_number:
-            for (i = 0; string[i] != '\0'; i++) {
+            /* leading minus is allowed, e.g. for native queryid */
+            for (i = (string[0] == '-'); string[i] != '\0'; i++) {
                 if (!isdigit(string[i]))
                     return -1;              /* not a digit char found */
             }
         break;
         case is_float:
-            for (i = 0; string[i] != '\0'; i++) {
+            for (i = (string[0] == '-'); string[i] != '\0'; i++) {
                 if (!isdigit(string[i]) && string[i] != '.')    /* not a digit, nor point */
                     return -1;
             }
@@ -142,6 +143,133 @@ int check_string(const char * string, enum chk_type ctype)
     return 0;
 }
 
+/*
+ ****************************************************************************
+ * FNV-1a hash of the text.
+ ****************************************************************************
+ */
+unsigned int hash_text(const char * text, size_t len)
+{
+    unsigned int hash = 2166136261U;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        hash = (hash ^ (unsigned char) text[i]) * 16777619U;
+
+    return hash;
+}
+
+/*
+ ****************************************************************************
+ * Name of header metric, used in alert rules.
+ ****************************************************************************
+ */
+const char * metric_name(enum header_metric metric)
+{
+    static const char * names[HEADER_METRICS] = { "load1", "cpu", "iowait", "mem", "conns",
+        "active", "waiting", "idle_xact", "stmt_s", "stmt_avgtime", "xact_maxtime",
+        "prep_maxtime", "disk_util" };
+
+    return names[metric];
+}
+
+/*
+ ****************************************************************************
+ * Find header metric by name, return -1 if there is no such metric.
+ ****************************************************************************
+ */
+int metric_lookup(const char * name)
+{
+    int i;
+
+    for (i = 0; i < HEADER_METRICS; i++)
+        if (!strcmp(metric_name(i), name))
+            return i;
+
+    return -1;
+}
+
+/*
+ ****************************************************************************
+ * Forget header metrics of the previous refresh, metrics which aren't shown
+ * in the current refresh remain unknown.
+ ****************************************************************************
+ */
+void reset_metrics(struct tab_s * tab)
+{
+    int i;
+
+    for (i = 0; i < HEADER_METRICS; i++)
+        tab->metrics[i] = NAN;
+}
+
+/*
+ ****************************************************************************
+ * Convert value as it is shown into number: plain numbers, intervals like
+ * "[N days] HH:MM:SS[.ss]" in seconds, sizes like "N kB" in bytes, and
+ * numbers with suffixes of alert rules like "5min", "1GB" or "90%". Return
+ * NAN for anything else.
+ ****************************************************************************
+ */
+double str_to_value(const char * str)
+{
+    static const struct { const char * unit; double factor; } units[] = {
+        { "bytes", 1 }, { "B", 1 }, { "kB", 1024.0 }, { "KB", 1024.0 }, { "MB", 1048576.0 },
+        { "GB", 1073741824.0 }, { "TB", 1099511627776.0 }, { "ms", 0.001 }, { "s", 1 },
+        { "sec", 1 }, { "min", 60 }, { "h", 3600 }, { "day", 86400 }, { "days", 86400 },
+        { "d", 86400 }, { "%", 1 }, { NULL, 0 } };
+    const char * p = str;
+    char * end;
+    double value, m, s;
+    size_t len;
+    int i;
+
+    value = strtod(p, &end);
+    if (end == p || isnan(value) || isinf(value))
+        return NAN;
+    p = end;
+
+    /* time of interval, sign of hours is the sign of whole value */
+    if (*p == ':') {
+        m = strtod(p + 1, &end);
+        if (end == p + 1 || *end != ':')
+            return NAN;
+        p = end + 1;
+        s = strtod(p, &end);
+        if (end == p)
+            return NAN;
+        value = (strchr(str, '-') != NULL) ? value * 3600 - m * 60 - s : value * 3600 + m * 60 + s;
+        p = end;
+    }
+
+    while (*p == ' ')
+        p++;
+    for (len = 0; isalpha((unsigned char) p[len]) || p[len] == '%'; len++)
+        ;
+    if (len > 0) {
+        for (i = 0; units[i].unit != NULL; i++)
+            if (strlen(units[i].unit) == len && !strncmp(p, units[i].unit, len))
+                break;
+        if (units[i].unit == NULL)
+            return NAN;
+        value *= units[i].factor;
+        p += len;
+
+        /* days are followed by time */
+        if (units[i].unit[0] == 'd') {
+            while (*p == ' ')
+                p++;
+            if (*p != '\0')
+                return (isnan(s = str_to_value(p))) ? NAN : value + s;
+        }
+    }
+
+    while (*p == ' ')
+        p++;
+
+    return (*p == '\0') ? value : NAN;
+}
+
 /*
  ****************************************************************************
  * Password prompt.
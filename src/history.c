@@ -0,0 +1,260 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+ ****************************************************************************
+ * history.c
+ *      header metrics history in rings of several resolutions and graphs.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#include "include/history.h"
+
+/*
+ ****************************************************************************
+ * Allocate history, all rings are allocated at once and never grow.
+ ****************************************************************************
+ */
+struct history_s * history_init(void)
+{
+    static const unsigned int res[HISTORY_LEVELS] = { 1, 10, 60 };
+    static const unsigned int size[HISTORY_LEVELS] = { 600, 720, 1440 };
+    struct history_s * h;
+    unsigned int i, j;
+
+    if ((h = (struct history_s *) malloc(HISTORY_SIZE)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for metrics history failed.\n");
+    }
+
+    for (i = 0; i < HISTORY_LEVELS; i++) {
+        h->levels[i].res = res[i];
+        h->levels[i].size = size[i];
+        if ((h->levels[i].slots = malloc(size[i] * sizeof(long long))) == NULL
+            || (h->levels[i].buckets = calloc(size[i] * HEADER_METRICS, sizeof(struct hist_bucket_s))) == NULL) {
+            mreport(true, msg_fatal, "FATAL: malloc for metrics history failed.\n");
+        }
+        for (j = 0; j < size[i]; j++)
+            h->levels[i].slots[j] = -1;
+    }
+
+    return h;
+}
+
+/*
+ ****************************************************************************
+ * Free history.
+ ****************************************************************************
+ */
+void free_history(struct history_s * h)
+{
+    unsigned int i;
+
+    if (h == NULL)
+        return;
+
+    for (i = 0; i < HISTORY_LEVELS; i++) {
+        free(h->levels[i].slots);
+        free(h->levels[i].buckets);
+    }
+    free(h);
+}
+
+/*
+ ****************************************************************************
+ * Description of history resolution, for messages.
+ ****************************************************************************
+ */
+const char * history_level_name(unsigned int level)
+{
+    switch (level) {
+        case 0:
+            return "1 second resolution, last 10 minutes";
+        case 1:
+            return "10 seconds resolution, last 2 hours";
+        case 2: default:
+            return "1 minute resolution, last 24 hours";
+    }
+}
+
+/*
+ ****************************************************************************
+ * Add metrics sample into current buckets of all resolutions. Rollups are
+ * updated in place, so adding is O(resolutions x metrics). Bucket of the
+ * ring which held older time is emptied first. Unknown metrics are skipped.
+ ****************************************************************************
+ */
+void history_add(struct history_s * h, double metrics[], long long now)
+{
+    struct hist_level_s * lv;
+    struct hist_bucket_s * b;
+    long long slot;
+    unsigned int i, m, idx;
+    float value;
+
+    for (i = 0; i < HISTORY_LEVELS; i++) {
+        lv = &h->levels[i];
+        slot = now / lv->res;
+        idx = slot % lv->size;
+
+        if (lv->slots[idx] != slot) {
+            lv->slots[idx] = slot;
+            for (m = 0; m < HEADER_METRICS; m++)
+                lv->buckets[m * lv->size + idx].count = 0;
+        }
+
+        for (m = 0; m < HEADER_METRICS; m++) {
+            if (isnan(metrics[m]))
+                continue;
+            b = &lv->buckets[m * lv->size + idx];
+            value = metrics[m];
+            if (b->count == 0) {
+                b->min = b->max = b->sum = value;
+            } else {
+                b->min = min(b->min, value);
+                b->max = max(b->max, value);
+                b->sum += value;
+            }
+            b->count++;
+        }
+    }
+}
+
+/*
+ ****************************************************************************
+ * Get bucket of metric for time slot of resolution. Return false if there
+ * are no samples for that time.
+ ****************************************************************************
+ */
+bool history_bucket(struct history_s * h, unsigned int level, enum header_metric metric,
+        long long slot, struct hist_bucket_s * b)
+{
+    struct hist_level_s * lv = &h->levels[level];
+    unsigned int idx;
+
+    if (slot < 0)
+        return false;
+
+    idx = slot % lv->size;
+    if (lv->slots[idx] != slot || lv->buckets[metric * lv->size + idx].count == 0)
+        return false;
+
+    *b = lv->buckets[metric * lv->size + idx];
+    return true;
+}
+
+/*
+ ****************************************************************************
+ * Add header metrics of the latest refresh into history of tab.
+ ****************************************************************************
+ */
+void record_history(struct tab_s * tab)
+{
+    struct timespec now;
+
+    if (tab->history == NULL)
+        tab->history = history_init();
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    history_add(tab->history, tab->metrics, now.tv_sec);
+}
+
+/*
+ ****************************************************************************
+ * Print graph of metric history at chosen resolution, one bucket per column
+ * with the latest bucket at the right. Bar is drawn up to average of the
+ * bucket and line above bar is drawn up to maximum, so short spikes are
+ * visible at coarse resolutions.
+ ****************************************************************************
+ */
+void print_graph(WINDOW * window, struct tab_s * tab)
+{
+    struct hist_level_s * lv;
+    struct hist_bucket_s b;
+    struct timespec now;
+    unsigned int rows, cols, width, height, x, y;
+    long long last;
+    double lo = 0, hi = 0, vmin = 0, vmax = 0, sum = 0, level, latest = NAN;
+    unsigned long count = 0, span;
+    bool found = false;
+
+    getmaxyx(window, rows, cols);
+    wclear(window);
+    if (tab->history == NULL || rows < 5 || cols < HISTORY_LABEL_WIDTH + 10) {
+        wprintw(window, "No history yet.");
+        wrefresh(window);
+        return;
+    }
+
+    lv = &tab->history->levels[tab->graph_level];
+    height = rows - 3;
+    width = min(cols - HISTORY_LABEL_WIDTH - 2, lv->size);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    last = now.tv_sec / lv->res;
+
+    /* scale and summary of the shown buckets */
+    for (x = 0; x < width; x++) {
+        if (!history_bucket(tab->history, tab->graph_level, tab->graph_metric, last - width + 1 + x, &b))
+            continue;
+        if (!found) {
+            vmin = b.min;
+            vmax = b.max;
+            found = true;
+        }
+        vmin = min(vmin, b.min);
+        vmax = max(vmax, b.max);
+        sum += b.sum;
+        count += b.count;
+        latest = b.sum / b.count;
+    }
+
+    /* values axis starts from zero unless there are negative values */
+    lo = min(0, vmin);
+    hi = vmax;
+    if (hi <= lo)
+        hi = lo + 1;
+
+    wattron(window, A_BOLD);
+    wprintw(window, "%s history, %s", metric_name(tab->graph_metric), history_level_name(tab->graph_level));
+    if (count > 0)
+        wprintw(window, ": min %.2f, max %.2f, avg %.2f, latest %.2f", vmin, vmax, sum / count, latest);
+    wattroff(window, A_BOLD);
+
+    for (y = 0; y < height; y++) {
+        /* middle of the row, cell is filled when value reaches it */
+        level = hi - (hi - lo) * (y + 0.5) / height;
+
+        if (y == 0)
+            mvwprintw(window, y + 1, 0, "%*.2f ", HISTORY_LABEL_WIDTH, hi);
+        else if (y == height - 1)
+            mvwprintw(window, y + 1, 0, "%*.2f ", HISTORY_LABEL_WIDTH, lo);
+        else if (y == height / 2)
+            mvwprintw(window, y + 1, 0, "%*.2f ", HISTORY_LABEL_WIDTH, (hi + lo) / 2);
+        else
+            mvwprintw(window, y + 1, 0, "%*s ", HISTORY_LABEL_WIDTH, "");
+        waddch(window, ACS_VLINE);
+
+        for (x = 0; x < width; x++) {
+            if (!history_bucket(tab->history, tab->graph_level, tab->graph_metric, last - width + 1 + x, &b))
+                waddch(window, ' ');
+            else if (b.sum / b.count >= level)
+                waddch(window, ACS_BLOCK);
+            else if (b.max >= level)
+                waddch(window, ACS_VLINE);
+            else
+                waddch(window, ' ');
+        }
+    }
+
+    /* time axis */
+    span = (unsigned long) width * lv->res;
+    mvwprintw(window, height + 1, HISTORY_LABEL_WIDTH + 1, "-");
+    if (span >= 3600)
+        wprintw(window, "%luh%02lum", span / 3600, span % 3600 / 60);
+    else
+        wprintw(window, "%lum%02lus", span / 60, span % 60);
+    mvwprintw(window, height + 1, HISTORY_LABEL_WIDTH + 1 + width - 3, "now");
+
+    wrefresh(window);
+}
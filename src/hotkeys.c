@@ -13,6 +13,20 @@
 #include "include/common.h"
 #include "include/pgf.h"
 #include "include/hotkeys.h"
+#include "include/pgss.h"
+#include "include/procstat.h"
+#include "include/waitprof.h"
+#include "include/replstat.h"
+#include "include/relsize.h"
+#include "include/bloat.h"
+#include "include/xidwrap.h"
+#include "include/progress.h"
+#include "include/bufcache.h"
+#include "include/churn.h"
+#include "include/pgssagg.h"
+#include "include/indexuse.h"
+#include "include/alerts.h"
+#include "include/history.h"
 
 
 /*
@@ -51,8 +65,14 @@ void print_help_tab(bool * first_iter)
                 PROGRAM_NAME, PROGRAM_VERSION, PROGRAM_RELEASE);
     wprintw(w, "general actions:\n\
   a,d,i,f,r       mode: 'a' activity, 'd' databases, 'i' indexes, 'f' functions, 'r' replication,\n\
-  s,t,T,v         's' tables sizes, 't' tables, 'T' tables IO, 'v' vacuum progress,\n\
-  x,X             'x' pg_stat_statements switch, 'X' pg_stat_statements menu.\n\
+  c               'c' discover cascading standbys in replication mode.\n\
+  s,t,T,v,D       's' tables sizes, 't' tables, 'T' tables IO, 'v' commands progress, 'D' tables bloat,\n\
+  P,w,k,O,u,n,j   'P' processes OS stats (cpu, io, rss), 'w' wait events profile, 'k' locks tree,\n\
+                  'O' transaction ID wraparound risk, 'u' shared buffers usage, 'n' connections churn,\n\
+                  'j' index usage efficiency.\n\
+  x,X,o,g         'x' pg_stat_statements switch, 'X' pg_stat_statements menu, 'o' sort by trend growth,\n\
+                  'g' group pg_stat_statements aggregates by database, user or both.\n\
+  y,Y             'y' show header metric history graph, 'Y' change graph resolution.\n\
   Left,Right,/,F  'Left,Right' change column sort, '/' change sort desc/asc, 'F' set filter.\n\
   C,E,R           config: 'C' show config, 'E' edit configs, 'R' reload config.\n\
   p                       'p' start psql session.\n\
@@ -60,7 +80,8 @@ void print_help_tab(bool * first_iter)
   N,Ctrl+D,W      'N' add new connection, Ctrl+D close current connection, 'W' write connections info.\n\
   1..8            switch between tabs.\n\
 subtab actions:\n\
-  B,I,L           'B' iostat, 'I' nicstat, 'L' logtail.\n\
+  B,I,L,e         'B' iostat, 'I' nicstat, 'L' logtail, 'e' log stats.\n\
+  b               'b' sort iostat devices by %%util and hide devices below threshold.\n\
 activity actions:\n\
   -,_             '-' cancel backend by pid, '_' terminate backend by pid.\n\
   >,.             '>' set new mask, '.' show current mask.\n\
@@ -88,12 +109,12 @@ other actions:\n\
 
 /*
  ****************************************************************************
- * Set sort.
+ * Get max number of column which can be used for sort in current context.
  ****************************************************************************
  */
-void change_sort_order(struct tab_s * tab, bool increment, bool * first_iter)
+unsigned int get_order_key_max(struct tab_s * tab)
 {
-    unsigned int max = 0, i;
+    unsigned int max = 0;
 
     /* Determine max limit of range where cursor can move */
     switch (tab->current_context) {
@@ -139,41 +160,86 @@ void change_sort_order(struct tab_s * tab, bool increment, bool * first_iter)
             break;
         case pg_stat_functions:
             max = PG_STAT_FUNCTIONS_CMAX_LT;
-            *first_iter = true;
             break;
         case pg_stat_statements_timing:
             (atoi(tab->pg_special.pg_version_num) < PG92)
                 ? (max = PGSS_TIMING_CMAX_91)
                 : (max = PGSS_TIMING_CMAX_LT);
-            *first_iter = true;
             break;
         case pg_stat_statements_general:
             max = PGSS_GENERAL_CMAX_LT;
-            *first_iter = true;
             break;
         case pg_stat_statements_io:
             (atoi(tab->pg_special.pg_version_num) < PG92)
                 ? (max = PGSS_IO_CMAX_91)
                 : (max = PGSS_IO_CMAX_LT);
-            *first_iter = true;
             break;
         case pg_stat_statements_temp:
             max = PGSS_TEMP_CMAX_LT;
-            *first_iter = true;
             break;
         case pg_stat_statements_local:
             (atoi(tab->pg_special.pg_version_num) < PG92)
                 ? (max = PGSS_LOCAL_CMAX_91)
                 : (max = PGSS_LOCAL_CMAX_LT);
-            *first_iter = true;
             break;
         case pg_stat_progress_vacuum:
             max = PG_STAT_PROGRESS_VACUUM_CMAX_LT;
             break;
+        case pg_stat_proc:
+            max = PG_STAT_PROC_CMAX_LT;
+            break;
+        case pg_wait_profile:
+            max = PG_WAIT_PROFILE_CMAX_LT;
+            break;
+        case pg_locks_tree:
+            max = PG_LOCKS_TREE_CMAX_LT;
+            break;
+        case pg_tables_bloat:
+            max = PG_TABLES_BLOAT_CMAX_LT;
+            break;
+        case pg_xid_wraparound:
+            max = PG_XID_WRAPAROUND_CMAX_LT;
+            break;
+        case pg_buffercache:
+            max = PG_BUFFERCACHE_CMAX_LT;
+            break;
+        case pg_stat_connections:
+            max = PG_STAT_CONNECTIONS_CMAX_LT;
+            break;
+        case pg_stat_statements_agg:
+            max = PGSS_AGG_CMAX_LT;
+            break;
+        case pg_index_usage:
+            max = PG_INDEX_USAGE_CMAX_LT;
+            break;
         default:
             break;
     }
 
+    /* rates and catch-up columns are added to replication stats */
+    if (tab->current_context == pg_stat_replication)
+        max += REPLSTAT_COLS;
+
+    /* since 9.4 trend and growth columns are added before query text */
+    if (pgss_context(tab->current_context) && atoi(tab->pg_special.pg_version_num) >= PG94)
+        max += PGSS_HIST_COLS;
+
+    return max;
+}
+
+/*
+ ****************************************************************************
+ * Set sort.
+ ****************************************************************************
+ */
+void change_sort_order(struct tab_s * tab, bool increment, bool * first_iter)
+{
+    unsigned int max = get_order_key_max(tab), i;
+
+    /* these contexts are sorted using diffs, restart cycle to recalc them */
+    if (tab->current_context == pg_stat_functions || pgss_context(tab->current_context))
+        *first_iter = true;
+
     /* Change number of column used for sort */
     for (i = 0; i < TOTAL_CONTEXTS; i++) {
         if (tab->current_context == tab->context_list[i].context) {
@@ -208,6 +274,36 @@ void change_sort_order_direction(struct tab_s * tab, bool * first_iter)
     }
 }
 
+/*
+ ****************************************************** key press function **
+ * Sort pg_stat_statements by growth of trend, the most growing go first.
+ ****************************************************************************
+ */
+void sort_by_growth(WINDOW * window, struct tab_s * tab, PGresult * res, bool * first_iter)
+{
+    unsigned int i;
+
+    if (!pgss_context(tab->current_context)) {
+        wprintw(window, "Do nothing. Growth is shown only in pg_stat_statements contexts.");
+        return;
+    }
+    if (atoi(tab->pg_special.pg_version_num) < PG94) {
+        wprintw(window, "Do nothing. Growth requires queryid, available since 9.4.");
+        return;
+    }
+
+    /* growth column is followed by query text, the last column */
+    for (i = 0; i < TOTAL_CONTEXTS; i++) {
+        if (tab->current_context == tab->context_list[i].context) {
+            tab->context_list[i].order_key = get_order_key_max(tab) - 1;
+            tab->context_list[i].order_desc = true;
+        }
+    }
+    if (res && *first_iter == false)
+        PQclear(res);
+    *first_iter = true;
+}
+
 /*
  ****************************************************************************
  * Set filter or reset one.
@@ -321,13 +417,68 @@ void switch_context(WINDOW * window, struct tab_s * tab,
         case pg_stat_statements_local:
             wprintw(window, "Show pg_stat_statements local io");
             break;
+        case pg_stat_statements_agg:
+            wprintw(window, "Show pg_stat_statements aggregates by %s",
+                    pgss_grouping_name(tab->pgss_agg != NULL ? tab->pgss_agg->grouping : grouping_database));
+            break;
         case pg_stat_progress_vacuum:
-            wprintw(window, "Show vacuum progress");
+            if (atoi(tab->pg_special.pg_version_num) < PG96) {
+                wprintw(window, "Do nothing. Progress of commands requires 9.6 or newer.");
+                return;
+            }
+            (atoi(tab->pg_special.pg_version_num) < PG12)
+                ? wprintw(window, "Show vacuum progress")
+                : wprintw(window, "Show vacuum and other commands progress");
+            break;
+        case pg_stat_proc:
+            if (!tab->conn_local) {
+                wprintw(window, "Do nothing. Process stats are not supported for remote hosts.");
+                return;
+            }
+            wprintw(window, "Show processes OS stats");
+            break;
+        case pg_wait_profile:
+            if (atoi(tab->pg_special.pg_version_num) < PG92) {
+                wprintw(window, "Do nothing. Wait events profile requires 9.2 or newer.");
+                return;
+            }
+            wprintw(window, "Show wait events profile (last %.0f seconds)", WAITPROF_WINDOW);
+            break;
+        case pg_locks_tree:
+            if (atoi(tab->pg_special.pg_version_num) < PG92) {
+                wprintw(window, "Do nothing. Locks tree requires 9.2 or newer.");
+                return;
+            }
+            wprintw(window, "Show locks blocking tree");
+            break;
+        case pg_tables_bloat:
+            wprintw(window, "Show tables dead tuples and bloat estimation");
+            break;
+        case pg_xid_wraparound:
+            wprintw(window, "Show transaction ID wraparound risk");
+            break;
+        case pg_buffercache:
+            wprintw(window, "Show shared buffers usage (requires pg_buffercache, scanned every %u+ seconds)",
+                    BUFCACHE_MIN_INTERVAL);
+            break;
+        case pg_index_usage:
+            wprintw(window, "Show index usage efficiency");
+            break;
+        case pg_stat_connections:
+            if (atoi(tab->pg_special.pg_version_num) < PG92) {
+                wprintw(window, "Do nothing. Connections churn requires 9.2 or newer.");
+                return;
+            }
+            wprintw(window, "Show connections churn by application and user");
             break;
         default:
             break;
     }
 
+    /* release cached /proc descriptors when process stats are left */
+    if (tab->current_context == pg_stat_proc && context != pg_stat_proc)
+        close_proc_cache();
+
     tab->current_context = context;
     if (res && *first_iter == false)
         PQclear(res);
@@ -366,6 +517,38 @@ void change_min_age(WINDOW * window, struct tab_s * tab, PGresult *res, bool *fi
     *first_iter = true;
 }
 
+/*
+ ****************************************************** key press function **
+ * Set %util threshold for iostat. Devices are sorted by %util and devices
+ * with lower %util are hidden. Empty input restores the default view.
+ ****************************************************************************
+ */
+void set_iostat_min_util(WINDOW * window, struct tab_s * tab)
+{
+    bool with_esc;
+    double value;
+    char * end;
+    char min_util[XS_BUF_LEN],
+         msg[] = "Sort iostat by %util and hide devices with %util less than (empty - reset): ";
+
+    cmd_readline(window, msg, strlen(msg), &with_esc, min_util, sizeof(min_util), true);
+    if (with_esc == true)
+        return;
+
+    if (strlen(min_util) == 0) {
+        tab->iostat_min_util = -1;
+        wprintw(window, "Show all devices unsorted.");
+        return;
+    }
+
+    value = strtod(min_util, &end);
+    if (*end != '\0' || value < 0 || value > 100) {
+        wprintw(window, "Do nothing. Value should be between 0 and 100.");
+    } else {
+        tab->iostat_min_util = value;
+    }
+}
+
 /*
  ****************************************************************************
  * Clear connection options in specified tab.
@@ -380,6 +563,24 @@ void clear_tab_connopts(struct tab_s * tabs[], unsigned int i)
     tabs[i]->password[0] = '\0';
     tabs[i]->conninfo[0] = '\0';
     tabs[i]->conn_used = false;
+    tabs[i]->pgss_cache = NULL;
+    tabs[i]->pgss_hist = NULL;
+    tabs[i]->pgss_agg = NULL;
+    tabs[i]->waitprof = NULL;
+    tabs[i]->replstat = NULL;
+    tabs[i]->relsize = NULL;
+    tabs[i]->bloat = NULL;
+    tabs[i]->xidwrap = NULL;
+    tabs[i]->progress = NULL;
+    tabs[i]->bufcache = NULL;
+    tabs[i]->churn = NULL;
+    tabs[i]->indexuse = NULL;
+    tabs[i]->alert = NULL;
+    tabs[i]->history = NULL;
+    tabs[i]->graph = false;
+    memset(&tabs[i]->walstat, 0, sizeof(tabs[i]->walstat));
+    tabs[i]->pgss_calls = 0;
+    tabs[i]->pgss_has_prev = false;
 }
 
 /*
@@ -498,12 +699,35 @@ void shift_tabs(struct tab_s * tabs[], PGconn * conns[], unsigned int i)
 
         tabs[i]->subtab =        tabs[i + 1]->subtab;
         snprintf(tabs[i]->log_path, sizeof(tabs[i]->log_path), "%s", tabs[i + 1]->log_path);
-        tabs[i]->log_fd =            tabs[i + 1]->log_fd;
+        tabs[i]->logtail =           tabs[i + 1]->logtail;
+        tabs[i]->logstat =           tabs[i + 1]->logstat;
+        tabs[i]->waitprof =          tabs[i + 1]->waitprof;
+        tabs[i]->replstat =          tabs[i + 1]->replstat;
+        tabs[i]->relsize =           tabs[i + 1]->relsize;
+        tabs[i]->bloat =             tabs[i + 1]->bloat;
+        tabs[i]->xidwrap =           tabs[i + 1]->xidwrap;
+        tabs[i]->progress =          tabs[i + 1]->progress;
+        tabs[i]->bufcache =          tabs[i + 1]->bufcache;
+        tabs[i]->churn =             tabs[i + 1]->churn;
+        tabs[i]->indexuse =          tabs[i + 1]->indexuse;
+        tabs[i]->alert =             tabs[i + 1]->alert;
+        tabs[i]->history =           tabs[i + 1]->history;
+        tabs[i]->graph =             tabs[i + 1]->graph;
+        tabs[i]->graph_metric =      tabs[i + 1]->graph_metric;
+        tabs[i]->graph_level =       tabs[i + 1]->graph_level;
+        tabs[i]->walstat =           tabs[i + 1]->walstat;
+        tabs[i]->pgss_calls =        tabs[i + 1]->pgss_calls;
+        tabs[i]->pgss_has_prev =     tabs[i + 1]->pgss_has_prev;
+        tabs[i]->pgss_ts =           tabs[i + 1]->pgss_ts;
         tabs[i]->current_context =   tabs[i + 1]->current_context;
         snprintf(tabs[i]->pg_stat_activity_min_age, sizeof(tabs[i]->pg_stat_activity_min_age), "%s",
 		tabs[i + 1]->pg_stat_activity_min_age);
         tabs[i]->signal_options =    tabs[i + 1]->signal_options;
         tabs[i]->pg_stat_sys =       tabs[i + 1]->pg_stat_sys;
+        tabs[i]->pgss_cache =        tabs[i + 1]->pgss_cache;
+        tabs[i]->pgss_hist =         tabs[i + 1]->pgss_hist;
+        tabs[i]->pgss_agg =          tabs[i + 1]->pgss_agg;
+        tabs[i]->iostat_min_util =   tabs[i + 1]->iostat_min_util;
         tabs[i]->curr_iostat = tabs[i + 1]->curr_iostat;    tabs[i]->prev_iostat = tabs[i + 1]->prev_iostat;
         tabs[i]->curr_ifstat = tabs[i + 1]->curr_ifstat;    tabs[i]->prev_ifstat = tabs[i + 1]->prev_ifstat;
 
@@ -535,6 +759,34 @@ unsigned int close_tab(WINDOW * window, struct tab_s * tabs[],
 {
     unsigned int i = tab_index;
     PQfinish(conns[tab_index]);
+    free_pgss_cache(tabs[tab_index]->pgss_cache);
+    tabs[tab_index]->pgss_cache = NULL;
+    free_pgss_hist(tabs[tab_index]->pgss_hist);
+    tabs[tab_index]->pgss_hist = NULL;
+    free_pgss_agg(tabs[tab_index]->pgss_agg);
+    tabs[tab_index]->pgss_agg = NULL;
+    free(tabs[tab_index]->waitprof);
+    tabs[tab_index]->waitprof = NULL;
+    replstat_free(tabs[tab_index]->replstat);
+    tabs[tab_index]->replstat = NULL;
+    free_oidmap(tabs[tab_index]->relsize);
+    tabs[tab_index]->relsize = NULL;
+    free_oidmap(tabs[tab_index]->bloat);
+    tabs[tab_index]->bloat = NULL;
+    free_xidwrap(tabs[tab_index]->xidwrap);
+    tabs[tab_index]->xidwrap = NULL;
+    free(tabs[tab_index]->progress);
+    tabs[tab_index]->progress = NULL;
+    free_bufcache(tabs[tab_index]->bufcache);
+    tabs[tab_index]->bufcache = NULL;
+    free_churn(tabs[tab_index]->churn);
+    tabs[tab_index]->churn = NULL;
+    free_oidmap(tabs[tab_index]->indexuse);
+    tabs[tab_index]->indexuse = NULL;
+    free_alert_tab(tabs[tab_index]->alert);
+    tabs[tab_index]->alert = NULL;
+    free_history(tabs[tab_index]->history);
+    tabs[tab_index]->history = NULL;
 
     wprintw(window, "Close current connection.");
     if (i == 0) {                               /* first active tab */
@@ -841,7 +1093,7 @@ void edit_config_menu(WINDOW * w_cmd, WINDOW * w_dba, struct tab_s * tab, PGconn
     menu = new_menu((ITEM **)items);
 
     /* construct menu, outer window for header and inner window for menu */
-    menu_win = newwin(10,54,5,0);
+    menu_win = newwin(10,54,6,0);
     keypad(menu_win, TRUE);
     set_menu_win(menu, menu_win);
     set_menu_sub(menu, derwin(menu_win, 4,20,1,0));
@@ -909,7 +1161,8 @@ void pgss_menu(WINDOW * w_cmd, WINDOW * w_dba, struct tab_s * tab, bool *first_i
 	"pg_stat_statements general",
 	"pg_stat_statements input/output",
 	"pg_stat_statements temp input/output",
-	"pg_stat_statements local input/output" };
+	"pg_stat_statements local input/output",
+	"pg_stat_statements by database and user" };
     WINDOW *menu_win;
     MENU *menu;
     ITEM **items;
@@ -930,10 +1183,10 @@ void pgss_menu(WINDOW * w_cmd, WINDOW * w_dba, struct tab_s * tab, bool *first_i
     menu = new_menu((ITEM **)items);
 
     /* construct menu, outer window for header and inner window for menu */
-    menu_win = newwin(11,64,5,0);
+    menu_win = newwin(11,64,6,0);
     keypad(menu_win, TRUE);
     set_menu_win(menu, menu_win);
-    set_menu_sub(menu, derwin(menu_win, 5,40,1,0));
+    set_menu_sub(menu, derwin(menu_win, 6,40,1,0));
 
     /* clear stuff from db answer window */
     wclear(w_dba);
@@ -965,6 +1218,8 @@ void pgss_menu(WINDOW * w_cmd, WINDOW * w_dba, struct tab_s * tab, bool *first_i
                     tab->current_context = pg_stat_statements_temp;
                 else if (!strcmp(item_name(current_item(menu)), "pg_stat_statements local input/output"))
                     tab->current_context = pg_stat_statements_local;
+                else if (!strcmp(item_name(current_item(menu)), "pg_stat_statements by database and user"))
+                    tab->current_context = pg_stat_statements_agg;
                 else
                     wprintw(w_cmd, "Do nothing. Unknown mode.");     /* never should be here. */
                 done = true;
@@ -997,7 +1252,7 @@ void pgss_switch(WINDOW * w_cmd, struct tab_s * tab, PGresult * p_res, bool *fir
 {
     /*
      * Check current context and switch to pg_stat_statements.
-     * any -> pgss_timing -> pgss_general -> pgss_io -> pgss_temp -> pgss_local -> pgss_timing -> ...
+     * any -> pgss_timing -> pgss_general -> pgss_io -> pgss_temp -> pgss_local -> pgss_agg -> pgss_timing -> ...
      */
     switch (tab->current_context) {
 	case pg_stat_statements_timing:
@@ -1012,7 +1267,10 @@ void pgss_switch(WINDOW * w_cmd, struct tab_s * tab, PGresult * p_res, bool *fir
 	case pg_stat_statements_temp:
             switch_context(w_cmd, tab, pg_stat_statements_local, p_res, first_iter);
             break;
-	case pg_stat_statements_local: default:
+	case pg_stat_statements_local:
+            switch_context(w_cmd, tab, pg_stat_statements_agg, p_res, first_iter);
+            break;
+	case pg_stat_statements_agg: default:
             switch_context(w_cmd, tab, pg_stat_statements_timing, p_res, first_iter);
             break;
     }
@@ -1384,10 +1642,159 @@ void system_view_toggle(WINDOW * window, struct tab_s * tab, bool * first_iter)
 
 /*
  ****************************************************************************
- * Get postgresql logfile path
+ * Toggle on/off discovery of cascading standbys in replication context.
+ * Standbys are connected with connection options of the tab.
  ****************************************************************************
  */
-void get_logfile_path(char * path, PGconn * conn)
+void cascade_toggle(WINDOW * window, struct tab_s * tab)
+{
+    if (tab->current_context != pg_stat_replication) {
+        wprintw(window, "Do nothing. Cascading standbys are shown only in replication context.");
+        return;
+    }
+
+    if (tab->replstat == NULL)
+        tab->replstat = replstat_init();
+
+    tab->replstat->cascade ^= 1;
+    if (tab->replstat->cascade)
+        wprintw(window, "Discover cascading standbys: on");
+    else {
+        replstat_disconnect(tab->replstat);
+        wprintw(window, "Discover cascading standbys: off");
+    }
+}
+
+/*
+ ****************************************************************************
+ * Switch grouping of pg_stat_statements aggregates: by database, by user,
+ * by both. All groupings are built from the same snapshot, thus new one is
+ * shown without waiting for the next snapshot.
+ ****************************************************************************
+ */
+void pgss_grouping_switch(WINDOW * window, struct tab_s * tab, PGresult * res, bool * first_iter)
+{
+    if (tab->current_context != pg_stat_statements_agg) {
+        wprintw(window, "Do nothing. Grouping is used only in pg_stat_statements aggregates context.");
+        return;
+    }
+
+    if (tab->pgss_agg == NULL)
+        tab->pgss_agg = pgss_agg_init();
+
+    tab->pgss_agg->grouping = (tab->pgss_agg->grouping + 1) % PGSS_GROUPINGS;
+    wprintw(window, "Group pg_stat_statements by %s", pgss_grouping_name(tab->pgss_agg->grouping));
+
+    if (res && *first_iter == false)
+        PQclear(res);
+    *first_iter = true;
+}
+
+/*
+ ****************************************************************************
+ * Print the menu of header metrics, chosen metric history is shown instead
+ * of context.
+ ****************************************************************************
+ */
+void graph_menu(WINDOW * w_cmd, WINDOW * w_dba, struct tab_s * tab, PGresult * res, bool *first_iter)
+{
+    WINDOW *menu_win;
+    MENU *menu;
+    ITEM **items;
+    unsigned int n_choices = HEADER_METRICS + 1, i;
+    int ch;
+    bool done = false;
+
+    cbreak();
+    noecho();
+    keypad(stdscr, TRUE);
+
+    /* allocate stuff, the first item turns graph off */
+    items = init_menuitems(n_choices + 1);
+    items[0] = new_item("off", NULL);
+    for (i = 1; i < n_choices; i++)
+        items[i] = new_item(metric_name(i - 1), NULL);
+    items[n_choices] = (ITEM *)NULL;
+    menu = new_menu((ITEM **)items);
+
+    /* construct menu, outer window for header and inner window for menu */
+    menu_win = newwin(n_choices + 2,64,6,0);
+    keypad(menu_win, TRUE);
+    set_menu_win(menu, menu_win);
+    set_menu_sub(menu, derwin(menu_win, n_choices,40,1,0));
+    if (tab->graph)
+        set_current_item(menu, items[tab->graph_metric + 1]);
+
+    /* clear stuff from db answer window */
+    wclear(w_dba);
+    wrefresh(w_dba);
+    /* print menu header */
+    mvwprintw(menu_win, 0, 0, "Choose metric history graph (Enter to choose, Esc to exit):");
+    post_menu(menu);
+    wrefresh(menu_win);
+
+    while (1) {
+        if (done)
+            break;
+        ch = wgetch(menu_win);
+        switch (ch) {
+            case KEY_DOWN:
+                menu_driver(menu, REQ_DOWN_ITEM);
+                break;
+            case KEY_UP:
+                menu_driver(menu, REQ_UP_ITEM);
+                break;
+            case 10:
+                i = item_index(current_item(menu));
+                tab->graph = (i > 0);
+                if (tab->graph) {
+                    tab->graph_metric = i - 1;
+                    wprintw(w_cmd, "Show %s history, %s.", metric_name(tab->graph_metric),
+                            history_level_name(tab->graph_level));
+                }
+                done = true;
+                break;
+            case 27:
+                done = true;
+                break;
+        }
+    }
+
+    /* clear menu items from tab */
+    clear();
+    refresh();
+
+    /* free stuff */
+    unpost_menu(menu);
+    for (i = 0; i < n_choices; i++)
+        free_item(items[i]);
+    free_menu(menu);
+    delwin(menu_win);
+    if (res && *first_iter == false)
+        PQclear(res);
+    *first_iter = true;
+}
+
+/*
+ ****************************************************************************
+ * Switch resolution of metric history graph.
+ ****************************************************************************
+ */
+void graph_zoom(WINDOW * window, struct tab_s * tab)
+{
+    tab->graph_level = (tab->graph_level + 1) % HISTORY_LEVELS;
+    wprintw(window, "Graph resolution: %s.", history_level_name(tab->graph_level));
+    if (!tab->graph)
+        wprintw(window, " Choose metric with 'y'.");
+}
+
+/*
+ ****************************************************************************
+ * Get postgresql logfile path. For remote hosts the path is checked with
+ * postgres functions, since 10 pg_current_logfile() is used.
+ ****************************************************************************
+ */
+void get_logfile_path(char * path, PGconn * conn, bool conn_local)
 {
     PGresult *res;
     char errmsg[ERRSIZE],
@@ -1401,6 +1808,17 @@ void get_logfile_path(char * path, PGconn * conn)
          path_log_fallback[PATH_MAX + NAME_MAX] = "";
 
     path[0] = '\0';
+    if (!conn_local && PQserverVersion(conn) >= PG10) {
+        if ((res = do_query(conn, PG_CURRENT_LOGFILE_QUERY, errmsg)) == NULL) {
+            PQclear(res);
+            return;
+        }
+        if (!PQgetisnull(res, 0, 0))
+            snprintf(path, PATH_MAX, "%s", PQgetvalue(res, 0, 0));
+        PQclear(res);
+        return;
+    }
+
     if ((res = do_query(conn, q2, errmsg)) == NULL) {
         PQclear(res);
         return;
@@ -1459,7 +1877,7 @@ void get_logfile_path(char * path, PGconn * conn)
     strftime(path, PATH_MAX, path_log, info);
 
     /* if file exists, return path */
-    if (access(path, F_OK ) != -1 ) {
+    if ((conn_local && access(path, F_OK) != -1) || (!conn_local && logtail_remote_size(conn, path) != -1)) {
         return;
     } 
     
@@ -1483,28 +1901,30 @@ void subtab_process(WINDOW * window, WINDOW ** w_sub, struct tab_s * tab, PGconn
     if (tab->subtab == SUBTAB_NONE) {
         /* open subtab */
         switch (subtab) {
-            case SUBTAB_LOGTAIL:
-                if (tab->conn_local) {
-                    *w_sub = newwin(0, 0, ((LINES * 2) / 3), 0);
-                    wrefresh(window);
-                    /* get logfile path  */
-                    get_logfile_path(tab->log_path, conn);
-    
-                    if (strlen(tab->log_path) == 0) {
-                        wprintw(window, "Do nothing. Unable to determine log filename or no access permissions.");
-                        return;
-                    }
-                    if ((tab->log_fd = open(tab->log_path, O_RDONLY)) == -1 ) {
-                        wprintw(window, "Do nothing. Failed to open %s", tab->log_path);
-                        return;
-                    }
-                    tab->subtab = SUBTAB_LOGTAIL;
-                    wprintw(window, "Open postgresql log: %s", tab->log_path);
+            case SUBTAB_LOGTAIL: case SUBTAB_LOGSTAT:
+                *w_sub = newwin(0, 0, ((LINES * 2) / 3), 0);
+                wrefresh(window);
+                /* get logfile path  */
+                get_logfile_path(tab->log_path, conn, tab->conn_local);
+
+                if (strlen(tab->log_path) == 0) {
+                    wprintw(window, "Do nothing. Unable to determine log filename or no access permissions.");
                     return;
-                } else {
-                    wprintw(window, "Do nothing. Log file view is not supported for remote hosts.");
+                }
+                /* remote log is read through the connection */
+                if ((tab->logtail = logtail_open(tab->log_path, tab->conn_local ? NULL : conn)) == NULL) {
+                    wprintw(window, "Do nothing. Failed to open %s", tab->log_path);
                     return;
                 }
+                /* parse only data which appears after the log is opened */
+                if (subtab == SUBTAB_LOGSTAT) {
+                    tab->logstat = logstat_init(strstr(tab->log_path, ".csv") != NULL);
+                    tab->logtail->hook = logstat_feed;
+                    tab->logtail->hook_arg = tab->logstat;
+                }
+                tab->subtab = subtab;
+                wprintw(window, "Open postgresql log: %s", tab->log_path);
+                return;
                 break;
             case SUBTAB_IOSTAT:
                 if (tab->conn_local) {
@@ -1543,8 +1963,14 @@ void subtab_process(WINDOW * window, WINDOW ** w_sub, struct tab_s * tab, PGconn
         /* close subtab */
         wclear(*w_sub);
         wrefresh(*w_sub);
-        if (tab->log_fd > 0)
-            close(tab->log_fd);
+        if (tab->logtail != NULL) {
+            logtail_close(tab->logtail);
+            tab->logtail = NULL;
+        }
+        if (tab->logstat != NULL) {
+            free(tab->logstat);
+            tab->logstat = NULL;
+        }
         tab->subtab = SUBTAB_NONE;
         return;
     }
@@ -1552,20 +1978,68 @@ void subtab_process(WINDOW * window, WINDOW ** w_sub, struct tab_s * tab, PGconn
 
 /*
  ****************************************************************************
- * Tail postgresql log in aux stat area.
+ * Read new log data. When log is rotated or a new file is created in log
+ * directory, check log path and switch to the new log file.
+ * Return false if log can't be read.
+ ****************************************************************************
+ */
+bool follow_log(WINDOW * w_cmd, struct tab_s * tab, PGconn * conn)
+{
+    unsigned int flags;
+    char path[PATH_MAX];
+
+    flags = logtail_check(tab->logtail);
+
+    if (flags & LOGTAIL_ROTATED) {
+        get_logfile_path(path, conn, tab->conn_local);
+        if (strlen(path) == 0)
+            snprintf(path, sizeof(path), "%s", tab->log_path);
+
+        /* log is switched to a new name, or renamed and created with the same name */
+        if (strcmp(path, tab->log_path) != 0 || logtail_replaced(tab->logtail)) {
+            if (logtail_switch(tab->logtail, path, conn) == 0) {
+                snprintf(tab->log_path, sizeof(tab->log_path), "%s", path);
+                wprintw(w_cmd, "Log rotated, tail %s", tab->log_path);
+            }
+        }
+        flags |= LOGTAIL_MODIFIED;
+    }
+
+    if ((flags & LOGTAIL_MODIFIED) && logtail_read(tab->logtail, conn) == (ssize_t) -1)
+        return false;
+
+    return true;
+}
+
+/*
+ ****************************************************************************
+ * Show log analytics in aux stat area. New log data is parsed as it comes.
+ ****************************************************************************
+ */
+void print_logstat(WINDOW * window, WINDOW * w_cmd, struct tab_s * tab, PGconn * conn)
+{
+    if (follow_log(w_cmd, tab, conn) == false) {
+        wprintw(w_cmd, "Do nothing. Log is not a regular file or can't be read.");
+        subtab_process(w_cmd, &window, tab, conn, SUBTAB_NONE);    /* close log file and log tab */
+        return;
+    }
+
+    logstat_update_rates(tab->logstat);
+    logstat_print(window, tab->logstat, tab->log_path);
+}
+
+/*
+ ****************************************************************************
+ * Tail postgresql log in aux stat area. Only appended bytes are read, when
+ * log is rotated, switch to the new log file.
  ****************************************************************************
  */
 void print_log(WINDOW * window, WINDOW * w_cmd, struct tab_s * tab, PGconn * conn)
 {
     unsigned int x, y;                                          /* window coordinates */
     unsigned int n_lines = 1, n_cols = 1;                       /* number of rows and columns for printing */
-    struct stat stats;                                          /* file stat struct */
-    off_t end_pos;                                              /* end of file position */
-    off_t pos;                                                  /* from this position start read of file */
-    size_t bytes_read;                                          /* bytes read from file to buffer */
-    char buffer[XXXL_BUF_LEN] = "";                               /* init empty buffer */
-    unsigned int i, nl_count = 0, len, scan_pos;                /* iterator, newline counter, buffer length, in-buffer scan position */
-    char *nl_ptr;                                               /* in-buffer newline pointer */
+    unsigned int i, len;
+    const char * line;
 
     getbegyx(window, y, x);                                     /* get window coordinates */
     /* calculate number of rows for log tailing, 2 is the number of lines for tab header */
@@ -1573,83 +2047,26 @@ void print_log(WINDOW * window, WINDOW * w_cmd, struct tab_s * tab, PGconn * con
     n_cols = COLS - x - 1;                                      /* calculate number of chars in row for cutting multiline log entries */
     wclear(window);                                             /* clear log window */
 
-    if ((fstat(tab->log_fd, &stats)) == -1) {
-	wprintw(w_cmd, "Failed to stat %s", tab->log_path);
-	wrefresh(w_cmd);
-	return;
+    if (follow_log(w_cmd, tab, conn) == false) {
+        wprintw(w_cmd, "Do nothing. Log is not a regular file or can't be read.");
+        subtab_process(w_cmd, &window, tab, conn, SUBTAB_NONE);    /* close log file and log tab */
+        return;
     }
-    if (S_ISREG (stats.st_mode) && stats.st_size != 0) {        /* log should be a non-empty regular file */
-        end_pos = lseek(tab->log_fd, 0, SEEK_END);           /* get end of file position */
-        pos = end_pos;                                          /* set position to the end of file */
-        bytes_read = XXXL_BUF_LEN;                                /* read with 8KB block */
-        if (end_pos < XXXL_BUF_LEN)                               /* if end file pos less than buffer */
-            pos = 0;                                            /* than set read position to the begin of file */
-        else                                                    /* if end file pos more than buffer */
-            pos = pos - bytes_read;                             /* than set read position into end of file minus buffer size */
-        lseek(tab->log_fd, pos, SEEK_SET);                       /* set determined position in file */
-        bytes_read = read(tab->log_fd, buffer, bytes_read);      /* read file to the buffer */
-
-        len = strlen(buffer);                                   /* determine the buffer length */
-        scan_pos = len;                                         /* set in-buffer scan position equal buffer length */
-
-        /* print header */
-        wattron(window, A_BOLD);
-        wprintw(window, "\ntail %s\n", tab->log_path);
-        wattroff(window, A_BOLD);
-
-        for (i = 0; i < len; i++)                               /* get number of newlines in the buffer */
-            if (buffer[i] == '\n')
-                nl_count++;
-        if (n_lines > nl_count) {                               /* if number of newlines less than required */
-            wprintw(window, "%s", buffer);                      /* then print out buffer content */
-            wrefresh(window);
-            return;                                             /* and finish work */
-        }
 
-        /*
-         * at this place, log size more than buffersize, fill the buffer 
-         * and find \n position from which start printing.
-         */
-        unsigned int n_lines_save = n_lines;                    /* save number of lines need for tail. */
-        do {
-            nl_ptr = memrchr(buffer, '\n', scan_pos);           /* find \n from scan_pos */
-            if (nl_ptr != NULL) {                               /* if found */
-                scan_pos = (nl_ptr - buffer);                   /* remember this place */
-            } else {                                            /* if not found */
-                break;                                          /* finish work */
-            }
-            n_lines--;                                          /* after each iteration decrement the line counter */
-        } while (n_lines != 0);                                 /* stop cycle when line counter equal zero - we found need amount of lines */
-
-        /* now we should cut multiline log entries to tab length */
-        char str[n_cols];                                       /* use var for one line */
-        char tmp[XXXL_BUF_LEN];                                   /* tmp var for line from buffer */
-        do {                                                    /* scan buffer from begin */
-            nl_ptr = strstr(buffer, "\n");                      /* find \n in buffer */
-            if (nl_ptr != NULL) {                               /* if found */
-                if (nl_count > n_lines_save) {                              /* and if lines too much, skip them */
-                    snprintf(buffer, sizeof(buffer), "%s", nl_ptr + 1);     /* decrease buffer, cut skipped line */
-                    nl_count--;                                             /* decrease newline counter */
-                    continue;                                   /* start next iteration */
-                }                                                       /* at this place we have sufficient number of lines for tail */
-                snprintf(tmp, nl_ptr - buffer + 1, "%s", buffer);       /* copy log line into temp buffer */
-                if (strlen(tmp) > n_cols) {                             /* if line longer than tab size (multiline), truncate line to tab size */
-                    snprintf(str, n_cols - 4, "%s", buffer);
-                } else {                                                /* if line have normal size, copy line as is */
-                    snprintf(str, strlen(tmp) + 1, "%s", buffer);
-                }
-                wprintw(window, "%s\n", str);                           /* print line to log tab */
-                snprintf(buffer, sizeof(buffer), "%s", nl_ptr + 1);     /* decrease buffer, cut printed line */
-            } else {
-                break;                                                  /* if \n not found, finish work */
-            }
-            n_lines++;                                                  /* after each iteration, increase newline counter */
-        } while (n_lines != n_lines_save);                              /* print lines until newline counter not equal saved newline counter */
-    } else {
-        wprintw(w_cmd, "Do nothing. Log is not a regular file or empty.");     /* if file not regular or empty */
-        subtab_process(w_cmd, &window, tab, conn, SUBTAB_NONE);    /* close log file and log tab */
+    /* print header */
+    wattron(window, A_BOLD);
+    wprintw(window, "\ntail %s\n", tab->log_path);
+    wattroff(window, A_BOLD);
+
+    /* print last lines, multiline log entries are cut to tab length */
+    i = (tab->logtail->count > n_lines) ? tab->logtail->count - n_lines : 0;
+    for (; i < tab->logtail->count; i++) {
+        line = logtail_get_line(tab->logtail, i, &len);
+        if (len > n_cols)
+            len = n_cols - 4;
+        wprintw(window, "%.*s\n", (int) len, line);
     }
-    
+
     wrefresh(window);
 }
 
@@ -1664,7 +2081,7 @@ void show_full_log(WINDOW * window, struct tab_s * tab, PGconn * conn)
 
     if (tab->conn_local) {
         /* get logfile path  */
-        get_logfile_path(tab->log_path, conn);
+        get_logfile_path(tab->log_path, conn, tab->conn_local);
         if (strlen(tab->log_path) != 0) {
             /* escape from ncurses mode */
             refresh();
@@ -1719,41 +2136,67 @@ void pg_stat_reset(WINDOW * window, PGconn * conn, bool * reseted)
 
 /*
  ****************************************************************************
- * Get query text using pseudo pg_stat_statements.queryid.
+ * Get query text using pg_stat_statements.queryid (pseudo queryid before 9.4).
  ****************************************************************************
  */
 void get_query_by_id(WINDOW * window, struct tab_s * tab, PGconn * conn)
 {
-    if (tab->current_context != pg_stat_statements_timing
-            && tab->current_context != pg_stat_statements_general
-            && tab->current_context != pg_stat_statements_io
-            && tab->current_context != pg_stat_statements_temp
-            && tab->current_context != pg_stat_statements_local) {
+    if (!pgss_context(tab->current_context)) {
         wprintw(window, "Get query text is not allowed here.");
         return;
     }
     
-    PGresult * res;
-    bool with_esc;
+    PGresult * res, * text_res = NULL;
+    bool with_esc, native;
     char msg[] = "Enter queryid: ",
          query[QUERY_MAXLEN],
          pager[M_BUF_LEN] = "";
-    char queryid[XS_BUF_LEN];
+    char queryid[S_BUF_LEN], * end;
     char errmsg[ERRSIZE];
+    const char * params[1] = { queryid };
     FILE * fpout;
 
     cmd_readline(window, msg, strlen(msg), &with_esc, queryid, sizeof(queryid), true);
-    if (check_string(queryid, is_alfanum) == -1) {
+    /* native queryid is a signed bigint, pseudo queryid is a part of md5 */
+    native = (atoi(tab->pg_special.pg_version_num) >= PG94);
+    if (native && strlen(queryid) != 0) {
+        errno = 0;
+        strtoll(queryid, &end, 10);
+        if (check_string(queryid, is_number) == -1 || *end != '\0' || errno == ERANGE) {
+            wprintw(window, "Do nothing. Value is not valid.");
+            return;
+        }
+    }
+    if (!native && check_string(queryid, is_alfanum) == -1) {
         wprintw(window, "Do nothing. Value is not valid.");
         return;
     }
 
     if (strlen(queryid) != 0 && with_esc == false) {
-        /* do query and send result into less */
-	snprintf(query, sizeof(query), "%s%s%s", PG_GET_QUERYREP_BY_QUERYID_QUERY_P1, queryid, PG_GET_QUERYREP_BY_QUERYID_QUERY_P2);
-        if ((res = do_query(conn, query, errmsg)) == NULL) {
-            wprintw(window, "%s", errmsg);
-            return;
+        if (native) {
+            /* counters of all queries without texts, text only of the requested query */
+            res = PQexecParams(conn, PG_GET_QUERYREP_COUNTERS_QUERY, 1, NULL, params, NULL, NULL, 0);
+            if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0) {
+                text_res = PQexecParams(conn, PG_GET_QUERYREP_TEXT_QUERY, 1, NULL, params, NULL, NULL, 0);
+                if (PQresultStatus(text_res) != PGRES_TUPLES_OK) {
+                    wprintw(window, "%s", PQresultErrorMessage(text_res));
+                    PQclear(text_res);
+                    PQclear(res);
+                    return;
+                }
+            } else if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+                wprintw(window, "%s", PQresultErrorMessage(res));
+                PQclear(res);
+                return;
+            }
+        } else {
+            /* do query and send result into less */
+            snprintf(query, sizeof(query), "%s%s%s%s", PG_GET_QUERYREP_BY_QUERYID_QUERY_P1,
+                    PG_GET_QUERYREP_MD5_FILTER, queryid, PG_GET_QUERYREP_BY_QUERYID_QUERY_P2);
+            if ((res = do_query(conn, query, errmsg)) == NULL) {
+                wprintw(window, "%s", errmsg);
+                return;
+            }
         }
 
         /* finish work if empty answer */
@@ -1770,6 +2213,8 @@ void get_query_by_id(WINDOW * window, struct tab_s * tab, PGconn * conn)
         
         if ((fpout = popen(pager, "w")) == NULL) {
             wprintw(window, "Do nothing. Failed to open pipe to %s", pager);
+            PQclear(text_res);
+            PQclear(res);
             return;
         }
 
@@ -1778,7 +2223,10 @@ void get_query_by_id(WINDOW * window, struct tab_s * tab, PGconn * conn)
         endwin();
 
         /* print result */
-        fprintf(fpout, "summary:\n\ttotal_time: %s, cpu_time: %s, io_time: %s (ALL: %s%%, CPU: %s%%, IO: %s%%),\ttotal queries: %s\n\
+        if (native) {
+            write_query_report(fpout, res, (PQntuples(text_res) > 0) ? PQgetvalue(text_res, 0, 0) : "", queryid);
+        } else {
+            fprintf(fpout, "summary:\n\ttotal_time: %s, cpu_time: %s, io_time: %s (ALL: %s%%, CPU: %s%%, IO: %s%%),\ttotal queries: %s\n\
 query info:\n\
 \tusename:\t\t\t\t%s,\n\
 \tdatname:\t\t\t\t%s,\n\
@@ -1787,24 +2235,26 @@ query info:\n\
 \ttotal time (relative to all queries):\t%s (ALL: %s%%, CPU: %s%%, IO: %s%%),\n\
 \taverage time (only for this query):\t%sms, cpu_time: %sms, io_time: %sms, (ALL: %s%%, CPU: %s%%, IO: %s%%),\n\n\
 query text (id: %s):\n%s",
-        /* summary */
-        PQgetvalue(res, 0, REP_ALL_TOTAL_TIME), PQgetvalue(res, 0, REP_ALL_CPU_TIME), PQgetvalue(res, 0, REP_ALL_IO_TIME),
-        PQgetvalue(res, 0, REP_ALL_TOTAL_TIME_PCT), PQgetvalue(res, 0, REP_ALL_CPU_TIME_PCT), PQgetvalue(res, 0, REP_ALL_IO_TIME_PCT), 
-        PQgetvalue(res, 0, REP_ALL_TOTAL_QUERIES),
-        /* user, dbname */
-        PQgetvalue(res, 0, REP_USER), PQgetvalue(res, 0, REP_DBNAME),
-        /* calls and rows */
-        PQgetvalue(res, 0, REP_CALLS), PQgetvalue(res, 0, REP_CALLS_PCT),
-        PQgetvalue(res, 0, REP_ROWS), PQgetvalue(res, 0, REP_ROWS_PCT),
-        /* timings */
-        PQgetvalue(res, 0, REP_TOTAL_TIME), PQgetvalue(res, 0, REP_TOTAL_TIME_PCT), PQgetvalue(res, 0, REP_CPU_TIME_PCT), PQgetvalue(res, 0, REP_IO_TIME_PCT),
-        /* averages */
-        PQgetvalue(res, 0, REP_AVG_TIME), PQgetvalue(res, 0, REP_AVG_CPU_TIME), PQgetvalue(res, 0, REP_AVG_IO_TIME), 
-        PQgetvalue(res, 0, REP_AVG_TIME_PCT), PQgetvalue(res, 0, REP_AVG_CPU_TIME_PCT), PQgetvalue(res, 0, REP_AVG_IO_TIME_PCT),
-        /* query */
-        queryid, PQgetvalue(res, 0, REP_QUERY));
+            /* summary */
+            PQgetvalue(res, 0, REP_ALL_TOTAL_TIME), PQgetvalue(res, 0, REP_ALL_CPU_TIME), PQgetvalue(res, 0, REP_ALL_IO_TIME),
+            PQgetvalue(res, 0, REP_ALL_TOTAL_TIME_PCT), PQgetvalue(res, 0, REP_ALL_CPU_TIME_PCT), PQgetvalue(res, 0, REP_ALL_IO_TIME_PCT), 
+            PQgetvalue(res, 0, REP_ALL_TOTAL_QUERIES),
+            /* user, dbname */
+            PQgetvalue(res, 0, REP_USER), PQgetvalue(res, 0, REP_DBNAME),
+            /* calls and rows */
+            PQgetvalue(res, 0, REP_CALLS), PQgetvalue(res, 0, REP_CALLS_PCT),
+            PQgetvalue(res, 0, REP_ROWS), PQgetvalue(res, 0, REP_ROWS_PCT),
+            /* timings */
+            PQgetvalue(res, 0, REP_TOTAL_TIME), PQgetvalue(res, 0, REP_TOTAL_TIME_PCT), PQgetvalue(res, 0, REP_CPU_TIME_PCT), PQgetvalue(res, 0, REP_IO_TIME_PCT),
+            /* averages */
+            PQgetvalue(res, 0, REP_AVG_TIME), PQgetvalue(res, 0, REP_AVG_CPU_TIME), PQgetvalue(res, 0, REP_AVG_IO_TIME), 
+            PQgetvalue(res, 0, REP_AVG_TIME_PCT), PQgetvalue(res, 0, REP_AVG_CPU_TIME_PCT), PQgetvalue(res, 0, REP_AVG_IO_TIME_PCT),
+            /* query */
+            queryid, PQgetvalue(res, 0, REP_QUERY));
+        }
 
         /* clean */
+        PQclear(text_res);
         PQclear(res);
         pclose(fpout);
 
@@ -0,0 +1,108 @@
+/*
+ ****************************************************************************
+ * alerts.h
+ *      definitions and macros for threshold alerts.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#ifndef __ALERTS_H__
+#define __ALERTS_H__
+
+#include <sys/wait.h>
+#include <time.h>
+#include "common.h"
+
+#define ALERT_RULES_MAX     64          /* max number of rules */
+#define ALERT_ROWS          64          /* tracked offending rows per rule, power of two */
+#define ALERT_MAX_TOKENS    8           /* target op value [vs window avg] [for hold] */
+
+/* comparison of alert rule */
+enum alert_op
+{
+    alert_gt,
+    alert_ge,
+    alert_lt,
+    alert_le,
+    alert_eq,
+    alert_ne,
+    alert_drops,                        /* value is below average by percent */
+    alert_rises                         /* value is above average by percent */
+};
+
+/* compiled alert rule, targets header metric or column of context */
+struct alert_rule_s
+{
+    char text[L_BUF_LEN];               /* condition as written, for messages and hook */
+    int metric;                         /* header metric, -1 for column rule */
+    enum context context;               /* context of column rule */
+    char column[S_BUF_LEN];             /* column name of column rule */
+    enum alert_op op;
+    double value;                       /* threshold, or percent for drops and rises */
+    double window;                      /* seconds, average window for drops and rises */
+    double hold;                        /* seconds, condition should hold before alert */
+    char hook[L_BUF_LEN];               /* command executed when alert fires, may be empty */
+};
+
+/* rules loaded at startup, they are common for all tabs */
+struct alerts_s
+{
+    struct alert_rule_s rules[ALERT_RULES_MAX];
+    unsigned int n_rules;
+};
+
+#define ALERTS_SIZE (sizeof(struct alerts_s))
+
+/* offending row of column rule, rows are identified by the first column */
+struct alert_row_s
+{
+    unsigned int hash;
+    unsigned int seen;                  /* evaluation when row offended last time, 0 - never */
+    struct timespec since;              /* row offends since */
+    bool fired;                         /* hook is executed */
+};
+
+/* state of rule in tab */
+struct alert_state_s
+{
+    bool active;                        /* condition holds */
+    bool fired;                         /* condition holds long enough */
+    struct timespec since;              /* condition holds since */
+    bool has_avg;                       /* average is valid */
+    double avg;                         /* time-weighted average for drops and rises */
+    struct timespec avg_ts;             /* time of the latest average update */
+    struct timespec avg_start;          /* time of the first value in average */
+    unsigned int seq;                   /* evaluation counter of column rule */
+    struct alert_row_s rows[ALERT_ROWS];
+};
+
+/* per-tab alerts state and offending cells of the shown result */
+struct alert_tab_s
+{
+    struct alert_state_s * states;      /* one per rule */
+    unsigned char * marks;              /* offending cells, n_rows x n_cols */
+    unsigned int marks_size;            /* allocated cells */
+    unsigned int n_rows;
+    unsigned int n_cols;
+    bool shown;                         /* alerts are printed in cmd window */
+};
+
+#define ALERT_TAB_SIZE (sizeof(struct alert_tab_s))
+
+/* function declarations */
+int context_lookup(const char * name);
+bool parse_alert_rule(const char * line, struct alert_rule_s * rule);
+struct alerts_s * load_alerts(struct args_s * args);
+struct alert_tab_s * alert_tab_init(struct alerts_s * alerts);
+void free_alert_tab(struct alert_tab_s * at);
+double alert_elapsed(struct timespec * from, struct timespec * to);
+bool alert_condition(struct alert_rule_s * rule, struct alert_state_s * st, double value, struct timespec * now);
+struct alert_row_s * alert_row_lookup(struct alert_state_s * st, unsigned int hash, struct timespec * now);
+void run_alert_hook(struct alert_rule_s * rule, struct tab_s * tab, const char * object, double value);
+void mark_alerts(struct alerts_s * alerts, struct tab_s * tab, PGresult * res, char *** arr,
+        unsigned int n_rows, unsigned int n_cols);
+bool alert_marked(struct tab_s * tab, unsigned int row, unsigned int col);
+void check_header_alerts(WINDOW * window, struct alerts_s * alerts, struct tab_s * tab);
+
+#endif /* __ALERTS_H__ */
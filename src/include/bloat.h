@@ -0,0 +1,50 @@
+/*
+ ****************************************************************************
+ * bloat.h
+ *      definitions and macros for dead tuples and bloat growth estimation.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#ifndef __BLOAT_H__
+#define __BLOAT_H__
+
+#include <time.h>
+#include "common.h"
+#include "pgf.h"
+#include "oidmap.h"
+
+#define BLOAT_MIN_ELAPSED       0.5         /* seconds, more frequent snapshots aren't used for rates */
+#define BLOAT_SMOOTH            0.3         /* weight of the last snapshot in smoothed rates */
+#define BLOAT_COLS              10          /* relation, size, live, dead, estimations */
+
+/* columns of tables bloat query, see PG_TABLES_BLOAT_QUERY_* */
+#define BLOAT_RELID_COL         0
+#define BLOAT_RELATION_COL      1
+#define BLOAT_LIVE_COL          2
+#define BLOAT_DEAD_COL          3
+#define BLOAT_SIZE_COL          4
+#define BLOAT_LIMIT_COL         5
+#define BLOAT_ENABLED_COL       6
+
+/* history of table, previous snapshot and smoothed rates, entry of oidmap */
+struct bloat_entry_s
+{
+    unsigned int relid;                 /* table oid, the key of oidmap */
+    bool has_prev;                      /* previous snapshot is valid */
+    bool has_rates;                     /* smoothed rates are valid */
+    long long n_dead;                   /* dead tuples */
+    double bloat;                       /* estimated bloat, KB */
+    struct timespec ts;                 /* time of previous snapshot */
+    double dead_rate;                   /* smoothed growth of dead tuples, per second */
+    double bloat_rate;                  /* smoothed growth of bloat, KB/s */
+};
+
+/* function declarations */
+void bloat_update(struct bloat_entry_s * e, long long n_dead, double bloat, struct timespec * ts);
+void format_vacuum_eta(struct bloat_entry_s * e, long long n_dead, double limit, bool enabled,
+        char * buf, size_t len);
+PGresult * merge_bloat_stats(PGconn * conn, PGresult * res, struct tab_s * tab);
+
+#endif /* __BLOAT_H__ */
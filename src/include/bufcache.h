@@ -0,0 +1,79 @@
+/*
+ ****************************************************************************
+ * bufcache.h
+ *      definitions and macros for shared buffers residency of relations.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#ifndef __BUFCACHE_H__
+#define __BUFCACHE_H__
+
+#include <time.h>
+#include "common.h"
+#include "pgf.h"
+
+#define BUFCACHE_MIN_INTERVAL   10          /* seconds, min interval between buffers scans */
+#define BUFCACHE_DUTY           50          /* interval is at least this many durations of the scan */
+#define BUFCACHE_NAMES_TTL      300         /* seconds, relations names are requested again */
+#define BUFCACHE_USAGE_MAX      5           /* max usage count of buffer */
+#define BUFCACHE_COLS           8           /* relation, buffers, percents, usage, change */
+#define BUFCACHE_BUFFERS_COL    1           /* default sort column */
+
+/* columns of context query, see PG_BUFFERCACHE_QUERY */
+#define BUFCACHE_DATID_COL      0
+
+/* special relations, for buffers of other databases and unused buffers */
+#define BUFCACHE_OTHER_DB       0
+#define BUFCACHE_UNUSED         1
+
+/* buffers of relation, aggregated by database and relfilenode */
+struct bufcache_rel_s
+{
+    unsigned int datid;                 /* database oid, 0 for shared relations */
+    unsigned int filenode;              /* relfilenode */
+    long long buffers;                  /* buffers used by relation */
+    long long dirty;                    /* dirty buffers */
+    long long usage[BUFCACHE_USAGE_MAX + 1];    /* buffers by usage count */
+    bool has_prev;                      /* relation was in the previous scan */
+    long long prev_buffers;             /* buffers in the previous scan */
+};
+
+/* name and size of relation, by relfilenode */
+struct bufcache_name_s
+{
+    unsigned int filenode;
+    long long relpages;
+    char name[S_BUF_LEN];
+};
+
+/* per-tab buffers residency state */
+struct bufcache_s
+{
+    struct bufcache_rel_s * rels;       /* sorted by database and relfilenode */
+    unsigned int used;
+    long long total;                    /* all buffers */
+    struct bufcache_name_s * names;     /* sorted by relfilenode */
+    unsigned int names_used;
+    bool names_stale;                   /* unknown relfilenode is found */
+    time_t names_at;                    /* time of names request */
+    struct timespec scan_at;            /* time of the last scan */
+    double scan_interval;               /* seconds until the next scan */
+    bool scanned;                       /* at least one scan is done */
+};
+
+#define BUFCACHE_SIZE (sizeof(struct bufcache_s))
+
+/* function declarations */
+struct bufcache_s * bufcache_init(void);
+void free_bufcache(struct bufcache_s * bc);
+int bufcache_rel_cmp(const void * a, const void * b);
+int bufcache_name_cmp(const void * a, const void * b);
+struct bufcache_rel_s * bufcache_rel_lookup(struct bufcache_s * bc, unsigned int datid, unsigned int filenode);
+struct bufcache_name_s * bufcache_name_lookup(struct bufcache_s * bc, unsigned int filenode);
+void bufcache_load_names(struct bufcache_s * bc, PGconn * conn);
+void bufcache_scan(struct bufcache_s * bc, PGconn * conn, unsigned int datid);
+PGresult * merge_buffercache(PGconn * conn, PGresult * res, struct tab_s * tab);
+
+#endif /* __BUFCACHE_H__ */
@@ -0,0 +1,81 @@
+/*
+ ****************************************************************************
+ * churn.h
+ *      definitions and macros for connections churn tracking.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#ifndef __CHURN_H__
+#define __CHURN_H__
+
+#include <time.h>
+#include "common.h"
+#include "pgf.h"
+
+#define CHURN_GROUPS_MAX        256         /* max number of tracked application/user pairs */
+#define CHURN_MIN_ELAPSED       0.5         /* seconds, more frequent snapshots aren't used for rates */
+#define CHURN_SMOOTH            0.3         /* weight of the last snapshot in smoothed rates */
+#define CHURN_SHORT_LIFE        10          /* seconds, sessions which lived less are short-lived */
+#define CHURN_COLS              7           /* application, user, conns, rates, short share, lifetime */
+#define CHURN_NEW_COL           3           /* default sort column */
+
+/* columns of connections query, see PG_STAT_CONNECTIONS_QUERY_* */
+#define CHURN_PID_COL           0
+#define CHURN_STARTED_COL       1
+#define CHURN_NOW_COL           2
+#define CHURN_APP_COL           3
+#define CHURN_USER_COL          4
+#define CHURN_SESSIONS_COL      5
+
+/* session, identified by pid and start time */
+struct churn_session_s
+{
+    int pid;
+    long long started;                  /* backend start, epoch */
+    int group;                          /* index of group, -1 if not tracked */
+};
+
+/* sessions of application and user */
+struct churn_group_s
+{
+    unsigned int hash;                  /* hash of application and user */
+    char app[S_BUF_LEN];
+    char user[S_BUF_LEN];
+    bool unseen;                        /* sessions started and ended between snapshots */
+    unsigned int conns;                 /* current sessions */
+    unsigned int new_cnt;               /* sessions started since previous snapshot */
+    unsigned int exit_cnt;              /* sessions ended since previous snapshot */
+    bool has_rates;                     /* smoothed rates are valid */
+    double new_rate;                    /* smoothed started sessions, per second */
+    double exit_rate;                   /* smoothed ended sessions, per second */
+    long long ended;                    /* ended sessions since tracking is started */
+    long long ended_short;              /* short-lived ended sessions */
+    double life_sum;                    /* lifetime of ended sessions, seconds */
+};
+
+/* per-tab connections churn state */
+struct churn_s
+{
+    struct churn_session_s * sessions;  /* sessions of previous snapshot, sorted by pid */
+    unsigned int used;
+    bool has_prev;                      /* previous snapshot is valid */
+    struct timespec ts;                 /* time of previous snapshot */
+    long long sessions_total;           /* total sessions counter, since 14 */
+    unsigned int n_groups;
+    struct churn_group_s groups[CHURN_GROUPS_MAX];
+};
+
+#define CHURN_SIZE (sizeof(struct churn_s))
+
+/* function declarations */
+struct churn_s * churn_init(void);
+void free_churn(struct churn_s * cs);
+int churn_session_cmp(const void * a, const void * b);
+int churn_group_lookup(struct churn_s * cs, const char * app, const char * user, bool unseen);
+void churn_update_rates(struct churn_s * cs, double elapsed);
+void churn_snapshot(struct churn_s * cs, PGresult * res, struct timespec * ts, double elapsed);
+PGresult * merge_conn_churn(PGconn * conn, PGresult * res, struct tab_s * tab);
+
+#endif /* __CHURN_H__ */
@@ -19,6 +19,7 @@
 #include <ifaddrs.h>
 #include <limits.h>
 #include <linux/types.h>
+#include <math.h>       /* NAN, isnan */
 #include <ncurses.h>
 #include <netdb.h>
 #include <signal.h>
@@ -28,6 +29,7 @@
 #include <string.h>     /* memset */
 #include <stdarg.h>     /* va_start, va_end */
 #include <termios.h>    /* tcsetattr */
+#include <time.h>       /* clock_gettime */
 #include <unistd.h>     /* sysconf */
 #include "libpq-fe.h"
 
@@ -55,7 +57,7 @@
 #define DEFAULT_EDITOR      "vi"
 #define DEFAULT_PSQL        "psql"
 
-#define TOTAL_CONTEXTS          14
+#define TOTAL_CONTEXTS          23
 #define DEFAULT_QUERY_CONTEXT   pg_stat_database
 
 #define CONN_ARG_MAXLEN		S_BUF_LEN
@@ -63,6 +65,7 @@
 
 #define PGCENTERRC_FILE         ".pgcenterrc"
 #define PGCENTERRC_NFIELDS      6
+#define PGCENTERALERTS_FILE     ".pgcenteralerts"
 
 /* enum for program internal messages */
 enum mtype
@@ -97,14 +100,47 @@ enum context
     pg_stat_statements_io,
     pg_stat_statements_temp,
     pg_stat_statements_local,
-    pg_stat_progress_vacuum
+    pg_stat_progress_vacuum,
+    pg_stat_proc,
+    pg_wait_profile,
+    pg_locks_tree,
+    pg_tables_bloat,
+    pg_xid_wraparound,
+    pg_buffercache,
+    pg_stat_connections,
+    pg_stat_statements_agg,
+    pg_index_usage
 };
 
+/*
+ * Metrics shown in the header, kept per tab for alerting. Times are in
+ * seconds, shares are in percents, unknown values are NAN.
+ */
+enum header_metric
+{
+    metric_load1,
+    metric_cpu,
+    metric_iowait,
+    metric_mem,
+    metric_conns,
+    metric_active,
+    metric_waiting,
+    metric_idle_xact,
+    metric_stmt_s,
+    metric_stmt_avgtime,
+    metric_xact_maxtime,
+    metric_prep_maxtime,
+    metric_disk_util
+};
+
+#define HEADER_METRICS  (metric_disk_util + 1)
+
 /* struct for input args */
 struct args_s
 {
     int count;
     char connfile[PATH_MAX];
+    char alertfile[PATH_MAX];
     char host[CONN_ARG_MAXLEN];
     char port[CONN_ARG_MAXLEN];
     char user[CONN_ARG_MAXLEN];
@@ -151,6 +187,21 @@ struct context_s
     char fstrings[MAX_COLS][S_BUF_LEN];         /* filtering patterns */
 };
 
+/* struct for previous WAL and checkpoints counters, used for rates */
+struct walstat_s
+{
+    bool has_prev;                      /* are previous counters valid? */
+    long long wal_bytes;                /* current WAL position */
+    long long wal_records;              /* WAL records, since 14 */
+    long long wal_fpi;                  /* full page images, since 14 */
+    long long ckpt_timed;               /* scheduled checkpoints */
+    long long ckpt_req;                 /* requested checkpoints */
+    long long buf_ckpt;                 /* buffers written by checkpointer */
+    long long buf_clean;                /* buffers written by bgwriter */
+    long long buf_backend;              /* buffers written by backends */
+    struct timespec ts;                 /* time of previous sample */
+};
+
 /* struct which define connection options */
 struct tab_s
 {
@@ -170,14 +221,38 @@ struct tab_s
     struct sys_special_s sys_special;       /* details about os when pg runs */
     int subtab;                              /* subtab type: logtail, iostat, etc. */
     char log_path[PATH_MAX];                    /* logfile path for logtail subtab */
-    int log_fd;                                 /* logfile fd for log viewing */
+    struct logtail_s * logtail;                 /* logfile tail state for logtail subtab */
+    struct logstat_s * logstat;                 /* log analytics state for logstat subtab */
+    struct waitprof_s * waitprof;               /* wait events profile for wait profile context */
+    struct replstat_s * replstat;               /* standbys rates for replication context */
+    struct oidmap_s * relsize;                  /* cached tables sizes for tables sizes context */
+    struct oidmap_s * bloat;                    /* tables history for tables bloat context */
+    struct xidwrap_s * xidwrap;                 /* XID rate and tables ages for wraparound context */
+    struct progress_s * progress;               /* commands rates for progress context */
+    struct bufcache_s * bufcache;               /* buffers residency for buffercache context */
+    struct churn_s * churn;                     /* sessions history for connections churn context */
+    struct oidmap_s * indexuse;                 /* indexes history for index usage context */
+    struct walstat_s walstat;                   /* WAL and checkpoints counters for header */
+    long long pgss_calls;                       /* pg_stat_statements total calls of previous refresh */
+    bool pgss_has_prev;                         /* is pgss_calls valid? */
+    struct timespec pgss_ts;                    /* time of pgss_calls sample */
+    double metrics[HEADER_METRICS];             /* header metrics of the latest refresh */
+    struct alert_tab_s * alert;                 /* alert rules state and marked cells */
+    struct history_s * history;                 /* header metrics history for graphs */
+    bool graph;                                 /* show graph instead of context */
+    enum header_metric graph_metric;            /* metric of graph */
+    unsigned int graph_level;                   /* resolution of graph */
     enum context current_context;
     char pg_stat_activity_min_age[XS_BUF_LEN];
     struct context_s context_list[TOTAL_CONTEXTS];
+    struct pgss_cache_s * pgss_cache;           /* pg_stat_statements query texts by queryid */
+    struct pgss_hist_s * pgss_hist;             /* pg_stat_statements history for trends */
+    struct pgss_agg_s * pgss_agg;               /* pg_stat_statements aggregates by database and user */
     int signal_options;
     bool pg_stat_sys;
     struct iodata_s ** curr_iostat;           /* current IO stats snapshot */
     struct iodata_s ** prev_iostat;           /* previous IO stats snapshot */
+    double iostat_min_util;                   /* sort devices by %util and hide below it, < 0 - off */
     struct ifdata_s ** curr_ifstat;           /* current iface stats snapshot */
     struct ifdata_s ** prev_ifstat;           /* previous iface stats snapshot */
 };
@@ -193,6 +268,11 @@ void mreport(bool do_exit, enum mtype mtype, const char * msg, ...);
 void strrpl(char * o_string, const char * s_string, const char * r_string, unsigned int buf_size);
 int parsestr(char *str, char *out[], int n_fields, char delimiter);
 int check_string(const char * string, enum chk_type ctype);
+unsigned int hash_text(const char * text, size_t len);
+const char * metric_name(enum header_metric metric);
+int metric_lookup(const char * name);
+void reset_metrics(struct tab_s * tab);
+double str_to_value(const char * str);
 char * password_prompt(const char *prompt, unsigned int pw_maxlen, bool echo);
 void cmd_readline(WINDOW *window, const char * msg, unsigned int pos, bool * with_esc, char * str, unsigned int len, bool echoing);
 void sig_handler(int signo);
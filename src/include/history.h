@@ -0,0 +1,59 @@
+/*
+ ****************************************************************************
+ * history.h
+ *      definitions and macros for header metrics history.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#ifndef __HISTORY_H__
+#define __HISTORY_H__
+
+#include <time.h>
+#include "common.h"
+
+#define HISTORY_LEVELS          3           /* 1s x 10min, 10s x 2h, 1min x 24h */
+#define HISTORY_LABEL_WIDTH     10          /* width of values axis of graph */
+
+/* samples of metric which fall into bucket of resolution */
+struct hist_bucket_s
+{
+    float min;
+    float max;
+    float sum;
+    unsigned int count;                 /* 0 - bucket is empty */
+};
+
+/*
+ * Ring of buckets of one resolution. Each bucket covers res seconds and is
+ * reused when the ring wraps, slots tell which time bucket holds, so gaps
+ * of the tab which isn't shown are empty buckets.
+ */
+struct hist_level_s
+{
+    unsigned int res;                   /* seconds per bucket */
+    unsigned int size;                  /* number of buckets */
+    long long * slots;                  /* time of bucket in res units, -1 - never used */
+    struct hist_bucket_s * buckets;     /* size buckets per metric */
+};
+
+/* header metrics history of tab, fixed size */
+struct history_s
+{
+    struct hist_level_s levels[HISTORY_LEVELS];
+};
+
+#define HISTORY_SIZE (sizeof(struct history_s))
+
+/* function declarations */
+struct history_s * history_init(void);
+void free_history(struct history_s * h);
+const char * history_level_name(unsigned int level);
+void history_add(struct history_s * h, double metrics[], long long now);
+bool history_bucket(struct history_s * h, unsigned int level, enum header_metric metric,
+        long long slot, struct hist_bucket_s * b);
+void record_history(struct tab_s * tab);
+void print_graph(WINDOW * window, struct tab_s * tab);
+
+#endif /* __HISTORY_H__ */
@@ -18,6 +18,8 @@
 #include <sys/wait.h>
 #include "common.h"
 #include "pgf.h"
+#include "logstat.h"
+#include "logtail.h"
 #include "qstats.h"
 #include "stats.h"
 
@@ -38,6 +40,7 @@
 #define SUBTAB_LOGTAIL   1
 #define SUBTAB_IOSTAT    2
 #define SUBTAB_NICSTAT   3
+#define SUBTAB_LOGSTAT   4
 
 /* Macros used to determine array size */
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
@@ -57,13 +60,16 @@ void clear_tab_connopts(struct tab_s * tabs[], unsigned int i);
 void do_noop(WINDOW * window, unsigned long interval);
 
 /* main hotkeys functions */
+unsigned int get_order_key_max(struct tab_s * tab);
 void change_sort_order(struct tab_s * tab, bool increment, bool * first_iter);
 void change_sort_order_direction(struct tab_s * tab, bool * first_iter);
+void sort_by_growth(WINDOW * window, struct tab_s * tab, PGresult * res, bool * first_iter);
 void set_filter(WINDOW * win, struct tab_s * tab, PGresult * res, bool * first_iter);
 unsigned int switch_tab(WINDOW * window, struct tab_s * tabs[],
         unsigned int ch, unsigned int tab_index, unsigned int tab_no, PGresult * res, bool * first_iter);
 void switch_context(WINDOW * window, struct tab_s * tab, enum context context, PGresult * res, bool * first_iter);
 void change_min_age(WINDOW * window, struct tab_s * tab, PGresult *res, bool *first_iter);
+void set_iostat_min_util(WINDOW * window, struct tab_s * tab);
 unsigned int add_tab(WINDOW * window, struct tab_s * tabs[],
         PGconn * conns[], unsigned int tab_index);
 void shift_tabs(struct tab_s * tabs[], PGconn * conns[], unsigned int i);
@@ -84,9 +90,15 @@ void signal_group_backend(WINDOW * window, struct tab_s *tab, PGconn * conn, boo
 void start_psql(WINDOW * window, struct tab_s * tab);
 unsigned long change_refresh(WINDOW * window, unsigned long interval);
 void system_view_toggle(WINDOW * window, struct tab_s * tab, bool * first_iter);
-void get_logfile_path(char * path, PGconn * conn);
+void cascade_toggle(WINDOW * window, struct tab_s * tab);
+void pgss_grouping_switch(WINDOW * window, struct tab_s * tab, PGresult * res, bool * first_iter);
+void graph_menu(WINDOW * w_cmd, WINDOW * w_dba, struct tab_s * tab, PGresult * res, bool *first_iter);
+void graph_zoom(WINDOW * window, struct tab_s * tab);
+void get_logfile_path(char * path, PGconn * conn, bool conn_local);
 void log_process(WINDOW * window, WINDOW ** w_log, struct tab_s * tab, PGconn * conn, unsigned int subtab);
 void show_full_log(WINDOW * window, struct tab_s * tab, PGconn * conn);
+bool follow_log(WINDOW * w_cmd, struct tab_s * tab, PGconn * conn);
+void print_logstat(WINDOW * window, WINDOW * w_cmd, struct tab_s * tab, PGconn * conn);
 void print_log(WINDOW * window, WINDOW * w_cmd, struct tab_s * tab, PGconn * conn);
 void subtab_process(WINDOW * window, WINDOW ** w_sub, struct tab_s * tab, PGconn * conn, unsigned int subtab);
 void get_query_by_id(WINDOW * window, struct tab_s * tab, PGconn * conn);
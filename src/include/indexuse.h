@@ -0,0 +1,77 @@
+/*
+ ****************************************************************************
+ * indexuse.h
+ *      definitions and macros for index usage efficiency.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#ifndef __INDEXUSE_H__
+#define __INDEXUSE_H__
+
+#include <time.h>
+#include "common.h"
+#include "pgf.h"
+#include "oidmap.h"
+
+#define INDEXUSE_IDLE_WINDOW    3600        /* seconds, index without scans for so long is idle */
+#define INDEXUSE_MAX_KEYS       32          /* max number of index columns, INDEX_MAX_KEYS */
+#define INDEXUSE_COLS           10          /* relation, index, size, scans, writes, window, flags */
+#define INDEXUSE_SIZE_KB_COL    2           /* default sort column */
+
+/* columns of index usage query, see PG_INDEX_USAGE_QUERY_* */
+#define INDEXUSE_INDEXRELID_COL 0
+#define INDEXUSE_RELID_COL      1
+#define INDEXUSE_RELATION_COL   2
+#define INDEXUSE_INDEX_COL      3
+#define INDEXUSE_SCAN_COL       4
+#define INDEXUSE_RELSIZE_COL    5
+#define INDEXUSE_WRITES_COL     6
+#define INDEXUSE_VALID_COL      7
+#define INDEXUSE_UNIQUE_COL     8
+#define INDEXUSE_NKEYS_COL      9
+#define INDEXUSE_INDKEY_COL     10
+#define INDEXUSE_INDCLASS_COL   11
+#define INDEXUSE_AM_COL         12
+#define INDEXUSE_EXPRS_COL      13
+#define INDEXUSE_PRED_COL       14
+
+/* scans and writes of index accumulated since it is tracked, entry of oidmap */
+struct indexuse_entry_s
+{
+    unsigned int indexrelid;            /* index oid, the key of oidmap */
+    bool tracked;                       /* previous snapshot is valid */
+    long long idx_scan;                 /* scans in previous snapshot */
+    long long writes;                   /* table writes in previous snapshot */
+    long long scans_window;             /* scans since tracking is started */
+    long long writes_window;            /* table writes since tracking is started */
+    struct timespec first;              /* time of the first snapshot */
+};
+
+/* definition of index, used for duplicates detection */
+struct indexuse_def_s
+{
+    unsigned int relid;
+    bool valid;
+    bool unique;
+    int nkeys;                          /* key columns, the rest are included ones */
+    int natts;
+    unsigned int keys[INDEXUSE_MAX_KEYS]; /* attnums, 0 for expressions */
+    unsigned int opclasses[INDEXUSE_MAX_KEYS];
+    const char * am;
+    const char * exprs;                 /* expressions and predicate, empty if none */
+    const char * pred;
+};
+
+/* function declarations */
+void indexuse_update(struct indexuse_entry_s * e, long long idx_scan, long long writes);
+int parse_vector(const char * str, unsigned int values[], int max);
+void indexuse_parse_def(PGresult * res, int row, struct indexuse_def_s * def);
+bool index_duplicates(struct indexuse_def_s * a, struct indexuse_def_s * b);
+bool index_covered(struct indexuse_def_s * a, struct indexuse_def_s * b);
+void indexuse_flags(PGresult * res, struct indexuse_def_s * defs, int row, int first, int last,
+        struct indexuse_entry_s * e, double window, char * buf, size_t len);
+PGresult * merge_index_usage(PGconn * conn, PGresult * res, struct tab_s * tab);
+
+#endif /* __INDEXUSE_H__ */
@@ -0,0 +1,69 @@
+/*
+ ****************************************************************************
+ * locktree.h
+ *      definitions and macros for locks blocking tree.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#ifndef __LOCKTREE_H__
+#define __LOCKTREE_H__
+
+#include "common.h"
+#include "pgf.h"
+
+#define LOCKTREE_COLS           12          /* pid, blocked_by, blocking, lock, locktype, mode, object, ... query */
+#define LOCKTREE_KEY_COLS       10          /* locktype .. objsubid identify locked object */
+#define LOCKTREE_MAX_DEPTH      16          /* deeper sessions aren't indented more */
+
+/* columns of locks snapshot, see PG_LOCKS_TREE_QUERY */
+enum locktree_col
+{
+    lcol_locktype,
+    lcol_pid = LOCKTREE_KEY_COLS,
+    lcol_mode,
+    lcol_granted,
+    lcol_object,
+    lcol_usename,
+    lcol_datname,
+    lcol_state,
+    lcol_xact_age,
+    lcol_query
+};
+
+/* session in the blocking graph */
+struct locknode_s
+{
+    int pid;                            /* 0 - prepared transaction */
+    int info_row;                       /* row with session info, -1 if unknown */
+    int wait_row;                       /* row of awaited lock, -1 if not waiting */
+    int hold_row;                       /* row of held lock which blocks others */
+    unsigned int first_blocker;         /* blockers in edges array */
+    unsigned int n_blockers;            /* sessions which hold awaited lock */
+    unsigned int n_waiters;             /* sessions which wait for locks held by this one */
+    unsigned int first_child;           /* waiters in children array */
+    unsigned int subtree;               /* sessions shown under this one */
+    bool visited;
+};
+
+/* edge of the blocking graph: waiter waits for lock held by blocker */
+struct lockedge_s
+{
+    unsigned int waiter;
+    unsigned int blocker;
+};
+
+/* function declarations */
+int lock_mode_num(const char * mode);
+bool lock_conflicts(int mode1, int mode2);
+unsigned int lock_target_hash(PGresult * res, int row);
+bool lock_target_equal(PGresult * res, int row1, int row2);
+unsigned int locktree_node(struct locknode_s * nodes, unsigned int * n_nodes,
+        int * index, unsigned int index_size, int pid);
+unsigned int locktree_walk(struct locknode_s * nodes, unsigned int * children, unsigned int node,
+        unsigned int depth, unsigned int * order, unsigned int * depths, unsigned int n_order);
+int locktree_root_cmp(const void * a, const void * b, void * arg);
+PGresult * merge_lock_tree(PGconn * conn, PGresult * res);
+
+#endif /* __LOCKTREE_H__ */
@@ -0,0 +1,85 @@
+/*
+ ****************************************************************************
+ * logstat.h
+ *      definitions and macros for postgres log analytics.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#ifndef __LOGSTAT_H__
+#define __LOGSTAT_H__
+
+#include <time.h>
+#include "common.h"
+
+#define LOGSTAT_LINE_LEN        XL_BUF_LEN          /* only the beginning of line is parsed */
+#define LOGSTAT_MSG_LEN         L_BUF_LEN           /* max length of normalized message */
+#define LOGSTAT_MAX_MSGS        1024                /* max distinct messages, power of two */
+#define LOGSTAT_CSV_SEVERITY    11                  /* error_severity field number in csvlog */
+#define LOGSTAT_CSV_MESSAGE     13                  /* message field number in csvlog */
+#define LOGSTAT_DURATION_BUCKETS    7
+
+/* severities of interest */
+enum log_severity
+{
+    sev_log,
+    sev_warning,
+    sev_error,
+    sev_fatal,
+    sev_panic,
+    sev_other
+};
+
+#define LOGSTAT_SEVERITIES  sev_other
+
+/* struct for normalized message statistics */
+struct logmsg_s
+{
+    unsigned int hash;                  /* hash of normalized text, 0 - empty slot */
+    enum log_severity severity;
+    unsigned long count;                /* number of occurrences */
+    char text[LOGSTAT_MSG_LEN];         /* normalized message text */
+};
+
+/* struct for log analytics state */
+struct logstat_s
+{
+    bool csvlog;                        /* log format: csvlog or stderr */
+    char line[LOGSTAT_LINE_LEN];        /* stderr: beginning of current line */
+    size_t line_len;
+    unsigned int csv_field;             /* csvlog: number of current field */
+    bool csv_quoted;                    /* csvlog: inside quoted field */
+    bool csv_quote_seen;                /* csvlog: quote inside quoted field, maybe escaped one */
+    char csv_severity[XS_BUF_LEN];      /* csvlog: error_severity of current record */
+    size_t csv_severity_len;
+    char csv_message[LOGSTAT_LINE_LEN]; /* csvlog: message of current record */
+    size_t csv_message_len;
+    unsigned long sev_count[LOGSTAT_SEVERITIES];        /* messages per severity since start */
+    unsigned long sev_prev[LOGSTAT_SEVERITIES];         /* values of previous refresh */
+    double sev_rate[LOGSTAT_SEVERITIES];                /* messages per second */
+    unsigned long durations[LOGSTAT_DURATION_BUCKETS];  /* duration: histogram since start */
+    unsigned long msgs_used;            /* number of used message slots */
+    unsigned long msgs_other;           /* messages which don't fit into messages table */
+    struct logmsg_s msgs[LOGSTAT_MAX_MSGS];
+    struct timespec ts;                 /* time of previous refresh */
+    time_t started;                     /* time of start */
+};
+
+#define LOGSTAT_SIZE (sizeof(struct logstat_s))
+
+/* function declarations */
+struct logstat_s * logstat_init(bool csvlog);
+void logstat_csv_append(struct logstat_s * ls, const char * data, size_t len);
+void logstat_feed_csvlog(struct logstat_s * ls, const char * data, size_t len, bool eol);
+void logstat_parse_stderr(struct logstat_s * ls, const char * line, size_t len);
+void logstat_feed(void * arg, const char * data, size_t len, bool eol);
+void logstat_process(struct logstat_s * ls, const char * severity, size_t sev_len,
+        const char * message, size_t msg_len);
+size_t logstat_normalize(const char * message, size_t len, char * out, size_t out_len);
+void logstat_add_message(struct logstat_s * ls, enum log_severity severity, const char * message, size_t len);
+void logstat_add_duration(struct logstat_s * ls, const char * message, size_t len);
+void logstat_update_rates(struct logstat_s * ls);
+void logstat_print(WINDOW * window, struct logstat_s * ls, const char * path);
+
+#endif /* __LOGSTAT_H__ */
@@ -0,0 +1,69 @@
+/*
+ ****************************************************************************
+ * logtail.h
+ *      definitions and macros for streaming postgres log tail.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#ifndef __LOGTAIL_H__
+#define __LOGTAIL_H__
+
+#include <libgen.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "queries.h"
+
+#define LOGTAIL_LINES           256                 /* max number of lines kept in ring buffer */
+#define LOGTAIL_LINE_MAXLEN     XL_BUF_LEN          /* longer lines are truncated */
+#define LOGTAIL_DATA_SIZE       (LOGTAIL_LINES * L_BUF_LEN)     /* lines storage size */
+#define LOGTAIL_INITIAL_READ    (64 * 1024)         /* on open, read only the end of the log */
+#define LOGTAIL_READ_LEN        (64 * 1024)         /* read file with such blocks */
+
+/* flags returned by logtail_check() */
+#define LOGTAIL_MODIFIED        1 << 0
+#define LOGTAIL_ROTATED         1 << 1
+
+/* struct for log tailing state */
+struct logtail_s
+{
+    char path[PATH_MAX];                /* path of the tailed log */
+    bool remote;                        /* log is read through postgres connection */
+    bool idle;                          /* remote: no new data at last read, maybe log is rotated */
+    int fd;                             /* log file descriptor */
+    off_t offset;                       /* read position, only appended bytes are read */
+    int inotify_fd;                     /* inotify instance, -1 if unavailable */
+    int file_wd;                        /* watch for the log file */
+    int dir_wd;                         /* watch for the log directory, new files on rotation */
+    char data[LOGTAIL_DATA_SIZE];       /* lines storage, used as circular buffer */
+    size_t wpos;                        /* write position in lines storage */
+    unsigned int line_off[LOGTAIL_LINES];   /* offset of line in lines storage */
+    unsigned int line_len[LOGTAIL_LINES];   /* length of line */
+    unsigned int head;                  /* index of the oldest line */
+    unsigned int count;                 /* number of lines in ring buffer */
+    char partial[LOGTAIL_LINE_MAXLEN];  /* incomplete last line, waits for newline */
+    size_t partial_len;                 /* length of incomplete line */
+    bool partial_skip;                  /* skip bytes until newline */
+    void (*hook)(void * arg, const char * data, size_t len, bool eol);  /* receives all new data, e.g. for parsing */
+    void * hook_arg;
+};
+
+#define LOGTAIL_SIZE (sizeof(struct logtail_s))
+
+/* function declarations */
+int logtail_attach(struct logtail_s * lt, const char * path, bool from_end, PGconn * conn);
+struct logtail_s * logtail_open(const char * path, PGconn * conn);
+int logtail_switch(struct logtail_s * lt, const char * path, PGconn * conn);
+void logtail_close(struct logtail_s * lt);
+bool logtail_replaced(struct logtail_s * lt);
+unsigned int logtail_check(struct logtail_s * lt);
+off_t logtail_remote_size(PGconn * conn, const char * path);
+ssize_t logtail_read_remote(struct logtail_s * lt, PGconn * conn);
+ssize_t logtail_read(struct logtail_s * lt, PGconn * conn);
+void logtail_split(struct logtail_s * lt, const char * buf, size_t len);
+void logtail_push_line(struct logtail_s * lt, const char * line, size_t len);
+const char * logtail_get_line(struct logtail_s * lt, unsigned int n, unsigned int * len);
+
+#endif /* __LOGTAIL_H__ */
@@ -0,0 +1,37 @@
+/*
+ ****************************************************************************
+ * oidmap.h
+ *      definitions and macros for history of objects keyed by oid.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#ifndef __OIDMAP_H__
+#define __OIDMAP_H__
+
+#include "common.h"
+
+/*
+ * History of database objects, e.g. tables or indexes. Entries are context
+ * specific structs which start with unsigned int oid of the object, they
+ * are kept sorted by oid and are looked up with binary search.
+ */
+struct oidmap_s
+{
+    void * entries;
+    size_t entry_size;                  /* size of context specific entry */
+    unsigned int used;                  /* number of entries */
+    unsigned int cursor;                /* oid of the last visited entry, for round-robin walks */
+};
+
+#define OIDMAP_SIZE (sizeof(struct oidmap_s))
+
+/* function declarations */
+struct oidmap_s * oidmap_init(size_t entry_size);
+void free_oidmap(struct oidmap_s * map);
+int oidmap_cmp(const void * a, const void * b);
+void * oidmap_lookup(struct oidmap_s * map, unsigned int oid);
+void oidmap_rebuild(struct oidmap_s * map, PGresult * res, int oid_col);
+
+#endif /* __OIDMAP_H__ */
@@ -14,6 +14,15 @@
 #define INVALID_ORDER_KEY   99
 #define PG_STAT_ACTIVITY_MIN_AGE_DEFAULT "00:00:00.0"
 
+/* item of sorted array, key is parsed once per row */
+struct sort_item_s
+{
+    char ** row;
+    const char * skey;
+    long long ikey;
+    double fkey;
+};
+
 /* .pgcenterrc read statuses */
 #define PGCENTERRC_READ_OK  0
 #define PGCENTERRC_READ_ERR 1
@@ -24,6 +33,8 @@ void init_args_struct(struct args_s *args);
 void init_tabs(struct tab_s *tabs[]);
 char *** init_array(char ***arr, unsigned int n_rows, unsigned int n_cols);
 char *** free_array(char ***arr, unsigned int n_rows, unsigned int n_cols);
+long long ** init_num_array(long long **arr, unsigned int n_rows, unsigned int n_cols);
+long long ** free_num_array(long long **arr, unsigned int n_rows);
 void init_colors(unsigned long long int * ws_color, unsigned long long int * wc_color,
         unsigned long long int * wa_color, unsigned long long int * wl_color);
 
@@ -37,18 +48,21 @@ unsigned int create_pgcenterrc_conn(struct args_s * args, struct tab_s * tabs[],
 void prepare_conninfo(struct tab_s * tabs[]);
 
 /* comparing values functions */
-int str_cmp_desc(const void * a, const void * b, void * arg);
-int str_cmp_asc(const void * a, const void * b, void * arg);
-int int_cmp_desc(const void * a, const void * b, void * arg);
-int int_cmp_asc(const void * a, const void * b, void * arg);
-int fl_cmp_desc(const void * a, const void * b, void * arg);
-int fl_cmp_asc(const void * a, const void * b, void * arg);
+int str_cmp_desc(const void * a, const void * b);
+int str_cmp_asc(const void * a, const void * b);
+int int_cmp_desc(const void * a, const void * b);
+int int_cmp_asc(const void * a, const void * b);
+int fl_cmp_desc(const void * a, const void * b);
+int fl_cmp_asc(const void * a, const void * b);
 
 /* arrays functions */
-void diff_arrays(char ***p_arr, char ***c_arr, char ***res_arr, struct tab_s * tab, 
+void get_diff_range(struct tab_s * tab, unsigned int * min, unsigned int * max);
+void diff_arrays(long long **p_num, long long **c_num, char ***c_arr, char ***res_arr, struct tab_s * tab,
         unsigned int n_rows, unsigned int n_cols, unsigned long interval);
 void sort_array(char ***res_arr, unsigned int n_rows, struct tab_s * tab);
-void pgrescpy(char ***arr, PGresult *res, unsigned int n_rows, unsigned int n_cols);
+void pgrescpy(char ***arr, long long **nums, PGresult *res, struct tab_s * tab,
+        unsigned int n_rows, unsigned int n_cols);
+int get_result_format(struct tab_s * tab);
 
 /* print info functions */
 void print_title(WINDOW * window);
@@ -59,7 +73,8 @@ void print_conninfo(WINDOW * window, PGconn *conn, unsigned int tab_no);
 void print_pg_general(WINDOW * window, struct tab_s * tab, PGconn * conn);
 void print_postgres_activity(WINDOW * window, struct tab_s * tab, PGconn * conn);
 void print_vacuum_info(WINDOW * window, struct tab_s * tab, PGconn * conn);
-void print_pgss_info(WINDOW * window, PGconn * conn, unsigned long interval);
+void print_pgss_info(WINDOW * window, struct tab_s * tab, PGconn * conn);
+void print_wal_info(WINDOW * window, struct tab_s * tab, PGconn * conn);
 void print_data(WINDOW *window, PGresult *res, char ***arr, 
         unsigned int n_rows, unsigned int n_cols, struct tab_s * tab);
 void print_iostat(WINDOW * window, WINDOW * w_cmd, struct tab_s * tab, PGconn * conn, bool * repaint);
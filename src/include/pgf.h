@@ -27,9 +27,15 @@
  * and YYY is minor. For example, 90540 means 9.5.4.
  * */
 #define PG92 90200
+#define PG94 90400
 #define PG95 90500
 #define PG96 90600
 #define PG10 100000
+#define PG11 110000
+#define PG12 120000
+#define PG13 130000
+#define PG14 140000
+#define PG17 170000
 
 #define PG_CONF_FILE            "postgresql.conf"
 #define PG_HBA_FILE             "pg_hba.conf"
@@ -54,6 +60,37 @@
 #define GUC_MAX_PREPS           "max_prepared_transactions"
 #define GUC_TRACK_XACT_TS       "track_commit_timestamp"
 
+#define PREPARED_MAX            64                  /* max prepared statements per connection */
+#define PREPARED_AUTO_FORMAT    -1                  /* binary result, if all columns can be decoded */
+
+/* oids of types which can be decoded from binary format, see decode_value() */
+#define BOOLOID                 16
+#define CHAROID                 18
+#define NAMEOID                 19
+#define INT8OID                 20
+#define INT2OID                 21
+#define INT4OID                 23
+#define TEXTOID                 25
+#define OIDOID                  26
+#define FLOAT4OID               700
+#define FLOAT8OID               701
+#define BPCHAROID               1042
+#define VARCHAROID              1043
+#define NUMERICOID              1700
+
+/* statements prepared in the session of connection */
+struct prepared_s
+{
+    PGconn * conn;
+    int backend_pid;                    /* statements are lost when session is changed */
+    unsigned int count;
+    unsigned int seq;                   /* number of the next statement name, never reused in session */
+    unsigned int hashes[PREPARED_MAX];  /* hashes of statements texts, for quick lookup */
+    char * texts[PREPARED_MAX];         /* statements texts */
+    unsigned int ids[PREPARED_MAX];     /* numbers of statements names */
+    bool binary[PREPARED_MAX];          /* all result columns can be decoded from binary */
+};
+
 /* PostgreSQL answers, see PQresultStatus() at http://www.postgresql.org/docs/current/static/libpq-exec.html */
 #define PG_CMD_OK       PGRES_COMMAND_OK
 #define PG_TUP_OK       PGRES_TUPLES_OK
@@ -61,7 +98,16 @@
 
 void open_connections(struct tab_s * tabs[], PGconn * conns[]);
 void close_connections(struct tab_s * tabs[], PGconn * conns[]);
+void query_error(PGresult * res, char errmsg[]);
 PGresult * do_query(PGconn * conn, const char * query, char errmsg[]);
+void forget_prepared(struct prepared_s * p);
+struct prepared_s * get_prepared(PGconn * conn);
+PGresult * exec_prepared(PGconn * conn, const char * query, int n_params, const char * const * params, int format);
+PGresult * do_prepared_query(PGconn * conn, const char * query, int format, char errmsg[]);
+bool decodable_type(Oid type);
+bool numeric_type(Oid type);
+size_t decode_numeric(const unsigned char * val, int len, char * buf, size_t buf_len, long long * num);
+size_t decode_value(PGresult * res, int row, int col, char * buf, size_t buf_len, long long * num);
 void get_conf_value(PGconn * conn, const char * config_option_name, char * config_option_value);
 void get_pg_special(PGconn * conn, struct tab_s * tab);
 void get_sys_special(PGconn * conn, struct tab_s * tab);
@@ -72,7 +118,8 @@ int get_conn_status(PGconn *conn);
 void write_conn_status(WINDOW * window, PGconn *conn, unsigned int tab_no, int st_index);
 void get_summary_pg_activity(WINDOW * window, struct tab_s * tab, PGconn * conn);
 void get_summary_vac_activity(WINDOW * window, struct tab_s * tab, PGconn * conn);
-void get_pgss_summary(WINDOW * window, PGconn * conn, unsigned long interval);
+void get_pgss_summary(WINDOW * window, struct tab_s * tab, PGconn * conn);
+void get_summary_wal_activity(WINDOW * window, struct tab_s * tab, PGconn * conn);
 bool check_view_exists(PGconn * conn, char * view);
 void install_stats_schema(struct tab_s * tab, PGconn * conn);
 void uninstall_stats_schema(PGconn * conn);
@@ -0,0 +1,122 @@
+/*
+ ****************************************************************************
+ * pgss.h
+ *      definitions and macros for pg_stat_statements helpers.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#ifndef __PGSS_H__
+#define __PGSS_H__
+
+#include <time.h>
+#include "common.h"
+#include "pgf.h"
+#include "qstats.h"
+
+#define PGSS_IDS_MIN_SIZE       1024                /* min number of queryid slots, power of two */
+#define PGSS_TEXTS_MIN_SIZE     1024                /* min number of interned texts slots, power of two */
+#define PGSS_ARENA_MIN_SIZE     (256 * 1024)        /* initial size of texts storage */
+#define PGSS_ARENA_MAX_SIZE     (64 * 1024 * 1024)  /* texts storage is reset when grows above */
+#define PGSS_QUERYID_MAXLEN     21                  /* max length of bigint queryid with separator */
+#define PGSS_HIST_MIN_SIZE      1024                /* min number of history slots, power of two */
+#define PGSS_HIST_LEN           16                  /* number of samples kept per statement */
+#define PGSS_HIST_MIN_ELAPSED   0.5                 /* samples taken more often are skipped, seconds */
+#define PGSS_HIST_SRC_COLS      4                   /* hidden counters after queryid: calls, time, rows, blks */
+#define PGSS_HIST_COLS          2                   /* trend and growth columns added into result */
+#define PGSS_SPARK_LEVELS       " .:-=+*#"          /* sparkline chars from lowest to highest */
+
+/* queryid slot, refers to interned query text */
+struct pgss_id_s
+{
+    long long queryid;
+    unsigned int text;                  /* offset of text in arena, 0 - empty slot */
+};
+
+/*
+ * Cache of normalized query texts keyed by queryid. Texts are kept in arena
+ * and are interned, thus queryids with the same normalized text share it.
+ * Offsets are used instead of pointers, so arena can be reallocated.
+ */
+struct pgss_cache_s
+{
+    struct pgss_id_s * ids;             /* queryid hash table */
+    unsigned int ids_size;              /* number of slots, power of two */
+    unsigned int ids_used;
+    unsigned int * texts;               /* interned texts hash table, offsets of texts */
+    unsigned int texts_size;            /* number of slots, power of two */
+    unsigned int texts_used;
+    char * arena;                       /* texts storage */
+    size_t arena_len;                   /* used part of storage */
+    size_t arena_size;
+};
+
+#define PGSS_CACHE_SIZE (sizeof(struct pgss_cache_s))
+
+/* series of statement history, in the same order as hidden counters */
+enum pgss_series
+{
+    series_calls,
+    series_time,
+    series_rows,
+    series_blks
+};
+
+#define PGSS_SERIES     (series_blks + 1)
+
+/*
+ * History of per second rates of statements, kept per tab. Slots are keyed
+ * by queryid, user and database. Arrays are used instead of array of structs,
+ * rates of the slot are stored in ring of PGSS_HIST_LEN samples per series.
+ * Position of sample in ring is defined by its number, thus all slots share it.
+ */
+struct pgss_hist_s
+{
+    unsigned long long * keys;          /* hash of queryid, user and database */
+    unsigned long * first;              /* number of the sample when slot is added */
+    unsigned long * last;               /* number of the last sample of slot, 0 - empty slot */
+    double * prev;                      /* last absolute counters, PGSS_SERIES per slot */
+    float * rates;                      /* per second rates, PGSS_SERIES * PGSS_HIST_LEN per slot */
+    unsigned int size;                  /* number of slots, power of two */
+    unsigned int used;
+    unsigned long seq;                  /* number of the latest sample */
+    double elapsed;                     /* seconds between the latest samples */
+    struct timespec ts;                 /* time of the latest sample */
+};
+
+#define PGSS_HIST_SIZE (sizeof(struct pgss_hist_s))
+
+/* function declarations */
+bool pgss_context(enum context context);
+const char * skip_placeholder(const char * ptr);
+size_t normalize_query(const char * query, char * out, size_t out_len);
+size_t mask_literals(const char * query, char * out, size_t out_len);
+void normalize_pgss_texts(PGresult * res);
+struct pgss_cache_s * init_pgss_cache(void);
+void reset_pgss_cache(struct pgss_cache_s * cache);
+void free_pgss_cache(struct pgss_cache_s * cache);
+void resize_pgss_ids(struct pgss_cache_s * cache);
+void resize_pgss_texts(struct pgss_cache_s * cache);
+unsigned int intern_pgss_text(struct pgss_cache_s * cache, const char * text, size_t len);
+struct pgss_id_s * lookup_pgss_id(struct pgss_id_s * ids, unsigned int size, long long queryid);
+const char * get_pgss_text(struct pgss_cache_s * cache, long long queryid);
+void add_pgss_text(struct pgss_cache_s * cache, long long queryid, const char * text);
+void fetch_pgss_texts(PGconn * conn, struct pgss_cache_s * cache, const char * queryids);
+PGresult * merge_pgss_texts(PGconn * conn, PGresult * res, struct tab_s * tab);
+struct pgss_hist_s * init_pgss_hist(unsigned int size);
+void free_pgss_hist(struct pgss_hist_s * hist);
+unsigned long long pgss_hist_key(const char * user, const char * database, const char * queryid);
+int lookup_pgss_hist(struct pgss_hist_s * hist, unsigned long long key);
+void rebuild_pgss_hist(struct pgss_hist_s * hist);
+bool advance_pgss_hist(struct pgss_hist_s * hist);
+void update_pgss_hist(struct pgss_hist_s * hist, unsigned long long key, double counters[]);
+enum pgss_series pgss_context_series(enum context context);
+unsigned int get_pgss_hist(struct pgss_hist_s * hist, int slot, enum pgss_series series, float values[]);
+void format_sparkline(float values[], unsigned int n, char * buf);
+double pgss_growth(float values[], unsigned int n);
+void format_ms(double ms, char * buf, size_t len);
+double percent(double part, double total);
+void write_query_report(FILE * fpout, PGresult * res, const char * query, const char * queryid);
+
+#endif /* __PGSS_H__ */
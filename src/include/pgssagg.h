@@ -0,0 +1,88 @@
+/*
+ ****************************************************************************
+ * pgssagg.h
+ *      definitions and macros for pg_stat_statements aggregates by database
+ *      and user.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#ifndef __PGSSAGG_H__
+#define __PGSSAGG_H__
+
+#include <time.h>
+#include "common.h"
+#include "pgf.h"
+#include "pgss.h"
+
+#define PGSS_AGG_MIN_SIZE       1024        /* min number of statements slots, power of two */
+#define PGSS_AGG_GROUPS_MIN     64          /* min number of groups, power of two */
+#define PGSS_AGG_MIN_ELAPSED    0.5         /* seconds, more frequent snapshots aren't used for rates */
+#define PGSS_AGG_COUNTERS       6           /* calls, time, hits, reads, temp reads, temp writes */
+#define PGSS_AGG_COLS           10          /* database, user, statements, rates */
+#define PGSS_AGG_TIME_COL       4           /* default sort column */
+
+/* columns of context query, see PG_STAT_STATEMENTS_AGG_QUERY */
+#define PGSS_AGG_DATABASE_COL   0
+#define PGSS_AGG_USER_COL       1
+#define PGSS_AGG_QUERYID_COL    2
+#define PGSS_AGG_SRC_COL        3           /* the first counter */
+
+/* groupings of statements, each snapshot is aggregated by all of them */
+enum pgss_grouping
+{
+    grouping_database,
+    grouping_user,
+    grouping_database_user
+};
+
+#define PGSS_GROUPINGS  (grouping_database_user + 1)
+
+/* statements of database, user or both, counters are summed up deltas */
+struct pgss_agg_group_s
+{
+    unsigned int hash;
+    enum pgss_grouping grouping;
+    char database[S_BUF_LEN];           /* empty when grouped only by user */
+    char user[S_BUF_LEN];               /* empty when grouped only by database */
+    unsigned int statements;
+    double deltas[PGSS_AGG_COUNTERS];   /* counters changes since previous snapshot */
+};
+
+/*
+ * Per-tab aggregates state. Counters of statements of the previous snapshot
+ * are kept in hash table keyed by queryid, user and database, so deltas are
+ * computed per statement and evicted statements don't distort groups. Groups
+ * of all groupings are built at once, switching between them is free.
+ */
+struct pgss_agg_s
+{
+    unsigned long long * keys;          /* statements of previous snapshot, see pgss_hist_key() */
+    bool * used;                        /* slot is used */
+    double * counters;                  /* PGSS_AGG_COUNTERS per slot */
+    unsigned int size;                  /* number of slots, power of two */
+    struct pgss_agg_group_s * groups;
+    unsigned int n_groups;
+    unsigned int groups_size;           /* allocated groups, power of two */
+    int * slots;                        /* groups hash table, index of group + 1 */
+    enum pgss_grouping grouping;        /* shown grouping */
+    bool has_prev;                      /* previous snapshot is valid */
+    bool has_rates;                     /* deltas of groups are valid */
+    double elapsed;                     /* seconds between the latest snapshots */
+    struct timespec ts;                 /* time of the latest snapshot */
+};
+
+#define PGSS_AGG_SIZE (sizeof(struct pgss_agg_s))
+
+/* function declarations */
+struct pgss_agg_s * pgss_agg_init(void);
+void free_pgss_agg(struct pgss_agg_s * agg);
+const char * pgss_grouping_name(enum pgss_grouping grouping);
+unsigned int lookup_pgss_agg(unsigned long long * keys, bool * used, unsigned int size, unsigned long long key);
+unsigned int pgss_agg_group(struct pgss_agg_s * agg, enum pgss_grouping grouping,
+        const char * database, const char * user);
+void pgss_agg_snapshot(struct pgss_agg_s * agg, PGresult * res, double elapsed);
+PGresult * merge_pgss_groups(PGconn * conn, PGresult * res, struct tab_s * tab);
+
+#endif /* __PGSSAGG_H__ */
@@ -0,0 +1,60 @@
+/*
+ ****************************************************************************
+ * procstat.h
+ *      definitions and macros for per-process OS stats of postgres backends.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#ifndef __PROCSTAT_H__
+#define __PROCSTAT_H__
+
+#include <sys/resource.h>
+#include <time.h>
+#include "common.h"
+
+#define PROC_STAT_FILE          "/proc/%d/stat"
+#define PROC_IO_FILE            "/proc/%d/io"
+
+#define PROC_CACHE_MIN_SIZE     64          /* min number of slots, power of two */
+#define PROC_NEW_COLS           5           /* cpu_usr, cpu_sys, read_kbs, write_kbs, rss_mb */
+
+/* struct for per-process stats, also holds cached /proc files descriptors */
+struct procstat_s
+{
+    pid_t pid;                          /* process id, 0 - empty slot */
+    int stat_fd;                        /* cached fd of /proc/<pid>/stat */
+    int io_fd;                          /* cached fd of /proc/<pid>/io */
+    bool has_prev;                      /* are previous counters valid? */
+    unsigned long long starttime;       /* process start time, used to detect pid reuse */
+    unsigned long long utime;           /* user time (ticks) */
+    unsigned long long stime;           /* system time (ticks) */
+    unsigned long long read_bytes;      /* bytes read from storage layer */
+    unsigned long long write_bytes;     /* bytes written to storage layer */
+    long rss;                           /* resident set size (pages) */
+};
+
+#define PROCSTAT_SIZE (sizeof(struct procstat_s))
+
+/* hash table of processes keyed by pid */
+struct proc_cache_s
+{
+    struct procstat_s * slots;
+    unsigned int size;                  /* number of slots, power of two */
+    bool fd_exhausted;                  /* no more fds for caching, open files on each read */
+    struct timespec ts;                 /* time of previous sample */
+};
+
+/* function declarations */
+struct procstat_s * proc_cache_lookup(struct procstat_s * slots, unsigned int size, pid_t pid);
+void raise_nofile_limit(void);
+void open_proc_files(struct procstat_s * p);
+void close_proc_files(struct procstat_s * p);
+ssize_t read_proc_file(int fd, const char * fmt, pid_t pid, char * buf, size_t len);
+bool read_proc_stats(struct procstat_s * p, struct procstat_s * curr);
+void rebuild_proc_cache(PGresult * res);
+void close_proc_cache(void);
+PGresult * merge_proc_stats(PGconn * conn, PGresult * res, struct tab_s * tab);
+
+#endif /* __PROCSTAT_H__ */
@@ -0,0 +1,65 @@
+/*
+ ****************************************************************************
+ * progress.h
+ *      definitions and macros for progress rates of vacuum and other commands.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#ifndef __PROGRESS_H__
+#define __PROGRESS_H__
+
+#include <time.h>
+#include "common.h"
+#include "pgf.h"
+
+#define PROGRESS_MAX            128         /* max number of tracked commands */
+#define PROGRESS_MIN_ELAPSED    0.5         /* seconds, more frequent snapshots aren't used for rates */
+#define PROGRESS_SMOOTH         0.3         /* weight of the last snapshot in smoothed rates */
+#define PROGRESS_COLS           3           /* scan_kbs, vac_kbs, eta */
+
+/* columns of progress query, see PG_STAT_PROGRESS_* */
+#define PROGRESS_PID_COL        0
+#define PROGRESS_RELATION_COL   3
+#define PROGRESS_COMMAND_COL    4
+#define PROGRESS_PHASE_COL      5
+#define PROGRESS_TOTAL_COL      6
+#define PROGRESS_SCANNED_COL    7
+#define PROGRESS_VACUUMED_COL   8
+
+/* history of command, keyed by pid, command and relation */
+struct progress_entry_s
+{
+    unsigned int hash;                  /* hash of the key */
+    char key[S_BUF_LEN];                /* pid, command and relation */
+    char phase[S_BUF_LEN];              /* phase of previous snapshot */
+    bool seen;                          /* command is in the last snapshot */
+    bool has_prev;                      /* previous counters are valid */
+    bool has_rates;                     /* smoothed rates are valid */
+    long long scanned;                  /* processed amount, KB */
+    long long vacuumed;                 /* vacuumed amount, KB */
+    struct timespec ts;                 /* time of previous snapshot */
+    double scan_rate;                   /* smoothed processing rate, KB/s */
+    double vac_rate;                    /* smoothed vacuuming rate, KB/s */
+};
+
+/* per-tab progress state */
+struct progress_s
+{
+    unsigned int used;                  /* number of tracked commands */
+    struct progress_entry_s entries[PROGRESS_MAX];
+};
+
+#define PROGRESS_SIZE (sizeof(struct progress_s))
+
+/* function declarations */
+struct progress_s * progress_init(void);
+struct progress_entry_s * progress_lookup(struct progress_s * ps, const char * key);
+void progress_update(struct progress_entry_s * e, const char * phase, long long scanned,
+        long long vacuumed, struct timespec * ts);
+void format_progress_eta(struct progress_entry_s * e, const char * command, long long total,
+        long long scanned, long long vacuumed, char * buf, size_t len);
+PGresult * merge_progress_stats(PGconn * conn, PGresult * res, struct tab_s * tab);
+
+#endif /* __PROGRESS_H__ */
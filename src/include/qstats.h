@@ -49,7 +49,10 @@
         FROM pg_stat_statements_normalized p \
         JOIN pg_roles a ON a.oid=p.userid \
         JOIN pg_database d ON d.oid=p.dbid \
-        WHERE TRUE AND left(md5(d.datname || a.rolname || p.query ), 10) = '"
+        WHERE TRUE AND "
+
+/* filter by pseudo queryid, used before 9.4 */
+#define PG_GET_QUERYREP_MD5_FILTER      "left(md5(d.datname || a.rolname || p.query ), 10) = '"
 
 #define PG_GET_QUERYREP_BY_QUERYID_QUERY_P2 \
     "' \
@@ -124,4 +127,42 @@ enum qstats_attr {
     REP_QUERY                   = 23
 };  /* qstats_attr */
 
+/*
+ * Since 9.4 report is built on our side: only counters are requested (without
+ * texts and normalization), text is requested for the one queryid.
+ */
+#define PG_GET_QUERYREP_COUNTERS_QUERY \
+    "SELECT \
+        s.all_total_time, s.all_io_time, s.all_calls, s.all_rows, \
+        a.rolname AS username, d.datname AS database, \
+        s.total_time, s.io_time, s.calls, s.rows \
+    FROM ( \
+        SELECT \
+            userid, dbid, queryid, total_time, blk_read_time + blk_write_time AS io_time, calls, rows, \
+            sum(total_time) OVER () AS all_total_time, \
+            sum(blk_read_time + blk_write_time) OVER () AS all_io_time, \
+            sum(calls) OVER () AS all_calls, sum(rows) OVER () AS all_rows \
+        FROM pg_stat_statements(false) \
+    ) s \
+    JOIN pg_roles a ON a.oid = s.userid \
+    JOIN pg_database d ON d.oid = s.dbid \
+    WHERE s.queryid = $1 \
+    ORDER BY s.total_time DESC LIMIT 1"
+
+#define PG_GET_QUERYREP_TEXT_QUERY \
+    "SELECT query FROM pg_stat_statements WHERE queryid = $1 LIMIT 1"
+
+enum qstats_counters_attr {
+    REPC_ALL_TOTAL_TIME         = 0,
+    REPC_ALL_IO_TIME            = 1,
+    REPC_ALL_CALLS              = 2,
+    REPC_ALL_ROWS               = 3,
+    REPC_USER                   = 4,
+    REPC_DBNAME                 = 5,
+    REPC_TOTAL_TIME             = 6,
+    REPC_IO_TIME                = 7,
+    REPC_CALLS                  = 8,
+    REPC_ROWS                   = 9
+};  /* qstats_counters_attr */
+
 #endif /* __QSTATS_H__ */
@@ -54,41 +54,27 @@
 /* drop pgcenter's stats schema and all its content */
 #define PG_DROP_STATS_SCHEMA_QUERY "DROP SCHEMA pgcenter CASCADE"
 
+/*
+ * Backends counted by state and waiting, counts are summed up on our side.
+ * Prepared transactions are returned as a separate 'prepared' state.
+ */
 /* for postgresql versions before 9.6 */
 #define PG_STAT_ACTIVITY_COUNT_95_QUERY \
-    "WITH pgsa AS (SELECT * FROM pg_stat_activity) \
-       SELECT \
-         (SELECT count(*) AS total FROM pgsa), \
-         (SELECT count(*) AS idle FROM pgsa WHERE state = 'idle'), \
-         (SELECT count(*) AS idle_in_xact FROM pgsa WHERE state IN ('idle in transaction', 'idle in transaction (aborted)')), \
-         (SELECT count(*) AS active FROM pgsa WHERE state = 'active'), \
-         (SELECT count(*) AS waiting FROM pgsa WHERE waiting), \
-         (SELECT count(*) AS others FROM pgsa WHERE state IN ('fastpath function call','disabled')), \
-         (SELECT count(*) AS total_prepared FROM pg_prepared_xacts)"
+    "SELECT state, waiting, count(*) FROM pg_stat_activity GROUP BY 1, 2 \
+    UNION ALL \
+    SELECT 'prepared', false, count(*) FROM pg_prepared_xacts"
 
 /* for postgresql versions since 9.6 */
 #define PG_STAT_ACTIVITY_COUNT_96_QUERY \
-    "WITH pgsa AS (SELECT * FROM pg_stat_activity) \
-       SELECT \
-         (SELECT count(*) AS total FROM pgsa), \
-         (SELECT count(*) AS idle FROM pgsa WHERE state = 'idle'), \
-         (SELECT count(*) AS idle_in_xact FROM pgsa WHERE state IN ('idle in transaction', 'idle in transaction (aborted)')), \
-         (SELECT count(*) AS active FROM pgsa WHERE state = 'active'), \
-         (SELECT count(*) AS waiting FROM pgsa WHERE wait_event IS NOT NULL), \
-         (SELECT count(*) AS others FROM pgsa WHERE state IN ('fastpath function call','disabled')), \
-         (SELECT count(*) AS total_prepared FROM pg_prepared_xacts)"
+    "SELECT state, wait_event IS NOT NULL, count(*) FROM pg_stat_activity GROUP BY 1, 2 \
+    UNION ALL \
+    SELECT 'prepared', false, count(*) FROM pg_prepared_xacts"
 
 /* for postgresql versions since 10.0 */
 #define PG_STAT_ACTIVITY_COUNT_QUERY \
-    "WITH pgsa AS (SELECT * FROM pg_stat_activity) \
-       SELECT \
-         (SELECT count(*) AS total FROM pgsa), \
-         (SELECT count(*) AS idle FROM pgsa WHERE state = 'idle'), \
-         (SELECT count(*) AS idle_in_xact FROM pgsa WHERE state IN ('idle in transaction', 'idle in transaction (aborted)')), \
-         (SELECT count(*) AS active FROM pgsa WHERE state = 'active'), \
-         (SELECT count(*) AS waiting FROM pgsa WHERE wait_event_type = 'Lock'), \
-         (SELECT count(*) AS others FROM pgsa WHERE state IN ('fastpath function call','disabled')), \
-         (SELECT count(*) AS total_prepared FROM pg_prepared_xacts)"
+    "SELECT state, coalesce(wait_event_type = 'Lock', false), count(*) FROM pg_stat_activity GROUP BY 1, 2 \
+    UNION ALL \
+    SELECT 'prepared', false, count(*) FROM pg_prepared_xacts"
 
 #define PG_STAT_ACTIVITY_AV_COUNT_QUERY \
     "WITH pgsa AS (SELECT * FROM pg_stat_activity) \
@@ -109,6 +95,73 @@
             (SELECT COALESCE(date_trunc('seconds', max(clock_timestamp() - prepared)), '00:00:00') \
                 AS prep_maxtime FROM pg_prepared_xacts);"
 
+/*
+ * WAL and checkpoints counters for the header. WAL position is replayed one
+ * on standbys. Distance from the last checkpoint's redo and max_wal_size are
+ * available since 9.6, full page images since 14.
+ */
+#define PG_WAL_SYS_95_QUERY \
+    "SELECT \
+        pg_xlog_location_diff(CASE WHEN pg_is_in_recovery() THEN pg_last_xlog_replay_location() \
+            ELSE pg_current_xlog_location() END, '0/0')::bigint AS wal_bytes, \
+        NULL AS wal_records, NULL AS wal_fpi, \
+        checkpoints_timed, checkpoints_req, buffers_checkpoint, buffers_clean, buffers_backend, \
+        NULL AS redo_distance, NULL AS max_wal_size \
+    FROM pg_stat_bgwriter"
+
+#define PG_WAL_SYS_96_QUERY \
+    "SELECT \
+        pg_xlog_location_diff(w.lsn, '0/0')::bigint AS wal_bytes, \
+        NULL AS wal_records, NULL AS wal_fpi, \
+        checkpoints_timed, checkpoints_req, buffers_checkpoint, buffers_clean, buffers_backend, \
+        pg_xlog_location_diff(w.lsn, c.redo_location)::bigint AS redo_distance, \
+        pg_size_bytes(current_setting('max_wal_size')) AS max_wal_size \
+    FROM pg_stat_bgwriter, pg_control_checkpoint() c, \
+        (SELECT CASE WHEN pg_is_in_recovery() THEN pg_last_xlog_replay_location() \
+            ELSE pg_current_xlog_location() END AS lsn) w"
+
+#define PG_WAL_SYS_QUERY \
+    "SELECT \
+        pg_wal_lsn_diff(w.lsn, '0/0')::bigint AS wal_bytes, \
+        NULL AS wal_records, NULL AS wal_fpi, \
+        checkpoints_timed, checkpoints_req, buffers_checkpoint, buffers_clean, buffers_backend, \
+        pg_wal_lsn_diff(w.lsn, c.redo_lsn)::bigint AS redo_distance, \
+        pg_size_bytes(current_setting('max_wal_size')) AS max_wal_size \
+    FROM pg_stat_bgwriter, pg_control_checkpoint() c, \
+        (SELECT CASE WHEN pg_is_in_recovery() THEN pg_last_wal_replay_lsn() \
+            ELSE pg_current_wal_lsn() END AS lsn) w"
+
+#define PG_WAL_SYS_14_QUERY \
+    "SELECT \
+        pg_wal_lsn_diff(w.lsn, '0/0')::bigint AS wal_bytes, \
+        s.wal_records, s.wal_fpi, \
+        checkpoints_timed, checkpoints_req, buffers_checkpoint, buffers_clean, buffers_backend, \
+        pg_wal_lsn_diff(w.lsn, c.redo_lsn)::bigint AS redo_distance, \
+        pg_size_bytes(current_setting('max_wal_size')) AS max_wal_size \
+    FROM pg_stat_bgwriter, pg_stat_wal s, pg_control_checkpoint() c, \
+        (SELECT CASE WHEN pg_is_in_recovery() THEN pg_last_wal_replay_lsn() \
+            ELSE pg_current_wal_lsn() END AS lsn) w"
+
+/*
+ * Since 17 checkpoints are in pg_stat_checkpointer and buffers written by
+ * backends are only in pg_stat_io, they are summed over shared relations
+ * of all processes except checkpointer and bgwriter.
+ */
+#define PG_WAL_SYS_17_QUERY \
+    "SELECT \
+        pg_wal_lsn_diff(w.lsn, '0/0')::bigint AS wal_bytes, \
+        s.wal_records, s.wal_fpi, \
+        k.num_timed AS checkpoints_timed, k.num_requested AS checkpoints_req, \
+        k.buffers_written AS buffers_checkpoint, b.buffers_clean, \
+        (SELECT coalesce(sum(writes), 0) FROM pg_stat_io \
+            WHERE object = 'relation' \
+            AND backend_type NOT IN ('checkpointer', 'background writer'))::bigint AS buffers_backend, \
+        pg_wal_lsn_diff(w.lsn, c.redo_lsn)::bigint AS redo_distance, \
+        pg_size_bytes(current_setting('max_wal_size')) AS max_wal_size \
+    FROM pg_stat_checkpointer k, pg_stat_bgwriter b, pg_stat_wal s, pg_control_checkpoint() c, \
+        (SELECT CASE WHEN pg_is_in_recovery() THEN pg_last_wal_replay_lsn() \
+            ELSE pg_current_wal_lsn() END AS lsn) w"
+
 /* context queries */
 #define PG_STAT_DATABASE_91_QUERY \
     "SELECT \
@@ -217,6 +270,12 @@
     FROM pg_stat_replication \
     ORDER BY left(md5(client_addr::text || client_port::text), 10) DESC"
 
+/* standbys which replicate from the standby, used for cascade discovery */
+#define PG_REPL_DOWNSTREAM_QUERY \
+    "SELECT coalesce(string_agg(coalesce(application_name, '') || '@' || \
+        coalesce(host(client_addr), 'local'), ','), '') \
+    FROM pg_stat_replication"
+
 /* use functions depending on recovery */
 #define PG_STAT_REPLICATION_NOREC "pg_current_xlog_location()"
 #define PG_STAT_REPLICATION_REC "pg_last_xlog_receive_location()"
@@ -279,25 +338,76 @@
 #define PG_STAT_INDEXES_DIFF_MAX    6
 #define PG_STAT_INDEXES_CMAX_LT     6
 
+/*
+ * Tables sizes are tracked on our side (see relsize.c): the list of tables is
+ * requested on every refresh, sizes are requested only for a slice of tables
+ * per refresh, each size is computed once per table by its oid.
+ */
 #define PG_TABLES_SIZE_QUERY_P1 \
-    "SELECT \
-        s.schemaname ||'.'|| s.relname AS relation, \
-        pg_total_relation_size((s.schemaname ||'.'|| s.relname)::regclass) / 1024 AS total_size, \
-        pg_relation_size((s.schemaname ||'.'|| s.relname)::regclass) / 1024 AS rel_size, \
-        (pg_total_relation_size((s.schemaname ||'.'|| s.relname)::regclass) / 1024) - \
-            (pg_relation_size((s.schemaname ||'.'|| s.relname)::regclass) / 1024) AS idx_size, \
-        pg_total_relation_size((s.schemaname ||'.'|| s.relname)::regclass) / 1024 AS total_change, \
-        pg_relation_size((s.schemaname ||'.'|| s.relname)::regclass) / 1024 AS rel_change, \
-        (pg_total_relation_size((s.schemaname ||'.'|| s.relname)::regclass) / 1024) - \
-            (pg_relation_size((s.schemaname ||'.'|| s.relname)::regclass) / 1024) AS idx_change \
+    "SELECT s.relid, s.schemaname ||'.'|| s.relname AS relation \
         FROM pg_stat_"
-#define PG_TABLES_SIZE_QUERY_P2 "_tables s, pg_class c WHERE s.relid = c.oid \
-        ORDER BY (s.schemaname || '.' || s.relname) DESC"
+#define PG_TABLES_SIZE_QUERY_P2 "_tables s ORDER BY s.relid"
+
+#define PG_TABLES_SIZE_SLICE_QUERY \
+    "SELECT c.oid, pg_table_size(c.oid) / 1024 AS rel_size, pg_indexes_size(c.oid) / 1024 AS idx_size \
+        FROM pg_class c WHERE c.oid = ANY($1::oid[])"
 
-#define PG_TABLES_SIZE_DIFF_MIN     4
-#define PG_TABLES_SIZE_DIFF_MAX     6
 #define PG_TABLES_SIZE_CMAX_LT      6
 
+/*
+ * Dead tuples and autovacuum trigger point of tables, rates and estimations
+ * are calculated on our side (see bloat.c). Only statistics and catalog are
+ * read, tables aren't scanned. Thresholds are taken from tables reloptions
+ * if set, otherwise from settings, as autovacuum does it.
+ */
+#define PG_TABLES_BLOAT_QUERY_P1 \
+    "SELECT \
+        s.relid, s.schemaname ||'.'|| s.relname AS relation, \
+        s.n_live_tup, s.n_dead_tup, \
+        c.relpages::bigint * current_setting('block_size')::int / 1024 AS size, \
+        coalesce((SELECT option_value::float8 FROM pg_options_to_table(c.reloptions) \
+                WHERE option_name = 'autovacuum_vacuum_threshold'), \
+            current_setting('autovacuum_vacuum_threshold')::float8) \
+        + coalesce((SELECT option_value::float8 FROM pg_options_to_table(c.reloptions) \
+                WHERE option_name = 'autovacuum_vacuum_scale_factor'), \
+            current_setting('autovacuum_vacuum_scale_factor')::float8) \
+        * greatest(c.reltuples, 0) AS av_limit, \
+        current_setting('autovacuum')::bool \
+        AND coalesce((SELECT option_value::bool FROM pg_options_to_table(c.reloptions) \
+                WHERE option_name = 'autovacuum_enabled'), true) AS av_enabled \
+    FROM pg_stat_"
+#define PG_TABLES_BLOAT_QUERY_P2 "_tables s JOIN pg_class c ON c.oid = s.relid ORDER BY s.relid"
+
+#define PG_TABLES_BLOAT_CMAX_LT     9
+
+/*
+ * Index usage efficiency. Scans and table writes are accumulated on our side
+ * (see indexuse.c), definitions of indexes are used for duplicates detection,
+ * rows must be ordered by table. Sizes are taken from relpages, so large
+ * schemas don't cost a size call per index.
+ */
+#define PG_INDEX_USAGE_QUERY_P1 \
+    "SELECT \
+        s.indexrelid, s.relid, s.schemaname ||'.'|| s.relname AS relation, s.indexrelname AS index, \
+        s.idx_scan, c.relpages::bigint * current_setting('block_size')::int / 1024 AS size, \
+        t.n_tup_ins + t.n_tup_upd - t.n_tup_hot_upd AS writes, \
+        i.indisvalid, i.indisunique, "
+#define PG_INDEX_USAGE_NKEYS_11 "i.indnkeyatts, "
+#define PG_INDEX_USAGE_NKEYS_10 "i.indnatts, "
+#define PG_INDEX_USAGE_QUERY_P2 \
+        "i.indkey::text, i.indclass::text, a.amname, \
+        coalesce(pg_get_expr(i.indexprs, i.indrelid), '') AS exprs, \
+        coalesce(pg_get_expr(i.indpred, i.indrelid), '') AS pred \
+    FROM pg_stat_"
+#define PG_INDEX_USAGE_QUERY_P3 "_indexes s \
+    JOIN pg_index i ON i.indexrelid = s.indexrelid \
+    JOIN pg_class c ON c.oid = s.indexrelid \
+    JOIN pg_am a ON a.oid = c.relam \
+    JOIN pg_stat_"
+#define PG_INDEX_USAGE_QUERY_P4 "_tables t ON t.relid = s.relid ORDER BY s.relid, s.indexrelid"
+
+#define PG_INDEX_USAGE_CMAX_LT      9
+
 #define PG_STAT_ACTIVITY_LONG_91_QUERY_P1 \
     "SELECT \
         procpid AS pid, client_addr AS cl_addr, client_port AS cl_port, \
@@ -418,28 +528,45 @@
 #define PG_STAT_FUNCTIONS_DIFF_MIN     3
 #define PG_STAT_FUNCTIONS_CMAX_LT      7
 
+/*
+ * pg_stat_statements queries are built from P1 and P2. Since 9.4 native
+ * queryid is used and query texts aren't requested, texts are taken from
+ * the client-side cache and only texts of new queryids are requested
+ * (see pgss.c). Older versions use pseudo queryid and query texts are
+ * requested every time. Query texts are normalized on our side.
+ * Native queryid is followed by hidden counters which are used for
+ * statements history and are removed from the result (see pgss.c).
+ */
+#define PG_STAT_STATEMENTS_MD5_QUERY_P2 \
+    "left(md5(d.datname || a.rolname || p.query ), 10) AS queryid, p.query \
+    FROM pg_stat_statements p \
+    JOIN pg_roles a ON a.oid=p.userid \
+    JOIN pg_database d ON d.oid=p.dbid \
+    GROUP BY a.rolname, d.datname, queryid, p.query \
+    ORDER BY queryid DESC"
+
+#define PG_STAT_STATEMENTS_QUERY_P2 \
+    "p.queryid, \
+        sum(p.calls) AS h_calls, sum(p.total_time) AS h_time, sum(p.rows) AS h_rows, \
+        sum(p.shared_blks_read + p.shared_blks_written + p.local_blks_read + p.local_blks_written \
+            + p.temp_blks_read + p.temp_blks_written) AS h_blks \
+    FROM pg_stat_statements(false) p \
+    JOIN pg_roles a ON a.oid=p.userid \
+    JOIN pg_database d ON d.oid=p.dbid \
+    GROUP BY a.rolname, d.datname, p.queryid \
+    ORDER BY p.queryid DESC, a.rolname, d.datname"
+
+#define PG_STAT_STATEMENTS_TEXTS_QUERY \
+    "SELECT DISTINCT ON (queryid) queryid, query \
+    FROM pg_stat_statements \
+    WHERE queryid = ANY($1::bigint[])"
+
 #define PG_STAT_STATEMENTS_TIMING_91_QUERY_P1 \
     "SELECT \
         a.rolname AS user, d.datname AS database, \
         date_trunc('seconds', round(sum(p.total_time)) / 1000 * '1 second'::interval) AS t_all_t, \
         round(sum(p.total_time)) AS all_t, \
-        sum(p.calls) AS calls, \
-        left(md5(d.datname || a.rolname || p.query ), 10) AS queryid, \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace(p.query, \
-            E'\\\\?(::[a-zA-Z_]+)?( *, *\\\\?(::[a-zA-Z_]+)?)+', '?', 'g'), \
-            E'\\\\$[0-9]+(::[a-zA-Z_]+)?( *, *\\\\$[0-9]+(::[a-zA-Z_]+)?)*', '$N', 'g'), \
-            E'--.*$', '', 'ng'), \
-            E'/\\\\*.*?\\\\*\\/', '', 'g'), \
-            E'\\\\s+', ' ', 'g') AS query \
-    FROM pg_stat_statements p \
-    JOIN pg_roles a ON a.oid=p.userid \
-    JOIN pg_database d ON d.oid=p.dbid \
-    GROUP BY a.rolname, d.datname, query \
-    ORDER BY left(md5(d.datname || a.rolname || p.query ), 10) DESC"
+        sum(p.calls) AS calls, "
 
 #define PG_STAT_STATEMENTS_TIMING_QUERY_P1 \
     "SELECT \
@@ -452,23 +579,7 @@
         round(sum(p.blk_read_time)) AS read_t, \
         round(sum(p.blk_write_time)) AS write_t, \
         round((sum(p.total_time) - (sum(p.blk_read_time) + sum(p.blk_write_time)))) AS cpu_t, \
-        sum(p.calls) AS calls, \
-        left(md5(d.datname || a.rolname || p.query ), 10) AS queryid, \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace(p.query, \
-            E'\\\\?(::[a-zA-Z_]+)?( *, *\\\\?(::[a-zA-Z_]+)?)+', '?', 'g'), \
-            E'\\\\$[0-9]+(::[a-zA-Z_]+)?( *, *\\\\$[0-9]+(::[a-zA-Z_]+)?)*', '$N', 'g'), \
-            E'--.*$', '', 'ng'), \
-            E'/\\\\*.*?\\\\*\\/', '', 'g'), \
-            E'\\\\s+', ' ', 'g') AS query \
-    FROM pg_stat_statements p \
-    JOIN pg_roles a ON a.oid=p.userid \
-    JOIN pg_database d ON d.oid=p.dbid \
-    GROUP BY a.rolname, d.datname, query \
-    ORDER BY left(md5(d.datname || a.rolname || p.query ), 10) DESC"
+        sum(p.calls) AS calls, "
 
 #define PGSS_TIMING_DIFF_MIN_91  3
 #define PGSS_TIMING_DIFF_MAX_91  4
@@ -481,45 +592,13 @@
     "SELECT \
         a.rolname AS user, d.datname AS database, \
         sum(p.calls) AS t_calls, sum(p.rows) as t_rows, \
-        sum(p.calls) AS calls, sum(p.rows) as rows, \
-        left(md5(d.datname || a.rolname || p.query ), 10) AS queryid, \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace(p.query, \
-            E'\\\\?(::[a-zA-Z_]+)?( *, *\\\\?(::[a-zA-Z_]+)?)+', '?', 'g'), \
-            E'\\\\$[0-9]+(::[a-zA-Z_]+)?( *, *\\\\$[0-9]+(::[a-zA-Z_]+)?)*', '$N', 'g'), \
-            E'--.*$', '', 'ng'), \
-            E'/\\\\*.*?\\\\*\\/', '', 'g'), \
-            E'\\\\s+', ' ', 'g') AS query \
-    FROM pg_stat_statements p \
-    JOIN pg_roles a ON a.oid=p.userid \
-    JOIN pg_database d ON d.oid=p.dbid \
-    GROUP BY a.rolname, d.datname, query \
-    ORDER BY left(md5(d.datname || a.rolname || p.query ), 10) DESC"
+        sum(p.calls) AS calls, sum(p.rows) as rows, "
 
 #define PG_STAT_STATEMENTS_GENERAL_QUERY_P1 \
     "SELECT \
         a.rolname AS user, d.datname AS database, \
         sum(p.calls) AS t_calls, sum(p.rows) as t_rows, \
-        sum(p.calls) AS calls, sum(p.rows) as rows, \
-        left(md5(d.datname || a.rolname || p.query ), 10) AS queryid, \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace(p.query, \
-            E'\\\\?(::[a-zA-Z_]+)?( *, *\\\\?(::[a-zA-Z_]+)?)+', '?', 'g'), \
-            E'\\\\$[0-9]+(::[a-zA-Z_]+)?( *, *\\\\$[0-9]+(::[a-zA-Z_]+)?)*', '$N', 'g'), \
-            E'--.*$', '', 'ng'), \
-            E'/\\\\*.*?\\\\*\\/', '', 'g'), \
-            E'\\\\s+', ' ', 'g') AS query \
-    FROM pg_stat_statements p \
-    JOIN pg_roles a ON a.oid=p.userid \
-    JOIN pg_database d ON d.oid=p.dbid \
-    GROUP BY a.rolname, d.datname, query \
-    ORDER BY left(md5(d.datname || a.rolname || p.query ), 10) DESC"
+        sum(p.calls) AS calls, sum(p.rows) as rows, "
 
 #define PGSS_GENERAL_DIFF_MIN_LT    4
 #define PGSS_GENERAL_DIFF_MAX_LT    5
@@ -540,23 +619,7 @@
             * (SELECT current_setting('block_size')::int / 1024) as reads, \
         (sum(p.shared_blks_written) + sum(p.local_blks_written)) \
             * (SELECT current_setting('block_size')::int / 1024) as written, \
-        sum(p.calls) AS calls, \
-        left(md5(d.datname || a.rolname || p.query ), 10) AS queryid, \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace(p.query, \
-            E'\\\\?(::[a-zA-Z_]+)?( *, *\\\\?(::[a-zA-Z_]+)?)+', '?', 'g'), \
-            E'\\\\$[0-9]+(::[a-zA-Z_]+)?( *, *\\\\$[0-9]+(::[a-zA-Z_]+)?)*', '$N', 'g'), \
-            E'--.*$', '', 'ng'), \
-            E'/\\\\*.*?\\\\*\\/', '', 'g'), \
-            E'\\\\s+', ' ', 'g') AS query \
-    FROM pg_stat_statements p \
-    JOIN pg_roles a ON a.oid=p.userid \
-    JOIN pg_database d ON d.oid=p.dbid \
-    GROUP BY a.rolname, d.datname, query \
-    ORDER BY left(md5(d.datname || a.rolname || p.query ), 10) DESC"
+        sum(p.calls) AS calls, "
 
 #define PG_STAT_STATEMENTS_IO_QUERY_P1 \
     "SELECT \
@@ -577,23 +640,7 @@
             * (SELECT current_setting('block_size')::int / 1024) as dirtied, \
         (sum(p.shared_blks_written) + sum(p.local_blks_written)) \
             * (SELECT current_setting('block_size')::int / 1024) as written, \
-        sum(p.calls) AS calls, \
-        left(md5(d.datname || a.rolname || p.query ), 10) AS queryid, \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace(p.query, \
-            E'\\\\?(::[a-zA-Z_]+)?( *, *\\\\?(::[a-zA-Z_]+)?)+', '?', 'g'), \
-            E'\\\\$[0-9]+(::[a-zA-Z_]+)?( *, *\\\\$[0-9]+(::[a-zA-Z_]+)?)*', '$N', 'g'), \
-            E'--.*$', '', 'ng'), \
-            E'/\\\\*.*?\\\\*\\/', '', 'g'), \
-            E'\\\\s+', ' ', 'g') AS query \
-    FROM pg_stat_statements p \
-    JOIN pg_roles a ON a.oid=p.userid \
-    JOIN pg_database d ON d.oid=p.dbid \
-    GROUP BY a.rolname, d.datname, query \
-    ORDER BY left(md5(d.datname || a.rolname || p.query ), 10) DESC"
+        sum(p.calls) AS calls, "
 
 #define PGSS_IO_DIFF_MIN_91    5
 #define PGSS_IO_DIFF_MAX_91    8
@@ -613,23 +660,7 @@
             * (SELECT current_setting('block_size')::int / 1024) as tmp_read, \
         sum(p.temp_blks_written) \
             * (SELECT current_setting('block_size')::int / 1024) as tmp_write, \
-        sum(p.calls) AS calls, \
-        left(md5(d.datname || a.rolname || p.query ), 10) AS queryid, \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace(p.query, \
-            E'\\\\?(::[a-zA-Z_]+)?( *, *\\\\?(::[a-zA-Z_]+)?)+', '?', 'g'), \
-            E'\\\\$[0-9]+(::[a-zA-Z_]+)?( *, *\\\\$[0-9]+(::[a-zA-Z_]+)?)*', '$N', 'g'), \
-            E'--.*$', '', 'ng'), \
-            E'/\\\\*.*?\\\\*\\/', '', 'g'), \
-            E'\\\\s+', ' ', 'g') AS query \
-    FROM pg_stat_statements p \
-    JOIN pg_roles a ON a.oid=p.userid \
-    JOIN pg_database d ON d.oid=p.dbid \
-    GROUP BY a.rolname, d.datname, query \
-    ORDER BY left(md5(d.datname || a.rolname || p.query ), 10) DESC"
+        sum(p.calls) AS calls, "
 
 #define PGSS_TEMP_DIFF_MIN_LT   4
 #define PGSS_TEMP_DIFF_MAX_LT   6
@@ -645,23 +676,7 @@
         (sum(p.local_blks_hit)) * (SELECT current_setting('block_size')::int / 1024) as lo_hits, \
         (sum(p.local_blks_read)) * (SELECT current_setting('block_size')::int / 1024) as lo_reads, \
         (sum(p.local_blks_written)) * (SELECT current_setting('block_size')::int / 1024) as lo_written, \
-        sum(p.calls) AS calls, \
-        left(md5(d.datname || a.rolname || p.query ), 10) AS queryid, \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace(p.query, \
-            E'\\\\?(::[a-zA-Z_]+)?( *, *\\\\?(::[a-zA-Z_]+)?)+', '?', 'g'), \
-            E'\\\\$[0-9]+(::[a-zA-Z_]+)?( *, *\\\\$[0-9]+(::[a-zA-Z_]+)?)*', '$N', 'g'), \
-            E'--.*$', '', 'ng'), \
-            E'/\\\\*.*?\\\\*\\/', '', 'g'), \
-            E'\\\\s+', ' ', 'g') AS query \
-    FROM pg_stat_statements p \
-    JOIN pg_roles a ON a.oid=p.userid \
-    JOIN pg_database d ON d.oid=p.dbid \
-    GROUP BY a.rolname, d.datname, query \
-    ORDER BY left(md5(d.datname || a.rolname || p.query ), 10) DESC"
+        sum(p.calls) AS calls, "
 
 #define PG_STAT_STATEMENTS_LOCAL_QUERY_P1 \
     "SELECT \
@@ -674,23 +689,7 @@
         (sum(p.local_blks_read)) * (SELECT current_setting('block_size')::int / 1024) as lo_reads, \
         (sum(p.local_blks_dirtied)) * (SELECT current_setting('block_size')::int / 1024) as lo_dirtied, \
         (sum(p.local_blks_written)) * (SELECT current_setting('block_size')::int / 1024) as lo_written, \
-        sum(p.calls) AS calls, \
-        left(md5(d.datname || a.rolname || p.query ), 10) AS queryid, \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace( \
-        regexp_replace(p.query, \
-            E'\\\\?(::[a-zA-Z_]+)?( *, *\\\\?(::[a-zA-Z_]+)?)+', '?', 'g'), \
-            E'\\\\$[0-9]+(::[a-zA-Z_]+)?( *, *\\\\$[0-9]+(::[a-zA-Z_]+)?)*', '$N', 'g'), \
-            E'--.*$', '', 'ng'), \
-            E'/\\\\*.*?\\\\*\\/', '', 'g'), \
-            E'\\\\s+', ' ', 'g') AS query \
-    FROM pg_stat_statements p \
-    JOIN pg_roles a ON a.oid=p.userid \
-    JOIN pg_database d ON d.oid=p.dbid \
-    GROUP BY a.rolname, d.datname, query \
-    ORDER BY left(md5(d.datname || a.rolname || p.query ), 10) DESC"
+        sum(p.calls) AS calls, "
 
 #define PGSS_LOCAL_DIFF_MIN_91    5
 #define PGSS_LOCAL_DIFF_MAX_91    8
@@ -699,22 +698,241 @@
 #define PGSS_LOCAL_CMAX_91    10
 #define PGSS_LOCAL_CMAX_LT    12
 
-#define PG_STAT_PROGRESS_VACUUM_QUERY \
-    "SELECT \
-     	a.pid, \
-	date_trunc('seconds', clock_timestamp() - xact_start) AS xact_age, \
-        v.datname, v.relid::regclass AS relation, \
-	a.state, v.phase, \
-	v.heap_blks_total * (SELECT current_setting('block_size')::int / 1024) AS total, \
-	v.heap_blks_scanned * (SELECT current_setting('block_size')::int / 1024) AS scanned, \
-	v.heap_blks_vacuumed * (SELECT current_setting('block_size')::int / 1024) AS vacuumed, \
-	a.wait_event_type AS wait_etype, a.wait_event, \
-	a.query \
+/*
+ * Statements snapshot for aggregates by database and user. Only absolute
+ * counters are requested, deltas, groups and rates are calculated on our side
+ * (see pgssagg.c), thus all groupings are built from the same snapshot.
+ */
+#define PG_STAT_STATEMENTS_AGG_91_QUERY \
+    "SELECT \
+        d.datname AS database, a.rolname AS user, left(md5(p.query), 10) AS queryid, \
+        sum(p.calls), sum(p.total_time), \
+        sum(p.shared_blks_hit) * b.kb, sum(p.shared_blks_read) * b.kb, \
+        sum(p.temp_blks_read) * b.kb, sum(p.temp_blks_written) * b.kb \
+    FROM pg_stat_statements p \
+    JOIN pg_roles a ON a.oid=p.userid \
+    JOIN pg_database d ON d.oid=p.dbid, \
+    (SELECT current_setting('block_size')::int / 1024 AS kb) b \
+    GROUP BY 1, 2, 3, b.kb"
+
+#define PG_STAT_STATEMENTS_AGG_QUERY \
+    "SELECT \
+        d.datname AS database, a.rolname AS user, p.queryid, \
+        sum(p.calls), sum(p.total_time), \
+        sum(p.shared_blks_hit) * b.kb, sum(p.shared_blks_read) * b.kb, \
+        sum(p.temp_blks_read) * b.kb, sum(p.temp_blks_written) * b.kb \
+    FROM pg_stat_statements(false) p \
+    JOIN pg_roles a ON a.oid=p.userid \
+    JOIN pg_database d ON d.oid=p.dbid, \
+    (SELECT current_setting('block_size')::int / 1024 AS kb) b \
+    GROUP BY 1, 2, 3, b.kb"
+
+#define PGSS_AGG_CMAX_LT      9
+
+/*
+ * Progress of vacuum and other commands, all progress views are reduced to
+ * the same columns: total and processed amount of work in KB, vacuumed
+ * amount and number of index vacuum passes (only vacuum). Rates and ETA are
+ * calculated on our side (see progress.c) and are inserted before the query,
+ * thus the query must be the last one.
+ */
+#define PG_STAT_PROGRESS_96_QUERY \
+    "SELECT \
+        a.pid, date_trunc('seconds', clock_timestamp() - a.xact_start) AS xact_age, \
+        v.datname, v.relid::regclass AS relation, 'vacuum' AS command, v.phase, \
+        v.heap_blks_total * (SELECT current_setting('block_size')::int / 1024) AS total, \
+        v.heap_blks_scanned * (SELECT current_setting('block_size')::int / 1024) AS scanned, \
+        v.heap_blks_vacuumed * (SELECT current_setting('block_size')::int / 1024) AS vacuumed, \
+        v.index_vacuum_count AS passes, \
+        a.wait_event_type AS wait_etype, a.wait_event, \
+        a.query \
     FROM pg_stat_progress_vacuum v \
     JOIN pg_stat_activity a ON v.pid = a.pid \
     ORDER BY a.pid DESC"
 
-#define PG_STAT_PROGRESS_VACUUM_CMAX_LT 11
+/* since 12, parts for analyze (13) and copy (14) are added between P1 and P2 */
+#define PG_STAT_PROGRESS_QUERY_P1 \
+    "SELECT \
+        a.pid, date_trunc('seconds', clock_timestamp() - a.xact_start) AS xact_age, \
+        p.datname, p.relid::regclass AS relation, p.command, p.phase, \
+        p.total * (SELECT current_setting('block_size')::int / 1024) AS total, \
+        p.scanned * (SELECT current_setting('block_size')::int / 1024) AS scanned, \
+        p.vacuumed * (SELECT current_setting('block_size')::int / 1024) AS vacuumed, \
+        p.passes, \
+        a.wait_event_type AS wait_etype, a.wait_event, \
+        a.query \
+    FROM ( \
+        SELECT pid, datname, relid, 'vacuum' AS command, phase, heap_blks_total AS total, \
+            heap_blks_scanned AS scanned, heap_blks_vacuumed AS vacuumed, index_vacuum_count AS passes \
+        FROM pg_stat_progress_vacuum \
+        UNION ALL \
+        SELECT pid, datname, relid, lower(command), phase, blocks_total, blocks_done, NULL, NULL \
+        FROM pg_stat_progress_create_index \
+        UNION ALL \
+        SELECT pid, datname, relid, lower(command), phase, heap_blks_total, heap_blks_scanned, NULL, NULL \
+        FROM pg_stat_progress_cluster "
+#define PG_STAT_PROGRESS_ANALYZE_PART \
+        "UNION ALL \
+        SELECT pid, datname, relid, 'analyze', phase, sample_blks_total, sample_blks_scanned, NULL, NULL \
+        FROM pg_stat_progress_analyze "
+#define PG_STAT_PROGRESS_COPY_PART \
+        "UNION ALL \
+        SELECT pid, datname, relid, lower(command), lower(type), \
+            bytes_total / current_setting('block_size')::int, \
+            bytes_processed / current_setting('block_size')::int, NULL, NULL \
+        FROM pg_stat_progress_copy "
+#define PG_STAT_PROGRESS_QUERY_P2 \
+    ") p \
+    JOIN pg_stat_activity a ON p.pid = a.pid \
+    ORDER BY a.pid DESC"
+
+#define PG_STAT_PROGRESS_VACUUM_CMAX_LT 15
+
+/* 
+ * OS-level stats (cpu, io, rss) are read from /proc for every pid and are 
+ * inserted before the query column, thus the query must be the last one.
+ */
+#define PG_STAT_PROC_91_QUERY \
+    "SELECT \
+        procpid AS pid, datname, usename, \
+        CASE current_query WHEN '<IDLE>' THEN 'idle' \
+            WHEN '<IDLE> in transaction' THEN 'idle in transaction' \
+            ELSE 'active' END AS state, \
+        current_query AS query \
+    FROM pg_stat_activity \
+    WHERE procpid <> pg_backend_pid() \
+    ORDER BY procpid"
+
+#define PG_STAT_PROC_QUERY \
+    "SELECT \
+        pid, datname, usename, state, query \
+    FROM pg_stat_activity \
+    WHERE pid <> pg_backend_pid() \
+    ORDER BY pid"
+
+#define PG_STAT_PROC_CMAX_LT    9
+
+/*
+ * Wait events sampling, the query is prepared once per connection and is
+ * executed many times per refresh interval, thus it's kept as cheap as
+ * possible: only non-idle sessions, truncated query texts, which are
+ * normalized on our side (see waitprof.c). Before 9.6 only heavyweight
+ * locks waiting is known. Since 14 query identifier is used as the key of
+ * query, when it's computed.
+ */
+#define PG_WAIT_SAMPLE_95_QUERY \
+    "SELECT \
+        state, CASE WHEN waiting THEN 'Lock' END AS wait_etype, NULL AS wait_event, \
+        left(query, 1024) AS query \
+    FROM pg_stat_activity \
+    WHERE state <> 'idle' AND pid <> pg_backend_pid()"
+
+#define PG_WAIT_SAMPLE_QUERY \
+    "SELECT \
+        state, wait_event_type AS wait_etype, wait_event, \
+        left(query, 1024) AS query \
+    FROM pg_stat_activity \
+    WHERE state <> 'idle' AND pid <> pg_backend_pid()"
+
+#define PG_WAIT_SAMPLE_14_QUERY \
+    "SELECT \
+        state, wait_event_type AS wait_etype, wait_event, \
+        left(query, 1024) AS query, query_id \
+    FROM pg_stat_activity \
+    WHERE state <> 'idle' AND pid <> pg_backend_pid()"
+
+#define PG_WAIT_PROFILE_CMAX_LT     5
+
+/*
+ * Locks snapshot for the blocking tree, the tree is built on our side (see
+ * locktree.c). Sessions info is returned only once per session, with the lock
+ * of its own virtual transaction, which is held by every session.
+ */
+#define PG_LOCKS_TREE_QUERY \
+    "SELECT \
+        l.locktype, l.database, l.relation, l.page, l.tuple, l.virtualxid, \
+        l.transactionid, l.classid, l.objid, l.objsubid, l.pid, l.mode, l.granted, \
+        CASE WHEN l.relation IS NOT NULL THEN l.relation::regclass::text \
+            WHEN l.transactionid IS NOT NULL THEN l.transactionid::text \
+            WHEN l.virtualxid IS NOT NULL THEN l.virtualxid \
+            ELSE concat_ws('/', l.classid, l.objid, l.objsubid) END AS object, \
+        a.usename, a.datname, a.state, \
+        date_trunc('seconds', clock_timestamp() - a.xact_start) AS xact_age, \
+        left(a.query, 1024) AS query \
+    FROM pg_locks l \
+    LEFT JOIN pg_stat_activity a ON a.pid = l.pid \
+        AND l.locktype = 'virtualxid' AND l.granted \
+    WHERE l.pid IS DISTINCT FROM pg_backend_pid()"
+
+#define PG_LOCKS_TREE_CMAX_LT       11
+
+/*
+ * Transaction ID wraparound risk, rate and estimations are calculated on our
+ * side (see xidwrap.c). Next XID is taken from snapshot, txid_current() isn't
+ * used because it assigns XID itself and fails on standby. Tables are checked
+ * in slices ordered by oid, starting after the last checked one.
+ */
+#define PG_XID_DATABASES_QUERY \
+    "SELECT \
+        txid_snapshot_xmax(txid_current_snapshot()) AS xid, \
+        datname, age(datfrozenxid) AS age, \
+        current_setting('autovacuum_freeze_max_age')::bigint AS freeze_max \
+    FROM pg_database ORDER BY datname"
+
+#define PG_XID_TABLES_SLICE_QUERY \
+    "SELECT \
+        c.oid, n.nspname ||'.'|| c.relname AS relation, age(c.relfrozenxid) AS age, \
+        least(current_setting('autovacuum_freeze_max_age')::bigint, \
+            (SELECT option_value::bigint FROM pg_options_to_table(c.reloptions) \
+                WHERE option_name = 'autovacuum_freeze_max_age')) AS freeze_max, \
+        txid_snapshot_xmax(txid_current_snapshot()) AS xid \
+    FROM pg_class c JOIN pg_namespace n ON n.oid = c.relnamespace \
+    WHERE c.relkind IN ('r', 'm', 't') AND c.oid > $1::oid \
+    ORDER BY c.oid LIMIT $2::int"
+
+#define PG_XID_WRAPAROUND_CMAX_LT   7
+
+/*
+ * Shared buffers residency, using pg_buffercache extension. The context query
+ * only checks the extension and gets the current database, buffers are
+ * scanned on our side not on every refresh (see bufcache.c). Buffers are
+ * counted on server side, thus only one row per relation, usage count and
+ * dirtiness is transferred.
+ */
+#define PG_BUFFERCACHE_QUERY \
+    "SELECT d.oid AS datid, 'pg_buffercache'::regclass::text AS view \
+    FROM pg_database d WHERE d.datname = current_database()"
+
+#define PG_BUFFERCACHE_SCAN_QUERY \
+    "SELECT relfilenode, coalesce(reldatabase, 0), coalesce(usagecount, 0), isdirty, count(*) \
+    FROM pg_buffercache GROUP BY 1, 2, 3, 4"
+
+#define PG_BUFFERCACHE_NAMES_QUERY \
+    "SELECT pg_relation_filenode(c.oid), n.nspname ||'.'|| c.relname, c.relpages \
+    FROM pg_class c JOIN pg_namespace n ON n.oid = c.relnamespace \
+    WHERE pg_relation_filenode(c.oid) IS NOT NULL"
+
+#define PG_BUFFERCACHE_CMAX_LT      7
+
+/*
+ * Client sessions for connections churn, sessions are tracked on our side by
+ * pid and start time (see churn.c). Since 14 the total number of sessions is
+ * used to count sessions which started and ended between refreshes.
+ */
+#define PG_STAT_CONNECTIONS_QUERY_P1 \
+    "SELECT \
+        pid, extract(epoch FROM backend_start)::bigint AS started, \
+        extract(epoch FROM now())::bigint AS now, \
+        coalesce(application_name, '') AS application_name, coalesce(usename, '') AS usename, "
+#define PG_STAT_CONNECTIONS_SESSIONS_14 \
+        "(SELECT sum(sessions) FROM pg_stat_database)::bigint AS sessions "
+#define PG_STAT_CONNECTIONS_SESSIONS_92 \
+        "NULL::bigint AS sessions "
+#define PG_STAT_CONNECTIONS_QUERY_P2 \
+    "FROM pg_stat_activity WHERE backend_start IS NOT NULL"
+#define PG_STAT_CONNECTIONS_CLIENTS_10 " AND backend_type = 'client backend'"
+
+#define PG_STAT_CONNECTIONS_CMAX_LT 6
 
 /* other queries */
 /* don't log our queries */
@@ -752,6 +970,12 @@
 /* reset statistics query */
 #define PG_STAT_RESET_QUERY "SELECT pg_stat_reset(), pg_stat_statements_reset()"
 
+/* remote log tail queries, log is read in binary format from the given offset */
+#define PG_CURRENT_LOGFILE_QUERY "SELECT pg_current_logfile()"
+#define PG_LOG_SIZE_QUERY "SELECT size FROM pg_stat_file($1)"
+#define PG_LOG_READ_QUERY \
+    "SELECT size, pg_read_binary_file($1, least($2::bigint, size), $3::bigint) FROM pg_stat_file($1)"
+
 /* postmaster uptime query */
 #define PG_UPTIME_QUERY "SELECT date_trunc('seconds', now() - pg_postmaster_start_time())"
 
@@ -0,0 +1,39 @@
+/*
+ ****************************************************************************
+ * relsize.h
+ *      definitions and macros for tables sizes tracking.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#ifndef __RELSIZE_H__
+#define __RELSIZE_H__
+
+#include <time.h>
+#include "common.h"
+#include "pgf.h"
+#include "oidmap.h"
+
+#define RELSIZE_SLICE           1000        /* max number of tables measured per refresh */
+#define RELSIZE_COLS            7           /* relation, total, rel, idx sizes and their changes */
+
+/* cached sizes of table, KB, entry of oidmap */
+struct relsize_entry_s
+{
+    unsigned int relid;                 /* table oid, the key of oidmap */
+    bool measured;                      /* sizes are known */
+    bool has_rates;                     /* size was measured at least twice */
+    long long rel_size;                 /* table with toast, fsm and vm */
+    long long idx_size;                 /* all indexes of the table */
+    double rel_rate;                    /* change of table size, KB/s */
+    double idx_rate;                    /* change of indexes size, KB/s */
+    struct timespec ts;                 /* time of the last measurement */
+};
+
+/* function declarations */
+unsigned int relsize_slice(struct oidmap_s * rs, char ** oids);
+void relsize_measure(struct oidmap_s * rs, PGconn * conn);
+PGresult * merge_rel_sizes(PGconn * conn, PGresult * res, struct tab_s * tab);
+
+#endif /* __RELSIZE_H__ */
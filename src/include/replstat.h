@@ -0,0 +1,70 @@
+/*
+ ****************************************************************************
+ * replstat.h
+ *      definitions and macros for replication lag rates of standbys.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#ifndef __REPLSTAT_H__
+#define __REPLSTAT_H__
+
+#include <time.h>
+#include "common.h"
+#include "pgf.h"
+
+#define REPLSTAT_MAX            64          /* max number of tracked standbys */
+#define REPLSTAT_MIN_ELAPSED    0.5         /* seconds, more frequent snapshots aren't used for rates */
+#define REPLSTAT_SMOOTH         0.3         /* weight of the last snapshot in smoothed rates */
+#define REPLSTAT_RETRY          30          /* seconds between connection attempts to standby */
+#define REPLSTAT_PROBES         2           /* max standbys asked for cascading standbys per refresh */
+#define REPLSTAT_TIMEOUT        "1000"      /* ms, statement_timeout of connection to standby */
+#define REPLSTAT_COLS           4           /* replay_kbs, lag_trend, catchup, downstream */
+
+/* columns of pg_stat_replication query, see PG_STAT_REPLICATION_QUERY_* */
+#define REPLSTAT_CLIENT_COL     0
+#define REPLSTAT_NAME_COL       2
+#define REPLSTAT_WAL_COL        5
+#define REPLSTAT_LAG_COL        10
+
+/* history of standby, keyed by client address and application name */
+struct replstat_entry_s
+{
+    unsigned int hash;                  /* hash of the key */
+    char key[S_BUF_LEN];                /* client address, name and number of duplicate */
+    bool seen;                          /* standby is in the last snapshot */
+    bool has_prev;                      /* previous positions are valid */
+    bool has_rates;                     /* smoothed rates are valid */
+    long long replay_pos;               /* replayed WAL position, KB */
+    long long lag;                      /* total lag, KB */
+    struct timespec ts;                 /* time of previous snapshot */
+    double replay_rate;                 /* smoothed WAL apply rate, KB/s */
+    double lag_rate;                    /* smoothed lag change, KB/s, positive - falling behind */
+    PGconn * conn;                      /* connection to standby for cascade discovery */
+    time_t retry_at;                    /* don't connect to standby until this time */
+    char downstream[S_BUF_LEN];         /* standbys replicating from this standby */
+};
+
+/* per-tab replication state */
+struct replstat_s
+{
+    bool cascade;                       /* discover cascading standbys */
+    unsigned int used;                  /* number of tracked standbys */
+    unsigned int probe_next;            /* row of the result which is probed first at next refresh */
+    struct replstat_entry_s entries[REPLSTAT_MAX];
+};
+
+#define REPLSTAT_SIZE (sizeof(struct replstat_s))
+
+/* function declarations */
+struct replstat_s * replstat_init(void);
+void replstat_free(struct replstat_s * rs);
+void replstat_disconnect(struct replstat_s * rs);
+struct replstat_entry_s * replstat_lookup(struct replstat_s * rs, const char * key);
+void replstat_update(struct replstat_entry_s * e, long long replay_pos, long long lag, struct timespec * ts);
+void format_catchup(struct replstat_entry_s * e, char * buf, size_t len);
+void replstat_downstream(struct replstat_entry_s * e, const char * host, struct tab_s * tab);
+PGresult * merge_repl_stats(PGconn * conn, PGresult * res, struct tab_s * tab);
+
+#endif /* __REPLSTAT_H__ */
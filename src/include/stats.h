@@ -28,6 +28,7 @@
 #define NETDEV_FILE             "/proc/net/dev"
 
 #define MAXDEV_IN_FILE      64          /* max devices per stats files */
+#define AWAIT_SAMPLES       60          /* number of intervals kept for await distribution */
 #define DEFAULT_HZ          100         /* default clock ticks */
 
 /*
@@ -87,9 +88,22 @@ struct iodata_s
     unsigned long io_in_progress;       /* I/Os currently in progress */
     unsigned long t_spent;              /* time spent doing I/Os (ms) */
     unsigned long t_weighted;           /* weighted time spent doing I/Os (ms) */
+    unsigned long d_completed;          /* discards completed (since 4.18) */
+    unsigned long d_merged;             /* discards merged */
+    unsigned long d_sectors;            /* sectors discarded */
+    unsigned long d_spent;              /* time spent discarding (ms) */
+    unsigned long f_completed;          /* flush requests completed (since 5.5) */
+    unsigned long f_spent;              /* time spent flushing (ms) */
     double arqsz;                       /* average request size */
     double await;                       /* latency */
+    double f_await;                     /* flush latency */
     double util;                        /* device utilization */
+    double await_samples[AWAIT_SAMPLES];    /* ring buffer with await of last intervals */
+    unsigned int await_pos;             /* next slot in await ring buffer */
+    unsigned int await_cnt;             /* number of used slots in await ring buffer */
+    double await_p50;                   /* median await over the ring buffer */
+    double await_p95;                   /* 95th percentile await over the ring buffer */
+    double await_max;                   /* max await over the ring buffer */
 };
 #define STATS_IODATA_SIZE (sizeof(struct iodata_s))
 #define BLKDEV     1
@@ -145,8 +159,9 @@ void write_mem_stat(WINDOW * window, struct mem_s *st_mem_short);
 void replace_iostat(struct iodata_s * curr[], struct iodata_s * prev[], int bdev);
 void read_local_diskstats(WINDOW * window, struct iodata_s * curr[], int bdev, bool * repaint);
 void read_remote_diskstats(WINDOW * window, struct iodata_s * curr[], int bdev, PGconn * conn, bool * repaint);
+void update_await_distribution(struct iodata_s * dev, double await);
 void write_iostat(WINDOW * window, struct iodata_s * curr[], struct iodata_s * prev[], 
-        int bdev, unsigned long long itv, int sys_hz);
+        int bdev, unsigned long long itv, int sys_hz, double min_util);
 
 /* nicstat functions */
 void get_speed_duplex(struct ifdata_s * ifdata, bool conn_local, PGconn * conn);
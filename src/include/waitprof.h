@@ -0,0 +1,74 @@
+/*
+ ****************************************************************************
+ * waitprof.h
+ *      definitions and macros for wait events sampling profiler.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#ifndef __WAITPROF_H__
+#define __WAITPROF_H__
+
+#include <math.h>
+#include <time.h>
+#include "common.h"
+#include "pgf.h"
+#include "pgss.h"
+
+#define WAITPROF_PERIOD         50000               /* usec between samples, 20 Hz */
+#define WAITPROF_WINDOW         60.0                /* decay time constant, seconds */
+#define WAITPROF_MAX_ENTRIES    512                 /* max distinct entries, power of two */
+#define WAITPROF_MIN_WEIGHT     0.5                 /* lighter entries are dropped when table is full */
+#define WAITPROF_SHOW_WEIGHT    0.01                /* lighter entries aren't shown */
+#define WAITPROF_RESCALE        1e12                /* weights are rescaled when scale grows above */
+#define WAITPROF_COLS           6                   /* sessions, time_pct, state, wait_etype, wait_event, query */
+#define WAITPROF_QUERYID_COL    4                   /* query_id column of sample, since 14 */
+
+/* aggregated observations of (state, wait event, query) */
+struct waitprof_entry_s
+{
+    unsigned int hash;                  /* hash of all fields, 0 - empty slot */
+    double weight;                      /* scaled weight of observations */
+    unsigned long hits;                 /* number of observations since start */
+    char state[S_BUF_LEN];
+    char wait_etype[S_BUF_LEN];
+    char wait_event[S_BUF_LEN];
+    long long queryid;                  /* query identifier, 0 - entry is keyed by query text */
+    char query[L_BUF_LEN];              /* normalized query text, the first one seen for queryid */
+};
+
+/*
+ * Profiler state, kept per tab. Observations are decayed exponentially, so
+ * the profile shows the recent WAITPROF_WINDOW seconds. Instead of decaying
+ * all entries on every sample, new observations get exponentially growing
+ * weights and all weights are rescaled rarely, when the scale is too big.
+ */
+struct waitprof_s
+{
+    double base;                        /* time of the weights scale, seconds since start */
+    double samples;                     /* scaled weight of samples */
+    double other;                       /* scaled weight of observations which don't fit into table */
+    unsigned int used;                  /* number of used entries */
+    struct timespec started;            /* time of start */
+    struct timespec last;               /* time of the last sample */
+    struct waitprof_entry_s entries[WAITPROF_MAX_ENTRIES];
+};
+
+#define WAITPROF_SIZE (sizeof(struct waitprof_s))
+
+/* function declarations */
+struct waitprof_s * waitprof_init(void);
+double waitprof_time(struct waitprof_s * wp, struct timespec * ts);
+double waitprof_decay(struct waitprof_s * wp, double now);
+struct waitprof_entry_s * waitprof_lookup(struct waitprof_s * wp, unsigned int hash, const char * state,
+        const char * wait_etype, const char * wait_event, long long queryid, const char * query);
+void waitprof_compact(struct waitprof_s * wp);
+void waitprof_add(struct waitprof_s * wp, double weight, const char * state,
+        const char * wait_etype, const char * wait_event, long long queryid, const char * query);
+void waitprof_feed(struct waitprof_s * wp, PGresult * res);
+bool waitprof_sample(struct waitprof_s * wp, PGconn * conn, struct tab_s * tab);
+void sample_wait_events(PGconn * conn, struct tab_s * tab, unsigned long usec);
+PGresult * merge_wait_profile(PGconn * conn, PGresult * res, struct tab_s * tab);
+
+#endif /* __WAITPROF_H__ */
@@ -0,0 +1,65 @@
+/*
+ ****************************************************************************
+ * xidwrap.h
+ *      definitions and macros for transaction ID wraparound risk tracking.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#ifndef __XIDWRAP_H__
+#define __XIDWRAP_H__
+
+#include <time.h>
+#include "common.h"
+#include "pgf.h"
+
+#define XIDWRAP_SLICE           1000        /* max number of tables checked per refresh */
+#define XIDWRAP_TOP             50          /* number of the oldest tables shown */
+#define XIDWRAP_MIN_ELAPSED     0.5         /* seconds, more frequent samples aren't used for rate */
+#define XIDWRAP_SMOOTH          0.3         /* weight of the last sample in smoothed rate */
+#define XIDWRAP_STOP_AGE        2144483647LL    /* age when new XIDs aren't assigned (2^31 - 3M) */
+#define XIDWRAP_COLS            8           /* kind, name, age, freeze_max, ETAs */
+#define XIDWRAP_AGE_COL         2           /* default sort column */
+
+/* columns of databases query, see PG_XID_DATABASES_QUERY */
+#define XIDWRAP_XID_COL         0
+#define XIDWRAP_DATNAME_COL     1
+#define XIDWRAP_DATAGE_COL      2
+#define XIDWRAP_FREEZE_COL      3
+
+/* age of table's relfrozenxid at the time of check */
+struct xidwrap_table_s
+{
+    unsigned int relid;                 /* table oid */
+    char name[S_BUF_LEN];               /* table name with schema */
+    long long age;                      /* age of relfrozenxid */
+    long long xid;                      /* next XID at the time of check */
+    long long freeze_max;               /* autovacuum_freeze_max_age of table */
+};
+
+/* XID consumption rate and tables ages, sorted by oid */
+struct xidwrap_s
+{
+    bool has_prev;                      /* previous XID sample is valid */
+    bool has_rate;                      /* smoothed rate is valid */
+    long long xid;                      /* previous next XID, with epoch */
+    struct timespec ts;                 /* time of previous sample */
+    double rate;                        /* smoothed XID consumption, per second */
+    struct xidwrap_table_s * tables;
+    unsigned int used;
+    unsigned int cursor;                /* oid of the last checked table */
+};
+
+#define XIDWRAP_SIZE (sizeof(struct xidwrap_s))
+
+/* function declarations */
+struct xidwrap_s * xidwrap_init(void);
+void free_xidwrap(struct xidwrap_s * xw);
+void xidwrap_update_rate(struct xidwrap_s * xw, long long xid, struct timespec * ts);
+void xidwrap_scan_slice(struct xidwrap_s * xw, PGconn * conn);
+int xidwrap_age_cmp(const void * a, const void * b);
+void format_xid_eta(struct xidwrap_s * xw, long long age, long long limit, char * buf, size_t len);
+PGresult * merge_xid_wraparound(PGconn * conn, PGresult * res, struct tab_s * tab);
+
+#endif /* __XIDWRAP_H__ */
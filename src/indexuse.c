@@ -0,0 +1,264 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+ ****************************************************************************
+ * indexuse.c
+ *      index usage efficiency: unused, idle, duplicate and covered indexes.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#include "include/indexuse.h"
+
+/*
+ ****************************************************************************
+ * Accumulate scans of index and writes of its table since the previous
+ * snapshot. Decreased counters mean stats reset, they are counted from zero.
+ ****************************************************************************
+ */
+void indexuse_update(struct indexuse_entry_s * e, long long idx_scan, long long writes)
+{
+    e->scans_window += (idx_scan >= e->idx_scan) ? idx_scan - e->idx_scan : idx_scan;
+    e->writes_window += (writes >= e->writes) ? writes - e->writes : writes;
+    e->idx_scan = idx_scan;
+    e->writes = writes;
+}
+
+/*
+ ****************************************************************************
+ * Parse space separated numbers of int2vector or oidvector. Return number
+ * of parsed values.
+ ****************************************************************************
+ */
+int parse_vector(const char * str, unsigned int values[], int max)
+{
+    char * end;
+    int n = 0;
+
+    while (n < max) {
+        values[n] = strtoul(str, &end, 10);
+        if (end == str)
+            break;
+        str = end;
+        n++;
+    }
+
+    return n;
+}
+
+/*
+ ****************************************************************************
+ * Get definition of index from result row. Strings refer to the result.
+ ****************************************************************************
+ */
+void indexuse_parse_def(PGresult * res, int row, struct indexuse_def_s * def)
+{
+    memset(def, 0, sizeof(struct indexuse_def_s));
+    def->relid = strtoul(PQgetvalue(res, row, INDEXUSE_RELID_COL), NULL, 10);
+    def->valid = (PQgetvalue(res, row, INDEXUSE_VALID_COL)[0] == 't');
+    def->unique = (PQgetvalue(res, row, INDEXUSE_UNIQUE_COL)[0] == 't');
+    def->natts = parse_vector(PQgetvalue(res, row, INDEXUSE_INDKEY_COL), def->keys, INDEXUSE_MAX_KEYS);
+    def->nkeys = min(atoi(PQgetvalue(res, row, INDEXUSE_NKEYS_COL)), def->natts);
+    parse_vector(PQgetvalue(res, row, INDEXUSE_INDCLASS_COL), def->opclasses, INDEXUSE_MAX_KEYS);
+    def->am = PQgetvalue(res, row, INDEXUSE_AM_COL);
+    def->exprs = PQgetvalue(res, row, INDEXUSE_EXPRS_COL);
+    def->pred = PQgetvalue(res, row, INDEXUSE_PRED_COL);
+}
+
+/*
+ ****************************************************************************
+ * Check that indexes are the same: access method, columns, operator classes,
+ * expressions and predicate are equal.
+ ****************************************************************************
+ */
+bool index_duplicates(struct indexuse_def_s * a, struct indexuse_def_s * b)
+{
+    int i;
+
+    if (a->relid != b->relid || a->nkeys != b->nkeys || a->natts != b->natts
+            || strcmp(a->am, b->am) || strcmp(a->exprs, b->exprs) || strcmp(a->pred, b->pred))
+        return false;
+
+    for (i = 0; i < a->natts; i++)
+        if (a->keys[i] != b->keys[i])
+            return false;
+    for (i = 0; i < a->nkeys; i++)
+        if (a->opclasses[i] != b->opclasses[i])
+            return false;
+
+    return true;
+}
+
+/*
+ ****************************************************************************
+ * Check that btree index A is covered by valid btree index B: key columns
+ * of A are leading key columns of B and included columns of A are in B.
+ * Unique index enforces constraint and isn't covered. Indexes with
+ * expressions and predicates aren't compared, it's hard to do it reliably.
+ ****************************************************************************
+ */
+bool index_covered(struct indexuse_def_s * a, struct indexuse_def_s * b)
+{
+    int i, j;
+
+    if (a->relid != b->relid || a->unique || !b->valid || a->nkeys > b->nkeys
+            || strcmp(a->am, "btree") || strcmp(b->am, "btree")
+            || a->exprs[0] != '\0' || b->exprs[0] != '\0' || a->pred[0] != '\0' || b->pred[0] != '\0')
+        return false;
+
+    for (i = 0; i < a->nkeys; i++)
+        if (a->keys[i] != b->keys[i] || a->opclasses[i] != b->opclasses[i])
+            return false;
+
+    for (i = a->nkeys; i < a->natts; i++) {
+        for (j = 0; j < b->natts; j++)
+            if (a->keys[i] == b->keys[j])
+                break;
+        if (j == b->natts)
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ ****************************************************************************
+ * Make flags of index: invalid, never scanned since stats reset, not scanned
+ * while tracked, duplicate of or covered by another index of the table.
+ * Indexes of the same table are the rows from first to last.
+ ****************************************************************************
+ */
+void indexuse_flags(PGresult * res, struct indexuse_def_s * defs, int row, int first, int last,
+        struct indexuse_entry_s * e, double window, char * buf, size_t len)
+{
+    size_t n = 0;
+    int i;
+
+    buf[0] = '\0';
+    if (!defs[row].valid)
+        n += snprintf(buf + n, len - n, "invalid");
+
+    /* unique indexes enforce constraints, scans aren't their only purpose */
+    if (!defs[row].unique) {
+        if (atoll(PQgetvalue(res, row, INDEXUSE_SCAN_COL)) == 0)
+            n += snprintf(buf + n, len - n, "%sunused", n ? ", " : "");
+        else if (e != NULL && e->scans_window == 0 && window >= INDEXUSE_IDLE_WINDOW)
+            n += snprintf(buf + n, len - n, "%sidle", n ? ", " : "");
+    }
+
+    for (i = first; i <= last && n < len; i++) {
+        if (i == row)
+            continue;
+        if (index_duplicates(&defs[row], &defs[i]))
+            n += snprintf(buf + n, len - n, "%sduplicate of %s", n ? ", " : "",
+                    PQgetvalue(res, i, INDEXUSE_INDEX_COL));
+        else if (index_covered(&defs[row], &defs[i]))
+            n += snprintf(buf + n, len - n, "%scovered by %s", n ? ", " : "",
+                    PQgetvalue(res, i, INDEXUSE_INDEX_COL));
+    }
+}
+
+/*
+ ****************************************************************************
+ * Replace indexes snapshot with index usage efficiency. Scans of indexes and
+ * writes of their tables are accumulated on our side since index is tracked,
+ * writes per scan show how much maintenance the index costs for its scans.
+ * Rows are ordered by table, so duplicates are looked for among neighbours.
+ ****************************************************************************
+ */
+PGresult * merge_index_usage(PGconn * conn, PGresult * res, struct tab_s * tab)
+{
+    static const char * names[INDEXUSE_COLS] = { "relation", "index", "size_kb", "idx_scan",
+        "scans", "scans_s", "writes", "wr_per_scan", "window", "flags" };
+    static const Oid types[INDEXUSE_COLS] = { TEXTOID, TEXTOID, INT8OID, INT8OID,
+        INT8OID, FLOAT8OID, INT8OID, FLOAT8OID, TEXTOID, TEXTOID };
+    PGresult * new_res;
+    PGresAttDesc attrs[INDEXUSE_COLS];
+    struct oidmap_s * iu;
+    struct indexuse_entry_s * e;
+    struct indexuse_def_s * defs;
+    struct timespec ts;
+    char values[INDEXUSE_COLS][M_BUF_LEN];
+    int i, j, first = 0, last = 0, n_rows = PQntuples(res);
+    double window;
+
+    if (PQnfields(res) <= INDEXUSE_PRED_COL)
+        return res;
+
+    memset(attrs, 0, sizeof(attrs));
+    for (i = 0; i < INDEXUSE_COLS; i++) {
+        attrs[i].name = (char *) names[i];
+        attrs[i].typid = types[i];
+        attrs[i].typlen = (types[i] == TEXTOID) ? -1 : 8;
+        attrs[i].atttypmod = -1;
+    }
+
+    if ((new_res = PQmakeEmptyPGresult(conn, PGRES_TUPLES_OK)) == NULL
+        || PQsetResultAttrs(new_res, INDEXUSE_COLS, attrs) == 0) {
+        PQclear(new_res);
+        return res;
+    }
+
+    if (tab->indexuse == NULL)
+        tab->indexuse = oidmap_init(sizeof(struct indexuse_entry_s));
+    iu = tab->indexuse;
+
+    /* history of known indexes is kept, new indexes start from the current counters */
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    oidmap_rebuild(iu, res, INDEXUSE_INDEXRELID_COL);
+    if ((defs = malloc(sizeof(struct indexuse_def_s) * (n_rows + 1))) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for index usage failed.\n");
+    }
+    for (i = 0; i < n_rows; i++) {
+        e = oidmap_lookup(iu, strtoul(PQgetvalue(res, i, INDEXUSE_INDEXRELID_COL), NULL, 10));
+        if (e->tracked) {
+            indexuse_update(e, atoll(PQgetvalue(res, i, INDEXUSE_SCAN_COL)),
+                    atoll(PQgetvalue(res, i, INDEXUSE_WRITES_COL)));
+        } else {
+            e->idx_scan = atoll(PQgetvalue(res, i, INDEXUSE_SCAN_COL));
+            e->writes = atoll(PQgetvalue(res, i, INDEXUSE_WRITES_COL));
+            e->first = ts;
+            e->tracked = true;
+        }
+        indexuse_parse_def(res, i, &defs[i]);
+    }
+
+    for (i = 0; i < n_rows; i++) {
+        /* bounds of rows of the same table */
+        if (i == 0 || defs[i].relid != defs[i - 1].relid) {
+            first = i;
+            for (last = i; last + 1 < n_rows && defs[last + 1].relid == defs[i].relid; last++)
+                ;
+        }
+
+        for (j = 0; j < INDEXUSE_COLS; j++)
+            values[j][0] = '\0';
+        snprintf(values[0], sizeof(values[0]), "%s", PQgetvalue(res, i, INDEXUSE_RELATION_COL));
+        snprintf(values[1], sizeof(values[1]), "%s", PQgetvalue(res, i, INDEXUSE_INDEX_COL));
+        snprintf(values[2], sizeof(values[2]), "%s", PQgetvalue(res, i, INDEXUSE_RELSIZE_COL));
+        snprintf(values[3], sizeof(values[3]), "%s", PQgetvalue(res, i, INDEXUSE_SCAN_COL));
+
+        e = oidmap_lookup(iu, strtoul(PQgetvalue(res, i, INDEXUSE_INDEXRELID_COL), NULL, 10));
+        window = (e != NULL)
+            ? (ts.tv_sec - e->first.tv_sec) + (ts.tv_nsec - e->first.tv_nsec) / 1000000000.0 : 0;
+        if (e != NULL && window > 0) {
+            snprintf(values[4], sizeof(values[4]), "%lli", e->scans_window);
+            snprintf(values[5], sizeof(values[5]), "%.2f", e->scans_window / window);
+            snprintf(values[6], sizeof(values[6]), "%lli", e->writes_window);
+            snprintf(values[7], sizeof(values[7]), "%.2f",
+                    (double) e->writes_window / (e->scans_window > 0 ? e->scans_window : 1));
+            snprintf(values[8], sizeof(values[8]), "%02d:%02d:%02d",
+                    (int) window / 3600, ((int) window % 3600) / 60, (int) window % 60);
+        }
+        indexuse_flags(res, defs, i, first, last, e, window, values[9], sizeof(values[9]));
+
+        for (j = 0; j < INDEXUSE_COLS; j++)
+            PQsetvalue(new_res, i, j, values[j], strlen(values[j]));
+    }
+
+    free(defs);
+    PQclear(res);
+    return new_res;
+}
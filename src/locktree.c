@@ -0,0 +1,358 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+ ****************************************************************************
+ * locktree.c
+ *      blocking tree of sessions built from locks snapshot.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#include "include/locktree.h"
+
+/* lock modes in order of their numbers in postgres, see lock.c */
+static const char * lock_modes[] = {
+    "", "AccessShareLock", "RowShareLock", "RowExclusiveLock", "ShareUpdateExclusiveLock",
+    "ShareLock", "ShareRowExclusiveLock", "ExclusiveLock", "AccessExclusiveLock"
+};
+
+/* conflicts table, bit N is set when the mode conflicts with mode N */
+static const unsigned int lock_conflicts_tab[] = {
+    0,
+    (1 << 8),
+    (1 << 7) | (1 << 8),
+    (1 << 5) | (1 << 6) | (1 << 7) | (1 << 8),
+    (1 << 4) | (1 << 5) | (1 << 6) | (1 << 7) | (1 << 8),
+    (1 << 3) | (1 << 4) | (1 << 6) | (1 << 7) | (1 << 8),
+    (1 << 3) | (1 << 4) | (1 << 5) | (1 << 6) | (1 << 7) | (1 << 8),
+    (1 << 2) | (1 << 3) | (1 << 4) | (1 << 5) | (1 << 6) | (1 << 7) | (1 << 8),
+    (1 << 1) | (1 << 2) | (1 << 3) | (1 << 4) | (1 << 5) | (1 << 6) | (1 << 7) | (1 << 8)
+};
+
+/*
+ ****************************************************************************
+ * Get number of lock mode. Unknown modes (e.g. SIReadLock) are 0, they
+ * don't conflict with anything.
+ ****************************************************************************
+ */
+int lock_mode_num(const char * mode)
+{
+    int i;
+
+    for (i = 1; i < (int) (sizeof(lock_modes) / sizeof(lock_modes[0])); i++)
+        if (!strcmp(mode, lock_modes[i]))
+            return i;
+
+    return 0;
+}
+
+/*
+ ****************************************************************************
+ * Check that two lock modes conflict.
+ ****************************************************************************
+ */
+bool lock_conflicts(int mode1, int mode2)
+{
+    return (lock_conflicts_tab[mode1] & (1 << mode2)) != 0;
+}
+
+/*
+ ****************************************************************************
+ * Hash of the locked object, i.e. of all columns which identify it.
+ ****************************************************************************
+ */
+unsigned int lock_target_hash(PGresult * res, int row)
+{
+    unsigned int hash = 2166136261U;
+    int i;
+
+    for (i = 0; i < LOCKTREE_KEY_COLS; i++)
+        hash = (hash ^ hash_text(PQgetvalue(res, row, i), PQgetlength(res, row, i))) * 16777619U;
+
+    return hash;
+}
+
+/*
+ ****************************************************************************
+ * Check that two locks are on the same object.
+ ****************************************************************************
+ */
+bool lock_target_equal(PGresult * res, int row1, int row2)
+{
+    int i;
+
+    for (i = 0; i < LOCKTREE_KEY_COLS; i++)
+        if (PQgetisnull(res, row1, i) != PQgetisnull(res, row2, i)
+                || strcmp(PQgetvalue(res, row1, i), PQgetvalue(res, row2, i)))
+            return false;
+
+    return true;
+}
+
+/*
+ ****************************************************************************
+ * Find session in the graph or add new one. Sessions are indexed by pid in
+ * open addressing hash table, which is at least twice bigger than number
+ * of sessions.
+ ****************************************************************************
+ */
+unsigned int locktree_node(struct locknode_s * nodes, unsigned int * n_nodes,
+        int * index, unsigned int index_size, int pid)
+{
+    unsigned int slot = ((unsigned int) pid * 2654435761U) & (index_size - 1);
+
+    while (index[slot] != -1) {
+        if (nodes[index[slot]].pid == pid)
+            return index[slot];
+        slot = (slot + 1) & (index_size - 1);
+    }
+
+    index[slot] = *n_nodes;
+    memset(&nodes[*n_nodes], 0, sizeof(struct locknode_s));
+    nodes[*n_nodes].pid = pid;
+    nodes[*n_nodes].info_row = nodes[*n_nodes].wait_row = nodes[*n_nodes].hold_row = -1;
+
+    return (*n_nodes)++;
+}
+
+/*
+ ****************************************************************************
+ * Walk the tree in depth-first order and put sessions into the output order.
+ * Sessions which are blocked by several others are shown only once, under
+ * the first visited blocker. Return new number of ordered sessions.
+ ****************************************************************************
+ */
+unsigned int locktree_walk(struct locknode_s * nodes, unsigned int * children, unsigned int node,
+        unsigned int depth, unsigned int * order, unsigned int * depths, unsigned int n_order)
+{
+    unsigned int i, start = n_order;
+
+    if (nodes[node].visited)
+        return n_order;
+
+    nodes[node].visited = true;
+    order[n_order] = node;
+    depths[n_order] = depth;
+    n_order++;
+
+    for (i = 0; i < nodes[node].n_waiters; i++)
+        n_order = locktree_walk(nodes, children, children[nodes[node].first_child + i],
+                depth + 1, order, depths, n_order);
+
+    nodes[node].subtree = n_order - start;
+    return n_order;
+}
+
+/*
+ ****************************************************************************
+ * Root blockers comparison function for qsort: blockers of more sessions
+ * go first. The 'arg' here is the array of sessions.
+ ****************************************************************************
+ */
+int locktree_root_cmp(const void * a, const void * b, void * arg)
+{
+    const struct locknode_s * nodes = (const struct locknode_s *) arg;
+    const struct locknode_s * na = &nodes[*(const unsigned int *) a];
+    const struct locknode_s * nb = &nodes[*(const unsigned int *) b];
+
+    if (na->subtree != nb->subtree)
+        return (nb->subtree > na->subtree) - (nb->subtree < na->subtree);
+
+    return (na->pid > nb->pid) - (na->pid < nb->pid);
+}
+
+/*
+ ****************************************************************************
+ * Replace locks snapshot with the blocking tree. Locks are indexed by locked
+ * object, thus for every awaited lock its conflicting holders are found in
+ * one lookup and the graph is built in linear time, unlike the self-join of
+ * pg_locks or calling pg_blocking_pids() for every session. Sessions queued
+ * before the waiter aren't considered as blockers, only holders are.
+ * Root blockers go first, ordered by number of sessions blocked by them,
+ * waiters follow their blockers. Sessions which aren't blocked and don't
+ * block anyone aren't shown.
+ ****************************************************************************
+ */
+PGresult * merge_lock_tree(PGconn * conn, PGresult * res)
+{
+    static const char * names[LOCKTREE_COLS] = { "pid", "blocked_by", "blocking", "lock", "locktype", "mode",
+        "object", "usename", "datname", "state", "xact_age", "query" };
+    PGresult * new_res;
+    PGresAttDesc attrs[LOCKTREE_COLS];
+    struct locknode_s * nodes, * node;
+    struct lockedge_s * edges = NULL;
+    unsigned int * hashes, * children, * order, * depths, * roots;
+    int * targets, * next, * pids;
+    unsigned int n_rows = PQntuples(res), index_size = 64, n_nodes = 0, n_edges = 0, max_edges = 0;
+    unsigned int n_roots = 0, n_order = 0, i, j, k, w, b, slot;
+    int r, h, mode;
+    char pid[S_BUF_LEN], blocked_by[S_BUF_LEN], blocking[XS_BUF_LEN];
+    const char * values[LOCKTREE_COLS];
+    size_t len;
+
+    memset(attrs, 0, sizeof(attrs));
+    for (i = 0; i < LOCKTREE_COLS; i++) {
+        attrs[i].name = (char *) names[i];
+        attrs[i].typid = (i == 2) ? INT4OID : TEXTOID;
+        attrs[i].typlen = (i == 2) ? 4 : -1;
+        attrs[i].atttypmod = -1;
+    }
+
+    if ((new_res = PQmakeEmptyPGresult(conn, PGRES_TUPLES_OK)) == NULL
+        || PQsetResultAttrs(new_res, LOCKTREE_COLS, attrs) == 0) {
+        PQclear(new_res);
+        return res;
+    }
+
+    while (index_size < n_rows * 2)
+        index_size <<= 1;
+
+    if ((nodes = malloc(sizeof(struct locknode_s) * (n_rows + 1))) == NULL
+        || (hashes = malloc(sizeof(unsigned int) * (n_rows + 1))) == NULL
+        || (next = malloc(sizeof(int) * (n_rows + 1))) == NULL
+        || (order = malloc(sizeof(unsigned int) * (n_rows + 1))) == NULL
+        || (depths = malloc(sizeof(unsigned int) * (n_rows + 1))) == NULL
+        || (roots = malloc(sizeof(unsigned int) * (n_rows + 1))) == NULL
+        || (targets = malloc(sizeof(int) * index_size)) == NULL
+        || (pids = malloc(sizeof(int) * index_size)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for locks tree failed.\n");
+    }
+    memset(targets, -1, sizeof(int) * index_size);
+    memset(pids, -1, sizeof(int) * index_size);
+
+    /* index locks by locked object and sessions by pid */
+    for (r = 0; r < (int) n_rows; r++) {
+        hashes[r] = lock_target_hash(res, r);
+        slot = hashes[r] & (index_size - 1);
+        next[r] = targets[slot];
+        targets[slot] = r;
+
+        node = &nodes[locktree_node(nodes, &n_nodes, pids, index_size, atoi(PQgetvalue(res, r, lcol_pid)))];
+        if (!strcmp(PQgetvalue(res, r, lcol_granted), "f"))
+            node->wait_row = r;
+        else if (!strcmp(PQgetvalue(res, r, lcol_locktype), "virtualxid"))
+            node->info_row = r;
+    }
+
+    /* find holders of conflicting locks for every awaited lock */
+    for (w = 0; w < n_nodes; w++) {
+        if ((r = nodes[w].wait_row) == -1)
+            continue;
+
+        nodes[w].first_blocker = n_edges;
+        mode = lock_mode_num(PQgetvalue(res, r, lcol_mode));
+        for (h = targets[hashes[r] & (index_size - 1)]; h != -1; h = next[h]) {
+            if (hashes[h] != hashes[r] || strcmp(PQgetvalue(res, h, lcol_granted), "t")
+                    || !lock_conflicts(mode, lock_mode_num(PQgetvalue(res, h, lcol_mode)))
+                    || !lock_target_equal(res, r, h))
+                continue;
+
+            b = locktree_node(nodes, &n_nodes, pids, index_size, atoi(PQgetvalue(res, h, lcol_pid)));
+            if (b == w)
+                continue;
+
+            /* holder can have several conflicting locks on the same object */
+            for (k = nodes[w].first_blocker; k < n_edges && edges[k].blocker != b; k++)
+                ;
+            if (k < n_edges)
+                continue;
+
+            if (n_edges == max_edges) {
+                max_edges = (max_edges == 0) ? n_rows : max_edges * 2;
+                if ((edges = realloc(edges, sizeof(struct lockedge_s) * max_edges)) == NULL) {
+                    mreport(true, msg_fatal, "FATAL: realloc for locks tree failed.\n");
+                }
+            }
+            edges[n_edges].waiter = w;
+            edges[n_edges].blocker = b;
+            n_edges++;
+            nodes[w].n_blockers++;
+            nodes[b].n_waiters++;
+            if (nodes[b].hold_row == -1)
+                nodes[b].hold_row = h;
+        }
+    }
+
+    /* group waiters by blockers */
+    if ((children = malloc(sizeof(unsigned int) * (n_edges + 1))) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for locks tree failed.\n");
+    }
+    for (i = 0, k = 0; i < n_nodes; i++) {
+        nodes[i].first_child = k;
+        k += nodes[i].n_waiters;
+        nodes[i].n_waiters = 0;
+    }
+    for (i = 0; i < n_edges; i++) {
+        node = &nodes[edges[i].blocker];
+        children[node->first_child + node->n_waiters++] = edges[i].waiter;
+    }
+
+    /* roots aren't blocked, they block others or their blockers are unknown */
+    for (i = 0; i < n_nodes; i++)
+        if (nodes[i].n_blockers == 0 && (nodes[i].n_waiters > 0 || nodes[i].wait_row != -1)) {
+            roots[n_roots++] = i;
+            n_order = locktree_walk(nodes, children, i, 0, order, depths, n_order);
+        }
+    qsort_r(roots, n_roots, sizeof(unsigned int), locktree_root_cmp, nodes);
+
+    /* walk the tree again, roots ordered by number of blocked sessions */
+    for (i = 0; i < n_nodes; i++)
+        nodes[i].visited = false;
+    for (i = 0, n_order = 0; i < n_roots; i++)
+        n_order = locktree_walk(nodes, children, roots[i], 0, order, depths, n_order);
+
+    /* the rest are in deadlock cycles, show them from any session */
+    for (i = 0; i < n_nodes; i++)
+        if (!nodes[i].visited && nodes[i].n_waiters > 0)
+            n_order = locktree_walk(nodes, children, i, 0, order, depths, n_order);
+
+    for (i = 0; i < n_order; i++) {
+        node = &nodes[order[i]];
+
+        /* indent waiters under their blockers */
+        len = 0;
+        if (depths[i] > 0) {
+            for (j = 1; j < (min(depths[i], LOCKTREE_MAX_DEPTH)); j++)
+                len += snprintf(pid + len, sizeof(pid) - len, "  ");
+            len += snprintf(pid + len, sizeof(pid) - len, "`- ");
+        }
+        (node->pid == 0)
+            ? snprintf(pid + len, sizeof(pid) - len, "prepared")
+            : snprintf(pid + len, sizeof(pid) - len, "%d", node->pid);
+
+        for (j = 0, len = 0, blocked_by[0] = '\0'; j < node->n_blockers && len < sizeof(blocked_by); j++)
+            len += snprintf(blocked_by + len, sizeof(blocked_by) - len, (j == 0) ? "%d" : ",%d",
+                    nodes[edges[node->first_blocker + j].blocker].pid);
+        snprintf(blocking, sizeof(blocking), "%u", node->n_waiters);
+
+        values[0] = pid;
+        values[1] = blocked_by;
+        values[2] = blocking;
+        values[3] = (node->wait_row != -1) ? "wait" : "hold";
+        r = (node->wait_row != -1) ? node->wait_row : node->hold_row;
+        values[4] = PQgetvalue(res, r, lcol_locktype);
+        values[5] = PQgetvalue(res, r, lcol_mode);
+        values[6] = PQgetvalue(res, r, lcol_object);
+        for (j = lcol_usename; j <= lcol_query; j++)
+            values[7 + j - lcol_usename] = (node->info_row != -1) ? PQgetvalue(res, node->info_row, j) : "";
+
+        for (j = 0; j < LOCKTREE_COLS; j++)
+            PQsetvalue(new_res, i, j, (char *) values[j], strlen(values[j]));
+    }
+
+    free(nodes);
+    free(hashes);
+    free(next);
+    free(order);
+    free(depths);
+    free(roots);
+    free(targets);
+    free(pids);
+    free(edges);
+    free(children);
+    PQclear(res);
+
+    return new_res;
+}
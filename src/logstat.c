@@ -0,0 +1,394 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+ ****************************************************************************
+ * logstat.c
+ *      postgres log analytics: severity rates, top errors, durations.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#include "include/logstat.h"
+
+static const char * sev_names[LOGSTAT_SEVERITIES] = { "LOG", "WARNING", "ERROR", "FATAL", "PANIC" };
+
+/* upper bounds of duration buckets (ms), the last bucket is unbounded */
+static const double duration_bounds[LOGSTAT_DURATION_BUCKETS - 1] = { 1, 10, 100, 1000, 10000, 60000 };
+static const char * duration_names[LOGSTAT_DURATION_BUCKETS] =
+    { "<1ms", "1-10ms", "10-100ms", "0.1-1s", "1-10s", "10-60s", ">60s" };
+
+/*
+ ****************************************************************************
+ * Allocate and initialize log analytics state.
+ ****************************************************************************
+ */
+struct logstat_s * logstat_init(bool csvlog)
+{
+    struct logstat_s * ls;
+
+    if ((ls = (struct logstat_s *) malloc(LOGSTAT_SIZE)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for logstat failed.\n");
+    }
+    memset(ls, 0, LOGSTAT_SIZE);
+    ls->csvlog = csvlog;
+    ls->started = time(NULL);
+    clock_gettime(CLOCK_MONOTONIC, &ls->ts);
+
+    return ls;
+}
+
+/*
+ ****************************************************************************
+ * Append data to the csvlog field if the field is interesting for us.
+ ****************************************************************************
+ */
+void logstat_csv_append(struct logstat_s * ls, const char * data, size_t len)
+{
+    size_t n;
+
+    if (ls->csv_field == LOGSTAT_CSV_SEVERITY) {
+        n = min(len, sizeof(ls->csv_severity) - 1 - ls->csv_severity_len);
+        memcpy(ls->csv_severity + ls->csv_severity_len, data, n);
+        ls->csv_severity_len += n;
+    } else if (ls->csv_field == LOGSTAT_CSV_MESSAGE) {
+        n = min(len, sizeof(ls->csv_message) - 1 - ls->csv_message_len);
+        memcpy(ls->csv_message + ls->csv_message_len, data, n);
+        ls->csv_message_len += n;
+    }
+}
+
+/*
+ ****************************************************************************
+ * Parse csvlog data. Records may span several lines because quoted fields
+ * may contain newlines, thus parser state is kept between calls.
+ ****************************************************************************
+ */
+void logstat_feed_csvlog(struct logstat_s * ls, const char * data, size_t len, bool eol)
+{
+    const char * ptr = data, * end = data + len, * q;
+
+    while (ptr < end) {
+        if (ls->csv_quote_seen) {
+            ls->csv_quote_seen = false;
+            if (*ptr == '"') {                  /* escaped quote */
+                logstat_csv_append(ls, ptr, 1);
+                ptr++;
+                continue;
+            }
+            ls->csv_quoted = false;             /* closing quote */
+        }
+
+        if (ls->csv_quoted) {
+            /* skip quoted text up to the next quote at once */
+            if ((q = memchr(ptr, '"', end - ptr)) == NULL) {
+                logstat_csv_append(ls, ptr, end - ptr);
+                break;
+            }
+            logstat_csv_append(ls, ptr, q - ptr);
+            ls->csv_quote_seen = true;
+            ptr = q + 1;
+            continue;
+        }
+
+        if (*ptr == '"')
+            ls->csv_quoted = true;
+        else if (*ptr == ',')
+            ls->csv_field++;
+        else
+            logstat_csv_append(ls, ptr, 1);
+        ptr++;
+    }
+
+    if (!eol)
+        return;
+
+    /* quote right before newline is a closing one */
+    if (ls->csv_quote_seen) {
+        ls->csv_quote_seen = false;
+        ls->csv_quoted = false;
+    }
+
+    /* newline inside quoted field, record continues */
+    if (ls->csv_quoted) {
+        logstat_csv_append(ls, "\n", 1);
+        return;
+    }
+
+    logstat_process(ls, ls->csv_severity, ls->csv_severity_len, ls->csv_message, ls->csv_message_len);
+    ls->csv_field = 0;
+    ls->csv_severity_len = 0;
+    ls->csv_message_len = 0;
+}
+
+/*
+ ****************************************************************************
+ * Parse stderr log line: severity is the uppercase word followed by colon
+ * and two spaces, it follows log_line_prefix. Continuation lines of
+ * multiline messages start with tab and are skipped.
+ ****************************************************************************
+ */
+void logstat_parse_stderr(struct logstat_s * ls, const char * line, size_t len)
+{
+    const char * ptr = line, * end = line + len, * sev;
+
+    if (len == 0 || line[0] == '\t')
+        return;
+
+    while ((ptr = memchr(ptr, ':', end - ptr)) != NULL) {
+        if (end - ptr >= 3 && ptr[1] == ' ' && ptr[2] == ' ')
+            break;
+        ptr++;
+    }
+    if (ptr == NULL)
+        return;
+
+    for (sev = ptr; sev > line && isupper((unsigned char) sev[-1]); sev--)
+        ;
+
+    logstat_process(ls, sev, ptr - sev, ptr + 3, end - ptr - 3);
+}
+
+/*
+ ****************************************************************************
+ * Log tail hook: receive new log data. Data comes in pieces, eol marks the
+ * end of line. Only the beginning of stderr line is kept.
+ ****************************************************************************
+ */
+void logstat_feed(void * arg, const char * data, size_t len, bool eol)
+{
+    struct logstat_s * ls = (struct logstat_s *) arg;
+    size_t n;
+
+    if (ls->csvlog) {
+        logstat_feed_csvlog(ls, data, len, eol);
+        return;
+    }
+
+    /* complete line, parse it in place */
+    if (eol && ls->line_len == 0) {
+        logstat_parse_stderr(ls, data, len);
+        return;
+    }
+
+    n = min(len, sizeof(ls->line) - ls->line_len);
+    memcpy(ls->line + ls->line_len, data, n);
+    ls->line_len += n;
+
+    if (eol) {
+        logstat_parse_stderr(ls, ls->line, ls->line_len);
+        ls->line_len = 0;
+    }
+}
+
+/*
+ ****************************************************************************
+ * Account log message with its severity.
+ ****************************************************************************
+ */
+void logstat_process(struct logstat_s * ls, const char * severity, size_t sev_len,
+        const char * message, size_t msg_len)
+{
+    unsigned int i;
+
+    for (i = 0; i < LOGSTAT_SEVERITIES; i++)
+        if (strlen(sev_names[i]) == sev_len && strncmp(severity, sev_names[i], sev_len) == 0)
+            break;
+
+    /* DETAIL, HINT, STATEMENT, etc. */
+    if (i == LOGSTAT_SEVERITIES)
+        return;
+
+    ls->sev_count[i]++;
+
+    if (i == sev_log && msg_len > 10 && strncmp(message, "duration: ", 10) == 0)
+        logstat_add_duration(ls, message + 10, msg_len - 10);
+    else if (i >= sev_error)
+        logstat_add_message(ls, i, message, msg_len);
+}
+
+/*
+ ****************************************************************************
+ * Normalize message: replace quoted literals and numbers with placeholders.
+ * Return length of normalized message.
+ ****************************************************************************
+ */
+size_t logstat_normalize(const char * message, size_t len, char * out, size_t out_len)
+{
+    size_t i, o = 0;
+    char c, quote;
+
+    for (i = 0; i < len && o + 3 < out_len; i++) {
+        c = message[i];
+        if (c == '"' || c == '\'') {
+            quote = c;
+            out[o++] = quote;
+            out[o++] = '?';
+            while (i + 1 < len && message[i + 1] != quote)
+                i++;
+            if (i + 1 < len) {
+                out[o++] = quote;
+                i++;
+            }
+        } else if (isdigit((unsigned char) c)
+                && (i == 0 || !(isalnum((unsigned char) message[i - 1]) || message[i - 1] == '_'))) {
+            out[o++] = 'N';
+            while (i + 1 < len && (isdigit((unsigned char) message[i + 1]) || message[i + 1] == '.'))
+                i++;
+        } else if (c == '\n' || c == '\t') {
+            out[o++] = ' ';
+        } else {
+            out[o++] = c;
+        }
+    }
+    out[o] = '\0';
+
+    return o;
+}
+
+/*
+ ****************************************************************************
+ * Account normalized error message in messages table.
+ ****************************************************************************
+ */
+void logstat_add_message(struct logstat_s * ls, enum log_severity severity, const char * message, size_t len)
+{
+    char text[LOGSTAT_MSG_LEN];
+    unsigned int hash = 2166136261U, i;
+    size_t n, j;
+
+    n = logstat_normalize(message, len, text, sizeof(text));
+
+    /* FNV-1a */
+    for (j = 0; j < n; j++)
+        hash = (hash ^ (unsigned char) text[j]) * 16777619U;
+    hash ^= severity;
+    if (hash == 0)
+        hash = 1;
+
+    for (i = hash & (LOGSTAT_MAX_MSGS - 1); ls->msgs[i].hash != 0; i = (i + 1) & (LOGSTAT_MAX_MSGS - 1)) {
+        if (ls->msgs[i].hash == hash && ls->msgs[i].severity == severity && strcmp(ls->msgs[i].text, text) == 0) {
+            ls->msgs[i].count++;
+            return;
+        }
+    }
+
+    /* keep table sparse enough for short probes */
+    if (ls->msgs_used >= LOGSTAT_MAX_MSGS * 3 / 4) {
+        ls->msgs_other++;
+        return;
+    }
+
+    ls->msgs[i].hash = hash;
+    ls->msgs[i].severity = severity;
+    ls->msgs[i].count = 1;
+    snprintf(ls->msgs[i].text, sizeof(ls->msgs[i].text), "%s", text);
+    ls->msgs_used++;
+}
+
+/*
+ ****************************************************************************
+ * Account "duration: N ms" into durations histogram.
+ ****************************************************************************
+ */
+void logstat_add_duration(struct logstat_s * ls, const char * message, size_t len)
+{
+    char value[XS_BUF_LEN];
+    double ms;
+    unsigned int i;
+
+    snprintf(value, sizeof(value), "%.*s", (int) (min(len, sizeof(value) - 1)), message);
+    ms = strtod(value, NULL);
+
+    for (i = 0; i < LOGSTAT_DURATION_BUCKETS - 1; i++)
+        if (ms < duration_bounds[i])
+            break;
+    ls->durations[i]++;
+}
+
+/*
+ ****************************************************************************
+ * Calculate per second rates of severities since previous refresh.
+ ****************************************************************************
+ */
+void logstat_update_rates(struct logstat_s * ls)
+{
+    struct timespec now;
+    double elapsed;
+    unsigned int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = (now.tv_sec - ls->ts.tv_sec) + (now.tv_nsec - ls->ts.tv_nsec) / 1000000000.0;
+    if (elapsed <= 0)
+        return;
+
+    for (i = 0; i < LOGSTAT_SEVERITIES; i++) {
+        ls->sev_rate[i] = (ls->sev_count[i] - ls->sev_prev[i]) / elapsed;
+        ls->sev_prev[i] = ls->sev_count[i];
+    }
+    ls->ts = now;
+}
+
+/*
+ ****************************************************************************
+ * Print log analytics into subtab.
+ ****************************************************************************
+ */
+void logstat_print(WINDOW * window, struct logstat_s * ls, const char * path)
+{
+    unsigned int y, n_lines, i, j, k, n_top = 0;
+    unsigned int top[LOGSTAT_MAX_MSGS];
+    char started[XS_BUF_LEN + 4];
+
+    y = getbegy(window);
+    /* header, severities, durations, messages header and empty line */
+    n_lines = (LINES - y > 6) ? LINES - y - 6 : 0;
+    wclear(window);
+
+    strftime(started, sizeof(started), "%H:%M:%S", localtime(&ls->started));
+    wattron(window, A_BOLD);
+    wprintw(window, "\nlog stats %s (since %s)\n", path, started);
+    wattroff(window, A_BOLD);
+
+    wprintw(window, "    rate/s: ");
+    for (i = sev_warning; i < LOGSTAT_SEVERITIES; i++)
+        wprintw(window, "%s %.2f (%lu)  ", sev_names[i], ls->sev_rate[i], ls->sev_count[i]);
+    wprintw(window, "\n durations: ");
+    for (i = 0; i < LOGSTAT_DURATION_BUCKETS; i++)
+        wprintw(window, "%s %lu  ", duration_names[i], ls->durations[i]);
+    wprintw(window, "\n");
+
+    /* select top messages by count */
+    for (i = 0; i < LOGSTAT_MAX_MSGS && n_top < n_lines; i++) {
+        if (ls->msgs[i].hash == 0)
+            continue;
+        top[n_top++] = i;
+    }
+    for (; i < LOGSTAT_MAX_MSGS && n_lines > 0; i++) {
+        if (ls->msgs[i].hash == 0)
+            continue;
+        /* replace the least frequent message in the top */
+        for (j = 0, k = 0; j < n_top; j++)
+            if (ls->msgs[top[j]].count < ls->msgs[top[k]].count)
+                k = j;
+        if (ls->msgs[i].count > ls->msgs[top[k]].count)
+            top[k] = i;
+    }
+    /* order top by count */
+    for (i = 1; i < n_top; i++)
+        for (j = i; j > 0 && ls->msgs[top[j - 1]].count < ls->msgs[top[j]].count; j--) {
+            k = top[j]; top[j] = top[j - 1]; top[j - 1] = k;
+        }
+
+    wattron(window, A_BOLD);
+    wprintw(window, "%10s %-8s %s\n", "count", "severity", "message");
+    wattroff(window, A_BOLD);
+    for (i = 0; i < n_top; i++)
+        wprintw(window, "%10lu %-8s %.*s\n", ls->msgs[top[i]].count, sev_names[ls->msgs[top[i]].severity],
+                (COLS > 21) ? COLS - 21 : 0, ls->msgs[top[i]].text);
+    if (ls->msgs_other > 0)
+        wprintw(window, "%10lu %-8s %s\n", ls->msgs_other, "", "other messages");
+
+    wrefresh(window);
+}
@@ -0,0 +1,389 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+ ****************************************************************************
+ * logtail.c
+ *      streaming tail of postgres log.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#include "include/logtail.h"
+#include "include/pgf.h"
+
+/*
+ ****************************************************************************
+ * Attach log tail to the file. If from_end is true, only the end of the file
+ * is read, otherwise the file is read from the beginning (rotated log).
+ * Remote log isn't opened, only its size is checked.
+ * Return 0 on success and -1 if file can't be opened.
+ ****************************************************************************
+ */
+int logtail_attach(struct logtail_s * lt, const char * path, bool from_end, PGconn * conn)
+{
+    struct stat stats;
+    char dir[PATH_MAX];
+    off_t size = 0;
+    int fd;
+
+    if (lt->remote) {
+        if ((size = logtail_remote_size(conn, path)) == -1)
+            return -1;
+    } else {
+        if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+            return -1;
+
+        if (lt->fd >= 0)
+            close(lt->fd);
+        lt->fd = fd;
+        if (fstat(fd, &stats) == 0)
+            size = stats.st_size;
+    }
+    snprintf(lt->path, sizeof(lt->path), "%s", path);
+
+    /* start reading near the end of log and skip the first incomplete line */
+    lt->offset = 0;
+    lt->partial_len = 0;
+    lt->partial_skip = false;
+    lt->idle = false;
+    if (from_end && size > LOGTAIL_INITIAL_READ) {
+        lt->offset = size - LOGTAIL_INITIAL_READ;
+        lt->partial_skip = true;
+    }
+
+    /* watch the file for appends and the directory for new files */
+    if (lt->inotify_fd >= 0) {
+        if (lt->file_wd >= 0)
+            inotify_rm_watch(lt->inotify_fd, lt->file_wd);
+        if (lt->dir_wd >= 0)
+            inotify_rm_watch(lt->inotify_fd, lt->dir_wd);
+        lt->file_wd = inotify_add_watch(lt->inotify_fd, path, IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF);
+        snprintf(dir, sizeof(dir), "%s", path);
+        lt->dir_wd = inotify_add_watch(lt->inotify_fd, dirname(dir), IN_CREATE | IN_MOVED_TO);
+    }
+
+    return 0;
+}
+
+/*
+ ****************************************************************************
+ * Open log for tailing. If conn isn't NULL, log is on the remote host and
+ * it's read with postgres functions. Return NULL if log can't be opened.
+ ****************************************************************************
+ */
+struct logtail_s * logtail_open(const char * path, PGconn * conn)
+{
+    struct logtail_s * lt;
+
+    if ((lt = (struct logtail_s *) malloc(LOGTAIL_SIZE)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for logtail failed.\n");
+    }
+    memset(lt, 0, LOGTAIL_SIZE);
+    lt->fd = lt->inotify_fd = lt->file_wd = lt->dir_wd = -1;
+    lt->remote = (conn != NULL);
+
+    /* without inotify the log is checked on every refresh */
+    if (!lt->remote)
+        lt->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (logtail_attach(lt, path, true, conn) == -1) {
+        logtail_close(lt);
+        return NULL;
+    }
+
+    logtail_read(lt, conn);
+    return lt;
+}
+
+/*
+ ****************************************************************************
+ * Switch to the new log file after rotation. The rest of the old file is read
+ * before switching, the new file is read from the beginning.
+ ****************************************************************************
+ */
+int logtail_switch(struct logtail_s * lt, const char * path, PGconn * conn)
+{
+    logtail_read(lt, conn);
+    return logtail_attach(lt, path, false, conn);
+}
+
+/*
+ ****************************************************************************
+ * Close log and free log tail resources.
+ ****************************************************************************
+ */
+void logtail_close(struct logtail_s * lt)
+{
+    if (lt == NULL)
+        return;
+
+    if (lt->fd >= 0)
+        close(lt->fd);
+    if (lt->inotify_fd >= 0)
+        close(lt->inotify_fd);
+    free(lt);
+}
+
+/*
+ ****************************************************************************
+ * Check that the log path still refers to the opened file. The file is
+ * replaced when log is renamed and created again with the same name, or
+ * when it's truncated. Return true if the log should be reopened.
+ ****************************************************************************
+ */
+bool logtail_replaced(struct logtail_s * lt)
+{
+    struct stat opened, current;
+
+    if (lt->remote || lt->fd < 0)
+        return false;
+
+    if (fstat(lt->fd, &opened) == -1 || stat(lt->path, &current) == -1)
+        return false;
+
+    return opened.st_dev != current.st_dev || opened.st_ino != current.st_ino
+        || current.st_size < lt->offset;
+}
+
+/*
+ ****************************************************************************
+ * Consume pending inotify events and return what happened with the log.
+ * Without inotify the log is read on every refresh and checked for being
+ * replaced. Remote log is always read, rotation is checked only when log
+ * is idle.
+ ****************************************************************************
+ */
+unsigned int logtail_check(struct logtail_s * lt)
+{
+    char buf[XXL_BUF_LEN] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event * ev;
+    unsigned int flags = 0;
+    ssize_t len;
+    char * ptr;
+
+    if (lt->remote)
+        return lt->idle ? (LOGTAIL_MODIFIED | LOGTAIL_ROTATED) : LOGTAIL_MODIFIED;
+
+    if (lt->inotify_fd < 0 || lt->file_wd < 0)
+        return logtail_replaced(lt) ? (LOGTAIL_MODIFIED | LOGTAIL_ROTATED) : LOGTAIL_MODIFIED;
+
+    while ((len = read(lt->inotify_fd, buf, sizeof(buf))) > 0) {
+        for (ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + ev->len) {
+            ev = (const struct inotify_event *) ptr;
+            if (ev->wd == lt->file_wd) {
+                if (ev->mask & IN_MODIFY)
+                    flags |= LOGTAIL_MODIFIED;
+                if (ev->mask & (IN_MOVE_SELF | IN_DELETE_SELF))
+                    flags |= LOGTAIL_ROTATED;
+            } else if (ev->wd == lt->dir_wd) {
+                flags |= LOGTAIL_ROTATED;
+            }
+        }
+    }
+
+    return flags;
+}
+
+/*
+ ****************************************************************************
+ * Get size of the log on the remote host. Return -1 if log can't be accessed.
+ ****************************************************************************
+ */
+off_t logtail_remote_size(PGconn * conn, const char * path)
+{
+    PGresult * res;
+    const char * params[1] = { path };
+    off_t size = -1;
+
+    res = exec_prepared(conn, PG_LOG_SIZE_QUERY, 1, params, 0);
+    if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 1)
+        size = strtoll(PQgetvalue(res, 0, 0), NULL, 10);
+    PQclear(res);
+
+    return size;
+}
+
+/*
+ ****************************************************************************
+ * Read bytes appended to the remote log since the last read. The read offset
+ * is kept on our side, so only new bytes are transferred. Result is requested
+ * in binary format to avoid bytea escaping. Return number of read bytes or -1
+ * on error.
+ ****************************************************************************
+ */
+ssize_t logtail_read_remote(struct logtail_s * lt, PGconn * conn)
+{
+    PGresult * res;
+    char offset[XS_BUF_LEN], length[XS_BUF_LEN];
+    const char * params[3] = { lt->path, offset, length };
+    const unsigned char * val;
+    ssize_t n, total = 0;
+    off_t size;
+    unsigned int i;
+
+    snprintf(length, sizeof(length), "%d", LOGTAIL_READ_LEN);
+    do {
+        snprintf(offset, sizeof(offset), "%lld", (long long) lt->offset);
+        res = exec_prepared(conn, PG_LOG_READ_QUERY, 3, params, 1);
+        if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != 1 || PQgetlength(res, 0, 0) != 8) {
+            PQclear(res);
+            return -1;
+        }
+
+        /* int8 in binary format is in network byte order */
+        val = (const unsigned char *) PQgetvalue(res, 0, 0);
+        for (i = 0, size = 0; i < 8; i++)
+            size = (size << 8) | val[i];
+
+        /* log has been truncated, read it again from the beginning */
+        if (size < lt->offset) {
+            lt->offset = 0;
+            lt->partial_len = 0;
+            lt->partial_skip = false;
+            PQclear(res);
+            n = LOGTAIL_READ_LEN;
+            continue;
+        }
+
+        n = PQgetlength(res, 0, 1);
+        lt->offset += n;
+        total += n;
+        logtail_split(lt, PQgetvalue(res, 0, 1), n);
+        PQclear(res);
+    } while (n == LOGTAIL_READ_LEN);
+
+    lt->idle = (total == 0);
+    return total;
+}
+
+/*
+ ****************************************************************************
+ * Read bytes appended to the log since the last read and split them into
+ * lines. Return number of read bytes or -1 on error.
+ ****************************************************************************
+ */
+ssize_t logtail_read(struct logtail_s * lt, PGconn * conn)
+{
+    static char buf[LOGTAIL_READ_LEN];
+    struct stat stats;
+    ssize_t n, total = 0;
+
+    if (lt->remote)
+        return logtail_read_remote(lt, conn);
+
+    if (fstat(lt->fd, &stats) == -1 || !S_ISREG(stats.st_mode))
+        return -1;
+
+    /* log has been truncated */
+    if (stats.st_size < lt->offset) {
+        lt->offset = 0;
+        lt->partial_len = 0;
+        lt->partial_skip = false;
+    }
+
+    while ((n = pread(lt->fd, buf, sizeof(buf), lt->offset)) > 0) {
+        lt->offset += n;
+        total += n;
+        logtail_split(lt, buf, n);
+
+        if (n < (ssize_t) sizeof(buf))
+            break;
+    }
+
+    return (n < 0) ? -1 : total;
+}
+
+/*
+ ****************************************************************************
+ * Split read data into lines and push them into ring buffer. Incomplete last
+ * line is kept until its end is read.
+ ****************************************************************************
+ */
+void logtail_split(struct logtail_s * lt, const char * buf, size_t len)
+{
+    const char * ptr, * end, * nl;
+    size_t seglen, copy;
+
+    for (ptr = buf, end = buf + len; ptr < end; ptr = nl + 1) {
+        nl = memchr(ptr, '\n', end - ptr);
+        seglen = (nl != NULL ? nl : end) - ptr;
+
+        /* pass complete data to the hook, lines aren't truncated there */
+        if (lt->hook != NULL && !lt->partial_skip)
+            lt->hook(lt->hook_arg, ptr, seglen, nl != NULL);
+
+        /* complete line without buffered prefix, push it without copying */
+        if (nl != NULL && lt->partial_len == 0 && !lt->partial_skip) {
+            logtail_push_line(lt, ptr, min(seglen, LOGTAIL_LINE_MAXLEN));
+            continue;
+        }
+
+        if (!lt->partial_skip) {
+            copy = min(seglen, LOGTAIL_LINE_MAXLEN - lt->partial_len);
+            memcpy(lt->partial + lt->partial_len, ptr, copy);
+            lt->partial_len += copy;
+        }
+
+        if (nl == NULL)
+            break;
+
+        if (!lt->partial_skip)
+            logtail_push_line(lt, lt->partial, lt->partial_len);
+        lt->partial_len = 0;
+        lt->partial_skip = false;
+    }
+}
+
+/*
+ ****************************************************************************
+ * Append line into ring buffer. Lines are stored contiguously, when there is
+ * no room at the end of storage, writing is continued from the beginning.
+ * The oldest lines which overlap the new one are dropped.
+ ****************************************************************************
+ */
+void logtail_push_line(struct logtail_s * lt, const char * line, size_t len)
+{
+    unsigned int idx;
+
+    if (len > LOGTAIL_DATA_SIZE)
+        len = LOGTAIL_DATA_SIZE;
+
+    /* wrap around, lines placed after write position are the oldest */
+    if (lt->wpos + len > LOGTAIL_DATA_SIZE) {
+        while (lt->count > 0 && lt->line_off[lt->head] >= lt->wpos) {
+            lt->head = (lt->head + 1) % LOGTAIL_LINES;
+            lt->count--;
+        }
+        lt->wpos = 0;
+    }
+
+    while (lt->count > 0
+            && (lt->count == LOGTAIL_LINES
+                || (lt->line_off[lt->head] >= lt->wpos && lt->line_off[lt->head] < lt->wpos + len))) {
+        lt->head = (lt->head + 1) % LOGTAIL_LINES;
+        lt->count--;
+    }
+
+    idx = (lt->head + lt->count) % LOGTAIL_LINES;
+    lt->line_off[idx] = lt->wpos;
+    lt->line_len[idx] = len;
+    memcpy(lt->data + lt->wpos, line, len);
+    lt->wpos += len;
+    lt->count++;
+}
+
+/*
+ ****************************************************************************
+ * Get n-th line from ring buffer, counting from the oldest line.
+ * Line isn't null-terminated, its length is returned via len.
+ ****************************************************************************
+ */
+const char * logtail_get_line(struct logtail_s * lt, unsigned int n, unsigned int * len)
+{
+    unsigned int idx = (lt->head + n) % LOGTAIL_LINES;
+
+    *len = lt->line_len[idx];
+    return lt->data + lt->line_off[idx];
+}
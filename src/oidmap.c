@@ -0,0 +1,106 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+ ****************************************************************************
+ * oidmap.c
+ *      history of objects keyed by oid, shared by contexts which track
+ *      tables or indexes between refreshes.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#include "include/oidmap.h"
+
+/*
+ ****************************************************************************
+ * Allocate empty history with entries of the given size.
+ ****************************************************************************
+ */
+struct oidmap_s * oidmap_init(size_t entry_size)
+{
+    struct oidmap_s * map;
+
+    if ((map = (struct oidmap_s *) malloc(OIDMAP_SIZE)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for objects history failed.\n");
+    }
+    memset(map, 0, OIDMAP_SIZE);
+    map->entry_size = entry_size;
+
+    return map;
+}
+
+/*
+ ****************************************************************************
+ * Free history.
+ ****************************************************************************
+ */
+void free_oidmap(struct oidmap_s * map)
+{
+    if (map == NULL)
+        return;
+
+    free(map->entries);
+    free(map);
+}
+
+/*
+ ****************************************************************************
+ * Entries comparison function for qsort, by oid.
+ ****************************************************************************
+ */
+int oidmap_cmp(const void * a, const void * b)
+{
+    unsigned int oa = *(const unsigned int *) a;
+    unsigned int ob = *(const unsigned int *) b;
+
+    return (oa > ob) - (oa < ob);
+}
+
+/*
+ ****************************************************************************
+ * Find entry of object using binary search. Return NULL if not found.
+ ****************************************************************************
+ */
+void * oidmap_lookup(struct oidmap_s * map, unsigned int oid)
+{
+    if (map->used == 0)
+        return NULL;
+
+    return bsearch(&oid, map->entries, map->used, map->entry_size, oidmap_cmp);
+}
+
+/*
+ ****************************************************************************
+ * Rebuild history using the list of objects, their oids are in oid_col of
+ * result. Entries of known objects are kept, new objects get zeroed entries,
+ * objects which are gone are forgotten.
+ ****************************************************************************
+ */
+void oidmap_rebuild(struct oidmap_s * map, PGresult * res, int oid_col)
+{
+    char * entries, * e;
+    void * prev;
+    unsigned int i, oid, n_rows = PQntuples(res);
+
+    if ((entries = malloc(map->entry_size * (n_rows + 1))) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for objects history failed.\n");
+    }
+
+    for (i = 0; i < n_rows; i++) {
+        e = entries + (size_t) i * map->entry_size;
+        oid = strtoul(PQgetvalue(res, i, oid_col), NULL, 10);
+        if ((prev = oidmap_lookup(map, oid)) != NULL)
+            memcpy(e, prev, map->entry_size);
+        else {
+            memset(e, 0, map->entry_size);
+            memcpy(e, &oid, sizeof(oid));
+        }
+    }
+    qsort(entries, n_rows, map->entry_size, oidmap_cmp);
+
+    free(map->entries);
+    map->entries = entries;
+    map->used = n_rows;
+}
@@ -15,6 +15,21 @@
 #include "include/stats.h"
 #include "include/pgf.h"
 #include "include/hotkeys.h"
+#include "include/pgss.h"
+#include "include/procstat.h"
+#include "include/waitprof.h"
+#include "include/locktree.h"
+#include "include/replstat.h"
+#include "include/relsize.h"
+#include "include/bloat.h"
+#include "include/xidwrap.h"
+#include "include/progress.h"
+#include "include/bufcache.h"
+#include "include/churn.h"
+#include "include/pgssagg.h"
+#include "include/indexuse.h"
+#include "include/alerts.h"
+#include "include/history.h"
 #include "include/pgcenter.h"
 
 /*
@@ -39,6 +54,7 @@ void init_args_struct(struct args_s *args)
 {
     args->count = 0;
     args->connfile[0] = '\0';
+    args->alertfile[0] = '\0';
     args->host[0] = '\0';
     args->port[0] = '\0';
     args->user[0] = '\0';
@@ -80,6 +96,7 @@ void init_tabs(struct tab_s *tabs[])
         snprintf(tabs[i]->pg_stat_activity_min_age, XS_BUF_LEN, "%s", PG_STAT_ACTIVITY_MIN_AGE_DEFAULT);
         tabs[i]->signal_options = 0;
         tabs[i]->pg_stat_sys = false;
+        tabs[i]->iostat_min_util = -1;
         
         /* init iostat/ifstat storage */
         /* that looks like an ugly hack, 8 is the pointer size on amd64 arch */
@@ -106,6 +123,15 @@ void init_tabs(struct tab_s *tabs[])
         tabs[i]->context_list[11].context = pg_stat_statements_temp;
         tabs[i]->context_list[12].context = pg_stat_statements_local;
         tabs[i]->context_list[13].context = pg_stat_progress_vacuum;
+        tabs[i]->context_list[14].context = pg_stat_proc;
+        tabs[i]->context_list[15].context = pg_wait_profile;
+        tabs[i]->context_list[16].context = pg_locks_tree;
+        tabs[i]->context_list[17].context = pg_tables_bloat;
+        tabs[i]->context_list[18].context = pg_xid_wraparound;
+        tabs[i]->context_list[19].context = pg_buffercache;
+        tabs[i]->context_list[20].context = pg_stat_connections;
+        tabs[i]->context_list[21].context = pg_stat_statements_agg;
+        tabs[i]->context_list[22].context = pg_index_usage;
 
         for (j = 0; j < TOTAL_CONTEXTS; j++) {
             /* initiate sorting */
@@ -115,6 +141,12 @@ void init_tabs(struct tab_s *tabs[])
             for (k = 0; k < MAX_COLS; k++)
                 tabs[i]->context_list[j].fstrings[k][0] = '\0';
         }
+        /* the oldest databases and tables, the biggest buffers users, the most churning clients go first */
+        tabs[i]->context_list[18].order_key = XIDWRAP_AGE_COL;
+        tabs[i]->context_list[19].order_key = BUFCACHE_BUFFERS_COL;
+        tabs[i]->context_list[20].order_key = CHURN_NEW_COL;
+        tabs[i]->context_list[21].order_key = PGSS_AGG_TIME_COL;
+        tabs[i]->context_list[22].order_key = INDEXUSE_SIZE_KB_COL;
     }
 }
 
@@ -168,6 +200,41 @@ char *** free_array(char ***arr, unsigned int n_rows, unsigned int n_cols)
     return arr;
 }
 
+/*
+ ****************************************************************************
+ * Allocate memory for array of numbers, parallel to the stats array.
+ * Numbers of diffed columns are stored here, so they are parsed only once.
+ ****************************************************************************
+ */
+long long ** init_num_array(long long **arr, unsigned int n_rows, unsigned int n_cols)
+{
+    unsigned int i;
+
+    if ((arr = malloc(sizeof(long long *) * n_rows)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for numbers array failed.\n");
+    }
+    for (i = 0; i < n_rows; i++)
+        if ((arr[i] = calloc(n_cols, sizeof(long long))) == NULL) {
+            mreport(true, msg_fatal, "FATAL: malloc for rows numbers failed.\n");
+        }
+    return arr;
+}
+
+/*
+ ****************************************************************************
+ * Free space occupied by array of numbers.
+ ****************************************************************************
+ */
+long long ** free_num_array(long long **arr, unsigned int n_rows)
+{
+    unsigned int i;
+
+    for (i = 0; i < n_rows; i++)
+        free(arr[i]);
+    free(arr);
+    return NULL;
+}
+
 /*
  ****************************************************************************
  * Init output colors.
@@ -219,6 +286,7 @@ void print_usage(void)
   -U, --username=USERNAME   database user name (default: \"current user\")\n \
   -d, --dbname=DBNAME       database name (default: \"current user\")\n \
   -f, --file=FILENAME       conninfo file (default: \"~/.pgcenterrc\")\n \
+  -a, --alerts=FILENAME     alert rules file (default: \"~/.pgcenteralerts\")\n \
   -w, --no-password         never prompt for password\n \
   -W, --password            force password prompt (should happen automatically)\n\n");
     printf("Report bugs to %s.\n", PROGRAM_ISSUES_URL);
@@ -249,12 +317,13 @@ void arg_parse(int argc, char *argv[], struct args_s *args)
     int param, option_index;
 
     /* short options */
-    const char * short_options = "f:h:p:U:d:l:ieuwW?";
+    const char * short_options = "f:a:h:p:U:d:l:ieuwW?";
 
     /* long options */
     const struct option long_options[] = {
         {"help", no_argument, NULL, '?'},
         {"file", required_argument, NULL, 'f'},
+        {"alerts", required_argument, NULL, 'a'},
         {"host", required_argument, NULL, 'h'},
         {"port", required_argument, NULL, 'p'},
         {"dbname", required_argument, NULL, 'd'},
@@ -288,6 +357,9 @@ void arg_parse(int argc, char *argv[], struct args_s *args)
                 snprintf(args->connfile, sizeof(args->connfile), "%s", optarg);
                 args->count++;
                 break;
+            case 'a':
+                snprintf(args->alertfile, sizeof(args->alertfile), "%s", optarg);
+                break;
             case 'p':
                 snprintf(args->port, sizeof(args->port), "%s", optarg);
         		check_portnum(args->port);
@@ -531,195 +603,226 @@ void prepare_conninfo(struct tab_s * tabs[])
 /*
  ****************************************************************************
  * String comparison function for qsort (descending order).
- * The 'arg' here is the number of column in the array.
+ * Sort items hold the value of the order key column.
  ****************************************************************************
  */
-int str_cmp_desc(const void * a, const void * b, void * arg)
+int str_cmp_desc(const void * a, const void * b)
 {
-    int *key = (int *) arg;
-    const char *pa = ((const char ***) a)[0][*key];
-    const char *pb = ((const char ***) b)[0][*key];
-
-    return -strcmp(pa, pb);
+    return -strcmp(((const struct sort_item_s *) a)->skey, ((const struct sort_item_s *) b)->skey);
 }
 
 /*
  ****************************************************************************
  * String comparison function for qsort (ascending order).
- * The 'arg' here is the number of column in the array.
  ****************************************************************************
  */
-int str_cmp_asc(const void * a, const void * b, void * arg)
+int str_cmp_asc(const void * a, const void * b)
 {
-    int *key = (int *) arg;
-    const char *pa = ((const char ***) a)[0][*key];
-    const char *pb = ((const char ***) b)[0][*key];
-
-    return strcmp(pa, pb);
+    return strcmp(((const struct sort_item_s *) a)->skey, ((const struct sort_item_s *) b)->skey);
 }
 
 /*
  ****************************************************************************
  * Integer comparison function for qsort (descending order).
- * The 'arg' here is the number of column in the array.
+ * Sort items hold the number parsed from the order key column.
  ****************************************************************************
  */
-int int_cmp_desc(const void * a, const void * b, void * arg)
+int int_cmp_desc(const void * a, const void * b)
 {
-    int *key = (int *) arg;
-    const char *ia = ((const char ***) a)[0][*key];
-    const char *ib = ((const char ***) b)[0][*key];
+    long long ia = ((const struct sort_item_s *) a)->ikey;
+    long long ib = ((const struct sort_item_s *) b)->ikey;
 
-    return atoll(ib) - atoll(ia);
+    return (ib > ia) - (ib < ia);
 }
 
 /*
  ****************************************************************************
  * Integer comparison function for qsort (ascending order).
- * The 'arg' here is the number of column in the array.
  ****************************************************************************
  */
-int int_cmp_asc(const void * a, const void * b, void * arg)
+int int_cmp_asc(const void * a, const void * b)
 {
-    int *key = (int *) arg;
-    const char *ia = ((const char ***) a)[0][*key];
-    const char *ib = ((const char ***) b)[0][*key];
+    long long ia = ((const struct sort_item_s *) a)->ikey;
+    long long ib = ((const struct sort_item_s *) b)->ikey;
 
-    return atoll(ia) - atoll(ib);
+    return (ia > ib) - (ia < ib);
 }
 
 /*
  ****************************************************************************
  * Float comparison function for qsort (descending order).
- * The 'arg' here is the number of column in the array.
  ****************************************************************************
  */
-int fl_cmp_desc(const void * a, const void * b, void * arg)
+int fl_cmp_desc(const void * a, const void * b)
 {
-    int *key = (int *) arg;
-    const char *fa = ((const char ***) a)[0][*key];
-    const char *fb = ((const char ***) b)[0][*key];
+    double fa = ((const struct sort_item_s *) a)->fkey;
+    double fb = ((const struct sort_item_s *) b)->fkey;
 
-    return atof(fb) > atof(fa);
+    return (fb > fa) - (fb < fa);
 }
 
 /*
  ****************************************************************************
- * Float comparison function for qsort (descending order).
- * The 'arg' here is the number of column in the array.
+ * Float comparison function for qsort (ascending order).
  ****************************************************************************
  */
-int fl_cmp_asc(const void * a, const void * b, void * arg)
+int fl_cmp_asc(const void * a, const void * b)
 {
-    int *key = (int *) arg;
-    const char *fa = ((const char ***) a)[0][*key];
-    const char *fb = ((const char ***) b)[0][*key];
+    double fa = ((const struct sort_item_s *) a)->fkey;
+    double fb = ((const struct sort_item_s *) b)->fkey;
 
-    return atof(fb) < atof(fa);
+    return (fa > fb) - (fa < fb);
 }
 
 /*
  ****************************************************************************
- * Compare two arrays and build third array with deltas.
- * Take the 'p_res' with previous values and 'c_res' with current values,
- * compare them (x = current - previous) and put results into the third 
- * 'res_arr' array.
- * Comparing is based on range of allowed columns for comparison which has 
- * MIN and MAX values, so we don't compare values that are not in the range
- * (e.g. string values like a tables, indexes, queries, ...).
+ * Get range of columns which are diffed in the current context.
  ****************************************************************************
  */
-void diff_arrays(char ***p_arr, char ***c_arr, char ***res_arr, struct tab_s * tab,
-		unsigned int n_rows, unsigned int n_cols, unsigned long interval)
+void get_diff_range(struct tab_s * tab, unsigned int * min, unsigned int * max)
 {
-    unsigned int i, j, min = 0, max = 0;
-    unsigned int divisor;
- 
+    *min = *max = 0;
+
     switch (tab->current_context) {
         case pg_stat_database:
-            min = PG_STAT_DATABASE_DIFF_MIN;
+            *min = PG_STAT_DATABASE_DIFF_MIN;
             (atoi(tab->pg_special.pg_version_num) < PG92)
-                ? (max = PG_STAT_DATABASE_DIFF_MAX_91)
-                : (max = PG_STAT_DATABASE_DIFF_MAX_LT);
+                ? (*max = PG_STAT_DATABASE_DIFF_MAX_91)
+                : (*max = PG_STAT_DATABASE_DIFF_MAX_LT);
             break;
         case pg_stat_replication:
             /* diff nothing, use returned values as-is */
-            min = max = PG_STAT_REPLICATION_DIFF_MIN;
+            *min = *max = PG_STAT_REPLICATION_DIFF_MIN;
             break;
         case pg_stat_tables:
-            min = PG_STAT_TABLES_DIFF_MIN;
-            max = PG_STAT_TABLES_DIFF_MAX;
+            *min = PG_STAT_TABLES_DIFF_MIN;
+            *max = PG_STAT_TABLES_DIFF_MAX;
             break;
         case pg_stat_indexes:
-            min = PG_STAT_INDEXES_DIFF_MIN;
-            max = PG_STAT_INDEXES_DIFF_MAX;
+            *min = PG_STAT_INDEXES_DIFF_MIN;
+            *max = PG_STAT_INDEXES_DIFF_MAX;
             break;
         case pg_statio_tables:
-            min = PG_STATIO_TABLES_DIFF_MIN;
-            max = PG_STATIO_TABLES_DIFF_MAX;
+            *min = PG_STATIO_TABLES_DIFF_MIN;
+            *max = PG_STATIO_TABLES_DIFF_MAX;
             break;
         case pg_tables_size:
-            min = PG_TABLES_SIZE_DIFF_MIN;
-            max = PG_TABLES_SIZE_DIFF_MAX;
+            /* changes are calculated using cached sizes */
+            *min = *max = INVALID_ORDER_KEY;
             break;
         case pg_stat_activity_long:
             /* diff nothing, use returned values as-is */
-            min = max = INVALID_ORDER_KEY;
+            *min = *max = INVALID_ORDER_KEY;
             break;
         case pg_stat_functions:
             /* only one column for diff */
-            min = max = PG_STAT_FUNCTIONS_DIFF_MIN;
+            *min = *max = PG_STAT_FUNCTIONS_DIFF_MIN;
             break;
         case pg_stat_statements_timing:
             if (atoi(tab->pg_special.pg_version_num) < PG92) {
-                min = PGSS_TIMING_DIFF_MIN_91;
-                max = PGSS_TIMING_DIFF_MAX_91;
+                *min = PGSS_TIMING_DIFF_MIN_91;
+                *max = PGSS_TIMING_DIFF_MAX_91;
             } else {
-                min = PGSS_TIMING_DIFF_MIN_LT;
-                max = PGSS_TIMING_DIFF_MAX_LT;
+                *min = PGSS_TIMING_DIFF_MIN_LT;
+                *max = PGSS_TIMING_DIFF_MAX_LT;
             }
             break;
         case pg_stat_statements_general:
-            min = PGSS_GENERAL_DIFF_MIN_LT;
-            max = PGSS_GENERAL_DIFF_MAX_LT;
+            *min = PGSS_GENERAL_DIFF_MIN_LT;
+            *max = PGSS_GENERAL_DIFF_MAX_LT;
             break;
         case pg_stat_statements_io:
             if (atoi(tab->pg_special.pg_version_num) < PG92) {
-                min = PGSS_IO_DIFF_MIN_91;
-                max = PGSS_IO_DIFF_MAX_91;
+                *min = PGSS_IO_DIFF_MIN_91;
+                *max = PGSS_IO_DIFF_MAX_91;
             } else {
-                min = PGSS_IO_DIFF_MIN_LT;
-                max = PGSS_IO_DIFF_MAX_LT;
+                *min = PGSS_IO_DIFF_MIN_LT;
+                *max = PGSS_IO_DIFF_MAX_LT;
             }
             break;
         case pg_stat_statements_temp:
-            min = PGSS_TEMP_DIFF_MIN_LT;
-            max = PGSS_TEMP_DIFF_MAX_LT;
+            *min = PGSS_TEMP_DIFF_MIN_LT;
+            *max = PGSS_TEMP_DIFF_MAX_LT;
             break;
         case pg_stat_statements_local:
             if (atoi(tab->pg_special.pg_version_num) < PG92) {
-                min = PGSS_LOCAL_DIFF_MIN_91;
-                max = PGSS_LOCAL_DIFF_MAX_91;
+                *min = PGSS_LOCAL_DIFF_MIN_91;
+                *max = PGSS_LOCAL_DIFF_MAX_91;
             } else {
-                min = PGSS_LOCAL_DIFF_MIN_LT;
-                max = PGSS_LOCAL_DIFF_MAX_LT;
+                *min = PGSS_LOCAL_DIFF_MIN_LT;
+                *max = PGSS_LOCAL_DIFF_MAX_LT;
             }
             break;
         case pg_stat_progress_vacuum:
-            /* diff nothing, use returned values as-is */
-            min = max = INVALID_ORDER_KEY;
+            /* rates are calculated using commands history */
+            *min = *max = INVALID_ORDER_KEY;
+            break;
+        case pg_stat_proc:
+            /* rates are already calculated using per-process counters */
+            *min = *max = INVALID_ORDER_KEY;
+            break;
+        case pg_wait_profile:
+            /* profile is aggregated from samples on our side */
+            *min = *max = INVALID_ORDER_KEY;
+            break;
+        case pg_locks_tree:
+            /* tree is built from locks snapshot on our side */
+            *min = *max = INVALID_ORDER_KEY;
+            break;
+        case pg_tables_bloat:
+            /* rates are calculated using tables history */
+            *min = *max = INVALID_ORDER_KEY;
+            break;
+        case pg_xid_wraparound:
+            /* ages are projected using XID rate on our side */
+            *min = *max = INVALID_ORDER_KEY;
+            break;
+        case pg_buffercache:
+            /* buffers are aggregated on our side */
+            *min = *max = INVALID_ORDER_KEY;
+            break;
+        case pg_stat_connections:
+            /* rates are calculated using sessions history */
+            *min = *max = INVALID_ORDER_KEY;
+            break;
+        case pg_stat_statements_agg:
+            /* rates are calculated using statements deltas */
+            *min = *max = INVALID_ORDER_KEY;
+            break;
+        case pg_index_usage:
+            /* scans are accumulated using indexes history */
+            *min = *max = INVALID_ORDER_KEY;
             break;
         default:
             break;
     }
+}
+
+/*
+ ****************************************************************************
+ * Compare two arrays and build third array with deltas.
+ * Take the numbers of previous and current snapshots, compare them
+ * (x = current - previous) and put results into the third 'res_arr' array.
+ * Comparing is based on range of allowed columns for comparison which has
+ * MIN and MAX values, so we don't compare values that are not in the range
+ * (e.g. string values like a tables, indexes, queries, ...), such values
+ * are copied from the current snapshot as is.
+ ****************************************************************************
+ */
+void diff_arrays(long long **p_num, long long **c_num, char ***c_arr, char ***res_arr, struct tab_s * tab,
+		unsigned int n_rows, unsigned int n_cols, unsigned long interval)
+{
+    unsigned int i, j, min, max;
+    unsigned int divisor;
 
+    get_diff_range(tab, &min, &max);
     divisor = interval / 1000000;
     for (i = 0; i < n_rows; i++) {
         for (j = 0; j < n_cols; j++)
             if (j < min || j > max)
                 snprintf(res_arr[i][j], XXXL_BUF_LEN, "%s", c_arr[i][j]);     /* copy unsortable values as is */
             else {
-                snprintf(res_arr[i][j], XXXL_BUF_LEN, "%lli", (atoll(c_arr[i][j]) - atoll(p_arr[i][j])) / divisor);
+                snprintf(res_arr[i][j], XXXL_BUF_LEN, "%lli", (c_num[i][j] - p_num[i][j]) / divisor);
             }
     }
 }
@@ -733,7 +836,10 @@ void diff_arrays(char ***p_arr, char ***c_arr, char ***res_arr, struct tab_s * t
 void sort_array(char ***res_arr, unsigned int n_rows, struct tab_s * tab)
 {
     unsigned int i, order_key = 0;
-    bool desc = false;
+    bool desc = false, integers = true, numbers = true;
+    struct sort_item_s * items;
+    const char * value;
+    int (*cmp)(const void *, const void *);
 
     for (i = 0; i < TOTAL_CONTEXTS; i++)
         if (tab->current_context == tab->context_list[i].context) {
@@ -741,46 +847,109 @@ void sort_array(char ***res_arr, unsigned int n_rows, struct tab_s * tab)
             desc = tab->context_list[i].order_desc;
         }
 
-    /* don't sort arrays with invalid key */
-    if (order_key == INVALID_ORDER_KEY)
+    /* don't sort arrays with invalid key, keep order of the tree */
+    if (order_key == INVALID_ORDER_KEY || tab->current_context == pg_locks_tree)
         return;
 
-    /* 
-     * Comparator function depends on column data type. 
-     * So check first element of an array, is it a number, float or string. 
+    if ((items = malloc(sizeof(struct sort_item_s) * n_rows)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for sort items failed.\n");
+    }
+
+    /*
+     * Comparator function depends on column data type, so check all values
+     * of the column: are they numbers, floats or strings. Empty values are
+     * not yet known values of merged results, they don't define the type.
+     * Keys are parsed once per row, not on every comparison.
      */
-    if (check_string(&res_arr[0][order_key][0], is_number) == 0) {
-        (desc)
-            ? qsort_r(res_arr, n_rows, sizeof(char **), int_cmp_desc, &order_key)
-            : qsort_r(res_arr, n_rows, sizeof(char **), int_cmp_asc, &order_key);
-    } else if (check_string(&res_arr[0][order_key][0], is_float) == 0) {
-        (desc)
-            ? qsort_r(res_arr, n_rows, sizeof(char **), fl_cmp_desc, &order_key)
-            : qsort_r(res_arr, n_rows, sizeof(char **), fl_cmp_asc, &order_key);
+    for (i = 0; i < n_rows && numbers; i++) {
+        value = res_arr[i][order_key];
+        if (value[0] == '\0')
+            continue;
+        if (integers && check_string(value, is_number) != 0)
+            integers = false;
+        if (!integers && check_string(value, is_float) != 0)
+            numbers = false;
+    }
+
+    if (integers) {
+        for (i = 0; i < n_rows; i++)
+            items[i].ikey = atoll(res_arr[i][order_key]);
+        cmp = desc ? int_cmp_desc : int_cmp_asc;
+    } else if (numbers) {
+        for (i = 0; i < n_rows; i++)
+            items[i].fkey = atof(res_arr[i][order_key]);
+        cmp = desc ? fl_cmp_desc : fl_cmp_asc;
     } else {
-        (desc)
-            ? qsort_r(res_arr, n_rows, sizeof(char **), str_cmp_desc, &order_key)
-            : qsort_r(res_arr, n_rows, sizeof(char **), str_cmp_asc, &order_key);
+        for (i = 0; i < n_rows; i++)
+            items[i].skey = res_arr[i][order_key];
+        cmp = desc ? str_cmp_desc : str_cmp_asc;
     }
+
+    for (i = 0; i < n_rows; i++)
+        items[i].row = res_arr[i];
+    qsort(items, n_rows, sizeof(struct sort_item_s), cmp);
+    for (i = 0; i < n_rows; i++)
+        res_arr[i] = items[i].row;
+
+    free(items);
 }
 
 /*
  ****************************************************************************
- * Get query results returned by postgres and put it into an array.
+ * Get query results returned by postgres and put it into arrays. Values of
+ * diffed columns are stored only as numbers, other values only as text.
+ * Binary results are decoded, so numbers aren't printed and parsed again.
  ****************************************************************************
  */
-void pgrescpy(char ***arr, PGresult *res, unsigned int n_rows, unsigned int n_cols)
+void pgrescpy(char ***arr, long long **nums, PGresult *res, struct tab_s * tab,
+        unsigned int n_rows, unsigned int n_cols)
 {
-    unsigned int i, j;
+    unsigned int i, j, min, max;
+    bool binary;
+
+    get_diff_range(tab, &min, &max);
+    for (j = 0; j < n_cols; j++) {
+        binary = (PQfformat(res, j) == 1);
+        for (i = 0; i < n_rows; i++) {
+            if (j >= min && j <= max) {
+                if (binary)
+                    decode_value(res, i, j, arr[i][j], S_BUF_LEN, &nums[i][j]);
+                else
+                    nums[i][j] = atoll(PQgetvalue(res, i, j));
+                continue;
+            }
 
-    for (i = 0; i < n_rows; i++)
-        for (j = 0; j < n_cols; j++) {
             /* allocate a big room only for values in the last column */
-            if (j != n_cols - 1)
-              snprintf(arr[i][j], S_BUF_LEN, "%s", PQgetvalue(res, i, j));
+            if (binary)
+                decode_value(res, i, j, arr[i][j], (j != n_cols - 1) ? S_BUF_LEN : XL_BUF_LEN, &nums[i][j]);
+            else if (j != n_cols - 1)
+                snprintf(arr[i][j], S_BUF_LEN, "%s", PQgetvalue(res, i, j));
             else
-              snprintf(arr[i][j], XL_BUF_LEN, "%s", PQgetvalue(res, i, j));
+                snprintf(arr[i][j], XL_BUF_LEN, "%s", PQgetvalue(res, i, j));
         }
+    }
+}
+
+/*
+ ****************************************************************************
+ * Get format of the context query result. Binary result is requested only
+ * for contexts which are shown as they are returned and all columns can be
+ * decoded. Results which are completed on our side and new contexts are text.
+ ****************************************************************************
+ */
+int get_result_format(struct tab_s * tab)
+{
+    switch (tab->current_context) {
+        case pg_stat_database:
+        case pg_stat_tables:
+        case pg_stat_indexes:
+        case pg_statio_tables:
+        case pg_stat_activity_long:
+        case pg_stat_functions:
+            return PREPARED_AUTO_FORMAT;
+        default:
+            return 0;
+    }
 }
 
 /*
@@ -805,6 +974,7 @@ void print_loadavg(WINDOW * window, struct tab_s * tab, PGconn * conn)
     float * la;
     tab->conn_local ? (la = get_local_loadavg()) : (la = get_remote_loadavg(conn));
     wprintw(window, "load average: %.2f, %.2f, %.2f\n", la[0], la[1], la[2]);
+    tab->metrics[metric_load1] = la[0];
 }
 
 /*
@@ -830,6 +1000,9 @@ void print_cpu_usage(WINDOW * window, struct cpu_s *st_cpu[], struct tab_s * tab
     }
     itv = get_interval(uptime[!curr], uptime[curr]);
     write_cpu_stat_raw(window, st_cpu, curr, itv);
+    tab->metrics[metric_cpu] = (st_cpu[curr]->cpu_idle < st_cpu[!curr]->cpu_idle) ?
+        100.0 : 100.0 - ll_sp_value(st_cpu[!curr]->cpu_idle, st_cpu[curr]->cpu_idle, itv);
+    tab->metrics[metric_iowait] = ll_sp_value(st_cpu[!curr]->cpu_iowait, st_cpu[curr]->cpu_iowait, itv);
     itv = get_interval(uptime0[!curr], uptime0[curr]);
     curr ^= 1;
 }
@@ -847,6 +1020,8 @@ void print_mem_usage(WINDOW * window, struct mem_s *st_mem_short, struct tab_s *
         read_remote_mem_stat(st_mem_short, conn);
     
     write_mem_stat(window, st_mem_short);
+    if (st_mem_short->mem_total > 0)
+        tab->metrics[metric_mem] = 100.0 * st_mem_short->mem_used / st_mem_short->mem_total;
 }
 
 /*
@@ -901,9 +1076,20 @@ void print_vacuum_info(WINDOW * window, struct tab_s * tab, PGconn * conn)
  * pg_stat_activity and print it to the pgstat area.
  ****************************************************************************
  */
-void print_pgss_info(WINDOW * window, PGconn * conn, unsigned long interval)
+void print_pgss_info(WINDOW * window, struct tab_s * tab, PGconn * conn)
+{
+    get_pgss_summary(window, tab, conn);
+}
+
+/*
+ ****************************************************************************
+ * Get WAL generation rate and checkpoints pressure and print it to the
+ * pgstat area.
+ ****************************************************************************
+ */
+void print_wal_info(WINDOW * window, struct tab_s * tab, PGconn * conn)
 {
-    get_pgss_summary(window, conn, interval);
+    get_summary_wal_activity(window, tab, conn);
 }
 
 /*
@@ -979,7 +1165,11 @@ void print_data(WINDOW *window, PGresult *res, char ***arr, unsigned int n_rows,
                 columns[x].width = COLS - winsz_x;
                 arr[i][j][columns[x].width] = '\0';
             }
-            if (print)
+            if (print && alert_marked(tab, i, j)) {
+                wattron(window, A_BOLD | A_REVERSE);
+                wprintw(window, "%-*s", columns[x].width, arr[i][j]);
+                wattroff(window, A_BOLD | A_REVERSE);
+            } else if (print)
                 wprintw(window, "%-*s", columns[x].width, arr[i][j]);
         }
     }
@@ -1007,6 +1197,7 @@ void print_iostat(WINDOW * window, WINDOW * w_cmd, struct tab_s * tab, PGconn *
     static unsigned long long uptime0[2] = {0, 0};
     static unsigned long long itv;
     static unsigned int curr = 1;
+    int i;
 
     /* reset uptime when tabs switched */
     if (tab->tab != tab_save) {
@@ -1024,7 +1215,11 @@ void print_iostat(WINDOW * window, WINDOW * w_cmd, struct tab_s * tab, PGconn *
     }
 
     itv = get_interval(uptime0[!curr], uptime0[curr]);
-    write_iostat(window, tab->curr_iostat, tab->prev_iostat, tab->sys_special.bdev, itv, tab->sys_special.sys_hz);
+    write_iostat(window, tab->curr_iostat, tab->prev_iostat, tab->sys_special.bdev, itv,
+            tab->sys_special.sys_hz, tab->iostat_min_util);
+    for (i = 0; i < tab->sys_special.bdev; i++)
+        if (isnan(tab->metrics[metric_disk_util]) || tab->curr_iostat[i]->util / 10.0 > tab->metrics[metric_disk_util])
+            tab->metrics[metric_disk_util] = tab->curr_iostat[i]->util / 10.0;
 
     /* save current stats snapshot */
     replace_iostat(tab->curr_iostat, tab->prev_iostat, tab->sys_special.bdev);
@@ -1106,6 +1301,7 @@ int main(int argc, char *argv[])
     struct tab_s *tabs[MAX_TABS];               /* array of tabs */
     struct cpu_s *st_cpu[2];                            /* cpu usage struct */
     struct mem_s *st_mem_short;                         /* mem usage struct */
+    struct alerts_s *alerts;                            /* alert rules */
 
     WINDOW *w_sys, *w_cmd, *w_dba, *w_sub;              /* ncurses windows  */
     int ch;                                    		/* store key press  */
@@ -1128,6 +1324,8 @@ int main(int argc, char *argv[])
     char ***p_arr = NULL,
          ***c_arr = NULL,
          ***r_arr = NULL;                               /* 3d arrays for query results  */
+    long long **p_num = NULL,
+              **c_num = NULL;                           /* numbers of diffed columns    */
 
     unsigned int long long ws_color, wc_color, wa_color, wl_color;/* colors for text zones */
 
@@ -1164,6 +1362,9 @@ int main(int argc, char *argv[])
             create_initial_conn(args, tabs);
     }
 
+    /* load alert rules, mistakes in them are reported before ncurses init */
+    alerts = load_alerts(args);
+
     /* open connections to postgres */
     prepare_conninfo(tabs);
     open_connections(tabs, conns);
@@ -1180,9 +1381,9 @@ int main(int argc, char *argv[])
     keypad(stdscr,TRUE);
     set_escdelay(100);                 /* milliseconds to wait after escape */
 
-    w_sys = newwin(5, 0, 0, 0);
-    w_cmd = newwin(1, 0, 4, 0);
-    w_dba = newwin(0, 0, 5, 0);
+    w_sys = newwin(6, 0, 0, 0);
+    w_cmd = newwin(1, 0, 5, 0);
+    w_dba = newwin(0, 0, 6, 0);
     w_sub = NULL;
 
     init_colors(&ws_color, &wc_color, &wa_color, &wl_color);
@@ -1237,6 +1438,14 @@ int main(int argc, char *argv[])
                         subtab_process(w_cmd, &w_sub, tabs[tab_index], conns[tab_index], SUBTAB_NONE);
                     subtab_process(w_cmd, &w_sub, tabs[tab_index], conns[tab_index], SUBTAB_IOSTAT);
                     break;
+                case 'b':               /* iostat devices sorting and filtering by %util */
+                    set_iostat_min_util(w_cmd, tabs[tab_index]);
+                    break;
+                case 'e':               /* log stats subtab on/off */
+                    if (tabs[tab_index]->subtab != SUBTAB_LOGSTAT)
+                        subtab_process(w_cmd, &w_sub, tabs[tab_index], conns[tab_index], SUBTAB_NONE);
+                    subtab_process(w_cmd, &w_sub, tabs[tab_index], conns[tab_index], SUBTAB_LOGSTAT);
+                    break;
                 case 'I':               /* nicstat subtab on/off */
                     if (tabs[tab_index]->subtab != SUBTAB_NICSTAT)
                         subtab_process(w_cmd, &w_sub, tabs[tab_index], conns[tab_index], SUBTAB_NONE);
@@ -1281,6 +1490,9 @@ int main(int argc, char *argv[])
                     change_sort_order_direction(tabs[tab_index], &first_iter);
                     PQclear(p_res);
                     break;
+                case 'o':               /* sort pg_stat_statements by trend growth */
+                    sort_by_growth(w_cmd, tabs[tab_index], p_res, &first_iter);
+                    break;
                 case 'p':               /* start psql session to current postgres */
                     start_psql(w_cmd, tabs[tab_index]);
                     break;
@@ -1317,6 +1529,42 @@ int main(int argc, char *argv[])
                 case 'v':               /* show pg_stat_activity tab */
                     switch_context(w_cmd, tabs[tab_index], pg_stat_progress_vacuum, p_res, &first_iter);
                     break;
+                case 'P':               /* show per-process OS stats tab */
+                    switch_context(w_cmd, tabs[tab_index], pg_stat_proc, p_res, &first_iter);
+                    break;
+                case 'w':               /* show wait events profile tab */
+                    switch_context(w_cmd, tabs[tab_index], pg_wait_profile, p_res, &first_iter);
+                    break;
+                case 'c':               /* discover cascading standbys */
+                    cascade_toggle(w_cmd, tabs[tab_index]);
+                    break;
+                case 'k':               /* show locks blocking tree tab */
+                    switch_context(w_cmd, tabs[tab_index], pg_locks_tree, p_res, &first_iter);
+                    break;
+                case 'D':               /* show dead tuples and bloat estimation tab */
+                    switch_context(w_cmd, tabs[tab_index], pg_tables_bloat, p_res, &first_iter);
+                    break;
+                case 'O':               /* show transaction ID wraparound risk tab */
+                    switch_context(w_cmd, tabs[tab_index], pg_xid_wraparound, p_res, &first_iter);
+                    break;
+                case 'u':               /* show shared buffers usage tab */
+                    switch_context(w_cmd, tabs[tab_index], pg_buffercache, p_res, &first_iter);
+                    break;
+                case 'n':               /* show connections churn tab */
+                    switch_context(w_cmd, tabs[tab_index], pg_stat_connections, p_res, &first_iter);
+                    break;
+                case 'j':               /* show index usage efficiency tab */
+                    switch_context(w_cmd, tabs[tab_index], pg_index_usage, p_res, &first_iter);
+                    break;
+                case 'g':               /* change grouping of pg_stat_statements aggregates */
+                    pgss_grouping_switch(w_cmd, tabs[tab_index], p_res, &first_iter);
+                    break;
+                case 'y':               /* show header metric history graph */
+                    graph_menu(w_cmd, w_dba, tabs[tab_index], p_res, &first_iter);
+                    break;
+                case 'Y':               /* change resolution of graph */
+                    graph_zoom(w_cmd, tabs[tab_index]);
+                    break;
                 case 'A':               /* change duration threshold in pg_stat_activity wcreen */
                     change_min_age(w_cmd, tabs[tab_index], p_res, &first_iter);
                     break;
@@ -1363,6 +1611,7 @@ int main(int argc, char *argv[])
              * Sysstat tab.
              */
             wclear(w_sys);
+            reset_metrics(tabs[tab_index]);
             print_title(w_sys);
             print_loadavg(w_sys, tabs[tab_index], conns[tab_index]);
             print_cpu_usage(w_sys, st_cpu, tabs[tab_index], conns[tab_index]);
@@ -1371,14 +1620,16 @@ int main(int argc, char *argv[])
             print_pg_general(w_sys, tabs[tab_index], conns[tab_index]);
             print_postgres_activity(w_sys, tabs[tab_index], conns[tab_index]);
             print_vacuum_info(w_sys, tabs[tab_index], conns[tab_index]);
-            print_pgss_info(w_sys, conns[tab_index], interval);
+            print_pgss_info(w_sys, tabs[tab_index], conns[tab_index]);
+            print_wal_info(w_sys, tabs[tab_index], conns[tab_index]);
             wrefresh(w_sys);
 
             /* 
              * Database tab. 
              */
             prepare_query(tabs[tab_index], query);
-            if ((c_res = do_query(conns[tab_index], query, errmsg)) == NULL) {
+            if ((c_res = do_prepared_query(conns[tab_index], query,
+                            get_result_format(tabs[tab_index]), errmsg)) == NULL) {
                 /* if error occured print SQL error message into cmd */
                 PQclear(c_res);
                 c_res = NULL;
@@ -1390,6 +1641,45 @@ int main(int argc, char *argv[])
                 sleep(1);
                 continue;
             }
+            /* replace tables list with cached sizes */
+            if (tabs[tab_index]->current_context == pg_tables_size)
+                c_res = merge_rel_sizes(conns[tab_index], c_res, tabs[tab_index]);
+            /* replace indexes stats with accumulated usage and duplicates */
+            if (tabs[tab_index]->current_context == pg_index_usage)
+                c_res = merge_index_usage(conns[tab_index], c_res, tabs[tab_index]);
+            /* replace tables stats with dead tuples growth and bloat estimation */
+            if (tabs[tab_index]->current_context == pg_tables_bloat)
+                c_res = merge_bloat_stats(conns[tab_index], c_res, tabs[tab_index]);
+            /* add progress rates and ETA of commands into result */
+            if (tabs[tab_index]->current_context == pg_stat_progress_vacuum)
+                c_res = merge_progress_stats(conns[tab_index], c_res, tabs[tab_index]);
+            /* replace sessions list with connections churn */
+            if (tabs[tab_index]->current_context == pg_stat_connections)
+                c_res = merge_conn_churn(conns[tab_index], c_res, tabs[tab_index]);
+            /* replace statements snapshot with aggregates by database and user */
+            if (tabs[tab_index]->current_context == pg_stat_statements_agg)
+                c_res = merge_pgss_groups(conns[tab_index], c_res, tabs[tab_index]);
+            /* replace context result with shared buffers residency */
+            if (tabs[tab_index]->current_context == pg_buffercache)
+                c_res = merge_buffercache(conns[tab_index], c_res, tabs[tab_index]);
+            /* replace databases ages with wraparound risk of databases and tables */
+            if (tabs[tab_index]->current_context == pg_xid_wraparound)
+                c_res = merge_xid_wraparound(conns[tab_index], c_res, tabs[tab_index]);
+            /* add standbys rates and catch-up time into result */
+            if (tabs[tab_index]->current_context == pg_stat_replication)
+                c_res = merge_repl_stats(conns[tab_index], c_res, tabs[tab_index]);
+            /* add OS-level stats of backends into result */
+            if (tabs[tab_index]->current_context == pg_stat_proc)
+                c_res = merge_proc_stats(conns[tab_index], c_res, tabs[tab_index]);
+            /* add pg_stat_statements query texts from cache */
+            if (pgss_context(tabs[tab_index]->current_context))
+                c_res = merge_pgss_texts(conns[tab_index], c_res, tabs[tab_index]);
+            /* replace wait events sample with aggregated profile */
+            if (tabs[tab_index]->current_context == pg_wait_profile)
+                c_res = merge_wait_profile(conns[tab_index], c_res, tabs[tab_index]);
+            /* replace locks snapshot with blocking tree */
+            if (tabs[tab_index]->current_context == pg_locks_tree)
+                c_res = merge_lock_tree(conns[tab_index], c_res);
             n_rows = PQntuples(c_res);
             n_cols = PQnfields(c_res);
 
@@ -1423,19 +1713,23 @@ int main(int argc, char *argv[])
             p_arr = init_array(p_arr, n_rows, n_cols);
             c_arr = init_array(c_arr, n_rows, n_cols);
             r_arr = init_array(r_arr, n_rows, n_cols);
+            p_num = init_num_array(p_num, n_rows, n_cols);
+            c_num = init_num_array(c_num, n_rows, n_cols);
 
             /* copy whole query results (current, previous) into arrays */
-            pgrescpy(p_arr, p_res, n_rows, n_cols);
-            pgrescpy(c_arr, c_res, n_rows, n_cols);
+            pgrescpy(p_arr, p_num, p_res, tabs[tab_index], n_rows, n_cols);
+            pgrescpy(c_arr, c_num, c_res, tabs[tab_index], n_rows, n_cols);
 
             /* diff current and previous arrays and build result array */
-            diff_arrays(p_arr, c_arr, r_arr, tabs[tab_index], n_rows, n_cols, interval);
+            diff_arrays(p_num, c_num, c_arr, r_arr, tabs[tab_index], n_rows, n_cols, interval);
 
             /* sort result array using order key */
             sort_array(r_arr, n_rows, tabs[tab_index]);
 
-            /* print sorted result array */
-            print_data(w_dba, c_res, r_arr, n_rows, n_cols, tabs[tab_index]);
+            /* mark cells offending alert rules, then print sorted result array */
+            mark_alerts(alerts, tabs[tab_index], c_res, r_arr, n_rows, n_cols);
+            if (!tabs[tab_index]->graph)
+                print_data(w_dba, c_res, r_arr, n_rows, n_cols, tabs[tab_index]);
 
             /* replace previous database query result with current result */
             PQclear(p_res);
@@ -1447,6 +1741,8 @@ int main(int argc, char *argv[])
             free_array(p_arr, n_rows, n_cols);
             free_array(c_arr, n_rows, n_cols);
             free_array(r_arr, n_rows, n_cols);
+            free_num_array(p_num, n_rows);
+            free_num_array(c_num, n_rows);
 
             wrefresh(w_cmd);
             wclear(w_cmd);
@@ -1458,6 +1754,9 @@ int main(int argc, char *argv[])
                 case SUBTAB_LOGTAIL:
                     print_log(w_sub, w_cmd, tabs[tab_index], conns[tab_index]);
                     break;
+                case SUBTAB_LOGSTAT:
+                    print_logstat(w_sub, w_cmd, tabs[tab_index], conns[tab_index]);
+                    break;
                 case SUBTAB_IOSTAT:
                     print_iostat(w_sub, w_cmd, tabs[tab_index], conns[tab_index], &repaint);
                     if (repaint == true) {
@@ -1484,12 +1783,22 @@ int main(int argc, char *argv[])
                     break;
             }
 
+            /* header alerts and history, disks utilization is known after iostat */
+            check_header_alerts(w_cmd, alerts, tabs[tab_index]);
+            record_history(tabs[tab_index]);
+            if (tabs[tab_index]->graph)
+                print_graph(w_dba, tabs[tab_index]);
+
             /* sleep loop */
             for (sleep_usec = 0; sleep_usec < interval; sleep_usec += INTERVAL_STEP) {
                 if (key_is_pressed())
                     break;
                 else {
-                    usleep(INTERVAL_STEP);
+                    /* wait events profile is sampled instead of sleeping */
+                    if (tabs[tab_index]->current_context == pg_wait_profile)
+                        sample_wait_events(conns[tab_index], tabs[tab_index], INTERVAL_STEP);
+                    else
+                        usleep(INTERVAL_STEP);
                     if (interval > DEFAULT_INTERVAL && sleep_usec == DEFAULT_INTERVAL) {
                         wrefresh(w_cmd);
                         wclear(w_cmd);
@@ -78,6 +78,23 @@ void close_connections(struct tab_s * tabs[], PGconn * conns[])
             PQfinish(conns[i]);
 }
 
+/* statements prepared per connection, see exec_prepared() */
+static struct prepared_s prepared[MAX_TABS];
+
+/*
+ ****************************************************************************
+ * Format error message of the failed query.
+ ****************************************************************************
+ */
+void query_error(PGresult * res, char errmsg[])
+{
+    snprintf(errmsg, ERRSIZE, "%s: %s\nDETAIL: %s\nHINT: %s",
+            PQresultErrorField(res, PG_DIAG_SEVERITY),
+            PQresultErrorField(res, PG_DIAG_MESSAGE_PRIMARY),
+            PQresultErrorField(res, PG_DIAG_MESSAGE_DETAIL),
+            PQresultErrorField(res, PG_DIAG_MESSAGE_HINT));
+}
+
 /*
  ****************************************************************************
  * Send query to postgres and return query result or error message.
@@ -93,17 +110,336 @@ PGresult * do_query(PGconn * conn, const char * query, char errmsg[])
             return res;
             break;
         default:
-	    snprintf(errmsg, ERRSIZE, "%s: %s\nDETAIL: %s\nHINT: %s",
-			PQresultErrorField(res, PG_DIAG_SEVERITY),
-			PQresultErrorField(res, PG_DIAG_MESSAGE_PRIMARY),
-			PQresultErrorField(res, PG_DIAG_MESSAGE_DETAIL),
-			PQresultErrorField(res, PG_DIAG_MESSAGE_HINT));
+            query_error(res, errmsg);
+            PQclear(res);
+            return NULL;
+            break;
+    }
+}
+
+/*
+ ****************************************************************************
+ * Clear list of prepared statements.
+ ****************************************************************************
+ */
+void forget_prepared(struct prepared_s * p)
+{
+    unsigned int i;
+
+    for (i = 0; i < p->count; i++)
+        free(p->texts[i]);
+    p->count = 0;
+}
+
+/*
+ ****************************************************************************
+ * Get list of statements prepared in the connection. Statements are lost
+ * when connection is reset or a new connection gets the same address, in
+ * both cases the session is changed, so the list is cleared.
+ ****************************************************************************
+ */
+struct prepared_s * get_prepared(PGconn * conn)
+{
+    static unsigned int next = 0;
+    struct prepared_s * p = NULL;
+    unsigned int i;
+
+    for (i = 0; i < MAX_TABS; i++)
+        if (prepared[i].conn == conn) {
+            p = &prepared[i];
+            break;
+        }
+
+    /* take unused item, or reuse items in turn */
+    if (p == NULL) {
+        for (i = 0; i < MAX_TABS; i++)
+            if (prepared[i].conn == NULL) {
+                p = &prepared[i];
+                break;
+            }
+        if (p == NULL) {
+            p = &prepared[next];
+            next = (next + 1) % MAX_TABS;
+        }
+        forget_prepared(p);
+        p->conn = conn;
+        p->backend_pid = 0;
+    }
+
+    if (p->backend_pid != PQbackendPID(conn)) {
+        p->backend_pid = PQbackendPID(conn);
+        forget_prepared(p);
+        p->seq = 0;
+    }
+
+    return p;
+}
+
+/*
+ ****************************************************************************
+ * Execute query as prepared statement. Statement is prepared at the first
+ * execution in the session and is found by its text, thus any change of the
+ * text (e.g. other version or options) gives new statement. Statements are
+ * named with numbers which aren't reused in the session, so a name never
+ * refers to other text. If statement has gone (e.g. after DISCARD), it's
+ * prepared again. With PREPARED_AUTO_FORMAT result is binary when all its
+ * columns can be decoded, column types are checked once when statement is
+ * prepared. Result or error is returned as is, as from PQexecParams().
+ ****************************************************************************
+ */
+PGresult * exec_prepared(PGconn * conn, const char * query, int n_params, const char * const * params, int format)
+{
+    struct prepared_s * p = get_prepared(conn);
+    PGresult * res = NULL;
+    const char * sqlstate;
+    char name[S_BUF_LEN];
+    unsigned int hash = hash_text(query, strlen(query)), i, attempt;
+    int j;
+
+    for (attempt = 0; attempt < 2; attempt++) {
+        for (i = 0; i < p->count; i++)
+            if (p->hashes[i] == hash && strcmp(p->texts[i], query) == 0)
+                break;
+
+        if (i == p->count) {
+            /* too many statements, e.g. activity age is changed too often */
+            if (p->count == PREPARED_MAX) {
+                PQclear(PQexec(conn, "DEALLOCATE ALL"));
+                forget_prepared(p);
+                i = 0;
+            }
+            p->ids[i] = p->seq++;
+            snprintf(name, sizeof(name), "pgcenter_%u", p->ids[i]);
+            res = PQprepare(conn, name, query, n_params, NULL);
+            if (PQresultStatus(res) != PG_CMD_OK)
+                return res;
+            PQclear(res);
+
+            p->binary[i] = false;
+            if (format == PREPARED_AUTO_FORMAT) {
+                res = PQdescribePrepared(conn, name);
+                if (PQresultStatus(res) == PG_CMD_OK && PQnfields(res) > 0) {
+                    for (j = 0; j < PQnfields(res) && decodable_type(PQftype(res, j)); j++)
+                        ;
+                    p->binary[i] = (j == PQnfields(res));
+                }
+                PQclear(res);
+            }
+            if ((p->texts[i] = strdup(query)) == NULL) {
+                mreport(true, msg_fatal, "FATAL: strdup for prepared statement failed.\n");
+            }
+            p->hashes[i] = hash;
+            p->count++;
+        } else {
+            snprintf(name, sizeof(name), "pgcenter_%u", p->ids[i]);
+        }
+
+        res = PQexecPrepared(conn, name, n_params, params, NULL, NULL,
+                (format == PREPARED_AUTO_FORMAT) ? p->binary[i] : format);
+        sqlstate = PQresultErrorField(res, PG_DIAG_SQLSTATE);
+        if (sqlstate == NULL || strcmp(sqlstate, "26000") || attempt > 0)
+            break;
+
+        /* statement doesn't exist, forget all and prepare it again */
+        PQclear(res);
+        res = NULL;
+        forget_prepared(p);
+    }
+
+    return res;
+}
+
+/*
+ ****************************************************************************
+ * Send recurring query as prepared statement, so it isn't parsed and
+ * planned on every refresh. Return query result or error message.
+ ****************************************************************************
+ */
+PGresult * do_prepared_query(PGconn * conn, const char * query, int format, char errmsg[])
+{
+    PGresult    *res;
+
+    res = exec_prepared(conn, query, 0, NULL, format);
+    switch (PQresultStatus(res)) {
+        case PG_CMD_OK: case PG_TUP_OK:
+            return res;
+            break;
+        default:
+            query_error(res, errmsg);
             PQclear(res);
             return NULL;
             break;
     }
 }
 
+/*
+ ****************************************************************************
+ * Check that values of the type can be decoded from binary format.
+ ****************************************************************************
+ */
+bool decodable_type(Oid type)
+{
+    switch (type) {
+        case BOOLOID: case CHAROID: case NAMEOID: case TEXTOID: case BPCHAROID: case VARCHAROID:
+        case INT2OID: case INT4OID: case INT8OID: case OIDOID:
+        case FLOAT4OID: case FLOAT8OID: case NUMERICOID:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ ****************************************************************************
+ * Check that the type is a number.
+ ****************************************************************************
+ */
+bool numeric_type(Oid type)
+{
+    switch (type) {
+        case INT2OID: case INT4OID: case INT8OID: case OIDOID:
+        case FLOAT4OID: case FLOAT8OID: case NUMERICOID:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ ****************************************************************************
+ * Decode numeric from binary format: number of base 10000 digits, weight of
+ * the first digit, sign, display scale and digits. Text is the same as
+ * postgres output, number is its integer part, infinities are limits of
+ * long long. Return length of text.
+ ****************************************************************************
+ */
+size_t decode_numeric(const unsigned char * val, int len, char * buf, size_t buf_len, long long * num)
+{
+    int ndigits, weight, sign, dscale, d, i;
+    size_t o = 0;
+    char digit[8];
+    long long value = 0;
+
+    if (len < 8)
+        return (buf[0] = '\0');
+
+    ndigits = (short) ((val[0] << 8) | val[1]);
+    weight = (short) ((val[2] << 8) | val[3]);
+    sign = (val[4] << 8) | val[5];
+    dscale = (val[6] << 8) | val[7];
+    if (ndigits < 0 || len < 8 + ndigits * 2)
+        return (buf[0] = '\0');
+
+    switch (sign) {
+        case 0xC000:
+            *num = 0;
+            return snprintf(buf, buf_len, "NaN");
+        case 0xD000:
+            *num = LLONG_MAX;
+            return snprintf(buf, buf_len, "Infinity");
+        case 0xF000:
+            *num = LLONG_MIN;
+            return snprintf(buf, buf_len, "-Infinity");
+    }
+    if (sign == 0x4000 && o + 1 < buf_len)
+        buf[o++] = '-';
+
+    /* integer part, the first digit is printed without leading zeroes */
+    if (weight < 0 && o + 1 < buf_len)
+        buf[o++] = '0';
+    for (i = 0; i <= weight; i++) {
+        d = (i < ndigits) ? (val[8 + i * 2] << 8) | val[9 + i * 2] : 0;
+        value = value * 10000 + d;
+        snprintf(digit, sizeof(digit), (i == 0) ? "%d" : "%04d", d);
+        if (o + strlen(digit) < buf_len) {
+            memcpy(buf + o, digit, strlen(digit));
+            o += strlen(digit);
+        }
+    }
+
+    /* fractional part is cut by display scale */
+    if (dscale > 0 && o + 1 < buf_len)
+        buf[o++] = '.';
+    for (i = weight + 1; dscale > 0; i++) {
+        d = (i >= 0 && i < ndigits) ? (val[8 + i * 2] << 8) | val[9 + i * 2] : 0;
+        snprintf(digit, sizeof(digit), "%04d", d);
+        digit[min(dscale, 4)] = '\0';
+        dscale -= 4;
+        if (o + strlen(digit) < buf_len) {
+            memcpy(buf + o, digit, strlen(digit));
+            o += strlen(digit);
+        }
+    }
+    buf[o] = '\0';
+
+    *num = (sign == 0x4000) ? -value : value;
+    return o;
+}
+
+/*
+ ****************************************************************************
+ * Decode value of the binary result into text and number (if the value is
+ * a number). Text is the same as in text result, except floats which are
+ * printed with 15 significant digits. NULL gives empty text and zero.
+ * Return length of text.
+ ****************************************************************************
+ */
+size_t decode_value(PGresult * res, int row, int col, char * buf, size_t buf_len, long long * num)
+{
+    const unsigned char * val = (const unsigned char *) PQgetvalue(res, row, col);
+    int len = PQgetlength(res, row, col), i;
+    unsigned long long u = 0;
+    union { unsigned int i; float f; } f4;
+    union { unsigned long long i; double f; } f8;
+
+    *num = 0;
+    if (PQgetisnull(res, row, col))
+        return (buf[0] = '\0');
+
+    switch (PQftype(res, col)) {
+        case INT2OID: case INT4OID: case INT8OID: case OIDOID: case FLOAT4OID: case FLOAT8OID:
+            /* fixed size numbers are in network byte order */
+            for (i = 0; i < len; i++)
+                u = (u << 8) | val[i];
+            break;
+        default:
+            break;
+    }
+
+    switch (PQftype(res, col)) {
+        case INT2OID:
+            *num = (short) u;
+            return snprintf(buf, buf_len, "%lld", *num);
+        case INT4OID:
+            *num = (int) u;
+            return snprintf(buf, buf_len, "%lld", *num);
+        case INT8OID:
+            *num = (long long) u;
+            return snprintf(buf, buf_len, "%lld", *num);
+        case OIDOID:
+            *num = (unsigned int) u;
+            return snprintf(buf, buf_len, "%lld", *num);
+        case FLOAT4OID:
+            f4.i = (unsigned int) u;
+            *num = (long long) f4.f;
+            return snprintf(buf, buf_len, "%.6g", f4.f);
+        case FLOAT8OID:
+            f8.i = u;
+            *num = (long long) f8.f;
+            return snprintf(buf, buf_len, "%.15g", f8.f);
+        case NUMERICOID:
+            return decode_numeric(val, len, buf, buf_len, num);
+        case BOOLOID:
+            return snprintf(buf, buf_len, "%s", (len > 0 && val[0]) ? "t" : "f");
+        default:
+            /* text types are the same in both formats */
+            len = min((size_t) len, buf_len - 1);
+            memcpy(buf, val, len);
+            buf[len] = '\0';
+            return len;
+    }
+}
+
 /*
  ****************************************************************************
  * Get GUC value from postgres config.
@@ -235,6 +571,11 @@ void reconnect_if_failed(WINDOW * window, PGconn * conns[], struct tab_s * tabs[
 void prepare_query(struct tab_s * tab, char * query)
 {
     char wal_function[S_BUF_LEN];
+    const char * pgss_query_p2;
+
+    /* since 9.4 pg_stat_statements has native queryid, texts are cached */
+    pgss_query_p2 = (atoi(tab->pg_special.pg_version_num) < PG94)
+        ? PG_STAT_STATEMENTS_MD5_QUERY_P2 : PG_STAT_STATEMENTS_QUERY_P2;
 
     switch (tab->current_context) {
         case pg_stat_database: default:
@@ -342,29 +683,81 @@ void prepare_query(struct tab_s * tab, char * query)
             break;
         case pg_stat_statements_timing:
     	    atoi(tab->pg_special.pg_version_num) < PG92
-                ? snprintf(query, QUERY_MAXLEN, "%s", PG_STAT_STATEMENTS_TIMING_91_QUERY_P1)
-                : snprintf(query, QUERY_MAXLEN, "%s", PG_STAT_STATEMENTS_TIMING_QUERY_P1);
+                ? snprintf(query, QUERY_MAXLEN, "%s%s", PG_STAT_STATEMENTS_TIMING_91_QUERY_P1, pgss_query_p2)
+                : snprintf(query, QUERY_MAXLEN, "%s%s", PG_STAT_STATEMENTS_TIMING_QUERY_P1, pgss_query_p2);
             break;
         case pg_stat_statements_general:
             atoi(tab->pg_special.pg_version_num) < PG92
-                ? snprintf(query, QUERY_MAXLEN, "%s", PG_STAT_STATEMENTS_GENERAL_91_QUERY_P1)
-                : snprintf(query, QUERY_MAXLEN, "%s", PG_STAT_STATEMENTS_GENERAL_QUERY_P1);
+                ? snprintf(query, QUERY_MAXLEN, "%s%s", PG_STAT_STATEMENTS_GENERAL_91_QUERY_P1, pgss_query_p2)
+                : snprintf(query, QUERY_MAXLEN, "%s%s", PG_STAT_STATEMENTS_GENERAL_QUERY_P1, pgss_query_p2);
             break;
         case pg_stat_statements_io:
             atoi(tab->pg_special.pg_version_num) < PG92
-                ? snprintf(query, QUERY_MAXLEN, "%s", PG_STAT_STATEMENTS_IO_91_QUERY_P1)
-                : snprintf(query, QUERY_MAXLEN, "%s", PG_STAT_STATEMENTS_IO_QUERY_P1);
+                ? snprintf(query, QUERY_MAXLEN, "%s%s", PG_STAT_STATEMENTS_IO_91_QUERY_P1, pgss_query_p2)
+                : snprintf(query, QUERY_MAXLEN, "%s%s", PG_STAT_STATEMENTS_IO_QUERY_P1, pgss_query_p2);
             break;
         case pg_stat_statements_temp:
-            snprintf(query, QUERY_MAXLEN, "%s", PG_STAT_STATEMENTS_TEMP_QUERY_P1);
+            snprintf(query, QUERY_MAXLEN, "%s%s", PG_STAT_STATEMENTS_TEMP_QUERY_P1, pgss_query_p2);
             break;
         case pg_stat_statements_local:
             atoi(tab->pg_special.pg_version_num) < PG92
-                ? snprintf(query, QUERY_MAXLEN, "%s", PG_STAT_STATEMENTS_LOCAL_91_QUERY_P1)
-                : snprintf(query, QUERY_MAXLEN, "%s", PG_STAT_STATEMENTS_LOCAL_QUERY_P1);
+                ? snprintf(query, QUERY_MAXLEN, "%s%s", PG_STAT_STATEMENTS_LOCAL_91_QUERY_P1, pgss_query_p2)
+                : snprintf(query, QUERY_MAXLEN, "%s%s", PG_STAT_STATEMENTS_LOCAL_QUERY_P1, pgss_query_p2);
             break;
         case pg_stat_progress_vacuum:
-            snprintf(query, QUERY_MAXLEN, "%s", PG_STAT_PROGRESS_VACUUM_QUERY);
+            if (atoi(tab->pg_special.pg_version_num) < PG12)
+                snprintf(query, QUERY_MAXLEN, "%s", PG_STAT_PROGRESS_96_QUERY);
+            else
+                snprintf(query, QUERY_MAXLEN, "%s%s%s%s", PG_STAT_PROGRESS_QUERY_P1,
+                        atoi(tab->pg_special.pg_version_num) < PG13 ? "" : PG_STAT_PROGRESS_ANALYZE_PART,
+                        atoi(tab->pg_special.pg_version_num) < PG14 ? "" : PG_STAT_PROGRESS_COPY_PART,
+                        PG_STAT_PROGRESS_QUERY_P2);
+            break;
+        case pg_stat_proc:
+            atoi(tab->pg_special.pg_version_num) < PG92
+                ? snprintf(query, QUERY_MAXLEN, "%s", PG_STAT_PROC_91_QUERY)
+                : snprintf(query, QUERY_MAXLEN, "%s", PG_STAT_PROC_QUERY);
+            break;
+        case pg_wait_profile:
+            if (atoi(tab->pg_special.pg_version_num) < PG96)
+                snprintf(query, QUERY_MAXLEN, "%s", PG_WAIT_SAMPLE_95_QUERY);
+            else if (atoi(tab->pg_special.pg_version_num) < PG14)
+                snprintf(query, QUERY_MAXLEN, "%s", PG_WAIT_SAMPLE_QUERY);
+            else
+                snprintf(query, QUERY_MAXLEN, "%s", PG_WAIT_SAMPLE_14_QUERY);
+            break;
+        case pg_locks_tree:
+            snprintf(query, QUERY_MAXLEN, "%s", PG_LOCKS_TREE_QUERY);
+            break;
+        case pg_tables_bloat:
+            snprintf(query, QUERY_MAXLEN, "%s%s%s",
+                        PG_TABLES_BLOAT_QUERY_P1, tab->pg_stat_sys ? "all" : "user",
+                        PG_TABLES_BLOAT_QUERY_P2);
+            break;
+        case pg_index_usage:
+            snprintf(query, QUERY_MAXLEN, "%s%s%s%s%s%s%s", PG_INDEX_USAGE_QUERY_P1,
+                        atoi(tab->pg_special.pg_version_num) < PG11 ? PG_INDEX_USAGE_NKEYS_10 : PG_INDEX_USAGE_NKEYS_11,
+                        PG_INDEX_USAGE_QUERY_P2, tab->pg_stat_sys ? "all" : "user",
+                        PG_INDEX_USAGE_QUERY_P3, tab->pg_stat_sys ? "all" : "user",
+                        PG_INDEX_USAGE_QUERY_P4);
+            break;
+        case pg_xid_wraparound:
+            snprintf(query, QUERY_MAXLEN, "%s", PG_XID_DATABASES_QUERY);
+            break;
+        case pg_buffercache:
+            snprintf(query, QUERY_MAXLEN, "%s", PG_BUFFERCACHE_QUERY);
+            break;
+        case pg_stat_statements_agg:
+            atoi(tab->pg_special.pg_version_num) < PG94
+                ? snprintf(query, QUERY_MAXLEN, "%s", PG_STAT_STATEMENTS_AGG_91_QUERY)
+                : snprintf(query, QUERY_MAXLEN, "%s", PG_STAT_STATEMENTS_AGG_QUERY);
+            break;
+        case pg_stat_connections:
+            snprintf(query, QUERY_MAXLEN, "%s%s%s%s", PG_STAT_CONNECTIONS_QUERY_P1,
+                    atoi(tab->pg_special.pg_version_num) < PG14
+                        ? PG_STAT_CONNECTIONS_SESSIONS_92 : PG_STAT_CONNECTIONS_SESSIONS_14,
+                    PG_STAT_CONNECTIONS_QUERY_P2,
+                    atoi(tab->pg_special.pg_version_num) < PG10 ? "" : PG_STAT_CONNECTIONS_CLIENTS_10);
             break;
     }
 }
@@ -379,7 +772,7 @@ void get_pg_uptime(PGconn * conn, char * uptime)
     static char errmsg[ERRSIZE];
     PGresult * res;
 
-    if ((res = do_query(conn, PG_UPTIME_QUERY, errmsg)) != NULL) {
+    if ((res = do_prepared_query(conn, PG_UPTIME_QUERY, 0, errmsg)) != NULL) {
         snprintf(uptime, S_BUF_LEN, "%s", PQgetvalue(res, 0, 0));
         PQclear(res);
     } else {
@@ -444,6 +837,9 @@ void get_summary_pg_activity(WINDOW * window, struct tab_s * tab, PGconn * conn)
         	 w_count = 0,			/* number of waiting connections */
         	 o_count = 0,			/* other, unclassiffied */
         	 p_count = 0;			/* number of prepared xacts */
+    unsigned int count;
+    int i;
+    char * state;
     PGresult *res;
     static char errmsg[ERRSIZE];
     char query[QUERY_MAXLEN];
@@ -455,17 +851,35 @@ void get_summary_pg_activity(WINDOW * window, struct tab_s * tab, PGconn * conn)
     else
         snprintf(query, QUERY_MAXLEN, "%s", PG_STAT_ACTIVITY_COUNT_QUERY);
 
-    if ((res = do_query(conn, query, errmsg)) != NULL) {
-        t_count = atoi(PQgetvalue(res, 0, 0));
-        i_count = atoi(PQgetvalue(res, 0, 1));
-        x_count = atoi(PQgetvalue(res, 0, 2));
-        a_count = atoi(PQgetvalue(res, 0, 3));
-        w_count = atoi(PQgetvalue(res, 0, 4));
-        o_count = atoi(PQgetvalue(res, 0, 5));
-        p_count = atoi(PQgetvalue(res, 0, 6));
+    if ((res = do_prepared_query(conn, query, 0, errmsg)) != NULL) {
+        for (i = 0; i < PQntuples(res); i++) {
+            state = PQgetvalue(res, i, 0);
+            count = atoi(PQgetvalue(res, i, 2));
+            if (!strcmp(state, "prepared")) {
+                p_count += count;
+                continue;
+            }
+
+            t_count += count;
+            if (PQgetvalue(res, i, 1)[0] == 't')
+                w_count += count;
+            if (!strcmp(state, "idle"))
+                i_count += count;
+            else if (!strcmp(state, "idle in transaction") || !strcmp(state, "idle in transaction (aborted)"))
+                x_count += count;
+            else if (!strcmp(state, "active"))
+                a_count += count;
+            else if (!strcmp(state, "fastpath function call") || !strcmp(state, "disabled"))
+                o_count += count;
+        }
         PQclear(res);
     }
 
+    tab->metrics[metric_conns] = t_count;
+    tab->metrics[metric_active] = a_count;
+    tab->metrics[metric_waiting] = w_count;
+    tab->metrics[metric_idle_xact] = x_count;
+
     mvwprintw(window, 1, COLS / 2,
             "  activity:%3i/%i conns,%3i/%i prepared,%3i idle,%3i idle_xact,%3i active,%3i waiting,%3i others",
             t_count, tab->pg_special.pg_max_conns,
@@ -488,7 +902,7 @@ void get_summary_vac_activity(WINDOW * window, struct tab_s * tab, PGconn * conn
     PGresult *res;
     static char errmsg[ERRSIZE];
     
-    if ((res = do_query(conn, PG_STAT_ACTIVITY_AV_COUNT_QUERY, errmsg)) != NULL) {
+    if ((res = do_prepared_query(conn, PG_STAT_ACTIVITY_AV_COUNT_QUERY, 0, errmsg)) != NULL) {
         av_count = atoi(PQgetvalue(res, 0, 0));
         avw_count = atoi(PQgetvalue(res, 0, 1));
         mv_count = atoi(PQgetvalue(res, 0, 2));
@@ -506,11 +920,13 @@ void get_summary_vac_activity(WINDOW * window, struct tab_s * tab, PGconn * conn
  * Get and print info about xacts and queries from pgss and pgsa.
  ****************************************************************************
  */
-void get_pgss_summary(WINDOW * window, PGconn * conn, unsigned long interval)
+void get_pgss_summary(WINDOW * window, struct tab_s * tab, PGconn * conn)
 {
     float avgtime;
-    static unsigned int qps, prev_queries = 0;
-    unsigned int divisor;
+    unsigned int qps = 0;
+    long long calls;
+    struct timespec now;
+    double elapsed;
     char x_maxtime[XS_BUF_LEN] = "--:--:--", p_maxtime[XS_BUF_LEN] = "--:--:--";
     PGresult *res;
     char errmsg[ERRSIZE];
@@ -519,29 +935,129 @@ void get_pgss_summary(WINDOW * window, PGconn * conn, unsigned long interval)
         avgtime = qps = 0;
     } 
 
-    divisor = interval / 1000000;
-    if ((res = do_query(conn, PG_STAT_STATEMENTS_SYS_QUERY, errmsg)) != NULL) {
+    if ((res = do_prepared_query(conn, PG_STAT_STATEMENTS_SYS_QUERY, 0, errmsg)) != NULL) {
         avgtime = atof(PQgetvalue(res, 0, 0));
-        qps = (atoi(PQgetvalue(res, 0, 1)) - prev_queries) / divisor;
-        prev_queries = atoi(PQgetvalue(res, 0, 1));
+        calls = strtoll(PQgetvalue(res, 0, 1), NULL, 10);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed = (now.tv_sec - tab->pgss_ts.tv_sec) + (now.tv_nsec - tab->pgss_ts.tv_nsec) / 1000000000.0;
+        /* rate since previous refresh of this tab, counter decreases after stats reset */
+        if (tab->pgss_has_prev && elapsed > 0 && calls >= tab->pgss_calls) {
+            qps = (calls - tab->pgss_calls) / elapsed;
+            tab->metrics[metric_stmt_s] = qps;
+        }
+        tab->pgss_calls = calls;
+        tab->pgss_ts = now;
+        tab->pgss_has_prev = true;
+        tab->metrics[metric_stmt_avgtime] = avgtime / 1000;
         PQclear(res);
     } else {
         avgtime = 0;
         qps = 0;
     }
 
-    if ((res = do_query(conn, PG_STAT_ACTIVITY_SYS_QUERY, errmsg)) != NULL) {
+    if ((res = do_prepared_query(conn, PG_STAT_ACTIVITY_SYS_QUERY, 0, errmsg)) != NULL) {
         snprintf(x_maxtime, sizeof(x_maxtime), "%s", PQgetvalue(res, 0, 0));
         snprintf(p_maxtime, sizeof(p_maxtime), "%s", PQgetvalue(res, 0, 1));
         PQclear(res);
     }
 
+    tab->metrics[metric_xact_maxtime] = str_to_value(x_maxtime);
+    tab->metrics[metric_prep_maxtime] = str_to_value(p_maxtime);
+
     mvwprintw(window, 3, COLS / 2,
             "statements: %3i stmt/s, %3.3f stmt_avgtime, %s xact_maxtime, %s prep_maxtime",
             qps, avgtime, x_maxtime, p_maxtime);
     wrefresh(window);
 }
 
+/*
+ ****************************************************************************
+ * Get and print WAL generation rate and checkpoints pressure: share of full
+ * page images, timed and requested checkpoints, who writes buffers and when
+ * max_wal_size is reached at the current rate, i.e. when checkpoint will be
+ * requested. Rates are calculated from counters of the previous refresh.
+ ****************************************************************************
+ */
+void get_summary_wal_activity(WINDOW * window, struct tab_s * tab, PGconn * conn)
+{
+    struct walstat_s * ws = &tab->walstat, curr;
+    PGresult *res;
+    static char errmsg[ERRSIZE];
+    char query[QUERY_MAXLEN],
+         rate[XS_BUF_LEN] = "--", fpi[XS_BUF_LEN] = "--", bufs[S_BUF_LEN] = "--/--/--",
+         eta[XS_BUF_LEN] = "--:--:--";
+    double elapsed, wal_rate = 0, remain;
+    long long redo_distance = -1, max_wal_size = -1, written;
+
+    if (atoi(tab->pg_special.pg_version_num) < PG96)
+        snprintf(query, QUERY_MAXLEN, "%s", PG_WAL_SYS_95_QUERY);
+    else if (atoi(tab->pg_special.pg_version_num) < PG10)
+        snprintf(query, QUERY_MAXLEN, "%s", PG_WAL_SYS_96_QUERY);
+    else if (atoi(tab->pg_special.pg_version_num) < PG14)
+        snprintf(query, QUERY_MAXLEN, "%s", PG_WAL_SYS_QUERY);
+    else if (atoi(tab->pg_special.pg_version_num) < PG17)
+        snprintf(query, QUERY_MAXLEN, "%s", PG_WAL_SYS_14_QUERY);
+    else
+        snprintf(query, QUERY_MAXLEN, "%s", PG_WAL_SYS_17_QUERY);
+
+    memset(&curr, 0, sizeof(curr));
+    if ((res = do_prepared_query(conn, query, 0, errmsg)) != NULL) {
+        curr.wal_bytes = atoll(PQgetvalue(res, 0, 0));
+        curr.wal_records = atoll(PQgetvalue(res, 0, 1));
+        curr.wal_fpi = atoll(PQgetvalue(res, 0, 2));
+        curr.ckpt_timed = atoll(PQgetvalue(res, 0, 3));
+        curr.ckpt_req = atoll(PQgetvalue(res, 0, 4));
+        curr.buf_ckpt = atoll(PQgetvalue(res, 0, 5));
+        curr.buf_clean = atoll(PQgetvalue(res, 0, 6));
+        curr.buf_backend = atoll(PQgetvalue(res, 0, 7));
+        if (!PQgetisnull(res, 0, 8) && !PQgetisnull(res, 0, 9)) {
+            redo_distance = atoll(PQgetvalue(res, 0, 8));
+            max_wal_size = atoll(PQgetvalue(res, 0, 9));
+        }
+        PQclear(res);
+        clock_gettime(CLOCK_MONOTONIC, &curr.ts);
+        curr.has_prev = true;
+
+        elapsed = (curr.ts.tv_sec - ws->ts.tv_sec) + (curr.ts.tv_nsec - ws->ts.tv_nsec) / 1000000000.0;
+        if (ws->has_prev && elapsed > 0 && curr.wal_bytes >= ws->wal_bytes) {
+            wal_rate = (curr.wal_bytes - ws->wal_bytes) / elapsed;
+            snprintf(rate, sizeof(rate), "%.1f", wal_rate / 1024);
+
+            if (curr.wal_records > ws->wal_records)
+                snprintf(fpi, sizeof(fpi), "%.0f%%",
+                        (curr.wal_fpi - ws->wal_fpi) * 100.0 / (curr.wal_records - ws->wal_records));
+            else if (atoi(tab->pg_special.pg_version_num) >= PG14)
+                snprintf(fpi, sizeof(fpi), "0%%");
+
+            written = (curr.buf_ckpt - ws->buf_ckpt) + (curr.buf_clean - ws->buf_clean)
+                    + (curr.buf_backend - ws->buf_backend);
+            if (written > 0)
+                snprintf(bufs, sizeof(bufs), "%.0f/%.0f/%.0f%%",
+                        (curr.buf_ckpt - ws->buf_ckpt) * 100.0 / written,
+                        (curr.buf_clean - ws->buf_clean) * 100.0 / written,
+                        (curr.buf_backend - ws->buf_backend) * 100.0 / written);
+
+            /* time until WAL since the last checkpoint reaches max_wal_size */
+            if (max_wal_size > 0 && redo_distance >= 0) {
+                remain = max_wal_size - redo_distance;
+                if (remain <= 0)
+                    snprintf(eta, sizeof(eta), "00:00:00");
+                else if (wal_rate > 0 && remain / wal_rate < 100 * 3600)
+                    snprintf(eta, sizeof(eta), "%02d:%02d:%02d", (int) (remain / wal_rate) / 3600,
+                            ((int) (remain / wal_rate) % 3600) / 60, (int) (remain / wal_rate) % 60);
+                else
+                    snprintf(eta, sizeof(eta), "never");
+            }
+        }
+    }
+    *ws = curr;
+
+    mvwprintw(window, 4, COLS / 2,
+            "       wal: %s KB/s, %s fpi, %lli/%lli ckpt timed/req, %s bufs ckpt/bgw/backend, %s to max_wal",
+            rate, fpi, curr.ckpt_timed, curr.ckpt_req, bufs, eta);
+    wrefresh(window);
+}
+
 /* 
  ****************************************************************************
  * Check pgcenter's statview existance.
@@ -0,0 +1,912 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+ ****************************************************************************
+ * pgss.c
+ *      pg_stat_statements helpers.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#include "include/pgss.h"
+
+/*
+ ****************************************************************************
+ * Check that the context shows pg_stat_statements stats.
+ ****************************************************************************
+ */
+bool pgss_context(enum context context)
+{
+    return (context == pg_stat_statements_timing
+            || context == pg_stat_statements_general
+            || context == pg_stat_statements_io
+            || context == pg_stat_statements_temp
+            || context == pg_stat_statements_local);
+}
+
+/*
+ ****************************************************************************
+ * Skip placeholder with optional type cast, e.g. "?", "$1" or "$1::text".
+ * Return pointer to the next char or NULL if there is no placeholder.
+ ****************************************************************************
+ */
+const char * skip_placeholder(const char * ptr)
+{
+    if (ptr[0] == '?')
+        ptr++;
+    else if (ptr[0] == '$' && isdigit((unsigned char) ptr[1]))
+        for (ptr++; isdigit((unsigned char) *ptr); ptr++)
+            ;
+    else
+        return NULL;
+
+    if (ptr[0] == ':' && ptr[1] == ':' && (isalpha((unsigned char) ptr[2]) || ptr[2] == '_'))
+        for (ptr += 2; isalpha((unsigned char) *ptr) || *ptr == '_'; ptr++)
+            ;
+
+    return ptr;
+}
+
+/*
+ ****************************************************************************
+ * Normalize query text in one pass: lists of "?" are replaced with single
+ * "?", "$1" and lists of them with "$N", comments are removed and whitespaces
+ * are squeezed. Return length of normalized text.
+ ****************************************************************************
+ */
+size_t normalize_query(const char * query, char * out, size_t out_len)
+{
+    const char * ptr = query, * next, * item, * start;
+    unsigned int items;
+    size_t o = 0;
+    char kind;
+
+    while (*ptr != '\0' && o + 3 < out_len) {
+        /* line comment, newline is left and squeezed later */
+        if (ptr[0] == '-' && ptr[1] == '-') {
+            while (*ptr != '\0' && *ptr != '\n')
+                ptr++;
+            continue;
+        }
+        /* block comment, unterminated comment ends the query */
+        if (ptr[0] == '/' && ptr[1] == '*') {
+            if ((next = strstr(ptr + 2, "*/")) == NULL)
+                break;
+            ptr = next + 2;
+            continue;
+        }
+        if (isspace((unsigned char) *ptr)) {
+            if (o > 0 && out[o - 1] != ' ')
+                out[o++] = ' ';
+            ptr++;
+            continue;
+        }
+        if ((next = skip_placeholder(ptr)) != NULL) {
+            /* collect comma separated list of the same placeholders */
+            start = ptr;
+            kind = *ptr;
+            for (items = 1; ; items++) {
+                for (item = next; *item == ' '; item++)
+                    ;
+                if (*item != ',')
+                    break;
+                for (item++; *item == ' '; item++)
+                    ;
+                if (*item != kind || (item = skip_placeholder(item)) == NULL)
+                    break;
+                next = item;
+            }
+
+            if (kind == '$') {
+                out[o++] = '$';
+                out[o++] = 'N';
+            } else if (items > 1) {
+                out[o++] = '?';
+            } else {
+                while (start < next && o + 1 < out_len)
+                    out[o++] = *start++;
+            }
+            ptr = next;
+            continue;
+        }
+        out[o++] = *ptr++;
+    }
+
+    /* remove trailing space */
+    if (o > 0 && out[o - 1] == ' ')
+        o--;
+    out[o] = '\0';
+
+    return o;
+}
+
+/*
+ ****************************************************************************
+ * Replace numeric and string literals with "?", used for texts which aren't
+ * normalized by postgres, e.g. texts of pg_stat_activity. Quoted identifiers
+ * are left as is. Return length of masked text.
+ ****************************************************************************
+ */
+size_t mask_literals(const char * query, char * out, size_t out_len)
+{
+    const char * ptr = query;
+    size_t o = 0;
+
+    while (*ptr != '\0' && o + 2 < out_len) {
+        /* string literal, doubled quote is an escaped quote */
+        if (*ptr == '\'') {
+            for (ptr++; *ptr != '\0'; ptr++)
+                if (*ptr == '\'' && *++ptr != '\'')
+                    break;
+            out[o++] = '?';
+            continue;
+        }
+        if (*ptr == '"') {
+            do
+                out[o++] = *ptr++;
+            while (*ptr != '\0' && *ptr != '"' && o + 2 < out_len);
+            if (*ptr == '"')
+                out[o++] = *ptr++;
+            continue;
+        }
+        /* number which isn't a part of identifier or placeholder */
+        if (isdigit((unsigned char) *ptr)
+                && (o == 0 || !(isalnum((unsigned char) out[o - 1]) || out[o - 1] == '_' || out[o - 1] == '$'))) {
+            while (isdigit((unsigned char) *ptr) || *ptr == '.')
+                ptr++;
+            out[o++] = '?';
+            continue;
+        }
+        out[o++] = *ptr++;
+    }
+    out[o] = '\0';
+
+    return o;
+}
+
+/*
+ ****************************************************************************
+ * Normalize query texts of pg_stat_statements result, texts are in the last
+ * column. Normalization is done here instead of regexps on postgres side,
+ * which are too expensive with large pg_stat_statements.
+ ****************************************************************************
+ */
+void normalize_pgss_texts(PGresult * res)
+{
+    static char buf[XL_BUF_LEN];
+    int i, col = PQnfields(res) - 1;
+    size_t len;
+
+    for (i = 0; i < PQntuples(res); i++) {
+        len = normalize_query(PQgetvalue(res, i, col), buf, sizeof(buf));
+        PQsetvalue(res, i, col, buf, len);
+    }
+}
+
+/*
+ ****************************************************************************
+ * Allocate and initialize query texts cache.
+ ****************************************************************************
+ */
+struct pgss_cache_s * init_pgss_cache(void)
+{
+    struct pgss_cache_s * cache;
+
+    if ((cache = (struct pgss_cache_s *) malloc(PGSS_CACHE_SIZE)) == NULL
+        || (cache->ids = calloc(PGSS_IDS_MIN_SIZE, sizeof(struct pgss_id_s))) == NULL
+        || (cache->texts = calloc(PGSS_TEXTS_MIN_SIZE, sizeof(unsigned int))) == NULL
+        || (cache->arena = malloc(PGSS_ARENA_MIN_SIZE)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for query texts cache failed.\n");
+    }
+    cache->ids_size = PGSS_IDS_MIN_SIZE;
+    cache->texts_size = PGSS_TEXTS_MIN_SIZE;
+    cache->arena_size = PGSS_ARENA_MIN_SIZE;
+    reset_pgss_cache(cache);
+
+    return cache;
+}
+
+/*
+ ****************************************************************************
+ * Forget all cached texts, allocated memory is kept.
+ ****************************************************************************
+ */
+void reset_pgss_cache(struct pgss_cache_s * cache)
+{
+    memset(cache->ids, 0, cache->ids_size * sizeof(struct pgss_id_s));
+    memset(cache->texts, 0, cache->texts_size * sizeof(unsigned int));
+    cache->ids_used = 0;
+    cache->texts_used = 0;
+
+    /* zero offset is reserved for empty slots */
+    cache->arena[0] = '\0';
+    cache->arena_len = 1;
+}
+
+/*
+ ****************************************************************************
+ * Free query texts cache.
+ ****************************************************************************
+ */
+void free_pgss_cache(struct pgss_cache_s * cache)
+{
+    if (cache == NULL)
+        return;
+
+    free(cache->ids);
+    free(cache->texts);
+    free(cache->arena);
+    free(cache);
+}
+
+/*
+ ****************************************************************************
+ * Double queryid hash table and move all queryids into the new one.
+ ****************************************************************************
+ */
+void resize_pgss_ids(struct pgss_cache_s * cache)
+{
+    struct pgss_id_s * ids, * slot;
+    unsigned int i, size = cache->ids_size * 2;
+
+    if ((ids = calloc(size, sizeof(struct pgss_id_s))) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for query texts cache failed.\n");
+    }
+
+    for (i = 0; i < cache->ids_size; i++) {
+        if (cache->ids[i].text == 0)
+            continue;
+        slot = lookup_pgss_id(ids, size, cache->ids[i].queryid);
+        *slot = cache->ids[i];
+    }
+
+    free(cache->ids);
+    cache->ids = ids;
+    cache->ids_size = size;
+}
+
+/*
+ ****************************************************************************
+ * Double interned texts hash table and move all texts into the new one.
+ ****************************************************************************
+ */
+void resize_pgss_texts(struct pgss_cache_s * cache)
+{
+    unsigned int * texts, i, j, size = cache->texts_size * 2;
+    const char * text;
+
+    if ((texts = calloc(size, sizeof(unsigned int))) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for query texts cache failed.\n");
+    }
+
+    for (i = 0; i < cache->texts_size; i++) {
+        if (cache->texts[i] == 0)
+            continue;
+        text = cache->arena + cache->texts[i];
+        for (j = hash_text(text, strlen(text)) & (size - 1); texts[j] != 0; j = (j + 1) & (size - 1))
+            ;
+        texts[j] = cache->texts[i];
+    }
+
+    free(cache->texts);
+    cache->texts = texts;
+    cache->texts_size = size;
+}
+
+/*
+ ****************************************************************************
+ * Intern text: return offset of the same text if it's already in arena,
+ * otherwise copy text into arena.
+ ****************************************************************************
+ */
+unsigned int intern_pgss_text(struct pgss_cache_s * cache, const char * text, size_t len)
+{
+    unsigned int i;
+    char * arena;
+
+    if (cache->texts_used >= cache->texts_size * 3 / 4)
+        resize_pgss_texts(cache);
+
+    for (i = hash_text(text, len) & (cache->texts_size - 1); cache->texts[i] != 0;
+            i = (i + 1) & (cache->texts_size - 1)) {
+        if (strncmp(cache->arena + cache->texts[i], text, len) == 0
+                && cache->arena[cache->texts[i] + len] == '\0')
+            return cache->texts[i];
+    }
+
+    while (cache->arena_len + len + 1 > cache->arena_size) {
+        if ((arena = realloc(cache->arena, cache->arena_size * 2)) == NULL) {
+            mreport(true, msg_fatal, "FATAL: realloc for query texts cache failed.\n");
+        }
+        cache->arena = arena;
+        cache->arena_size *= 2;
+    }
+
+    memcpy(cache->arena + cache->arena_len, text, len);
+    cache->arena[cache->arena_len + len] = '\0';
+    cache->texts[i] = cache->arena_len;
+    cache->texts_used++;
+    cache->arena_len += len + 1;
+
+    return cache->texts[i];
+}
+
+/*
+ ****************************************************************************
+ * Find queryid slot in hash table. Return slot with queryid or the empty
+ * slot where queryid should be placed.
+ ****************************************************************************
+ */
+struct pgss_id_s * lookup_pgss_id(struct pgss_id_s * ids, unsigned int size, long long queryid)
+{
+    unsigned int i;
+
+    /* queryid is a hash itself, mix its halves only */
+    for (i = (unsigned int) (queryid ^ (queryid >> 32)) & (size - 1); ids[i].text != 0; i = (i + 1) & (size - 1))
+        if (ids[i].queryid == queryid)
+            break;
+
+    return &ids[i];
+}
+
+/*
+ ****************************************************************************
+ * Get cached query text by queryid. Return NULL if text isn't cached.
+ ****************************************************************************
+ */
+const char * get_pgss_text(struct pgss_cache_s * cache, long long queryid)
+{
+    struct pgss_id_s * slot = lookup_pgss_id(cache->ids, cache->ids_size, queryid);
+
+    return (slot->text != 0) ? cache->arena + slot->text : NULL;
+}
+
+/*
+ ****************************************************************************
+ * Normalize query text and put it into cache.
+ ****************************************************************************
+ */
+void add_pgss_text(struct pgss_cache_s * cache, long long queryid, const char * text)
+{
+    static char buf[XL_BUF_LEN];
+    struct pgss_id_s * slot;
+    size_t len;
+
+    if (cache->ids_used >= cache->ids_size * 3 / 4)
+        resize_pgss_ids(cache);
+
+    slot = lookup_pgss_id(cache->ids, cache->ids_size, queryid);
+    if (slot->text != 0)
+        return;
+
+    len = normalize_query(text, buf, sizeof(buf));
+    slot->queryid = queryid;
+    slot->text = intern_pgss_text(cache, buf, len);
+    cache->ids_used++;
+}
+
+/*
+ ****************************************************************************
+ * Request texts of the given queryids and put them into cache. Queryids are
+ * passed as array literal.
+ ****************************************************************************
+ */
+void fetch_pgss_texts(PGconn * conn, struct pgss_cache_s * cache, const char * queryids)
+{
+    PGresult * res;
+    const char * params[1] = { queryids };
+    int i;
+
+    res = exec_prepared(conn, PG_STAT_STATEMENTS_TEXTS_QUERY, 1, params, 0);
+    if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+        for (i = 0; i < PQntuples(res); i++)
+            add_pgss_text(cache, strtoll(PQgetvalue(res, i, 0), NULL, 10), PQgetvalue(res, i, 1));
+    }
+    PQclear(res);
+}
+
+/*
+ ****************************************************************************
+ * Complete pg_stat_statements result. Since 9.4 the result has queryid and
+ * hidden counters in the last columns: counters are saved into statements
+ * history and replaced with trend and growth columns, query texts are taken
+ * from the cache, only texts of unknown queryids are requested from postgres.
+ * Old versions have texts in the result, they are only normalized.
+ ****************************************************************************
+ */
+PGresult * merge_pgss_texts(PGconn * conn, PGresult * res, struct tab_s * tab)
+{
+    PGresult * new_res;
+    PGresAttDesc attrs[MAX_COLS];
+    struct pgss_cache_s * cache;
+    struct pgss_hist_s * hist;
+    enum pgss_series series = pgss_context_series(tab->current_context);
+    const char * text;
+    char * queryids, trend[PGSS_HIST_LEN + 1], growth[XS_BUF_LEN];
+    double counters[PGSS_SERIES];
+    float values[PGSS_HIST_LEN];
+    unsigned long long key;
+    unsigned int n;
+    size_t len = 0;
+    long long queryid;
+    int i, j, slot, qcol, n_rows = PQntuples(res), n_cols = PQnfields(res);
+
+    if (atoi(tab->pg_special.pg_version_num) < PG94) {
+        normalize_pgss_texts(res);
+        return res;
+    }
+
+    /* queryid is followed by hidden counters, they are replaced with new columns */
+    qcol = n_cols - 1 - PGSS_HIST_SRC_COLS;
+    if (qcol < 2 || qcol + 1 + PGSS_HIST_COLS + 1 > MAX_COLS)
+        return res;
+
+    if (tab->pgss_cache == NULL)
+        tab->pgss_cache = init_pgss_cache();
+    cache = tab->pgss_cache;
+    if (tab->pgss_hist == NULL)
+        tab->pgss_hist = init_pgss_hist(PGSS_HIST_MIN_SIZE);
+    hist = tab->pgss_hist;
+
+    /* don't let texts of long gone queries grow forever */
+    if (cache->arena_len > PGSS_ARENA_MAX_SIZE)
+        reset_pgss_cache(cache);
+
+    /* save counters into history */
+    if (advance_pgss_hist(hist))
+        for (i = 0; i < n_rows; i++) {
+            for (j = 0; j < PGSS_SERIES; j++)
+                counters[j] = strtod(PQgetvalue(res, i, qcol + 1 + j), NULL);
+            key = pgss_hist_key(PQgetvalue(res, i, 0), PQgetvalue(res, i, 1), PQgetvalue(res, i, qcol));
+            update_pgss_hist(hist, key, counters);
+        }
+
+    /* collect unknown queryids into array literal */
+    if ((queryids = malloc(n_rows * PGSS_QUERYID_MAXLEN + 3)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for queryids failed.\n");
+    }
+    queryids[len++] = '{';
+    for (i = 0; i < n_rows; i++) {
+        queryid = strtoll(PQgetvalue(res, i, qcol), NULL, 10);
+        if (get_pgss_text(cache, queryid) == NULL)
+            len += sprintf(queryids + len, "%lld,", queryid);
+    }
+    if (len > 1) {
+        queryids[len - 1] = '}';
+        queryids[len] = '\0';
+        fetch_pgss_texts(conn, cache, queryids);
+    }
+    free(queryids);
+
+    /* describe columns: source columns up to queryid, trend, growth and query text */
+    memset(attrs, 0, sizeof(attrs));
+    for (j = 0; j <= qcol; j++) {
+        attrs[j].name = PQfname(res, j);
+        attrs[j].typid = PQftype(res, j);
+        attrs[j].typlen = PQfsize(res, j);
+        attrs[j].atttypmod = PQfmod(res, j);
+    }
+    attrs[qcol + 1].name = (char *) "trend";
+    attrs[qcol + 1].typid = 25;             /* text */
+    attrs[qcol + 1].typlen = -1;
+    attrs[qcol + 1].atttypmod = -1;
+    attrs[qcol + 2].name = (char *) "growth_pct";
+    attrs[qcol + 2].typid = 701;            /* float8 */
+    attrs[qcol + 2].typlen = 8;
+    attrs[qcol + 2].atttypmod = -1;
+    attrs[qcol + 3].name = (char *) "query";
+    attrs[qcol + 3].typid = 25;             /* text */
+    attrs[qcol + 3].typlen = -1;
+    attrs[qcol + 3].atttypmod = -1;
+
+    if ((new_res = PQmakeEmptyPGresult(conn, PGRES_TUPLES_OK)) == NULL
+        || PQsetResultAttrs(new_res, qcol + 4, attrs) == 0) {
+        PQclear(new_res);
+        return res;
+    }
+
+    for (i = 0; i < n_rows; i++) {
+        for (j = 0; j <= qcol; j++)
+            PQsetvalue(new_res, i, j, PQgetvalue(res, i, j), PQgetlength(res, i, j));
+
+        /* statements which aren't in history yet have no trend */
+        key = pgss_hist_key(PQgetvalue(res, i, 0), PQgetvalue(res, i, 1), PQgetvalue(res, i, qcol));
+        slot = lookup_pgss_hist(hist, key);
+        n = get_pgss_hist(hist, slot, series, values);
+        format_sparkline(values, n, trend);
+        snprintf(growth, sizeof(growth), "%.1f", pgss_growth(values, n));
+        PQsetvalue(new_res, i, qcol + 1, trend, PGSS_HIST_LEN);
+        PQsetvalue(new_res, i, qcol + 2, growth, strlen(growth));
+
+        if ((text = get_pgss_text(cache, strtoll(PQgetvalue(res, i, qcol), NULL, 10))) == NULL)
+            text = "";
+        PQsetvalue(new_res, i, qcol + 3, (char *) text, strlen(text));
+    }
+
+    PQclear(res);
+    return new_res;
+}
+
+/*
+ ****************************************************************************
+ * Allocate and initialize statements history with the given number of slots.
+ ****************************************************************************
+ */
+struct pgss_hist_s * init_pgss_hist(unsigned int size)
+{
+    struct pgss_hist_s * hist;
+
+    if ((hist = (struct pgss_hist_s *) malloc(PGSS_HIST_SIZE)) == NULL
+        || (hist->keys = calloc(size, sizeof(unsigned long long))) == NULL
+        || (hist->first = calloc(size, sizeof(unsigned long))) == NULL
+        || (hist->last = calloc(size, sizeof(unsigned long))) == NULL
+        || (hist->prev = calloc(size * PGSS_SERIES, sizeof(double))) == NULL
+        || (hist->rates = calloc(size * PGSS_SERIES * PGSS_HIST_LEN, sizeof(float))) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for statements history failed.\n");
+    }
+    hist->size = size;
+    hist->used = 0;
+    hist->seq = 0;
+    hist->elapsed = 0;
+    hist->ts.tv_sec = hist->ts.tv_nsec = 0;
+
+    return hist;
+}
+
+/*
+ ****************************************************************************
+ * Free statements history.
+ ****************************************************************************
+ */
+void free_pgss_hist(struct pgss_hist_s * hist)
+{
+    if (hist == NULL)
+        return;
+
+    free(hist->keys);
+    free(hist->first);
+    free(hist->last);
+    free(hist->prev);
+    free(hist->rates);
+    free(hist);
+}
+
+/*
+ ****************************************************************************
+ * Make history key from queryid, user and database. The same queryid can be
+ * executed by different users in different databases, each of them is shown
+ * in its own row and has its own history.
+ ****************************************************************************
+ */
+unsigned long long pgss_hist_key(const char * user, const char * database, const char * queryid)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    const char * fields[3] = { user, database, queryid };
+    const char * ptr;
+    unsigned int i;
+
+    /* FNV-1a, terminating zeroes separate fields */
+    for (i = 0; i < 3; i++)
+        for (ptr = fields[i]; ; ptr++) {
+            hash ^= (unsigned char) *ptr;
+            hash *= 1099511628211ULL;
+            if (*ptr == '\0')
+                break;
+        }
+
+    return hash;
+}
+
+/*
+ ****************************************************************************
+ * Find history slot by key. Return slot of the key or empty slot where the
+ * key should be placed. There is always an empty slot, see update_pgss_hist().
+ ****************************************************************************
+ */
+int lookup_pgss_hist(struct pgss_hist_s * hist, unsigned long long key)
+{
+    unsigned int i = key & (hist->size - 1);
+
+    while (hist->last[i] != 0 && hist->keys[i] != key)
+        i = (i + 1) & (hist->size - 1);
+
+    return i;
+}
+
+/*
+ ****************************************************************************
+ * Rebuild history hash table. Only slots which have samples in ring are kept,
+ * thus history of gone statements doesn't grow forever. Table is resized, so
+ * at least a half of it is free after rebuild.
+ ****************************************************************************
+ */
+void rebuild_pgss_hist(struct pgss_hist_s * hist)
+{
+    struct pgss_hist_s * new_hist;
+    unsigned int i, live = 0, size = PGSS_HIST_MIN_SIZE;
+    int slot;
+
+    for (i = 0; i < hist->size; i++)
+        if (hist->last[i] != 0 && hist->seq - hist->last[i] < PGSS_HIST_LEN)
+            live++;
+    while (size / 2 < live + 1)
+        size *= 2;
+
+    new_hist = init_pgss_hist(size);
+    for (i = 0; i < hist->size; i++) {
+        if (hist->last[i] == 0 || hist->seq - hist->last[i] >= PGSS_HIST_LEN)
+            continue;
+        slot = lookup_pgss_hist(new_hist, hist->keys[i]);
+        new_hist->keys[slot] = hist->keys[i];
+        new_hist->first[slot] = hist->first[i];
+        new_hist->last[slot] = hist->last[i];
+        memcpy(new_hist->prev + slot * PGSS_SERIES, hist->prev + i * PGSS_SERIES,
+                PGSS_SERIES * sizeof(double));
+        memcpy(new_hist->rates + slot * PGSS_SERIES * PGSS_HIST_LEN, hist->rates + i * PGSS_SERIES * PGSS_HIST_LEN,
+                PGSS_SERIES * PGSS_HIST_LEN * sizeof(float));
+        new_hist->used++;
+    }
+
+    /* replace storage, but keep sampling state */
+    free(hist->keys);
+    free(hist->first);
+    free(hist->last);
+    free(hist->prev);
+    free(hist->rates);
+    hist->keys = new_hist->keys;
+    hist->first = new_hist->first;
+    hist->last = new_hist->last;
+    hist->prev = new_hist->prev;
+    hist->rates = new_hist->rates;
+    hist->size = new_hist->size;
+    hist->used = new_hist->used;
+    free(new_hist);
+}
+
+/*
+ ****************************************************************************
+ * Start new sample. Return false if previous sample is too recent, e.g. when
+ * stats are requested twice after switching context, such sample is skipped.
+ ****************************************************************************
+ */
+bool advance_pgss_hist(struct pgss_hist_s * hist)
+{
+    struct timespec now;
+    double elapsed;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = (now.tv_sec - hist->ts.tv_sec) + (now.tv_nsec - hist->ts.tv_nsec) / 1000000000.0;
+    if (hist->seq > 0 && elapsed < PGSS_HIST_MIN_ELAPSED)
+        return false;
+
+    hist->seq++;
+    hist->elapsed = elapsed;
+    hist->ts = now;
+    return true;
+}
+
+/*
+ ****************************************************************************
+ * Put counters of the statement into the current sample as per second rates.
+ * New statement gets its first sample with zero rates. Samples missed by the
+ * statement are zeroed, decreased counters (stats reset) give zero rates.
+ ****************************************************************************
+ */
+void update_pgss_hist(struct pgss_hist_s * hist, unsigned long long key, double counters[])
+{
+    unsigned long n;
+    unsigned int i;
+    double * prev;
+    float * rates;
+    int slot;
+
+    /* keep table sparse, so lookups are short and always find empty slot */
+    if ((hist->used + 1) * 4 > hist->size * 3)
+        rebuild_pgss_hist(hist);
+
+    slot = lookup_pgss_hist(hist, key);
+    prev = hist->prev + slot * PGSS_SERIES;
+    rates = hist->rates + slot * PGSS_SERIES * PGSS_HIST_LEN;
+
+    if (hist->last[slot] == 0) {
+        hist->keys[slot] = key;
+        hist->first[slot] = hist->seq;
+        hist->last[slot] = hist->seq;
+        hist->used++;
+        memcpy(prev, counters, PGSS_SERIES * sizeof(double));
+        memset(rates, 0, PGSS_SERIES * PGSS_HIST_LEN * sizeof(float));
+        return;
+    }
+
+    /* duplicate key in the same sample, nothing to do */
+    if (hist->last[slot] == hist->seq)
+        return;
+
+    for (n = hist->last[slot] + 1; n < hist->seq && hist->seq - n < PGSS_HIST_LEN; n++)
+        for (i = 0; i < PGSS_SERIES; i++)
+            rates[i * PGSS_HIST_LEN + n % PGSS_HIST_LEN] = 0;
+
+    for (i = 0; i < PGSS_SERIES; i++) {
+        rates[i * PGSS_HIST_LEN + hist->seq % PGSS_HIST_LEN] =
+            (counters[i] > prev[i] && hist->elapsed > 0) ? (counters[i] - prev[i]) / hist->elapsed : 0;
+        prev[i] = counters[i];
+    }
+    hist->last[slot] = hist->seq;
+}
+
+/*
+ ****************************************************************************
+ * Series which is shown in trend column of the context.
+ ****************************************************************************
+ */
+enum pgss_series pgss_context_series(enum context context)
+{
+    switch (context) {
+        case pg_stat_statements_timing:
+            return series_time;
+        case pg_stat_statements_io:
+        case pg_stat_statements_temp:
+        case pg_stat_statements_local:
+            return series_blks;
+        case pg_stat_statements_general:
+        default:
+            return series_calls;
+    }
+}
+
+/*
+ ****************************************************************************
+ * Get samples of series of the slot, the oldest goes first. The first sample
+ * of the slot has no rates and isn't returned. Return number of samples.
+ ****************************************************************************
+ */
+unsigned int get_pgss_hist(struct pgss_hist_s * hist, int slot, enum pgss_series series, float values[])
+{
+    const float * rates = hist->rates + (slot * PGSS_SERIES + series) * PGSS_HIST_LEN;
+    unsigned long n, from;
+    unsigned int count = 0;
+
+    if (slot < 0 || hist->last[slot] == 0)
+        return 0;
+
+    from = (hist->seq >= PGSS_HIST_LEN) ? hist->seq - PGSS_HIST_LEN + 1 : 1;
+    if (from <= hist->first[slot])
+        from = hist->first[slot] + 1;
+
+    /* samples after the last sample of the slot are zero, statement has gone */
+    for (n = from; n <= hist->seq; n++)
+        values[count++] = (n <= hist->last[slot]) ? rates[n % PGSS_HIST_LEN] : 0;
+
+    return count;
+}
+
+/*
+ ****************************************************************************
+ * Draw values as a sparkline, values are scaled to their max. Sparkline is
+ * aligned to the right, so the newest values are always at the same place.
+ ****************************************************************************
+ */
+void format_sparkline(float values[], unsigned int n, char * buf)
+{
+    const char * levels = PGSS_SPARK_LEVELS;
+    unsigned int i, nlevels = strlen(levels);
+    float max = 0;
+
+    for (i = 0; i < n; i++)
+        if (values[i] > max)
+            max = values[i];
+
+    memset(buf, ' ', PGSS_HIST_LEN - n);
+    for (i = 0; i < n; i++)
+        buf[PGSS_HIST_LEN - n + i] = (values[i] > 0 && max > 0)
+            ? levels[1 + (unsigned int) (values[i] / max * (nlevels - 1.01))]
+            : levels[0];
+    buf[PGSS_HIST_LEN] = '\0';
+}
+
+/*
+ ****************************************************************************
+ * Growth of values in percents: mean of the recent half of samples against
+ * mean of the older half. Too short history has no growth.
+ ****************************************************************************
+ */
+double pgss_growth(float values[], unsigned int n)
+{
+    double older = 0, recent = 0;
+    unsigned int i;
+
+    if (n < 4)
+        return 0;
+
+    for (i = 0; i < n / 2; i++)
+        older += values[i];
+    for (i = n - n / 2; i < n; i++)
+        recent += values[i];
+
+    if (older > 0)
+        return (recent - older) / older * 100;
+
+    return (recent > 0) ? 100 : 0;
+}
+
+/*
+ ****************************************************************************
+ * Format milliseconds as HH:MM:SS.
+ ****************************************************************************
+ */
+void format_ms(double ms, char * buf, size_t len)
+{
+    unsigned long secs = (ms > 0) ? ms / 1000 : 0;
+
+    snprintf(buf, len, "%02lu:%02lu:%02lu", secs / 3600, (secs / 60) % 60, secs % 60);
+}
+
+/*
+ ****************************************************************************
+ * Return part in percents of total, zero total gives zero.
+ ****************************************************************************
+ */
+double percent(double part, double total)
+{
+    return (total > 0) ? 100 * part / total : 0;
+}
+
+/*
+ ****************************************************************************
+ * Write query report using counters of the query and totals of all queries.
+ ****************************************************************************
+ */
+void write_query_report(FILE * fpout, PGresult * res, const char * query, const char * queryid)
+{
+    double all_total, all_io, all_cpu, all_calls, all_rows,
+           total, io, cpu, calls, rows, avg, avg_io, avg_cpu;
+    char all_total_s[XS_BUF_LEN], all_io_s[XS_BUF_LEN], all_cpu_s[XS_BUF_LEN], total_s[XS_BUF_LEN];
+
+    all_total = strtod(PQgetvalue(res, 0, REPC_ALL_TOTAL_TIME), NULL);
+    all_io = strtod(PQgetvalue(res, 0, REPC_ALL_IO_TIME), NULL);
+    all_cpu = all_total - all_io;
+    all_calls = strtod(PQgetvalue(res, 0, REPC_ALL_CALLS), NULL);
+    all_rows = strtod(PQgetvalue(res, 0, REPC_ALL_ROWS), NULL);
+    total = strtod(PQgetvalue(res, 0, REPC_TOTAL_TIME), NULL);
+    io = strtod(PQgetvalue(res, 0, REPC_IO_TIME), NULL);
+    cpu = total - io;
+    calls = strtod(PQgetvalue(res, 0, REPC_CALLS), NULL);
+    rows = strtod(PQgetvalue(res, 0, REPC_ROWS), NULL);
+
+    avg = (calls > 0) ? total / calls : 0;
+    avg_io = (calls > 0) ? io / calls : 0;
+    avg_cpu = (calls > 0) ? cpu / calls : 0;
+
+    format_ms(all_total, all_total_s, sizeof(all_total_s));
+    format_ms(all_io, all_io_s, sizeof(all_io_s));
+    format_ms(all_cpu, all_cpu_s, sizeof(all_cpu_s));
+    format_ms(total, total_s, sizeof(total_s));
+
+    fprintf(fpout, "summary:\n\ttotal_time: %s, cpu_time: %s, io_time: %s (ALL: %.2f%%, CPU: %.2f%%, IO: %.2f%%),\ttotal queries: %.0f\n\
+query info:\n\
+\tusename:\t\t\t\t%s,\n\
+\tdatname:\t\t\t\t%s,\n\
+\tcalls (relative to all queries):\t%.0f (%.2f%%),\n\
+\trows (relative to all queries):\t\t%.0f (%.2f%%),\n\
+\ttotal time (relative to all queries):\t%s (ALL: %.1f%%, CPU: %.1f%%, IO: %.1f%%),\n\
+\taverage time (only for this query):\t%.2fms, cpu_time: %.2fms, io_time: %.2fms, (ALL: %.1f%%, CPU: %.1f%%, IO: %.1f%%),\n\n\
+query text (id: %s):\n%s",
+        /* summary */
+        all_total_s, all_cpu_s, all_io_s,
+        percent(all_total, all_total), percent(all_cpu, all_total), percent(all_io, all_total),
+        all_calls,
+        /* user, dbname */
+        PQgetvalue(res, 0, REPC_USER), PQgetvalue(res, 0, REPC_DBNAME),
+        /* calls and rows */
+        calls, percent(calls, all_calls),
+        rows, percent(rows, all_rows),
+        /* timings */
+        total_s, percent(total, all_total), percent(cpu, all_cpu), percent(io, all_io),
+        /* averages */
+        avg, avg_cpu, avg_io,
+        (avg > 0) ? 100.0 : 0, percent(avg_cpu, avg), percent(avg_io, avg),
+        /* query */
+        queryid, query);
+}
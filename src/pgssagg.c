@@ -0,0 +1,290 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+ ****************************************************************************
+ * pgssagg.c
+ *      pg_stat_statements aggregates by database, by user and by both.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#include "include/pgssagg.h"
+
+/*
+ ****************************************************************************
+ * Allocate aggregates state.
+ ****************************************************************************
+ */
+struct pgss_agg_s * pgss_agg_init(void)
+{
+    struct pgss_agg_s * agg;
+
+    if ((agg = (struct pgss_agg_s *) malloc(PGSS_AGG_SIZE)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for statements aggregates failed.\n");
+    }
+    memset(agg, 0, PGSS_AGG_SIZE);
+
+    agg->groups_size = PGSS_AGG_GROUPS_MIN;
+    if ((agg->groups = malloc(agg->groups_size * sizeof(struct pgss_agg_group_s))) == NULL
+        || (agg->slots = calloc(agg->groups_size * 2, sizeof(int))) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for statements aggregates failed.\n");
+    }
+    agg->grouping = grouping_database;
+
+    return agg;
+}
+
+/*
+ ****************************************************************************
+ * Free aggregates state.
+ ****************************************************************************
+ */
+void free_pgss_agg(struct pgss_agg_s * agg)
+{
+    if (agg == NULL)
+        return;
+
+    free(agg->keys);
+    free(agg->used);
+    free(agg->counters);
+    free(agg->groups);
+    free(agg->slots);
+    free(agg);
+}
+
+/*
+ ****************************************************************************
+ * Name of grouping, for messages.
+ ****************************************************************************
+ */
+const char * pgss_grouping_name(enum pgss_grouping grouping)
+{
+    switch (grouping) {
+        case grouping_database:
+            return "database";
+        case grouping_user:
+            return "user";
+        case grouping_database_user: default:
+            return "database and user";
+    }
+}
+
+/*
+ ****************************************************************************
+ * Find statement slot by key. Return slot of the key or empty slot where the
+ * key should be placed, table is always at least half empty.
+ ****************************************************************************
+ */
+unsigned int lookup_pgss_agg(unsigned long long * keys, bool * used, unsigned int size, unsigned long long key)
+{
+    unsigned int i = key & (size - 1);
+
+    while (used[i] && keys[i] != key)
+        i = (i + 1) & (size - 1);
+
+    return i;
+}
+
+/*
+ ****************************************************************************
+ * Find group of the grouping or add new one, return index of the group.
+ * Groups are stored in array, hash table refers them by index, so the array
+ * can be reallocated.
+ ****************************************************************************
+ */
+unsigned int pgss_agg_group(struct pgss_agg_s * agg, enum pgss_grouping grouping,
+        const char * database, const char * user)
+{
+    struct pgss_agg_group_s * g;
+    unsigned int hash, mask, i, j;
+
+    /* grow groups and rehash them, so hash table is at least half empty */
+    if (agg->n_groups == agg->groups_size) {
+        agg->groups_size *= 2;
+        free(agg->slots);
+        if ((agg->groups = realloc(agg->groups, agg->groups_size * sizeof(struct pgss_agg_group_s))) == NULL
+            || (agg->slots = calloc(agg->groups_size * 2, sizeof(int))) == NULL) {
+            mreport(true, msg_fatal, "FATAL: malloc for statements aggregates failed.\n");
+        }
+        mask = agg->groups_size * 2 - 1;
+        for (j = 0; j < agg->n_groups; j++) {
+            for (i = agg->groups[j].hash & mask; agg->slots[i] != 0; i = (i + 1) & mask)
+                ;
+            agg->slots[i] = j + 1;
+        }
+    }
+
+    hash = hash_text(database, strlen(database)) ^ (hash_text(user, strlen(user)) * 31) ^ grouping;
+    mask = agg->groups_size * 2 - 1;
+    for (i = hash & mask; agg->slots[i] != 0; i = (i + 1) & mask) {
+        g = &agg->groups[agg->slots[i] - 1];
+        if (g->hash == hash && g->grouping == grouping
+                && !strcmp(g->database, database) && !strcmp(g->user, user))
+            return agg->slots[i] - 1;
+    }
+
+    g = &agg->groups[agg->n_groups];
+    memset(g, 0, sizeof(struct pgss_agg_group_s));
+    g->hash = hash;
+    g->grouping = grouping;
+    snprintf(g->database, sizeof(g->database), "%s", database);
+    snprintf(g->user, sizeof(g->user), "%s", user);
+    agg->slots[i] = ++agg->n_groups;
+
+    return agg->n_groups - 1;
+}
+
+/*
+ ****************************************************************************
+ * Aggregate statements of the new snapshot. Deltas are computed against the
+ * previous snapshot per statement: new statements are counted completely,
+ * reset counters are counted since reset, evicted statements are skipped.
+ * Then deltas are summed up into groups of all groupings.
+ ****************************************************************************
+ */
+void pgss_agg_snapshot(struct pgss_agg_s * agg, PGresult * res, double elapsed)
+{
+    unsigned long long * keys, key;
+    bool * used;
+    double * counters, delta[PGSS_AGG_COUNTERS];
+    unsigned int i, j, k, slot, size = PGSS_AGG_MIN_SIZE, n_rows = PQntuples(res);
+    const char * database, * user;
+    struct pgss_agg_group_s * g;
+    unsigned int groups[PGSS_GROUPINGS];
+
+    while (size < n_rows * 2)
+        size *= 2;
+
+    if ((keys = calloc(size, sizeof(unsigned long long))) == NULL
+        || (used = calloc(size, sizeof(bool))) == NULL
+        || (counters = calloc(size * PGSS_AGG_COUNTERS, sizeof(double))) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for statements aggregates failed.\n");
+    }
+
+    agg->n_groups = 0;
+    memset(agg->slots, 0, agg->groups_size * 2 * sizeof(int));
+
+    for (i = 0; i < n_rows; i++) {
+        database = PQgetvalue(res, i, PGSS_AGG_DATABASE_COL);
+        user = PQgetvalue(res, i, PGSS_AGG_USER_COL);
+        key = pgss_hist_key(user, database, PQgetvalue(res, i, PGSS_AGG_QUERYID_COL));
+
+        /* statements with colliding keys share the slot */
+        slot = lookup_pgss_agg(keys, used, size, key);
+        keys[slot] = key;
+        used[slot] = true;
+        for (j = 0; j < PGSS_AGG_COUNTERS; j++) {
+            delta[j] = atof(PQgetvalue(res, i, PGSS_AGG_SRC_COL + j));
+            counters[slot * PGSS_AGG_COUNTERS + j] += delta[j];
+        }
+
+        if (agg->has_prev) {
+            k = lookup_pgss_agg(agg->keys, agg->used, agg->size, key);
+            if (agg->used[k])
+                for (j = 0; j < PGSS_AGG_COUNTERS; j++)
+                    if (delta[j] >= agg->counters[k * PGSS_AGG_COUNTERS + j])
+                        delta[j] -= agg->counters[k * PGSS_AGG_COUNTERS + j];
+        }
+
+        groups[grouping_database] = pgss_agg_group(agg, grouping_database, database, "");
+        groups[grouping_user] = pgss_agg_group(agg, grouping_user, "", user);
+        groups[grouping_database_user] = pgss_agg_group(agg, grouping_database_user, database, user);
+        for (k = 0; k < PGSS_GROUPINGS; k++) {
+            g = &agg->groups[groups[k]];
+            g->statements++;
+            for (j = 0; j < PGSS_AGG_COUNTERS; j++)
+                g->deltas[j] += delta[j];
+        }
+    }
+
+    free(agg->keys);
+    free(agg->used);
+    free(agg->counters);
+    agg->keys = keys;
+    agg->used = used;
+    agg->counters = counters;
+    agg->size = size;
+    agg->has_rates = agg->has_prev;
+    agg->has_prev = true;
+    agg->elapsed = elapsed;
+}
+
+/*
+ ****************************************************************************
+ * Replace statements snapshot with per second rates of statements grouped
+ * by database, by user or by both, depending on grouping of the tab. Rates
+ * are empty until the second snapshot.
+ ****************************************************************************
+ */
+PGresult * merge_pgss_groups(PGconn * conn, PGresult * res, struct tab_s * tab)
+{
+    static const char * names[PGSS_AGG_COLS] = { "database", "user", "statements",
+        "calls_s", "time_ms_s", "avg_ms", "hit_kbs", "read_kbs", "tmp_read_kbs", "tmp_write_kbs" };
+    PGresult * new_res;
+    PGresAttDesc attrs[PGSS_AGG_COLS];
+    struct pgss_agg_s * agg;
+    struct pgss_agg_group_s * g;
+    struct timespec ts;
+    char values[PGSS_AGG_COLS][S_BUF_LEN];
+    unsigned int i, j, k;
+    double elapsed = 0;
+
+    if (PQnfields(res) < PGSS_AGG_SRC_COL + PGSS_AGG_COUNTERS)
+        return res;
+
+    memset(attrs, 0, sizeof(attrs));
+    for (i = 0; i < PGSS_AGG_COLS; i++) {
+        attrs[i].name = (char *) names[i];
+        attrs[i].typid = (i < 2) ? TEXTOID : (i == 2) ? INT8OID : FLOAT8OID;
+        attrs[i].typlen = (i < 2) ? -1 : 8;
+        attrs[i].atttypmod = -1;
+    }
+
+    if ((new_res = PQmakeEmptyPGresult(conn, PGRES_TUPLES_OK)) == NULL
+        || PQsetResultAttrs(new_res, PGSS_AGG_COLS, attrs) == 0) {
+        PQclear(new_res);
+        return res;
+    }
+
+    if (tab->pgss_agg == NULL)
+        tab->pgss_agg = pgss_agg_init();
+    agg = tab->pgss_agg;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if (agg->has_prev)
+        elapsed = (ts.tv_sec - agg->ts.tv_sec) + (ts.tv_nsec - agg->ts.tv_nsec) / 1000000000.0;
+
+    /* too frequent snapshot, e.g. after grouping switch, is only shown */
+    if (!agg->has_prev || elapsed >= PGSS_AGG_MIN_ELAPSED) {
+        pgss_agg_snapshot(agg, res, elapsed);
+        agg->ts = ts;
+    }
+
+    for (i = 0, k = 0; i < agg->n_groups; i++) {
+        g = &agg->groups[i];
+        if (g->grouping != agg->grouping)
+            continue;
+
+        snprintf(values[0], sizeof(values[0]), "%s", (g->grouping == grouping_user) ? "all" : g->database);
+        snprintf(values[1], sizeof(values[1]), "%s", (g->grouping == grouping_database) ? "all" : g->user);
+        snprintf(values[2], sizeof(values[2]), "%u", g->statements);
+        for (j = 3; j < PGSS_AGG_COLS; j++)
+            values[j][0] = '\0';
+        if (agg->has_rates && agg->elapsed > 0) {
+            snprintf(values[3], sizeof(values[3]), "%.2f", g->deltas[0] / agg->elapsed);
+            snprintf(values[4], sizeof(values[4]), "%.2f", g->deltas[1] / agg->elapsed);
+            snprintf(values[5], sizeof(values[5]), "%.2f", (g->deltas[0] > 0) ? g->deltas[1] / g->deltas[0] : 0);
+            for (j = 2; j < PGSS_AGG_COUNTERS; j++)
+                snprintf(values[j + 4], sizeof(values[j + 4]), "%.2f", g->deltas[j] / agg->elapsed);
+        }
+
+        for (j = 0; j < PGSS_AGG_COLS; j++)
+            PQsetvalue(new_res, k, j, values[j], strlen(values[j]));
+        k++;
+    }
+
+    PQclear(res);
+    return new_res;
+}
@@ -0,0 +1,341 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+ ****************************************************************************
+ * procstat.c
+ *      per-process OS stats of postgres backends.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#include "include/procstat.h"
+
+/* processes cache is shared by all tabs, pids are unique within the host */
+static struct proc_cache_s cache = { NULL, 0, false, { 0, 0 } };
+
+/*
+ ****************************************************************************
+ * Find slot for pid: slot with the same pid or the first empty slot.
+ * Slots with negative pid are moved ones and are skipped.
+ ****************************************************************************
+ */
+struct procstat_s * proc_cache_lookup(struct procstat_s * slots, unsigned int size, pid_t pid)
+{
+    unsigned int i = ((unsigned int) pid * 2654435761U) & (size - 1);
+
+    while (slots[i].pid != 0 && slots[i].pid != pid)
+        i = (i + 1) & (size - 1);
+
+    return &slots[i];
+}
+
+/*
+ ****************************************************************************
+ * Raise soft limit of open files up to hard limit, descriptors are cached
+ * for every process and there may be thousands of backends.
+ ****************************************************************************
+ */
+void raise_nofile_limit(void)
+{
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+/*
+ ****************************************************************************
+ * Open /proc files of the process. When the limit of open files is reached,
+ * the files are opened on every read.
+ ****************************************************************************
+ */
+void open_proc_files(struct procstat_s * p)
+{
+    char path[S_BUF_LEN];
+
+    if (cache.fd_exhausted)
+        return;
+
+    snprintf(path, sizeof(path), PROC_STAT_FILE, p->pid);
+    if ((p->stat_fd = open(path, O_RDONLY | O_CLOEXEC)) < 0
+        && (errno == EMFILE || errno == ENFILE)) {
+        cache.fd_exhausted = true;
+        return;
+    }
+
+    snprintf(path, sizeof(path), PROC_IO_FILE, p->pid);
+    if ((p->io_fd = open(path, O_RDONLY | O_CLOEXEC)) < 0
+        && (errno == EMFILE || errno == ENFILE))
+        cache.fd_exhausted = true;
+}
+
+/*
+ ****************************************************************************
+ * Close cached /proc files of the process.
+ ****************************************************************************
+ */
+void close_proc_files(struct procstat_s * p)
+{
+    if (p->stat_fd >= 0)
+        close(p->stat_fd);
+    if (p->io_fd >= 0)
+        close(p->io_fd);
+    p->stat_fd = p->io_fd = -1;
+}
+
+/*
+ ****************************************************************************
+ * Read content of /proc file using cached fd or open file if fd isn't cached.
+ * Return number of read bytes or -1 on error.
+ ****************************************************************************
+ */
+ssize_t read_proc_file(int fd, const char * fmt, pid_t pid, char * buf, size_t len)
+{
+    char path[S_BUF_LEN];
+    ssize_t n;
+
+    if (fd >= 0) {
+        /* /proc files are regenerated when read from the beginning */
+        n = pread(fd, buf, len - 1, 0);
+    } else {
+        snprintf(path, sizeof(path), fmt, pid);
+        if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+            return -1;
+        n = read(fd, buf, len - 1);
+        close(fd);
+    }
+
+    if (n >= 0)
+        buf[n] = '\0';
+    return n;
+}
+
+/*
+ ****************************************************************************
+ * Read /proc/<pid>/stat and /proc/<pid>/io of the process into curr.
+ * Files are reopened when cached descriptors are stale. Return false if
+ * process stats are not available.
+ ****************************************************************************
+ */
+bool read_proc_stats(struct procstat_s * p, struct procstat_s * curr)
+{
+    char buf[XL_BUF_LEN], * ptr;
+
+    if (read_proc_file(p->stat_fd, PROC_STAT_FILE, p->pid, buf, sizeof(buf)) <= 0) {
+        /*
+         * Cached fd refers to exited process, but its pid may be already
+         * reused by a new backend, so reopen files and retry once.
+         */
+        if (p->stat_fd < 0)
+            return false;
+        close_proc_files(p);
+        open_proc_files(p);
+        p->has_prev = false;
+        if (read_proc_file(p->stat_fd, PROC_STAT_FILE, p->pid, buf, sizeof(buf)) <= 0)
+            return false;
+    }
+
+    /* process name may contain spaces and brackets, skip it */
+    if ((ptr = strrchr(buf, ')')) == NULL)
+        return false;
+
+    if (sscanf(ptr + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu %*d %*d %*d %*d %*d %*d %llu %*u %ld",
+                &curr->utime, &curr->stime, &curr->starttime, &curr->rss) != 4)
+        return false;
+
+    /* io stats requires the same user as postgres or root privileges */
+    curr->read_bytes = curr->write_bytes = 0;
+    if (read_proc_file(p->io_fd, PROC_IO_FILE, p->pid, buf, sizeof(buf)) > 0) {
+        if ((ptr = strstr(buf, "\nread_bytes:")) != NULL)
+            curr->read_bytes = strtoull(ptr + 12, NULL, 10);
+        if ((ptr = strstr(buf, "\nwrite_bytes:")) != NULL)
+            curr->write_bytes = strtoull(ptr + 13, NULL, 10);
+    }
+
+    return true;
+}
+
+/*
+ ****************************************************************************
+ * Rebuild processes cache using pids from the query result. Processes which
+ * still alive keep their descriptors and counters, descriptors of exited
+ * processes are closed, new processes are opened in a single batch.
+ ****************************************************************************
+ */
+void rebuild_proc_cache(PGresult * res)
+{
+    struct procstat_s * slots, * p, * old;
+    unsigned int i, size = PROC_CACHE_MIN_SIZE, n_rows = PQntuples(res);
+    pid_t pid;
+
+    /* keep load factor below 0.5 */
+    while (size < n_rows * 2)
+        size <<= 1;
+
+    if ((slots = (struct procstat_s *) calloc(size, PROCSTAT_SIZE)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: calloc for processes cache failed.\n");
+    }
+
+    for (i = 0; i < n_rows; i++) {
+        if ((pid = atoi(PQgetvalue(res, i, 0))) <= 0)
+            continue;
+
+        p = proc_cache_lookup(slots, size, pid);
+        if (p->pid == pid)
+            continue;
+
+        if (cache.slots != NULL && (old = proc_cache_lookup(cache.slots, cache.size, pid))->pid == pid) {
+            *p = *old;
+            old->pid = -1;                  /* mark as moved */
+        } else {
+            p->pid = pid;
+            p->stat_fd = p->io_fd = -1;
+            p->has_prev = false;
+        }
+    }
+
+    /* close descriptors of exited processes */
+    if (cache.slots != NULL) {
+        for (i = 0; i < cache.size; i++)
+            if (cache.slots[i].pid > 0)
+                close_proc_files(&cache.slots[i]);
+        free(cache.slots);
+    }
+
+    cache.slots = slots;
+    cache.size = size;
+
+    /* open files of new processes */
+    for (i = 0; i < size; i++)
+        if (slots[i].pid > 0 && slots[i].stat_fd < 0)
+            open_proc_files(&slots[i]);
+}
+
+/*
+ ****************************************************************************
+ * Close all cached descriptors and free processes cache.
+ ****************************************************************************
+ */
+void close_proc_cache(void)
+{
+    unsigned int i;
+
+    if (cache.slots == NULL)
+        return;
+
+    for (i = 0; i < cache.size; i++)
+        if (cache.slots[i].pid > 0)
+            close_proc_files(&cache.slots[i]);
+
+    free(cache.slots);
+    cache.slots = NULL;
+    cache.size = 0;
+    cache.fd_exhausted = false;
+    cache.ts.tv_sec = cache.ts.tv_nsec = 0;
+}
+
+/*
+ ****************************************************************************
+ * Build new query result which contains OS-level stats of every process
+ * from the source result. Stats columns are inserted before the last
+ * (query) column. Source result is freed.
+ ****************************************************************************
+ */
+PGresult * merge_proc_stats(PGconn * conn, PGresult * res, struct tab_s * tab)
+{
+    static bool limit_raised = false;
+    static const char * names[PROC_NEW_COLS] = { "cpu_usr", "cpu_sys", "read_kbs", "write_kbs", "rss_mb" };
+    static long page_size = 0;
+    PGresult * new_res;
+    PGresAttDesc attrs[MAX_COLS];
+    struct procstat_s * p, curr;
+    struct timespec now;
+    double elapsed = 0, rates[PROC_NEW_COLS];
+    char value[XS_BUF_LEN];
+    unsigned int i, j, n_rows = PQntuples(res), n_cols = PQnfields(res);
+
+    if (n_cols == 0 || n_cols + PROC_NEW_COLS > MAX_COLS)
+        return res;
+
+    if (!limit_raised) {
+        raise_nofile_limit();
+        page_size = sysconf(_SC_PAGESIZE);
+        limit_raised = true;
+    }
+
+    /* describe columns: source columns plus stats columns before the last one */
+    memset(attrs, 0, sizeof(attrs));
+    for (i = 0, j = 0; i < n_cols + PROC_NEW_COLS; i++) {
+        if (i >= n_cols - 1 && i < n_cols - 1 + PROC_NEW_COLS) {
+            attrs[i].name = (char *) names[i - (n_cols - 1)];
+            attrs[i].typid = 701;           /* float8 */
+            attrs[i].typlen = 8;
+        } else {
+            attrs[i].name = PQfname(res, j);
+            attrs[i].typid = PQftype(res, j);
+            attrs[i].typlen = PQfsize(res, j);
+            attrs[i].atttypmod = PQfmod(res, j);
+            j++;
+        }
+        attrs[i].format = 0;
+    }
+
+    if ((new_res = PQmakeEmptyPGresult(conn, PGRES_TUPLES_OK)) == NULL
+        || PQsetResultAttrs(new_res, n_cols + PROC_NEW_COLS, attrs) == 0) {
+        PQclear(new_res);
+        return res;
+    }
+
+    /* process stats are available only for local postgres */
+    if (tab->conn_local) {
+        rebuild_proc_cache(res);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (cache.ts.tv_sec != 0)
+            elapsed = (now.tv_sec - cache.ts.tv_sec) + (now.tv_nsec - cache.ts.tv_nsec) / 1000000000.0;
+        cache.ts = now;
+    }
+
+    for (i = 0; i < n_rows; i++) {
+        for (j = 0; j < PROC_NEW_COLS; j++)
+            rates[j] = 0;
+
+        p = NULL;
+        if (tab->conn_local && atoi(PQgetvalue(res, i, 0)) > 0)
+            p = proc_cache_lookup(cache.slots, cache.size, atoi(PQgetvalue(res, i, 0)));
+
+        if (p != NULL && p->pid > 0 && read_proc_stats(p, &curr)) {
+            /* pid might be reused by a new process */
+            if (p->has_prev && p->starttime == curr.starttime && elapsed > 0) {
+                rates[0] = (curr.utime - p->utime) * 100.0 / tab->sys_special.sys_hz / elapsed;
+                rates[1] = (curr.stime - p->stime) * 100.0 / tab->sys_special.sys_hz / elapsed;
+                rates[2] = (curr.read_bytes - p->read_bytes) / 1024.0 / elapsed;
+                rates[3] = (curr.write_bytes - p->write_bytes) / 1024.0 / elapsed;
+            }
+            rates[4] = (double) curr.rss * page_size / 1048576;
+
+            p->utime = curr.utime;
+            p->stime = curr.stime;
+            p->starttime = curr.starttime;
+            p->read_bytes = curr.read_bytes;
+            p->write_bytes = curr.write_bytes;
+            p->rss = curr.rss;
+            p->has_prev = true;
+        }
+
+        for (j = 0; j < n_cols - 1; j++)
+            PQsetvalue(new_res, i, j, PQgetvalue(res, i, j), PQgetlength(res, i, j));
+        for (j = 0; j < PROC_NEW_COLS; j++) {
+            snprintf(value, sizeof(value), "%.2f", rates[j]);
+            PQsetvalue(new_res, i, n_cols - 1 + j, value, strlen(value));
+        }
+        PQsetvalue(new_res, i, n_cols - 1 + PROC_NEW_COLS,
+                PQgetvalue(res, i, n_cols - 1), PQgetlength(res, i, n_cols - 1));
+    }
+
+    PQclear(res);
+    return new_res;
+}
@@ -0,0 +1,232 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+ ****************************************************************************
+ * progress.c
+ *      progress rates and time estimation of vacuum and other commands.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#include "include/progress.h"
+
+/*
+ ****************************************************************************
+ * Allocate progress state.
+ ****************************************************************************
+ */
+struct progress_s * progress_init(void)
+{
+    struct progress_s * ps;
+
+    if ((ps = (struct progress_s *) malloc(PROGRESS_SIZE)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for progress stats failed.\n");
+    }
+    memset(ps, 0, PROGRESS_SIZE);
+
+    return ps;
+}
+
+/*
+ ****************************************************************************
+ * Find command by its key or add new one. Return NULL when too many
+ * commands are tracked.
+ ****************************************************************************
+ */
+struct progress_entry_s * progress_lookup(struct progress_s * ps, const char * key)
+{
+    struct progress_entry_s * e;
+    unsigned int hash = hash_text(key, strlen(key)), i;
+
+    for (i = 0; i < ps->used; i++)
+        if (ps->entries[i].hash == hash && !strcmp(ps->entries[i].key, key))
+            return &ps->entries[i];
+
+    if (ps->used == PROGRESS_MAX)
+        return NULL;
+
+    e = &ps->entries[ps->used++];
+    memset(e, 0, sizeof(struct progress_entry_s));
+    e->hash = hash;
+    snprintf(e->key, sizeof(e->key), "%s", key);
+
+    return e;
+}
+
+/*
+ ****************************************************************************
+ * Update rates of command using counters from the new snapshot. Counters
+ * of different phases aren't comparable, so rates are started again when
+ * phase is changed or counters are reset.
+ ****************************************************************************
+ */
+void progress_update(struct progress_entry_s * e, const char * phase, long long scanned,
+        long long vacuumed, struct timespec * ts)
+{
+    double elapsed, scan_rate, vac_rate;
+
+    if (e->has_prev && (strcmp(e->phase, phase) || scanned < e->scanned || vacuumed < e->vacuumed)) {
+        e->has_rates = false;
+    } else if (e->has_prev) {
+        elapsed = (ts->tv_sec - e->ts.tv_sec) + (ts->tv_nsec - e->ts.tv_nsec) / 1000000000.0;
+        if (elapsed < PROGRESS_MIN_ELAPSED)
+            return;
+
+        scan_rate = (scanned - e->scanned) / elapsed;
+        vac_rate = (vacuumed - e->vacuumed) / elapsed;
+
+        if (e->has_rates) {
+            e->scan_rate += PROGRESS_SMOOTH * (scan_rate - e->scan_rate);
+            e->vac_rate += PROGRESS_SMOOTH * (vac_rate - e->vac_rate);
+        } else {
+            e->scan_rate = scan_rate;
+            e->vac_rate = vac_rate;
+            e->has_rates = true;
+        }
+    }
+
+    snprintf(e->phase, sizeof(e->phase), "%s", phase);
+    e->scanned = scanned;
+    e->vacuumed = vacuumed;
+    e->ts = *ts;
+    e->has_prev = true;
+}
+
+/*
+ ****************************************************************************
+ * Estimate time until the current phase is finished. Vacuum reports amount
+ * of work only for heap scanning and heap vacuuming phases, other commands
+ * report it for all phases which have the total amount.
+ ****************************************************************************
+ */
+void format_progress_eta(struct progress_entry_s * e, const char * command, long long total,
+        long long scanned, long long vacuumed, char * buf, size_t len)
+{
+    long long left;
+    double rate, eta;
+
+    buf[0] = '\0';
+    if (!e->has_rates || total <= 0)
+        return;
+
+    if (!strcmp(command, "vacuum")) {
+        if (!strcmp(e->phase, "scanning heap")) {
+            left = total - scanned;
+            rate = e->scan_rate;
+        } else if (!strcmp(e->phase, "vacuuming heap")) {
+            left = total - vacuumed;
+            rate = e->vac_rate;
+        } else
+            return;
+    } else {
+        left = total - scanned;
+        rate = e->scan_rate;
+    }
+
+    if (left <= 0) {
+        snprintf(buf, len, "00:00:00");
+    } else if (rate > 0) {
+        eta = left / rate;
+        (eta >= 100 * 3600)
+            ? snprintf(buf, len, ">99h")
+            : snprintf(buf, len, "%02d:%02d:%02d",
+                    (int) eta / 3600, ((int) eta % 3600) / 60, (int) eta % 60);
+    }
+}
+
+/*
+ ****************************************************************************
+ * Add processing and vacuuming rates and ETA of the current phase into
+ * progress result, before the query column. Commands are tracked by pid,
+ * command and relation, commands which are finished are forgotten.
+ ****************************************************************************
+ */
+PGresult * merge_progress_stats(PGconn * conn, PGresult * res, struct tab_s * tab)
+{
+    static const char * names[PROGRESS_COLS] = { "scan_kbs", "vac_kbs", "eta" };
+    PGresult * new_res;
+    PGresAttDesc attrs[MAX_COLS];
+    struct progress_s * ps;
+    struct progress_entry_s * e;
+    struct timespec ts;
+    char key[S_BUF_LEN], values[PROGRESS_COLS][S_BUF_LEN];
+    unsigned int i, j, n_rows = PQntuples(res), n_cols = PQnfields(res);
+    long long total, scanned, vacuumed;
+
+    if (n_cols <= PROGRESS_VACUUMED_COL + 1 || n_cols + PROGRESS_COLS > MAX_COLS)
+        return res;
+
+    if (tab->progress == NULL)
+        tab->progress = progress_init();
+    ps = tab->progress;
+
+    /* new columns are placed before the last one, the query */
+    memset(attrs, 0, sizeof(attrs));
+    for (i = 0; i < n_cols; i++) {
+        j = (i < n_cols - 1) ? i : n_cols + PROGRESS_COLS - 1;
+        attrs[j].name = PQfname(res, i);
+        attrs[j].typid = PQftype(res, i);
+        attrs[j].typlen = PQfsize(res, i);
+        attrs[j].atttypmod = PQfmod(res, i);
+    }
+    for (i = 0; i < PROGRESS_COLS; i++) {
+        attrs[n_cols - 1 + i].name = (char *) names[i];
+        attrs[n_cols - 1 + i].typid = (i < 2) ? FLOAT8OID : TEXTOID;
+        attrs[n_cols - 1 + i].typlen = (i < 2) ? 8 : -1;
+        attrs[n_cols - 1 + i].atttypmod = -1;
+    }
+
+    if ((new_res = PQmakeEmptyPGresult(conn, PGRES_TUPLES_OK)) == NULL
+        || PQsetResultAttrs(new_res, n_cols + PROGRESS_COLS, attrs) == 0) {
+        PQclear(new_res);
+        return res;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    for (i = 0; i < ps->used; i++)
+        ps->entries[i].seen = false;
+
+    for (i = 0; i < n_rows; i++) {
+        snprintf(key, sizeof(key), "%s/%s/%s", PQgetvalue(res, i, PROGRESS_PID_COL),
+                PQgetvalue(res, i, PROGRESS_COMMAND_COL), PQgetvalue(res, i, PROGRESS_RELATION_COL));
+        total = atoll(PQgetvalue(res, i, PROGRESS_TOTAL_COL));
+        scanned = atoll(PQgetvalue(res, i, PROGRESS_SCANNED_COL));
+        vacuumed = atoll(PQgetvalue(res, i, PROGRESS_VACUUMED_COL));
+
+        for (j = 0; j < PROGRESS_COLS; j++)
+            values[j][0] = '\0';
+
+        if ((e = progress_lookup(ps, key)) != NULL) {
+            e->seen = true;
+            progress_update(e, PQgetvalue(res, i, PROGRESS_PHASE_COL), scanned, vacuumed, &ts);
+            if (e->has_rates) {
+                snprintf(values[0], sizeof(values[0]), "%.2f", e->scan_rate);
+                if (!PQgetisnull(res, i, PROGRESS_VACUUMED_COL))
+                    snprintf(values[1], sizeof(values[1]), "%.2f", e->vac_rate);
+            }
+            format_progress_eta(e, PQgetvalue(res, i, PROGRESS_COMMAND_COL), total, scanned, vacuumed,
+                    values[2], sizeof(values[2]));
+        }
+
+        for (j = 0; j < n_cols - 1; j++)
+            PQsetvalue(new_res, i, j, PQgetvalue(res, i, j), PQgetlength(res, i, j));
+        for (j = 0; j < PROGRESS_COLS; j++)
+            PQsetvalue(new_res, i, n_cols - 1 + j, values[j], strlen(values[j]));
+        PQsetvalue(new_res, i, n_cols + PROGRESS_COLS - 1,
+                PQgetvalue(res, i, n_cols - 1), PQgetlength(res, i, n_cols - 1));
+    }
+
+    /* forget commands which are finished */
+    for (i = 0; i < ps->used; ) {
+        if (ps->entries[i].seen) {
+            i++;
+            continue;
+        }
+        ps->entries[i] = ps->entries[--ps->used];
+    }
+
+    PQclear(res);
+    return new_res;
+}
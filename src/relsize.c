@@ -0,0 +1,173 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+ ****************************************************************************
+ * relsize.c
+ *      tables sizes tracking, sizes are sampled in round-robin slices.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#include "include/relsize.h"
+
+/*
+ ****************************************************************************
+ * Choose tables for measuring at this refresh and make array of their oids.
+ * New tables go first, then the rest in round-robin order, thus all sizes
+ * are refreshed every (number of tables / RELSIZE_SLICE) refreshes.
+ * Return number of chosen tables.
+ ****************************************************************************
+ */
+unsigned int relsize_slice(struct oidmap_s * rs, char ** oids)
+{
+    struct relsize_entry_s * entries = rs->entries;
+    unsigned int i, j, start, n = 0;
+    size_t len = 0, buf_len = RELSIZE_SLICE * 12 + 3;
+
+    if ((*oids = malloc(buf_len)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for tables sizes failed.\n");
+    }
+    len += snprintf(*oids + len, buf_len - len, "{");
+
+    for (i = 0; i < rs->used && n < RELSIZE_SLICE; i++)
+        if (!entries[i].measured) {
+            len += snprintf(*oids + len, buf_len - len, (n == 0) ? "%u" : ",%u", entries[i].relid);
+            n++;
+        }
+
+    /* continue from the table after the last measured one */
+    for (start = 0; start < rs->used && entries[start].relid <= rs->cursor; start++)
+        ;
+    for (i = 0; i < rs->used && n < RELSIZE_SLICE; i++) {
+        j = (start + i) % rs->used;
+        if (!entries[j].measured)
+            continue;
+        len += snprintf(*oids + len, buf_len - len, (n == 0) ? "%u" : ",%u", entries[j].relid);
+        rs->cursor = entries[j].relid;
+        n++;
+    }
+
+    snprintf(*oids + len, buf_len - len, "}");
+    return n;
+}
+
+/*
+ ****************************************************************************
+ * Measure sizes of the next slice of tables and update their change rates
+ * using the previous measurements.
+ ****************************************************************************
+ */
+void relsize_measure(struct oidmap_s * rs, PGconn * conn)
+{
+    PGresult * res;
+    struct relsize_entry_s * e;
+    struct timespec now;
+    const char * params[1];
+    char * oids;
+    double elapsed;
+    long long rel_size, idx_size;
+    int i;
+
+    if (relsize_slice(rs, &oids) == 0) {
+        free(oids);
+        return;
+    }
+
+    params[0] = oids;
+    res = exec_prepared(conn, PG_TABLES_SIZE_SLICE_QUERY, 1, params, 0);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+        for (i = 0; i < PQntuples(res); i++) {
+            if ((e = oidmap_lookup(rs, strtoul(PQgetvalue(res, i, 0), NULL, 10))) == NULL
+                    || PQgetisnull(res, i, 1) || PQgetisnull(res, i, 2))
+                continue;
+
+            rel_size = atoll(PQgetvalue(res, i, 1));
+            idx_size = atoll(PQgetvalue(res, i, 2));
+            if (e->measured) {
+                elapsed = (now.tv_sec - e->ts.tv_sec) + (now.tv_nsec - e->ts.tv_nsec) / 1000000000.0;
+                if (elapsed > 0) {
+                    e->rel_rate = (rel_size - e->rel_size) / elapsed;
+                    e->idx_rate = (idx_size - e->idx_size) / elapsed;
+                    e->has_rates = true;
+                }
+            }
+            e->rel_size = rel_size;
+            e->idx_size = idx_size;
+            e->ts = now;
+            e->measured = true;
+        }
+    }
+    PQclear(res);
+    free(oids);
+}
+
+/*
+ ****************************************************************************
+ * Replace list of tables with their cached sizes and change rates. Sizes
+ * of only one slice of tables are requested at every refresh, the rest are
+ * taken from the cache, not yet measured tables have empty sizes.
+ ****************************************************************************
+ */
+PGresult * merge_rel_sizes(PGconn * conn, PGresult * res, struct tab_s * tab)
+{
+    static const char * names[RELSIZE_COLS] = { "relation", "total_size", "rel_size", "idx_size",
+        "total_change", "rel_change", "idx_change" };
+    PGresult * new_res;
+    PGresAttDesc attrs[RELSIZE_COLS];
+    struct oidmap_s * rs;
+    struct relsize_entry_s * e;
+    char values[RELSIZE_COLS][S_BUF_LEN];
+    unsigned int i, j;
+
+    if (PQnfields(res) < 2)
+        return res;
+
+    memset(attrs, 0, sizeof(attrs));
+    for (i = 0; i < RELSIZE_COLS; i++) {
+        attrs[i].name = (char *) names[i];
+        attrs[i].typid = (i == 0) ? TEXTOID : (i < 4) ? INT8OID : FLOAT8OID;
+        attrs[i].typlen = (i == 0) ? -1 : 8;
+        attrs[i].atttypmod = -1;
+    }
+
+    if ((new_res = PQmakeEmptyPGresult(conn, PGRES_TUPLES_OK)) == NULL
+        || PQsetResultAttrs(new_res, RELSIZE_COLS, attrs) == 0) {
+        PQclear(new_res);
+        return res;
+    }
+
+    if (tab->relsize == NULL)
+        tab->relsize = oidmap_init(sizeof(struct relsize_entry_s));
+    rs = tab->relsize;
+
+    /* sizes of known tables are kept, new tables are added as not measured */
+    oidmap_rebuild(rs, res, 0);
+    relsize_measure(rs, conn);
+
+    for (i = 0; i < (unsigned int) PQntuples(res); i++) {
+        for (j = 0; j < RELSIZE_COLS; j++)
+            values[j][0] = '\0';
+        snprintf(values[0], sizeof(values[0]), "%s", PQgetvalue(res, i, 1));
+
+        e = oidmap_lookup(rs, strtoul(PQgetvalue(res, i, 0), NULL, 10));
+        if (e != NULL && e->measured) {
+            snprintf(values[1], sizeof(values[1]), "%lli", e->rel_size + e->idx_size);
+            snprintf(values[2], sizeof(values[2]), "%lli", e->rel_size);
+            snprintf(values[3], sizeof(values[3]), "%lli", e->idx_size);
+        }
+        if (e != NULL && e->has_rates) {
+            snprintf(values[4], sizeof(values[4]), "%.2f", e->rel_rate + e->idx_rate);
+            snprintf(values[5], sizeof(values[5]), "%.2f", e->rel_rate);
+            snprintf(values[6], sizeof(values[6]), "%.2f", e->idx_rate);
+        }
+
+        for (j = 0; j < RELSIZE_COLS; j++)
+            PQsetvalue(new_res, i, j, values[j], strlen(values[j]));
+    }
+
+    PQclear(res);
+    return new_res;
+}
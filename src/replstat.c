@@ -0,0 +1,296 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+ ****************************************************************************
+ * replstat.c
+ *      replication lag rates and catch-up estimation of standbys.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#include "include/replstat.h"
+
+/*
+ ****************************************************************************
+ * Allocate replication state.
+ ****************************************************************************
+ */
+struct replstat_s * replstat_init(void)
+{
+    struct replstat_s * rs;
+
+    if ((rs = (struct replstat_s *) malloc(REPLSTAT_SIZE)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for replication stats failed.\n");
+    }
+    memset(rs, 0, REPLSTAT_SIZE);
+
+    return rs;
+}
+
+/*
+ ****************************************************************************
+ * Close connections to standbys.
+ ****************************************************************************
+ */
+void replstat_disconnect(struct replstat_s * rs)
+{
+    unsigned int i;
+
+    for (i = 0; i < rs->used; i++) {
+        PQfinish(rs->entries[i].conn);
+        rs->entries[i].conn = NULL;
+        rs->entries[i].retry_at = 0;
+        rs->entries[i].downstream[0] = '\0';
+    }
+}
+
+/*
+ ****************************************************************************
+ * Free replication state and close its connections.
+ ****************************************************************************
+ */
+void replstat_free(struct replstat_s * rs)
+{
+    if (rs == NULL)
+        return;
+
+    replstat_disconnect(rs);
+    free(rs);
+}
+
+/*
+ ****************************************************************************
+ * Find standby by its key or add new one. Return NULL when too many
+ * standbys are tracked.
+ ****************************************************************************
+ */
+struct replstat_entry_s * replstat_lookup(struct replstat_s * rs, const char * key)
+{
+    struct replstat_entry_s * e;
+    unsigned int hash = hash_text(key, strlen(key)), i;
+
+    for (i = 0; i < rs->used; i++)
+        if (rs->entries[i].hash == hash && !strcmp(rs->entries[i].key, key))
+            return &rs->entries[i];
+
+    if (rs->used == REPLSTAT_MAX)
+        return NULL;
+
+    e = &rs->entries[rs->used++];
+    memset(e, 0, sizeof(struct replstat_entry_s));
+    e->hash = hash;
+    snprintf(e->key, sizeof(e->key), "%s", key);
+
+    return e;
+}
+
+/*
+ ****************************************************************************
+ * Update rates of standby using its positions from the new snapshot. Rates
+ * are smoothed, too frequent snapshots (e.g. after context switch) are
+ * skipped.
+ ****************************************************************************
+ */
+void replstat_update(struct replstat_entry_s * e, long long replay_pos, long long lag, struct timespec * ts)
+{
+    double elapsed, replay_rate, lag_rate;
+
+    if (e->has_prev) {
+        elapsed = (ts->tv_sec - e->ts.tv_sec) + (ts->tv_nsec - e->ts.tv_nsec) / 1000000000.0;
+        if (elapsed < REPLSTAT_MIN_ELAPSED)
+            return;
+
+        replay_rate = (replay_pos - e->replay_pos) / elapsed;
+        lag_rate = (lag - e->lag) / elapsed;
+        if (replay_rate < 0)            /* standby is restarted from older position */
+            replay_rate = 0;
+
+        if (e->has_rates) {
+            e->replay_rate += REPLSTAT_SMOOTH * (replay_rate - e->replay_rate);
+            e->lag_rate += REPLSTAT_SMOOTH * (lag_rate - e->lag_rate);
+        } else {
+            e->replay_rate = replay_rate;
+            e->lag_rate = lag_rate;
+            e->has_rates = true;
+        }
+    }
+
+    e->replay_pos = replay_pos;
+    e->lag = lag;
+    e->ts = *ts;
+    e->has_prev = true;
+}
+
+/*
+ ****************************************************************************
+ * Estimate time until standby catches up with the primary: lag divided by
+ * the speed of its reduction. Standby which doesn't reduce lag never
+ * catches up.
+ ****************************************************************************
+ */
+void format_catchup(struct replstat_entry_s * e, char * buf, size_t len)
+{
+    double eta;
+
+    if (e->lag <= 0) {
+        snprintf(buf, len, "00:00:00");
+    } else if (!e->has_rates || e->lag_rate >= 0) {
+        snprintf(buf, len, "never");
+    } else {
+        eta = e->lag / -e->lag_rate;
+        (eta >= 100 * 3600)
+            ? snprintf(buf, len, ">99h")
+            : snprintf(buf, len, "%02d:%02d:%02d",
+                    (int) eta / 3600, ((int) eta % 3600) / 60, (int) eta % 60);
+    }
+}
+
+/*
+ ****************************************************************************
+ * Get standbys which replicate from the standby, i.e. cascading standbys.
+ * Standby is connected with options of the tab and short statement timeout,
+ * failed attempts are repeated not often than REPLSTAT_RETRY.
+ ****************************************************************************
+ */
+void replstat_downstream(struct replstat_entry_s * e, const char * host, struct tab_s * tab)
+{
+    const char * keywords[] = { "host", "port", "user", "dbname", "password", "connect_timeout",
+                                "options", "application_name", NULL };
+    const char * values[] = { host, tab->port, tab->user, tab->dbname, tab->password, "1",
+                              "-c statement_timeout=" REPLSTAT_TIMEOUT, PROGRAM_NAME, NULL };
+    PGresult * res;
+
+    if (e->conn == NULL || PQstatus(e->conn) != CONNECTION_OK) {
+        PQfinish(e->conn);
+        e->conn = NULL;
+        if (strlen(host) == 0 || time(NULL) < e->retry_at) {
+            snprintf(e->downstream, sizeof(e->downstream), "%s", strlen(host) == 0 ? "" : "?");
+            return;
+        }
+
+        e->conn = PQconnectdbParams(keywords, values, 0);
+        if (PQstatus(e->conn) != CONNECTION_OK) {
+            PQfinish(e->conn);
+            e->conn = NULL;
+            e->retry_at = time(NULL) + REPLSTAT_RETRY;
+            snprintf(e->downstream, sizeof(e->downstream), "?");
+            return;
+        }
+    }
+
+    res = PQexec(e->conn, PG_REPL_DOWNSTREAM_QUERY);
+    if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 1)
+        snprintf(e->downstream, sizeof(e->downstream), "%s", PQgetvalue(res, 0, 0));
+    else
+        snprintf(e->downstream, sizeof(e->downstream), "?");
+    PQclear(res);
+}
+
+/*
+ ****************************************************************************
+ * Add WAL apply rate, lag trend, catch-up time and (optionally) cascading
+ * standbys to pg_stat_replication result. Standbys are tracked by client
+ * address and application name, not by position in the result, standbys
+ * which are gone are forgotten. Connections to standbys block the refresh,
+ * so only REPLSTAT_PROBES standbys are asked at once, in turn, others keep
+ * cascading standbys of their previous probe.
+ ****************************************************************************
+ */
+PGresult * merge_repl_stats(PGconn * conn, PGresult * res, struct tab_s * tab)
+{
+    static const char * names[REPLSTAT_COLS] = { "replay_kbs", "lag_trend", "catchup", "downstream" };
+    PGresult * new_res;
+    PGresAttDesc attrs[MAX_COLS];
+    struct replstat_s * rs;
+    struct replstat_entry_s * e;
+    struct timespec ts;
+    char key[S_BUF_LEN], values[REPLSTAT_COLS][S_BUF_LEN];
+    unsigned int i, j, k, n_rows = PQntuples(res), n_cols = PQnfields(res);
+
+    if (n_cols <= REPLSTAT_LAG_COL || n_cols + REPLSTAT_COLS > MAX_COLS)
+        return res;
+
+    if (tab->replstat == NULL)
+        tab->replstat = replstat_init();
+    rs = tab->replstat;
+
+    memset(attrs, 0, sizeof(attrs));
+    for (i = 0; i < n_cols + REPLSTAT_COLS; i++) {
+        if (i < n_cols) {
+            attrs[i].name = PQfname(res, i);
+            attrs[i].typid = PQftype(res, i);
+            attrs[i].typlen = PQfsize(res, i);
+            attrs[i].atttypmod = PQfmod(res, i);
+        } else {
+            attrs[i].name = (char *) names[i - n_cols];
+            attrs[i].typid = (i - n_cols < 2) ? FLOAT8OID : TEXTOID;
+            attrs[i].typlen = (i - n_cols < 2) ? 8 : -1;
+            attrs[i].atttypmod = -1;
+        }
+    }
+
+    if ((new_res = PQmakeEmptyPGresult(conn, PGRES_TUPLES_OK)) == NULL
+        || PQsetResultAttrs(new_res, n_cols + REPLSTAT_COLS, attrs) == 0) {
+        PQclear(new_res);
+        return res;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    for (i = 0; i < rs->used; i++)
+        rs->entries[i].seen = false;
+
+    for (i = 0; i < n_rows; i++) {
+        /* standbys with the same address and name are numbered */
+        for (j = 0, k = 0; j < i; j++)
+            if (!strcmp(PQgetvalue(res, i, REPLSTAT_CLIENT_COL), PQgetvalue(res, j, REPLSTAT_CLIENT_COL))
+                    && !strcmp(PQgetvalue(res, i, REPLSTAT_NAME_COL), PQgetvalue(res, j, REPLSTAT_NAME_COL)))
+                k++;
+        snprintf(key, sizeof(key), "%s/%s/%u",
+                PQgetvalue(res, i, REPLSTAT_CLIENT_COL), PQgetvalue(res, i, REPLSTAT_NAME_COL), k);
+
+        for (j = 0; j < REPLSTAT_COLS; j++)
+            values[j][0] = '\0';
+
+        if ((e = replstat_lookup(rs, key)) != NULL) {
+            e->seen = true;
+            /* replayed position is the current position minus total lag */
+            if (!PQgetisnull(res, i, REPLSTAT_LAG_COL))
+                replstat_update(e, atoll(PQgetvalue(res, i, REPLSTAT_WAL_COL)) - atoll(PQgetvalue(res, i, REPLSTAT_LAG_COL)),
+                        atoll(PQgetvalue(res, i, REPLSTAT_LAG_COL)), &ts);
+            if (e->has_rates) {
+                snprintf(values[0], sizeof(values[0]), "%.2f", e->replay_rate);
+                snprintf(values[1], sizeof(values[1]), "%.2f", e->lag_rate);
+            }
+            if (e->has_prev)
+                format_catchup(e, values[2], sizeof(values[2]));
+            if (rs->cascade) {
+                if ((i + n_rows - rs->probe_next % n_rows) % n_rows < REPLSTAT_PROBES)
+                    replstat_downstream(e, PQgetvalue(res, i, REPLSTAT_CLIENT_COL), tab);
+                snprintf(values[3], sizeof(values[3]), "%s", e->downstream);
+            }
+        }
+
+        for (j = 0; j < n_cols; j++)
+            PQsetvalue(new_res, i, j, PQgetvalue(res, i, j), PQgetlength(res, i, j));
+        for (j = 0; j < REPLSTAT_COLS; j++)
+            PQsetvalue(new_res, i, n_cols + j, values[j], strlen(values[j]));
+    }
+
+    if (n_rows > 0)
+        rs->probe_next = (rs->probe_next + REPLSTAT_PROBES) % n_rows;
+
+    /* forget standbys which are gone */
+    for (i = 0; i < rs->used; ) {
+        if (rs->entries[i].seen) {
+            i++;
+            continue;
+        }
+        PQfinish(rs->entries[i].conn);
+        rs->entries[i] = rs->entries[--rs->used];
+    }
+
+    PQclear(res);
+    return new_res;
+}
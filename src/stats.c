@@ -241,7 +241,7 @@ float * get_remote_loadavg(PGconn * conn)
     static float la[3];
     PGresult * res;
 
-    if ((res = do_query(conn, PG_SYS_PROC_LOADAVG_QUERY, errmsg)) != NULL
+    if ((res = do_prepared_query(conn, PG_SYS_PROC_LOADAVG_QUERY, 0, errmsg)) != NULL
         && PQntuples(res) > 0) {
         la[0] = atof(PQgetvalue(res, 0, 0));
         la[1] = atof(PQgetvalue(res, 0, 1));
@@ -304,7 +304,7 @@ void read_remote_uptime(unsigned long long *uptime, struct tab_s * tab, PGconn *
     int sys_hz = tab->sys_special.sys_hz;
     PGresult * res;
 
-    if ((res = do_query(conn, PG_SYS_PROC_UPTIME_QUERY, errmsg)) != NULL
+    if ((res = do_prepared_query(conn, PG_SYS_PROC_UPTIME_QUERY, 0, errmsg)) != NULL
         && PQntuples(res) > 0) {
         up_full = atof(PQgetvalue(res, 0, 0));
         PQclear(res);
@@ -405,7 +405,7 @@ void read_remote_cpu_stat(struct cpu_s *st_cpu, unsigned int nbr,
     PGresult * res_cpu_total;
     PGresult * res_cpu_part;
 
-    if ((res_cpu_total = do_query(conn, PG_SYS_PROC_TOTAL_CPU_STAT_QUERY, errmsg)) != NULL
+    if ((res_cpu_total = do_prepared_query(conn, PG_SYS_PROC_TOTAL_CPU_STAT_QUERY, 0, errmsg)) != NULL
         && PQntuples(res_cpu_total) > 0) {
         memset(st_cpu, 0, STATS_CPU_SIZE);
         /* fill st_cpu */
@@ -425,7 +425,7 @@ void read_remote_cpu_stat(struct cpu_s *st_cpu, unsigned int nbr,
                   st_cpu->cpu_hardirq + st_cpu->cpu_softirq +
                   st_cpu->cpu_guest + st_cpu->cpu_guest_nice;
         PQclear(res_cpu_total);
-    } else if ((res_cpu_part = do_query(conn, PG_SYS_PROC_PART_CPU_STAT_QUERY, errmsg)) != NULL
+    } else if ((res_cpu_part = do_prepared_query(conn, PG_SYS_PROC_PART_CPU_STAT_QUERY, 0, errmsg)) != NULL
         && PQntuples(res_cpu_part) > 0) {
         if (nbr > 1) {
             memset(&sc, 0, STATS_CPU_SIZE);
@@ -562,7 +562,7 @@ void read_remote_mem_stat(struct mem_s *st_mem_short, PGconn * conn)
     char * tmp;                     /* for strtoull() */
     PGresult * res;
 
-    if ((res = do_query(conn, PG_SYS_PROC_MEMINFO_QUERY, errmsg)) != NULL
+    if ((res = do_prepared_query(conn, PG_SYS_PROC_MEMINFO_QUERY, 0, errmsg)) != NULL
         && PQntuples(res) > 0) {
         if (!strcmp(PQgetvalue(res,0,0),"Buffers:"))
             st_mem_short->buffers = strtoull(PQgetvalue(res,0,1), &tmp, 10) / 1024;
@@ -632,8 +632,15 @@ void replace_iostat(struct iodata_s *curr[], struct iodata_s *prev[], int bdev)
         prev[i]->io_in_progress = curr[i]->io_in_progress;
         prev[i]->t_spent = curr[i]->t_spent;
         prev[i]->t_weighted = curr[i]->t_weighted;
+        prev[i]->d_completed = curr[i]->d_completed;
+        prev[i]->d_merged = curr[i]->d_merged;
+        prev[i]->d_sectors = curr[i]->d_sectors;
+        prev[i]->d_spent = curr[i]->d_spent;
+        prev[i]->f_completed = curr[i]->f_completed;
+        prev[i]->f_spent = curr[i]->f_spent;
         prev[i]->arqsz = curr[i]->arqsz;
         prev[i]->await = curr[i]->await;
+        prev[i]->f_await = curr[i]->f_await;
         prev[i]->util = curr[i]->util;
     }
 }
@@ -722,14 +729,16 @@ void get_time(char * strtime)
 void read_local_diskstats(WINDOW * window, struct iodata_s *curr[], int bdev, bool * repaint)
 {
     FILE *fp;
-    char line[L_BUF_LEN];
+    char line[X_BUF_LEN];
 
     unsigned int major, minor;
     char devname[S_BUF_LEN];
     unsigned long r_completed, r_merged, r_sectors, r_spent,
                   w_completed, w_merged, w_sectors, w_spent,
-                  io_in_progress, t_spent, t_weighted;
-    int i = 0;
+                  io_in_progress, t_spent, t_weighted,
+                  d_completed, d_merged, d_sectors, d_spent,
+                  f_completed, f_spent;
+    int i = 0, nfields;
     
     /*
      * If /proc/diskstats read failed, fire up repaint flag.
@@ -743,11 +752,23 @@ void read_local_diskstats(WINDOW * window, struct iodata_s *curr[], int bdev, bo
     }
 
     while ((fgets(line, sizeof(line), fp) != NULL) && (i < bdev)) {
-        sscanf(line, "%u %u %s %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu",
+        /* 
+         * Discard fields appeared in 4.18 and flush fields in 5.5, older 
+         * kernels provide less fields and missing counters are zeroed.
+         */
+        d_completed = d_merged = d_sectors = d_spent = f_completed = f_spent = 0;
+        nfields = sscanf(line, "%u %u %s %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu",
                     &major, &minor, devname,
                     &r_completed, &r_merged, &r_sectors, &r_spent,
                     &w_completed, &w_merged, &w_sectors, &w_spent,
-                    &io_in_progress, &t_spent, &t_weighted);
+                    &io_in_progress, &t_spent, &t_weighted,
+                    &d_completed, &d_merged, &d_sectors, &d_spent,
+                    &f_completed, &f_spent);
+        if (nfields < 18)
+            d_completed = d_merged = d_sectors = d_spent = 0;
+        if (nfields < 20)
+            f_completed = f_spent = 0;
+
         curr[i]->major = major;
         curr[i]->minor = minor;
         snprintf(curr[i]->devname, S_BUF_LEN, "%s", devname);
@@ -762,6 +783,12 @@ void read_local_diskstats(WINDOW * window, struct iodata_s *curr[], int bdev, bo
         curr[i]->io_in_progress = io_in_progress;
         curr[i]->t_spent = t_spent;
         curr[i]->t_weighted = t_weighted;
+        curr[i]->d_completed = d_completed;
+        curr[i]->d_merged = d_merged;
+        curr[i]->d_sectors = d_sectors;
+        curr[i]->d_spent = d_spent;
+        curr[i]->f_completed = f_completed;
+        curr[i]->f_spent = f_spent;
         i++;
     }
     fclose(fp);
@@ -779,7 +806,7 @@ void read_remote_diskstats(WINDOW * window, struct iodata_s * curr[], int bdev,
     PGresult * res;
     int i;
     
-    if ((res = do_query(conn, PG_SYS_PROC_DISKSTATS_QUERY, errmsg)) != NULL
+    if ((res = do_prepared_query(conn, PG_SYS_PROC_DISKSTATS_QUERY, 0, errmsg)) != NULL
         && PQntuples(res) > 0) {
         for (i = 0; i < bdev; i++) {
             curr[i]->major = strtoul(PQgetvalue(res, i, 0), &tmp, 10);
@@ -796,6 +823,17 @@ void read_remote_diskstats(WINDOW * window, struct iodata_s * curr[], int bdev,
             curr[i]->io_in_progress = strtoul(PQgetvalue(res, i, 11), &tmp, 10);
             curr[i]->t_spent = strtoul(PQgetvalue(res, i, 12), &tmp, 10);
             curr[i]->t_weighted = strtoul(PQgetvalue(res, i, 13), &tmp, 10);
+            /* extended fields are available only if the view provides them */
+            if (PQnfields(res) >= 18) {
+                curr[i]->d_completed = strtoul(PQgetvalue(res, i, 14), &tmp, 10);
+                curr[i]->d_merged = strtoul(PQgetvalue(res, i, 15), &tmp, 10);
+                curr[i]->d_sectors = strtoul(PQgetvalue(res, i, 16), &tmp, 10);
+                curr[i]->d_spent = strtoul(PQgetvalue(res, i, 17), &tmp, 10);
+            }
+            if (PQnfields(res) >= 20) {
+                curr[i]->f_completed = strtoul(PQgetvalue(res, i, 18), &tmp, 10);
+                curr[i]->f_spent = strtoul(PQgetvalue(res, i, 19), &tmp, 10);
+            }
         }
         PQclear(res);
     } else {
@@ -810,16 +848,49 @@ void read_remote_diskstats(WINDOW * window, struct iodata_s * curr[], int bdev,
     }
 }
 
+/*
+ ****************************************************************************
+ * Save await of the last interval into device's ring buffer and calculate
+ * await distribution (p50, p95, max) over the buffered intervals.
+ ****************************************************************************
+ */
+void update_await_distribution(struct iodata_s * dev, double await)
+{
+    double sorted[AWAIT_SAMPLES], tmp;
+    unsigned int i, j;
+
+    dev->await_samples[dev->await_pos] = await;
+    dev->await_pos = (dev->await_pos + 1) % AWAIT_SAMPLES;
+    if (dev->await_cnt < AWAIT_SAMPLES)
+        dev->await_cnt++;
+
+    /* buffer is small, so insertion sort is enough */
+    for (i = 0; i < dev->await_cnt; i++) {
+        tmp = dev->await_samples[i];
+        for (j = i; j > 0 && sorted[j - 1] > tmp; j--)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = tmp;
+    }
+
+    /* nearest-rank percentiles */
+    dev->await_p50 = sorted[(dev->await_cnt * 50 + 99) / 100 - 1];
+    dev->await_p95 = sorted[(dev->await_cnt * 95 + 99) / 100 - 1];
+    dev->await_max = sorted[dev->await_cnt - 1];
+}
+
 /*
  ****************************************************************************
  * Calculate IO stats and print it out.
+ * If min_util is not negative, devices are sorted by %util and devices with
+ * lower %util are hidden.
  ****************************************************************************
  */
 void write_iostat(WINDOW * window, struct iodata_s * curr[], struct iodata_s * prev[], 
-        int bdev, unsigned long long itv, int sys_hz)
+        int bdev, unsigned long long itv, int sys_hz, double min_util)
 {
-    int i = 0;
+    int i = 0, j, k;
     double r_await[bdev], w_await[bdev];
+    int order[bdev];                    /* devices in order of printing */
     
     for (i = 0; i < bdev; i++) {
         curr[i]->util = S_VALUE(prev[i]->t_spent, curr[i]->t_spent, itv, sys_hz);
@@ -829,6 +900,9 @@ void write_iostat(WINDOW * window, struct iodata_s * curr[], struct iodata_s * p
         curr[i]->arqsz = ((curr[i]->r_completed + curr[i]->w_completed) - (prev[i]->r_completed + prev[i]->w_completed)) ?
             ((curr[i]->r_sectors - prev[i]->r_sectors) + (curr[i]->w_sectors - prev[i]->w_sectors)) /
             ((double) ((curr[i]->r_completed + curr[i]->w_completed) - (prev[i]->r_completed + prev[i]->w_completed))) : 0.0;
+        curr[i]->f_await = (curr[i]->f_completed - prev[i]->f_completed) ?
+            (curr[i]->f_spent - prev[i]->f_spent) /
+            ((double) (curr[i]->f_completed - prev[i]->f_completed)) : 0.0;
 
         r_await[i] = (curr[i]->r_completed - prev[i]->r_completed) ?
             (curr[i]->r_spent - prev[i]->r_spent) /
@@ -836,20 +910,38 @@ void write_iostat(WINDOW * window, struct iodata_s * curr[], struct iodata_s * p
         w_await[i] = (curr[i]->w_completed - prev[i]->w_completed) ?
             (curr[i]->w_spent - prev[i]->w_spent) /
             ((double) (curr[i]->w_completed - prev[i]->w_completed)) : 0.0;
+
+        /* 
+         * Collect await only for intervals with completed IOs, the first 
+         * snapshot has no previous values and its await is since boot.
+         */
+        if ((prev[i]->r_completed + prev[i]->w_completed) != 0
+            && (curr[i]->r_completed + curr[i]->w_completed) != (prev[i]->r_completed + prev[i]->w_completed))
+            update_await_distribution(curr[i], curr[i]->await);
+
+        /* sort devices by %util (desc) if required */
+        for (j = i; min_util >= 0 && j > 0 && curr[order[j - 1]]->util < curr[i]->util; j--)
+            order[j] = order[j - 1];
+        order[j] = i;
     }
 
     /* print headers */
     wclear(window);
     wattron(window, A_BOLD);
-    wprintw(window, "\nDevice:           rrqm/s  wrqm/s      r/s      w/s    rMB/s    wMB/s avgrq-sz avgqu-sz     await   r_await   w_await   %%util\n");
+    wprintw(window, "\nDevice:           rrqm/s  wrqm/s      r/s      w/s    rMB/s    wMB/s avgrq-sz avgqu-sz     await   r_await   w_await      f/s   f_await      d/s   aw_p50   aw_p95   aw_max   %%util\n");
     wattroff(window, A_BOLD);
 
     /* print statistics */
-    for (i = 0; i < bdev; i++) {
+    for (k = 0; k < bdev; k++) {
+        i = order[k];
         /* skip devices without iops */
         if (curr[i]->r_completed == 0 && curr[i]->w_completed == 0) {
             continue;
         }
+        /* skip devices below %util threshold */
+        if (min_util >= 0 && curr[i]->util / 10.0 < min_util) {
+            continue;
+        }
         wprintw(window, "%6s:\t\t", curr[i]->devname);
         wprintw(window, "%8.2f%8.2f",
                 S_VALUE(prev[i]->r_merged, curr[i]->r_merged, itv, sys_hz),
@@ -863,6 +955,11 @@ void write_iostat(WINDOW * window, struct iodata_s * curr[], struct iodata_s * p
                 curr[i]->arqsz,
                 S_VALUE(prev[i]->t_weighted, curr[i]->t_weighted, itv, sys_hz) / 1000.0);
         wprintw(window, "%10.2f%10.2f%10.2f", curr[i]->await, r_await[i], w_await[i]);
+        wprintw(window, "%9.2f%10.2f%9.2f",
+                S_VALUE(prev[i]->f_completed, curr[i]->f_completed, itv, sys_hz),
+                curr[i]->f_await,
+                S_VALUE(prev[i]->d_completed, curr[i]->d_completed, itv, sys_hz));
+        wprintw(window, "%9.2f%9.2f%9.2f", curr[i]->await_p50, curr[i]->await_p95, curr[i]->await_max);
         wprintw(window, "%8.2f", curr[i]->util / 10.0);
         wprintw(window, "\n");
     }
@@ -935,7 +1032,7 @@ void read_remote_netdev(WINDOW * window, struct ifdata_s *curr[], int idev, PGco
     PGresult * res;
     int i;
     
-    if ((res = do_query(conn, PG_SYS_PROC_NETDEV_QUERY, errmsg)) != NULL
+    if ((res = do_prepared_query(conn, PG_SYS_PROC_NETDEV_QUERY, 0, errmsg)) != NULL
         && PQntuples(res) > 0) {
         for (i = 0; i < idev; i++) {
             snprintf(curr[i]->ifname, IF_NAMESIZE + 1, "%s", PQgetvalue(res, i, 0));
@@ -0,0 +1,351 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+ ****************************************************************************
+ * waitprof.c
+ *      wait events sampling profiler.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#include "include/waitprof.h"
+
+/*
+ ****************************************************************************
+ * Allocate and initialize profiler state.
+ ****************************************************************************
+ */
+struct waitprof_s * waitprof_init(void)
+{
+    struct waitprof_s * wp;
+
+    if ((wp = (struct waitprof_s *) malloc(WAITPROF_SIZE)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for wait profile failed.\n");
+    }
+    memset(wp, 0, WAITPROF_SIZE);
+    clock_gettime(CLOCK_MONOTONIC, &wp->started);
+
+    return wp;
+}
+
+/*
+ ****************************************************************************
+ * Get current time into ts and return it as seconds since start.
+ ****************************************************************************
+ */
+double waitprof_time(struct waitprof_s * wp, struct timespec * ts)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    return (ts->tv_sec - wp->started.tv_sec) + (ts->tv_nsec - wp->started.tv_nsec) / 1000000000.0;
+}
+
+/*
+ ****************************************************************************
+ * Return factor which converts scaled weights into decayed weights at now.
+ ****************************************************************************
+ */
+double waitprof_decay(struct waitprof_s * wp, double now)
+{
+    return exp(-(now - wp->base) / WAITPROF_WINDOW);
+}
+
+/*
+ ****************************************************************************
+ * Find entry with the given fields. Query is compared by identifier, if it's
+ * known, otherwise by text. Return the entry or empty slot where the entry
+ * should be placed. Table is never full, see waitprof_add().
+ ****************************************************************************
+ */
+struct waitprof_entry_s * waitprof_lookup(struct waitprof_s * wp, unsigned int hash, const char * state,
+        const char * wait_etype, const char * wait_event, long long queryid, const char * query)
+{
+    struct waitprof_entry_s * e;
+    unsigned int i = hash & (WAITPROF_MAX_ENTRIES - 1);
+
+    for (e = &wp->entries[i]; e->hash != 0; e = &wp->entries[i]) {
+        if (e->hash == hash && e->queryid == queryid && (queryid != 0 || !strcmp(e->query, query))
+                && !strcmp(e->wait_event, wait_event) && !strcmp(e->wait_etype, wait_etype)
+                && !strcmp(e->state, state))
+            break;
+        i = (i + 1) & (WAITPROF_MAX_ENTRIES - 1);
+    }
+
+    return e;
+}
+
+/*
+ ****************************************************************************
+ * Drop entries which have decayed below minimal weight, their weight is
+ * moved into others. Entries are rehashed into cleaned table.
+ ****************************************************************************
+ */
+void waitprof_compact(struct waitprof_s * wp)
+{
+    struct waitprof_entry_s * old, * e;
+    double decay = waitprof_decay(wp, (wp->last.tv_sec - wp->started.tv_sec)
+                + (wp->last.tv_nsec - wp->started.tv_nsec) / 1000000000.0);
+    unsigned int i;
+
+    if ((old = malloc(sizeof(wp->entries))) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for wait profile failed.\n");
+    }
+    memcpy(old, wp->entries, sizeof(wp->entries));
+    memset(wp->entries, 0, sizeof(wp->entries));
+    wp->used = 0;
+
+    for (i = 0; i < WAITPROF_MAX_ENTRIES; i++) {
+        if (old[i].hash == 0)
+            continue;
+        if (old[i].weight * decay < WAITPROF_MIN_WEIGHT) {
+            wp->other += old[i].weight;
+            continue;
+        }
+        e = waitprof_lookup(wp, old[i].hash, old[i].state, old[i].wait_etype, old[i].wait_event,
+                old[i].queryid, old[i].query);
+        *e = old[i];
+        wp->used++;
+    }
+
+    free(old);
+}
+
+/*
+ ****************************************************************************
+ * Add observation with the given weight into profile. When table is full
+ * and nothing can be dropped, observation is accounted in others.
+ ****************************************************************************
+ */
+void waitprof_add(struct waitprof_s * wp, double weight, const char * state,
+        const char * wait_etype, const char * wait_event, long long queryid, const char * query)
+{
+    struct waitprof_entry_s * e;
+    char key[L_BUF_LEN + S_BUF_LEN * 3];
+    unsigned int hash;
+    int len;
+
+    len = (queryid != 0)
+        ? snprintf(key, sizeof(key), "%s|%s|%s|#%lld", state, wait_etype, wait_event, queryid)
+        : snprintf(key, sizeof(key), "%s|%s|%s|%s", state, wait_etype, wait_event, query);
+    if ((hash = hash_text(key, min((size_t) len, sizeof(key) - 1))) == 0)
+        hash = 1;
+
+    e = waitprof_lookup(wp, hash, state, wait_etype, wait_event, queryid, query);
+    if (e->hash == 0) {
+        if (wp->used * 4 >= WAITPROF_MAX_ENTRIES * 3) {
+            waitprof_compact(wp);
+            e = waitprof_lookup(wp, hash, state, wait_etype, wait_event, queryid, query);
+        }
+        if (wp->used * 4 >= WAITPROF_MAX_ENTRIES * 3) {
+            wp->other += weight;
+            return;
+        }
+        e->hash = hash;
+        e->weight = 0;
+        e->hits = 0;
+        e->queryid = queryid;
+        snprintf(e->state, sizeof(e->state), "%s", state);
+        snprintf(e->wait_etype, sizeof(e->wait_etype), "%s", wait_etype);
+        snprintf(e->wait_event, sizeof(e->wait_event), "%s", wait_event);
+        snprintf(e->query, sizeof(e->query), "%s", query);
+        wp->used++;
+    }
+
+    e->weight += weight;
+    e->hits++;
+}
+
+/*
+ ****************************************************************************
+ * Account sessions of the sample into profile. Active sessions which don't
+ * wait are shown as CPU. Queries are aggregated by identifier, when it's
+ * known. Otherwise query texts are normalized with literals, so the same
+ * queries with different values are aggregated together. Comments are
+ * removed before masking, lists of values are collapsed after it.
+ ****************************************************************************
+ */
+void waitprof_feed(struct waitprof_s * wp, PGresult * res)
+{
+    char query[L_BUF_LEN], buf[XL_BUF_LEN], masked[XL_BUF_LEN];
+    const char * state, * wait_etype;
+    long long queryid;
+    double now, scale, factor;
+    int i;
+
+    now = waitprof_time(wp, &wp->last);
+
+    /* new observations weigh more than old ones, rescale before overflow */
+    if ((scale = exp((now - wp->base) / WAITPROF_WINDOW)) > WAITPROF_RESCALE) {
+        factor = 1 / scale;
+        for (i = 0; i < WAITPROF_MAX_ENTRIES; i++)
+            wp->entries[i].weight *= factor;
+        wp->samples *= factor;
+        wp->other *= factor;
+        wp->base = now;
+        scale = 1;
+    }
+
+    wp->samples += scale;
+    for (i = 0; i < PQntuples(res); i++) {
+        state = PQgetvalue(res, i, 0);
+        wait_etype = PQgetvalue(res, i, 1);
+        if (wait_etype[0] == '\0' && !strcmp(state, "active"))
+            wait_etype = "CPU";
+        normalize_query(PQgetvalue(res, i, 3), buf, sizeof(buf));
+        mask_literals(buf, masked, sizeof(masked));
+        normalize_query(masked, query, sizeof(query));
+        queryid = (PQnfields(res) > WAITPROF_QUERYID_COL && !PQgetisnull(res, i, WAITPROF_QUERYID_COL))
+                ? strtoll(PQgetvalue(res, i, WAITPROF_QUERYID_COL), NULL, 10) : 0;
+        waitprof_add(wp, scale, state, wait_etype, PQgetvalue(res, i, 2), queryid, query);
+    }
+}
+
+/*
+ ****************************************************************************
+ * Take one sample using prepared statement. Return false on error.
+ ****************************************************************************
+ */
+bool waitprof_sample(struct waitprof_s * wp, PGconn * conn, struct tab_s * tab)
+{
+    PGresult * res;
+    const char * query;
+
+    if (PQstatus(conn) != CONNECTION_OK)
+        return false;
+
+    if (atoi(tab->pg_special.pg_version_num) < PG96)
+        query = PG_WAIT_SAMPLE_95_QUERY;
+    else if (atoi(tab->pg_special.pg_version_num) < PG14)
+        query = PG_WAIT_SAMPLE_QUERY;
+    else
+        query = PG_WAIT_SAMPLE_14_QUERY;
+
+    res = exec_prepared(conn, query, 0, NULL, 0);
+    if (PQresultStatus(res) != PG_TUP_OK) {
+        PQclear(res);
+        return false;
+    }
+
+    waitprof_feed(wp, res);
+    PQclear(res);
+    return true;
+}
+
+/*
+ ****************************************************************************
+ * Take samples at WAITPROF_PERIOD rate during usec microseconds. Used
+ * instead of sleeping between refreshes. On error just sleep the rest.
+ ****************************************************************************
+ */
+void sample_wait_events(PGconn * conn, struct tab_s * tab, unsigned long usec)
+{
+    struct waitprof_s * wp;
+    struct timespec start, now;
+    double elapsed, since_last;
+
+    if (tab->waitprof == NULL)
+        tab->waitprof = waitprof_init();
+    wp = tab->waitprof;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (1) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed = (now.tv_sec - start.tv_sec) * 1000000.0 + (now.tv_nsec - start.tv_nsec) / 1000.0;
+        since_last = (now.tv_sec - wp->last.tv_sec) * 1000000.0 + (now.tv_nsec - wp->last.tv_nsec) / 1000.0;
+        if (elapsed >= usec)
+            break;
+
+        if (since_last >= WAITPROF_PERIOD) {
+            if (waitprof_sample(wp, conn, tab) == false) {
+                usleep((useconds_t) (usec - elapsed));
+                break;
+            }
+            continue;
+        }
+
+        usleep((useconds_t) (min(WAITPROF_PERIOD - since_last, usec - elapsed)));
+    }
+}
+
+/*
+ ****************************************************************************
+ * Build profile result. Source result is a sample taken by the main loop,
+ * it's accounted if previous sample isn't too recent. Sessions column is
+ * the average number of sessions in the state, time_pct is the share of
+ * the total time. Source result is freed.
+ ****************************************************************************
+ */
+PGresult * merge_wait_profile(PGconn * conn, PGresult * res, struct tab_s * tab)
+{
+    static const char * names[WAITPROF_COLS] = { "sessions", "time_pct", "state", "wait_etype", "wait_event", "query" };
+    PGresult * new_res;
+    PGresAttDesc attrs[WAITPROF_COLS];
+    struct waitprof_s * wp;
+    struct waitprof_entry_s * e;
+    struct timespec ts;
+    double now, decay, total;
+    char sessions[XS_BUF_LEN], pct[XS_BUF_LEN];
+    const char * values[WAITPROF_COLS];
+    unsigned int i, j, row = 0;
+
+    if (tab->waitprof == NULL)
+        tab->waitprof = waitprof_init();
+    wp = tab->waitprof;
+
+    now = waitprof_time(wp, &ts);
+    if ((ts.tv_sec - wp->last.tv_sec) * 1000000.0 + (ts.tv_nsec - wp->last.tv_nsec) / 1000.0 >= WAITPROF_PERIOD)
+        waitprof_feed(wp, res);
+
+    memset(attrs, 0, sizeof(attrs));
+    for (i = 0; i < WAITPROF_COLS; i++) {
+        attrs[i].name = (char *) names[i];
+        attrs[i].typid = (i < 2) ? 701 : 25;        /* float8 or text */
+        attrs[i].typlen = (i < 2) ? 8 : -1;
+        attrs[i].atttypmod = -1;
+    }
+
+    if ((new_res = PQmakeEmptyPGresult(conn, PGRES_TUPLES_OK)) == NULL
+        || PQsetResultAttrs(new_res, WAITPROF_COLS, attrs) == 0) {
+        PQclear(new_res);
+        return res;
+    }
+    PQclear(res);
+
+    if (wp->samples <= 0)
+        return new_res;
+
+    decay = waitprof_decay(wp, now);
+    for (i = 0, total = wp->other; i < WAITPROF_MAX_ENTRIES; i++)
+        total += wp->entries[i].weight;
+
+    /* entries and others, others go the last */
+    for (i = 0; i <= WAITPROF_MAX_ENTRIES; i++) {
+        if (i < WAITPROF_MAX_ENTRIES) {
+            e = &wp->entries[i];
+            if (e->hash == 0 || e->weight * decay < WAITPROF_SHOW_WEIGHT)
+                continue;
+            values[2] = e->state;
+            values[3] = e->wait_etype;
+            values[4] = e->wait_event;
+            values[5] = e->query;
+            snprintf(sessions, sizeof(sessions), "%.2f", e->weight / wp->samples);
+            snprintf(pct, sizeof(pct), "%.1f", e->weight / total * 100);
+        } else {
+            if (wp->other * decay < WAITPROF_SHOW_WEIGHT)
+                continue;
+            values[2] = values[3] = values[4] = "";
+            values[5] = "(other)";
+            snprintf(sessions, sizeof(sessions), "%.2f", wp->other / wp->samples);
+            snprintf(pct, sizeof(pct), "%.1f", wp->other / total * 100);
+        }
+        values[0] = sessions;
+        values[1] = pct;
+
+        for (j = 0; j < WAITPROF_COLS; j++)
+            PQsetvalue(new_res, row, j, (char *) values[j], strlen(values[j]));
+        row++;
+    }
+
+    return new_res;
+}
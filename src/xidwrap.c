@@ -0,0 +1,291 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+/*
+ ****************************************************************************
+ * xidwrap.c
+ *      transaction ID wraparound risk of databases and tables.
+ *
+ * (C) 2016 by Alexey V. Lesovsky (lesovsky <at> gmail.com)
+ *
+ ****************************************************************************
+ */
+#include "include/xidwrap.h"
+
+/*
+ ****************************************************************************
+ * Allocate wraparound state.
+ ****************************************************************************
+ */
+struct xidwrap_s * xidwrap_init(void)
+{
+    struct xidwrap_s * xw;
+
+    if ((xw = (struct xidwrap_s *) malloc(XIDWRAP_SIZE)) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for wraparound stats failed.\n");
+    }
+    memset(xw, 0, XIDWRAP_SIZE);
+
+    return xw;
+}
+
+/*
+ ****************************************************************************
+ * Free wraparound state.
+ ****************************************************************************
+ */
+void free_xidwrap(struct xidwrap_s * xw)
+{
+    if (xw == NULL)
+        return;
+
+    free(xw->tables);
+    free(xw);
+}
+
+/*
+ ****************************************************************************
+ * Update XID consumption rate using the next XID sample. Rate is smoothed,
+ * too frequent samples (e.g. after context switch) are skipped.
+ ****************************************************************************
+ */
+void xidwrap_update_rate(struct xidwrap_s * xw, long long xid, struct timespec * ts)
+{
+    double elapsed, rate;
+
+    if (xw->has_prev) {
+        elapsed = (ts->tv_sec - xw->ts.tv_sec) + (ts->tv_nsec - xw->ts.tv_nsec) / 1000000000.0;
+        if (elapsed < XIDWRAP_MIN_ELAPSED)
+            return;
+
+        rate = (xid - xw->xid) / elapsed;
+        if (rate < 0)                   /* connected to another server */
+            rate = 0;
+
+        if (xw->has_rate) {
+            xw->rate += XIDWRAP_SMOOTH * (rate - xw->rate);
+        } else {
+            xw->rate = rate;
+            xw->has_rate = true;
+        }
+    }
+
+    xw->xid = xid;
+    xw->ts = *ts;
+    xw->has_prev = true;
+}
+
+/*
+ ****************************************************************************
+ * Check ages of the next slice of tables. Tables are checked in order of
+ * their oids starting after the last checked one, thus all tables are
+ * checked every (number of tables / XIDWRAP_SLICE) refreshes. Known tables
+ * from the checked range of oids which aren't returned are dropped ones.
+ ****************************************************************************
+ */
+void xidwrap_scan_slice(struct xidwrap_s * xw, PGconn * conn)
+{
+    PGresult * res;
+    struct xidwrap_table_s * tables, * t;
+    const char * params[2];
+    char cursor[XS_BUF_LEN], limit[XS_BUF_LEN];
+    unsigned int i, n = 0, n_rows, last;
+
+    snprintf(cursor, sizeof(cursor), "%u", xw->cursor);
+    snprintf(limit, sizeof(limit), "%u", XIDWRAP_SLICE);
+    params[0] = cursor;
+    params[1] = limit;
+
+    res = exec_prepared(conn, PG_XID_TABLES_SLICE_QUERY, 2, params, 0);
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        PQclear(res);
+        return;
+    }
+
+    /* the end of the list is reached, the range is up to the last oid */
+    n_rows = PQntuples(res);
+    last = (n_rows < XIDWRAP_SLICE) ? UINT_MAX : strtoul(PQgetvalue(res, n_rows - 1, 0), NULL, 10);
+
+    if ((tables = malloc(sizeof(struct xidwrap_table_s) * (xw->used + n_rows + 1))) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for wraparound stats failed.\n");
+    }
+
+    for (i = 0; i < xw->used && xw->tables[i].relid <= xw->cursor; i++)
+        tables[n++] = xw->tables[i];
+    for (i = 0; i < n_rows; i++) {
+        t = &tables[n++];
+        t->relid = strtoul(PQgetvalue(res, i, 0), NULL, 10);
+        snprintf(t->name, sizeof(t->name), "%s", PQgetvalue(res, i, 1));
+        t->age = atoll(PQgetvalue(res, i, 2));
+        t->freeze_max = atoll(PQgetvalue(res, i, 3));
+        t->xid = atoll(PQgetvalue(res, i, 4));
+    }
+    for (i = 0; i < xw->used; i++)
+        if (xw->tables[i].relid > last)
+            tables[n++] = xw->tables[i];
+
+    free(xw->tables);
+    xw->tables = tables;
+    xw->used = n;
+    xw->cursor = (last == UINT_MAX) ? 0 : last;
+
+    PQclear(res);
+}
+
+/*
+ ****************************************************************************
+ * Tables comparison function for qsort, the oldest tables go first. Tables
+ * are checked at different times, so ages are compared as of the same XID.
+ ****************************************************************************
+ */
+int xidwrap_age_cmp(const void * a, const void * b)
+{
+    const struct xidwrap_table_s * ta = *(const struct xidwrap_table_s * const *) a;
+    const struct xidwrap_table_s * tb = *(const struct xidwrap_table_s * const *) b;
+    long long ka = ta->age - ta->xid, kb = tb->age - tb->xid;
+
+    return (ka < kb) - (ka > kb);
+}
+
+/*
+ ****************************************************************************
+ * Estimate time until the age reaches the limit with the current XID
+ * consumption rate.
+ ****************************************************************************
+ */
+void format_xid_eta(struct xidwrap_s * xw, long long age, long long limit, char * buf, size_t len)
+{
+    double eta;
+
+    if (age >= limit) {
+        snprintf(buf, len, "due");
+    } else if (!xw->has_rate || xw->rate <= 0) {
+        snprintf(buf, len, "never");
+    } else {
+        eta = (limit - age) / xw->rate;
+        if (eta >= 1000 * 86400)
+            snprintf(buf, len, ">999d");
+        else if (eta >= 86400)
+            snprintf(buf, len, "%dd %02dh", (int) (eta / 86400), ((int) (eta / 3600)) % 24);
+        else
+            snprintf(buf, len, "%02d:%02d:%02d",
+                    (int) eta / 3600, ((int) eta % 3600) / 60, (int) eta % 60);
+    }
+}
+
+/*
+ ****************************************************************************
+ * Replace databases ages with wraparound risk panel: XID consumption rate
+ * of the cluster, ages of databases and the oldest tables of the current
+ * database, and time left until forced autovacuum (autovacuum_freeze_max_age)
+ * and until the server stops assigning new XIDs. Ages of tables are
+ * projected from the time of their last check using the next XID.
+ ****************************************************************************
+ */
+PGresult * merge_xid_wraparound(PGconn * conn, PGresult * res, struct tab_s * tab)
+{
+    static const char * names[XIDWRAP_COLS] = { "kind", "name", "age", "freeze_max",
+        "freeze_pct", "xid_rate", "freeze_eta", "wrap_eta" };
+    static const Oid types[XIDWRAP_COLS] = { TEXTOID, TEXTOID, INT8OID, INT8OID,
+        FLOAT8OID, FLOAT8OID, TEXTOID, TEXTOID };
+    PGresult * new_res;
+    PGresAttDesc attrs[XIDWRAP_COLS];
+    struct xidwrap_s * xw;
+    struct xidwrap_table_s ** oldest;
+    struct timespec ts;
+    char values[XIDWRAP_COLS][S_BUF_LEN];
+    unsigned int i, j, row = 0, n_rows = PQntuples(res), n_top;
+    long long xid, age, max_age = 0, freeze_max = 0;
+
+    if (PQnfields(res) <= XIDWRAP_FREEZE_COL || n_rows == 0)
+        return res;
+
+    memset(attrs, 0, sizeof(attrs));
+    for (i = 0; i < XIDWRAP_COLS; i++) {
+        attrs[i].name = (char *) names[i];
+        attrs[i].typid = types[i];
+        attrs[i].typlen = (types[i] == TEXTOID) ? -1 : 8;
+        attrs[i].atttypmod = -1;
+    }
+
+    if ((new_res = PQmakeEmptyPGresult(conn, PGRES_TUPLES_OK)) == NULL
+        || PQsetResultAttrs(new_res, XIDWRAP_COLS, attrs) == 0) {
+        PQclear(new_res);
+        return res;
+    }
+
+    if (tab->xidwrap == NULL)
+        tab->xidwrap = xidwrap_init();
+    xw = tab->xidwrap;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    xid = atoll(PQgetvalue(res, 0, XIDWRAP_XID_COL));
+    xidwrap_update_rate(xw, xid, &ts);
+    xidwrap_scan_slice(xw, conn);
+
+    /* databases, the oldest one defines the age of cluster */
+    for (i = 0; i < n_rows; i++) {
+        age = atoll(PQgetvalue(res, i, XIDWRAP_DATAGE_COL));
+        freeze_max = atoll(PQgetvalue(res, i, XIDWRAP_FREEZE_COL));
+        max_age = (age > max_age) ? age : max_age;
+
+        snprintf(values[0], sizeof(values[0]), "database");
+        snprintf(values[1], sizeof(values[1]), "%s", PQgetvalue(res, i, XIDWRAP_DATNAME_COL));
+        snprintf(values[2], sizeof(values[2]), "%lli", age);
+        snprintf(values[3], sizeof(values[3]), "%lli", freeze_max);
+        snprintf(values[4], sizeof(values[4]), "%.2f", freeze_max > 0 ? 100.0 * age / freeze_max : 0);
+        values[5][0] = '\0';
+        format_xid_eta(xw, age, freeze_max, values[6], sizeof(values[6]));
+        format_xid_eta(xw, age, XIDWRAP_STOP_AGE, values[7], sizeof(values[7]));
+
+        for (j = 0; j < XIDWRAP_COLS; j++)
+            PQsetvalue(new_res, row, j, values[j], strlen(values[j]));
+        row++;
+    }
+
+    snprintf(values[0], sizeof(values[0]), "cluster");
+    snprintf(values[1], sizeof(values[1]), "all databases");
+    snprintf(values[2], sizeof(values[2]), "%lli", max_age);
+    snprintf(values[3], sizeof(values[3]), "%lli", freeze_max);
+    snprintf(values[4], sizeof(values[4]), "%.2f", freeze_max > 0 ? 100.0 * max_age / freeze_max : 0);
+    if (xw->has_rate)
+        snprintf(values[5], sizeof(values[5]), "%.2f", xw->rate);
+    else
+        values[5][0] = '\0';
+    format_xid_eta(xw, max_age, freeze_max, values[6], sizeof(values[6]));
+    format_xid_eta(xw, max_age, XIDWRAP_STOP_AGE, values[7], sizeof(values[7]));
+    for (j = 0; j < XIDWRAP_COLS; j++)
+        PQsetvalue(new_res, row, j, values[j], strlen(values[j]));
+    row++;
+
+    /* the oldest tables of the current database */
+    if ((oldest = malloc(sizeof(struct xidwrap_table_s *) * (xw->used + 1))) == NULL) {
+        mreport(true, msg_fatal, "FATAL: malloc for wraparound stats failed.\n");
+    }
+    for (i = 0; i < xw->used; i++)
+        oldest[i] = &xw->tables[i];
+    qsort(oldest, xw->used, sizeof(struct xidwrap_table_s *), xidwrap_age_cmp);
+
+    n_top = (xw->used < XIDWRAP_TOP) ? xw->used : XIDWRAP_TOP;
+    for (i = 0; i < n_top; i++) {
+        age = oldest[i]->age + (xid - oldest[i]->xid);
+
+        snprintf(values[0], sizeof(values[0]), "table");
+        snprintf(values[1], sizeof(values[1]), "%s", oldest[i]->name);
+        snprintf(values[2], sizeof(values[2]), "%lli", age);
+        snprintf(values[3], sizeof(values[3]), "%lli", oldest[i]->freeze_max);
+        snprintf(values[4], sizeof(values[4]), "%.2f",
+                oldest[i]->freeze_max > 0 ? 100.0 * age / oldest[i]->freeze_max : 0);
+        values[5][0] = '\0';
+        format_xid_eta(xw, age, oldest[i]->freeze_max, values[6], sizeof(values[6]));
+        format_xid_eta(xw, age, XIDWRAP_STOP_AGE, values[7], sizeof(values[7]));
+
+        for (j = 0; j < XIDWRAP_COLS; j++)
+            PQsetvalue(new_res, row, j, values[j], strlen(values[j]));
+        row++;
+    }
+    free(oldest);
+
+    PQclear(res);
+    return new_res;
+}